@@ -0,0 +1,55 @@
+﻿using System.Text.RegularExpressions;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.Diagnostics;
+
+namespace dotnes.analyzers;
+
+/// <summary>
+/// Reads the *.nescost.json file written by the TranspileToNES task.
+/// Each statement is a JSON object on its own line, so no JSON library is needed.
+/// </summary>
+record CostHint(string Document, int Line, int Column, int EndLine, int EndColumn, int Bytes, int TotalCycles, bool Exact, string[] Calls)
+{
+    public const string Extension = ".nescost.json";
+
+    static readonly Regex Statement = new(@"^\s*\{""ilOffset"": \d+, ""document"": ""(?<document>(?:[^""\\]|\\.)*)"", ""line"": (?<line>\d+), ""column"": (?<column>\d+), ""endLine"": (?<endLine>\d+), ""endColumn"": (?<endColumn>\d+), ""bytes"": (?<bytes>\d+), ""cycles"": \d+, ""calls"": \[(?<calls>.*)\], ""totalCycles"": (?<totalCycles>\d+), ""exact"": (?<exact>true|false)\},?\s*$");
+    static readonly Regex CallName = new(@"\{""name"": ""(?<name>[^""]*)""");
+
+    public static List<CostHint> Read(IEnumerable<AdditionalText> files, CancellationToken cancellationToken)
+    {
+        var hints = new List<CostHint>();
+        foreach (var file in files)
+        {
+            if (!file.Path.EndsWith(Extension, StringComparison.OrdinalIgnoreCase))
+                continue;
+            var text = file.GetText(cancellationToken);
+            if (text is null)
+                continue;
+
+            foreach (var line in text.Lines)
+            {
+                var match = Statement.Match(line.ToString());
+                if (!match.Success)
+                    continue;
+                hints.Add(new CostHint(
+                    Regex.Unescape(match.Groups["document"].Value),
+                    int.Parse(match.Groups["line"].Value),
+                    int.Parse(match.Groups["column"].Value),
+                    int.Parse(match.Groups["endLine"].Value),
+                    int.Parse(match.Groups["endColumn"].Value),
+                    int.Parse(match.Groups["bytes"].Value),
+                    int.Parse(match.Groups["totalCycles"].Value),
+                    match.Groups["exact"].Value == "true",
+                    CallName.Matches(match.Groups["calls"].Value).Cast<Match>().Select(m => m.Groups["name"].Value).ToArray()));
+            }
+        }
+        return hints;
+    }
+
+    /// <summary>
+    /// PDB paths are absolute, but compare file names too in case the project moved
+    /// </summary>
+    public bool IsFor(string path) =>
+        string.Equals(Document, path, StringComparison.OrdinalIgnoreCase) ||
+        string.Equals(Path.GetFileName(Document), Path.GetFileName(path), StringComparison.OrdinalIgnoreCase);
+}
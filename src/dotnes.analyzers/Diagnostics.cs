@@ -0,0 +1,71 @@
+﻿using Microsoft.CodeAnalysis;
+
+namespace dotnes.analyzers;
+
+/// <summary>
+/// All diagnostics reported for .NES projects
+/// * NES0xx: code the transpiler cannot compile
+/// * NES1xx: code that compiles, but is slow on the 6502
+/// </summary>
+static class Diagnostics
+{
+    const string Compatibility = "Compatibility";
+    const string Performance = "Performance";
+
+    public static readonly DiagnosticDescriptor UnsupportedNESLibMethod = new(
+        id: "NES001",
+        title: "NESLib method is not supported",
+        messageFormat: "'{0}' is not supported by the .NES transpiler yet",
+        category: Compatibility,
+        defaultSeverity: DiagnosticSeverity.Warning,
+        isEnabledByDefault: true);
+
+    public static readonly DiagnosticDescriptor UnsupportedMethod = new(
+        id: "NES002",
+        title: "Only NESLib methods can be called",
+        messageFormat: "'{0}' cannot be called, the .NES transpiler only supports calls to NESLib",
+        category: Compatibility,
+        defaultSeverity: DiagnosticSeverity.Warning,
+        isEnabledByDefault: true);
+
+    public static readonly DiagnosticDescriptor WideLocal = new(
+        id: "NES100",
+        title: "Use byte for small values",
+        messageFormat: "'{0}' is declared as '{1}', but its value fits in a byte. The 6502 needs several instructions for each '{1}' operation.",
+        category: Performance,
+        defaultSeverity: DiagnosticSeverity.Info,
+        isEnabledByDefault: true);
+
+    public static readonly DiagnosticDescriptor WideLoopCounter = new(
+        id: "NES101",
+        title: "Use a byte loop counter",
+        messageFormat: "Loop counter '{0}' is a '{1}', but the loop runs less than 256 times. A byte counter is a single INX/INY.",
+        category: Performance,
+        defaultSeverity: DiagnosticSeverity.Info,
+        isEnabledByDefault: true);
+
+    public static readonly DiagnosticDescriptor MultiplyInLoop = new(
+        id: "NES102",
+        title: "Avoid multiplication and division in loops",
+        messageFormat: "'{0}' in a loop calls a software routine on every iteration, the 6502 has no multiply or divide instructions",
+        category: Performance,
+        defaultSeverity: DiagnosticSeverity.Info,
+        isEnabledByDefault: true);
+
+    public static readonly DiagnosticDescriptor ArrayOfStructs = new(
+        id: "NES103",
+        title: "Avoid arrays of structs",
+        messageFormat: "Accessing '{0}' multiplies the index by the size of '{1}'. Parallel byte arrays can use the index directly.",
+        category: Performance,
+        defaultSeverity: DiagnosticSeverity.Info,
+        isEnabledByDefault: true);
+
+    public static readonly DiagnosticDescriptor StatementCost = new(
+        id: "NES104",
+        title: "Estimated cost of a statement",
+        messageFormat: "{0} bytes, {1} cycles{2}",
+        category: Performance,
+        defaultSeverity: DiagnosticSeverity.Info,
+        isEnabledByDefault: true,
+        description: "Reported from the *.nescost.json file of the last build, when NESCostHints is true.");
+}
@@ -0,0 +1,236 @@
+﻿using System.Collections.Immutable;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CSharp;
+using Microsoft.CodeAnalysis.CSharp.Syntax;
+using Microsoft.CodeAnalysis.Diagnostics;
+using Microsoft.CodeAnalysis.Text;
+
+namespace dotnes.analyzers;
+
+/// <summary>
+/// Reports C# the transpiler cannot compile, or that is slow on the 6502, while typing in the IDE
+/// </summary>
+[DiagnosticAnalyzer(LanguageNames.CSharp)]
+public class NESAnalyzer : DiagnosticAnalyzer
+{
+    const string NESLibAssembly = "neslib";
+
+    /// <summary>
+    /// Methods of neslib the transpiler can call have this attribute, whatever their class, the same metadata the transpiler binds calls with
+    /// </summary>
+    const string NESBuiltIn = "NES.NESBuiltInAttribute";
+
+    public override ImmutableArray<DiagnosticDescriptor> SupportedDiagnostics { get; } = ImmutableArray.Create(
+        Diagnostics.UnsupportedNESLibMethod,
+        Diagnostics.UnsupportedMethod,
+        Diagnostics.WideLocal,
+        Diagnostics.WideLoopCounter,
+        Diagnostics.MultiplyInLoop,
+        Diagnostics.ArrayOfStructs,
+        Diagnostics.StatementCost);
+
+    public override void Initialize(AnalysisContext context)
+    {
+        context.ConfigureGeneratedCodeAnalysis(GeneratedCodeAnalysisFlags.None);
+        context.EnableConcurrentExecution();
+        context.RegisterSyntaxNodeAction(AnalyzeInvocation, SyntaxKind.InvocationExpression);
+        context.RegisterSyntaxNodeAction(AnalyzeLocalDeclaration, SyntaxKind.LocalDeclarationStatement);
+        context.RegisterSyntaxNodeAction(AnalyzeFor, SyntaxKind.ForStatement);
+        context.RegisterSyntaxNodeAction(AnalyzeMultiply, SyntaxKind.MultiplyExpression, SyntaxKind.DivideExpression, SyntaxKind.ModuloExpression);
+        context.RegisterSyntaxNodeAction(AnalyzeElementAccess, SyntaxKind.ElementAccessExpression);
+        context.RegisterCompilationStartAction(start =>
+        {
+            var hints = CostHint.Read(start.Options.AdditionalFiles, start.CancellationToken);
+            if (hints.Count > 0)
+                start.RegisterSyntaxTreeAction(tree => AnalyzeCost(tree, hints));
+        });
+    }
+
+    static void AnalyzeCost(SyntaxTreeAnalysisContext context, List<CostHint> hints)
+    {
+        var text = context.Tree.GetText(context.CancellationToken);
+        foreach (var hint in hints)
+        {
+            if (!hint.IsFor(context.Tree.FilePath))
+                continue;
+            // The file may have changed since the last build
+            if (hint.Line < 1 || hint.EndLine > text.Lines.Count)
+                continue;
+
+            var start = text.Lines[hint.Line - 1].Start + hint.Column - 1;
+            var end = text.Lines[hint.EndLine - 1].Start + hint.EndColumn - 1;
+            if (start > end || end > text.Lines[hint.EndLine - 1].End)
+                continue;
+
+            string calls = hint.Calls.Length == 0 ? "" : $" including {string.Join(", ", hint.Calls)}";
+            string cycles = hint.Exact ? hint.TotalCycles.ToString() : $"at least {hint.TotalCycles}";
+            var location = Location.Create(context.Tree, TextSpan.FromBounds(start, end));
+            context.ReportDiagnostic(Diagnostic.Create(Diagnostics.StatementCost, location, hint.Bytes, cycles, calls));
+        }
+    }
+
+    static void AnalyzeInvocation(SyntaxNodeAnalysisContext context)
+    {
+        var invocation = (InvocationExpressionSyntax)context.Node;
+        if (context.SemanticModel.GetSymbolInfo(invocation, context.CancellationToken).Symbol is not IMethodSymbol method)
+            return;
+
+        if (method.GetAttributes().Any(a => a.AttributeClass?.ToDisplayString() == NESBuiltIn))
+            return;
+        if (method.ContainingAssembly?.Name == NESLibAssembly)
+        {
+            context.ReportDiagnostic(Diagnostic.Create(Diagnostics.UnsupportedNESLibMethod, invocation.Expression.GetLocation(), method.Name));
+        }
+        else if (!IsTranspiled(method, context.Compilation))
+        {
+            context.ReportDiagnostic(Diagnostic.Create(Diagnostics.UnsupportedMethod, invocation.Expression.GetLocation(), method.Name));
+        }
+    }
+
+    /// <summary>
+    /// True for methods the transpiler compiles with the program: those of the program and of the libraries built against neslib,
+    /// which include local functions, generic instantiations and static interface members, and calls through delegates and function pointers
+    /// </summary>
+    static bool IsTranspiled(IMethodSymbol method, Compilation compilation)
+    {
+        if (method.MethodKind is MethodKind.DelegateInvoke or MethodKind.FunctionPointerSignature)
+            return true;
+        var assembly = method.ContainingAssembly;
+        if (assembly is null)
+            return false;
+        if (SymbolEqualityComparer.Default.Equals(assembly, compilation.Assembly))
+            return true;
+        return assembly.Modules.Any(m => m.ReferencedAssemblies.Any(a => a.Name == NESLibAssembly));
+    }
+
+    static void AnalyzeLocalDeclaration(SyntaxNodeAnalysisContext context)
+    {
+        var statement = (LocalDeclarationStatementSyntax)context.Node;
+        // const values never reach the 6502 as a variable
+        if (statement.IsConst || statement.Declaration.Variables.Count != 1)
+            return;
+
+        var variable = statement.Declaration.Variables[0];
+        if (variable.Initializer is null)
+            return;
+        if (context.SemanticModel.GetDeclaredSymbol(variable, context.CancellationToken) is not ILocalSymbol local || !IsWide(local.Type))
+            return;
+        if (!FitsInByte(context.SemanticModel, variable.Initializer.Value, context.CancellationToken))
+            return;
+
+        // Any other assignment could need the wider type
+        var scope = statement.Parent is GlobalStatementSyntax global ? global.Parent : statement.Parent;
+        if (scope is null || IsWritten(context.SemanticModel, scope, local, context.CancellationToken))
+            return;
+
+        context.ReportDiagnostic(Diagnostic.Create(Diagnostics.WideLocal, statement.Declaration.Type.GetLocation(), local.Name, local.Type.ToDisplayString()));
+    }
+
+    static void AnalyzeFor(SyntaxNodeAnalysisContext context)
+    {
+        var statement = (ForStatementSyntax)context.Node;
+        if (statement.Declaration is not { Variables.Count: 1 } declaration || statement.Condition is not BinaryExpressionSyntax condition)
+            return;
+
+        var variable = declaration.Variables[0];
+        if (variable.Initializer is null)
+            return;
+        if (context.SemanticModel.GetDeclaredSymbol(variable, context.CancellationToken) is not ILocalSymbol local || !IsWide(local.Type))
+            return;
+        if (!FitsInByte(context.SemanticModel, variable.Initializer.Value, context.CancellationToken))
+            return;
+
+        // i < N, i <= N, or i != N, where N keeps a byte counter from wrapping around
+        if (!SymbolEqualityComparer.Default.Equals(context.SemanticModel.GetSymbolInfo(condition.Left, context.CancellationToken).Symbol, local))
+            return;
+        var bound = context.SemanticModel.GetConstantValue(condition.Right, context.CancellationToken);
+        if (!bound.HasValue || GetInteger(bound.Value) is not long max)
+            return;
+        bool fits = condition.Kind() switch
+        {
+            SyntaxKind.LessThanExpression or SyntaxKind.NotEqualsExpression => max is >= 0 and <= byte.MaxValue,
+            SyntaxKind.LessThanOrEqualExpression => max is >= 0 and < byte.MaxValue,
+            _ => false,
+        };
+        if (!fits)
+            return;
+
+        // Only the incrementors should write to the counter
+        if (IsWritten(context.SemanticModel, statement.Statement, local, context.CancellationToken))
+            return;
+
+        context.ReportDiagnostic(Diagnostic.Create(Diagnostics.WideLoopCounter, declaration.Type.GetLocation(), local.Name, local.Type.ToDisplayString()));
+    }
+
+    static void AnalyzeMultiply(SyntaxNodeAnalysisContext context)
+    {
+        var expression = (BinaryExpressionSyntax)context.Node;
+        // Constants are folded by the C# compiler
+        if (context.SemanticModel.GetConstantValue(expression, context.CancellationToken).HasValue)
+            return;
+        if (!expression.Ancestors().Any(a => a is ForStatementSyntax or ForEachStatementSyntax or WhileStatementSyntax or DoStatementSyntax))
+            return;
+
+        context.ReportDiagnostic(Diagnostic.Create(Diagnostics.MultiplyInLoop, expression.GetLocation(), expression.ToString()));
+    }
+
+    static void AnalyzeElementAccess(SyntaxNodeAnalysisContext context)
+    {
+        var access = (ElementAccessExpressionSyntax)context.Node;
+        if (context.SemanticModel.GetTypeInfo(access.Expression, context.CancellationToken).Type is not IArrayTypeSymbol array)
+            return;
+        var element = array.ElementType;
+        if (element.TypeKind != TypeKind.Struct || element.SpecialType != SpecialType.None)
+            return;
+        // A constant index is computed at build time
+        if (access.ArgumentList.Arguments.All(a => context.SemanticModel.GetConstantValue(a.Expression, context.CancellationToken).HasValue))
+            return;
+
+        context.ReportDiagnostic(Diagnostic.Create(Diagnostics.ArrayOfStructs, access.GetLocation(), access.ToString(), element.Name));
+    }
+
+    /// <summary>
+    /// Integer types wider than a byte
+    /// </summary>
+    static bool IsWide(ITypeSymbol type) => type.SpecialType is
+        SpecialType.System_Int16 or SpecialType.System_UInt16 or
+        SpecialType.System_Int32 or SpecialType.System_UInt32 or
+        SpecialType.System_Int64 or SpecialType.System_UInt64;
+
+    static bool FitsInByte(SemanticModel model, ExpressionSyntax expression, CancellationToken cancellationToken)
+    {
+        var value = model.GetConstantValue(expression, cancellationToken);
+        return value.HasValue && GetInteger(value.Value) is >= byte.MinValue and <= byte.MaxValue;
+    }
+
+    /// <summary>
+    /// The value of an integral constant, or null if it is not one or is a ulong past long.MaxValue, which does not fit either
+    /// </summary>
+    static long? GetInteger(object? value) => value switch
+    {
+        sbyte or byte or short or ushort or int or uint or long => Convert.ToInt64(value),
+        ulong number when number <= long.MaxValue => (long)number,
+        _ => null,
+    };
+
+    /// <summary>
+    /// True if anything in scope assigns, increments or passes the local by reference
+    /// </summary>
+    static bool IsWritten(SemanticModel model, SyntaxNode scope, ILocalSymbol local, CancellationToken cancellationToken)
+    {
+        foreach (var node in scope.DescendantNodes())
+        {
+            ExpressionSyntax? target = node switch
+            {
+                AssignmentExpressionSyntax assignment => assignment.Left,
+                PrefixUnaryExpressionSyntax prefix when prefix.IsKind(SyntaxKind.PreIncrementExpression) || prefix.IsKind(SyntaxKind.PreDecrementExpression) => prefix.Operand,
+                PostfixUnaryExpressionSyntax postfix => postfix.Operand,
+                ArgumentSyntax argument when !argument.RefKindKeyword.IsKind(SyntaxKind.None) => argument.Expression,
+                _ => null,
+            };
+            if (target is not null && SymbolEqualityComparer.Default.Equals(model.GetSymbolInfo(target, cancellationToken).Symbol, local))
+                return true;
+        }
+        return false;
+    }
+}
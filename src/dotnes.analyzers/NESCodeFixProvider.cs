@@ -0,0 +1,96 @@
+﻿using System.Collections.Immutable;
+using System.Composition;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CodeActions;
+using Microsoft.CodeAnalysis.CodeFixes;
+using Microsoft.CodeAnalysis.CSharp;
+using Microsoft.CodeAnalysis.CSharp.Syntax;
+
+namespace dotnes.analyzers;
+
+/// <summary>
+/// Code fixes for the performance diagnostics in NESAnalyzer:
+/// * NES100, NES101: declare the local as byte
+/// * NES102: multiply by a power of two with a shift
+/// </summary>
+[ExportCodeFixProvider(LanguageNames.CSharp, Name = nameof(NESCodeFixProvider)), Shared]
+public class NESCodeFixProvider : CodeFixProvider
+{
+    public override ImmutableArray<string> FixableDiagnosticIds { get; } = ImmutableArray.Create(
+        Diagnostics.WideLocal.Id,
+        Diagnostics.WideLoopCounter.Id,
+        Diagnostics.MultiplyInLoop.Id);
+
+    public override FixAllProvider GetFixAllProvider() => WellKnownFixAllProviders.BatchFixer;
+
+    public override async Task RegisterCodeFixesAsync(CodeFixContext context)
+    {
+        var root = await context.Document.GetSyntaxRootAsync(context.CancellationToken).ConfigureAwait(false);
+        if (root is null)
+            return;
+
+        foreach (var diagnostic in context.Diagnostics)
+        {
+            var node = root.FindNode(diagnostic.Location.SourceSpan, getInnermostNodeForTie: true);
+            if (diagnostic.Id == Diagnostics.MultiplyInLoop.Id)
+            {
+                if (node.FirstAncestorOrSelf<BinaryExpressionSyntax>() is { } multiply && TryGetShift(multiply, out var shift))
+                {
+                    context.RegisterCodeFix(CodeAction.Create(
+                        title: "Use a shift",
+                        createChangedDocument: _ => Task.FromResult(context.Document.WithSyntaxRoot(root.ReplaceNode(multiply, shift))),
+                        equivalenceKey: Diagnostics.MultiplyInLoop.Id),
+                        diagnostic);
+                }
+            }
+            else if (node is TypeSyntax type)
+            {
+                var @byte = SyntaxFactory.PredefinedType(SyntaxFactory.Token(SyntaxKind.ByteKeyword)).WithTriviaFrom(type);
+                context.RegisterCodeFix(CodeAction.Create(
+                    title: "Use byte",
+                    createChangedDocument: _ => Task.FromResult(context.Document.WithSyntaxRoot(root.ReplaceNode(type, @byte))),
+                    equivalenceKey: diagnostic.Id),
+                    diagnostic);
+            }
+        }
+    }
+
+    /// <summary>
+    /// x * 8 or 8 * x becomes (x &lt;&lt; 3)
+    /// </summary>
+    static bool TryGetShift(BinaryExpressionSyntax multiply, out ExpressionSyntax shift)
+    {
+        shift = multiply;
+        if (!multiply.IsKind(SyntaxKind.MultiplyExpression))
+            return false;
+
+        ExpressionSyntax operand;
+        int bits;
+        if (TryGetPowerOfTwo(multiply.Right, out bits))
+            operand = multiply.Left;
+        else if (TryGetPowerOfTwo(multiply.Left, out bits))
+            operand = multiply.Right;
+        else
+            return false;
+
+        ExpressionSyntax result = SyntaxFactory.BinaryExpression(SyntaxKind.LeftShiftExpression,
+            operand.WithoutTrivia(),
+            SyntaxFactory.LiteralExpression(SyntaxKind.NumericLiteralExpression, SyntaxFactory.Literal(bits)));
+        // << has a lower precedence than *, + and -
+        if (multiply.Parent is ExpressionSyntax and not ParenthesizedExpressionSyntax and not AssignmentExpressionSyntax)
+            result = SyntaxFactory.ParenthesizedExpression(result);
+
+        shift = result.WithTriviaFrom(multiply);
+        return true;
+    }
+
+    static bool TryGetPowerOfTwo(ExpressionSyntax expression, out int bits)
+    {
+        bits = 0;
+        if (expression is not LiteralExpressionSyntax { Token.Value: int value } || value <= 1 || (value & (value - 1)) != 0)
+            return false;
+        while ((value >>= 1) != 0)
+            bits++;
+        return true;
+    }
+}
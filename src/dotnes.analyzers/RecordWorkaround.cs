@@ -0,0 +1,5 @@
+﻿// WTF? https://stackoverflow.com/a/64749403/132442
+namespace System.Runtime.CompilerServices
+{
+    internal static class IsExternalInit { }
+}
\ No newline at end of file
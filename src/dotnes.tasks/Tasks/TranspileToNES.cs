@@ -12,14 +12,191 @@ public class TranspileToNES : Task
 
     public bool DiagnosticLogging { get; set; }
 
+    /// <summary>
+    /// Keeps parsed *.s files and pre-assembled built-ins in memory between builds
+    /// </summary>
+    public bool UseBuildCache { get; set; }
+
+    /// <summary>
+    /// Optional path to write the estimated bytes and cycles of each C# statement, for the IDE
+    /// </summary>
+    public string? CostHintsPath { get; set; }
+
+    /// <summary>
+    /// Optional path to write the RAM map, what each part of the program uses and the worst-case stack depths
+    /// </summary>
+    public string? RamMapPath { get; set; }
+
+    /// <summary>
+    /// Comma-separated IL optimization passes, such as "DeadStores, ConstantPropagation" or "All"
+    /// </summary>
+    public string? ILOptimizations { get; set; }
+
+    /// <summary>
+    /// Comma-separated 6502 optimization passes, such as "Registers" or "All"
+    /// </summary>
+    public string? CodeOptimizations { get; set; }
+
+    /// <summary>
+    /// Size versus speed policy: None, Size, Speed or Balanced, adds to the passes above
+    /// </summary>
+    public string? Optimization { get; set; }
+
+    /// <summary>
+    /// Optional profile from a previous build, moves hot locals to zero page
+    /// </summary>
+    public string? ProfilePath { get; set; }
+
+    /// <summary>
+    /// Optional path to write a profile, by running the ROM headless after it is built
+    /// </summary>
+    public string? ProfileOutputPath { get; set; }
+
+    /// <summary>
+    /// Optional input script for the profile run, each line is a frame and the buttons held from then on
+    /// </summary>
+    public string? ProfileInputPath { get; set; }
+
+    /// <summary>
+    /// Number of frames the profile run lasts
+    /// </summary>
+    public int ProfileFrames { get; set; } = 600;
+
+    /// <summary>
+    /// Precompiled class libraries to link into the ROM, *.nesobj files
+    /// </summary>
+    public string[] ObjectFiles { get; set; } = Array.Empty<string>();
+
+    /// <summary>
+    /// Project assemblies the program references, their methods are transpiled with static void main as one program
+    /// </summary>
+    public string[] ReferenceFiles { get; set; } = Array.Empty<string>();
+
+    /// <summary>
+    /// Writes a *.nesobj of the class library to OutputPath, instead of a ROM
+    /// </summary>
+    public bool Library { get; set; }
+
+    /// <summary>
+    /// rand8 reads a 256-byte table generated at build time, instead of stepping the LFSRs
+    /// </summary>
+    public bool RandomTable { get; set; }
+
+    /// <summary>
+    /// Enums are stored in the fewest bytes that hold their members, values cast to them that are not members are truncated
+    /// </summary>
+    public bool NarrowEnums { get; set; }
+
     public override bool Execute()
     {
+        var optimizations = dotnes.ILOptimizations.None;
+        if (!string.IsNullOrEmpty(ILOptimizations) && !Enum.TryParse(ILOptimizations, ignoreCase: true, out optimizations))
+        {
+            Log.LogError($"Invalid NESILOptimizations value '{ILOptimizations}', expected one or more of: {string.Join(", ", Enum.GetNames(typeof(dotnes.ILOptimizations)))}");
+            return false;
+        }
+
+        var codeOptimizations = dotnes.CodeOptimizations.None;
+        if (!string.IsNullOrEmpty(CodeOptimizations) && !Enum.TryParse(CodeOptimizations, ignoreCase: true, out codeOptimizations))
+        {
+            Log.LogError($"Invalid NESCodeOptimizations value '{CodeOptimizations}', expected one or more of: {string.Join(", ", Enum.GetNames(typeof(dotnes.CodeOptimizations)))}");
+            return false;
+        }
+
+        var optimization = NESOptimization.None;
+        if (!string.IsNullOrEmpty(Optimization) && !Enum.TryParse(Optimization, ignoreCase: true, out optimization))
+        {
+            Log.LogError($"Invalid NESOptimization value '{Optimization}', expected one of: {string.Join(", ", Enum.GetNames(typeof(NESOptimization)))}");
+            return false;
+        }
+
+        NESProfile? profile = null;
+        if (!string.IsNullOrEmpty(ProfilePath))
+        {
+            using var reader = File.OpenText(ProfilePath);
+            profile = NESProfile.Read(reader);
+            codeOptimizations |= dotnes.CodeOptimizations.ZeroPage;
+        }
+
         var logger = DiagnosticLogging ? new MSBuildLogger(Log) : null;
+        if (Library)
+        {
+            using var library = new Transpiler(TargetPath, Array.Empty<AssemblyReader>(), logger) { Optimizations = optimizations };
+            var obj = library.TranspileObject();
+            using var writer = File.CreateText(OutputPath);
+            obj.Write(writer);
+            return !Log.HasLoggedErrors;
+        }
+
+        var objects = new List<NESObject>();
+        foreach (var path in ObjectFiles)
+        {
+            using var reader = File.OpenText(path);
+            objects.Add(NESObject.Read(reader));
+        }
+
         var assemblies = AssemblyFiles.Select(a => new AssemblyReader(a)).ToList();
-        using var input = File.OpenRead(TargetPath);
         using var output = File.Create(OutputPath);
-        using var transpiler = new Transpiler(input, assemblies, logger);
-        transpiler.Write(output);
+        // Kept in memory until the ROM is written, the analyzer reads these files and a failed build would leave them partial
+        using var costHints = string.IsNullOrEmpty(CostHintsPath) ? null : new StringWriter();
+        using var ramMap = string.IsNullOrEmpty(RamMapPath) ? null : new StringWriter();
+        var references = new List<Transpiler>();
+        try
+        {
+            foreach (var path in ReferenceFiles)
+            {
+                references.Add(new Transpiler(path, Array.Empty<AssemblyReader>(), logger));
+            }
+            using var transpiler = new Transpiler(TargetPath, assemblies, logger)
+            {
+                Cache = UseBuildCache ? BuildCache.Get(BuildEngine4) : null,
+                CostHints = costHints,
+                RamMap = ramMap,
+                Optimizations = optimizations,
+                CodeOptimizations = codeOptimizations,
+                Optimization = optimization,
+                Profile = profile,
+                Objects = objects,
+                RandomTable = RandomTable,
+                NarrowEnums = NarrowEnums,
+                References = references,
+            };
+            transpiler.Write(output);
+        }
+        catch
+        {
+            // A partial .nes would look up to date to the next incremental build
+            output.Dispose();
+            File.Delete(OutputPath);
+            throw;
+        }
+        finally
+        {
+            // Each reference maps its file, which would stay locked in a long-lived MSBuild node
+            foreach (var reference in references)
+            {
+                reference.Dispose();
+            }
+        }
+        if (costHints is not null)
+            File.WriteAllText(CostHintsPath!, costHints.ToString());
+        if (ramMap is not null)
+            File.WriteAllText(RamMapPath!, ramMap.ToString());
+
+        if (!string.IsNullOrEmpty(ProfileOutputPath))
+        {
+            var rom = new byte[output.Length];
+            output.Position = 0;
+            output.Read(rom, 0, rom.Length);
+            var profiler = new Profiler(rom, logger) { Frames = ProfileFrames };
+            if (!string.IsNullOrEmpty(ProfileInputPath))
+            {
+                using var input = File.OpenText(ProfileInputPath);
+                profiler.ReadInput(input);
+            }
+            using var writer = File.CreateText(ProfileOutputPath);
+            profiler.Run().Write(writer);
+        }
 
         return !Log.HasLoggedErrors;
     }
@@ -0,0 +1,36 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Keeps the messages of a section written in parallel, so they are logged in order after the sections are joined.
+/// The loggers of MSBuild are not safe to call from more than one thread.
+/// </summary>
+class BufferedLogger(ILogger logger) : ILogger
+{
+    List<IFormattable>? _messages = [];
+
+    public void WriteLine(IFormattable message)
+    {
+        if (_messages is null)
+        {
+            logger.WriteLine(message);
+        }
+        else
+        {
+            _messages.Add(message);
+        }
+    }
+
+    /// <summary>
+    /// Logs the buffered messages, later messages are logged directly
+    /// </summary>
+    public void Flush()
+    {
+        if (_messages is null)
+            return;
+        foreach (var message in _messages)
+        {
+            logger.WriteLine(message);
+        }
+        _messages = null;
+    }
+}
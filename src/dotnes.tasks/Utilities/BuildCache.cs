@@ -0,0 +1,65 @@
+﻿using System.Collections.Concurrent;
+
+namespace dotnes;
+
+/// <summary>
+/// State that is kept warm between builds in a long-lived MSBuild node:
+/// * Segments parsed from *.s files, until the file changes on disk
+/// * Pre-assembled built-ins, for each size of static void main
+/// See: https://learn.microsoft.com/dotnet/api/microsoft.build.framework.ibuildengine4.registertaskobject
+/// </summary>
+class BuildCache
+{
+    static readonly string Key = $"dotnes.{nameof(BuildCache)}, {typeof(BuildCache).Assembly.FullName}";
+
+    readonly ConcurrentDictionary<string, (DateTime LastWriteTimeUtc, long Length, Segment[] Segments)> _segments = new(StringComparer.Ordinal);
+    readonly ConcurrentDictionary<ushort, byte[]> _builtIns = new();
+
+    /// <summary>
+    /// Gets the cache registered for the lifetime of the MSBuild node, or registers a new one
+    /// </summary>
+    public static BuildCache Get(IBuildEngine4 engine)
+    {
+        if (engine.GetRegisteredTaskObject(Key, RegisteredTaskObjectLifetime.AppDomain) is BuildCache cache)
+            return cache;
+
+        cache = new BuildCache();
+        engine.RegisterTaskObject(Key, cache, RegisteredTaskObjectLifetime.AppDomain, allowEarlyCollection: true);
+        return cache;
+    }
+
+    /// <summary>
+    /// Number of times a cached value was reused
+    /// </summary>
+    public int Hits => _hits;
+    int _hits;
+
+    public IReadOnlyList<Segment> GetSegments(AssemblyReader reader)
+    {
+        // Only files on disk can be cached, not TextReader instances
+        var info = new FileInfo(reader.Path);
+        if (!info.Exists)
+            return reader.GetSegments().ToArray();
+
+        if (_segments.TryGetValue(info.FullName, out var value) &&
+            value.LastWriteTimeUtc == info.LastWriteTimeUtc && value.Length == info.Length)
+        {
+            Interlocked.Increment(ref _hits);
+            return value.Segments;
+        }
+
+        var segments = reader.GetSegments().ToArray();
+        _segments[info.FullName] = (info.LastWriteTimeUtc, info.Length, segments);
+        return segments;
+    }
+
+    public byte[] GetBuiltIns(ushort sizeOfMain, Func<ushort, byte[]> factory)
+    {
+        if (_builtIns.TryGetValue(sizeOfMain, out var bytes))
+        {
+            Interlocked.Increment(ref _hits);
+            return bytes;
+        }
+        return _builtIns[sizeOfMain] = factory(sizeOfMain);
+    }
+}
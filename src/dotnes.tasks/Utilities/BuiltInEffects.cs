@@ -0,0 +1,59 @@
+﻿namespace dotnes;
+
+[Flags]
+enum Registers : byte
+{
+    None = 0,
+    A = 1,
+    X = 2,
+    Y = 4,
+    All = A | X | Y,
+}
+
+/// <summary>
+/// What a built-in subroutine leaves in the registers, so values can be tracked across a JSR.
+/// Every built-in may write zero page and the stacks, none of them write the locals of static void main.
+/// </summary>
+/// <param name="Preserved">Registers that have the same value on return</param>
+/// <param name="A">Known value of A on return</param>
+/// <param name="X">Known value of X on return</param>
+/// <param name="Y">Known value of Y on return</param>
+record BuiltInEffects(Registers Preserved, byte? A = null, byte? X = null, byte? Y = null)
+{
+    public static readonly BuiltInEffects Unknown = new(Registers.None);
+
+    /// <summary>
+    /// The cc65 runtime routines written after static void main
+    /// </summary>
+    static readonly Dictionary<string, BuiltInEffects> runtime = new()
+    {
+        ["pusha"] = new(Registers.A | Registers.X, Y: 0),
+        ["pushax"] = new(Registers.A | Registers.X, Y: 0),
+        ["popa"] = new(Registers.X, Y: 0),
+    };
+
+    /// <summary>
+    /// Effects of a NESLib method are in its [NESBuiltIn] attribute, anything else clobbers everything
+    /// </summary>
+    public static BuiltInEffects Get(string name) =>
+        runtime.TryGetValue(name, out var value) ? value : NESLibBinding.TryGet(name)?.Effects ?? Unknown;
+
+    /// <summary>
+    /// Effects of every subroutine static void main can call, by address
+    /// </summary>
+    public static Dictionary<ushort, BuiltInEffects> GetAddresses(ushort sizeOfMain)
+    {
+        var addresses = new Dictionary<ushort, BuiltInEffects>();
+        foreach (var binding in NESLibBinding.All)
+        {
+            if (!binding.IsIntrinsic && !binding.IsLinked)
+                addresses[binding.Address] = binding.Effects;
+        }
+        foreach (var pair in NESWriter.GetFinalBuiltInAddresses(sizeOfMain))
+        {
+            if (runtime.TryGetValue(pair.Value, out var value))
+                addresses[pair.Key] = value;
+        }
+        return addresses;
+    }
+}
@@ -0,0 +1,163 @@
+﻿using System.Reflection.Metadata;
+
+namespace dotnes;
+
+/// <summary>
+/// The methods static void main calls, directly or not, across the entry assembly and the project assemblies it references.
+/// Methods that are never called are not transpiled, methods called once are inlined with ILOptimizations.Inlining.
+/// </summary>
+class CallGraph
+{
+    readonly Func<string, ILInstruction[]?> _readMethod;
+    readonly ILogger _logger;
+    readonly Dictionary<string, ILInstruction[]?> _bodies = new(StringComparer.Ordinal);
+
+    /// <param name="readMethod">Decodes a method by its full name, or returns null if it is not in the program</param>
+    public CallGraph(ILInstruction[] main, Func<string, ILInstruction[]?> readMethod, ILogger? logger = null)
+    {
+        Main = main;
+        _readMethod = readMethod;
+        _logger = logger ?? new NullLogger();
+        Update();
+    }
+
+    public ILInstruction[] Main { get; private set; }
+
+    /// <summary>
+    /// Methods reachable from static void main, in the order they are first called
+    /// </summary>
+    public List<(string Name, ILInstruction[] Instructions)> Methods { get; } = new();
+
+    /// <summary>
+    /// Calls that are not to NESLib or to a method of the program, such as the methods of a NESObject
+    /// </summary>
+    public HashSet<string> External { get; } = new(StringComparer.Ordinal);
+
+    /// <summary>
+    /// Number of methods inlined by Inline
+    /// </summary>
+    public int Inlined { get; private set; }
+
+    /// <summary>
+    /// Every instruction of the program, static void main first
+    /// </summary>
+    public IEnumerable<ILInstruction> Instructions => Main.Concat(Methods.SelectMany(m => m.Instructions));
+
+    /// <summary>
+    /// Replaces calls to methods called once, or that only call another method, by their body.
+    /// The body must be straight-line code and not call itself.
+    /// </summary>
+    public void Inline()
+    {
+        // Each inlined call removes a call site, or a method that only calls itself in a cycle
+        for (int pass = 0; pass <= Methods.Count; pass++)
+        {
+            var counts = new Dictionary<string, int>(StringComparer.Ordinal);
+            var addressTaken = new HashSet<string>(StringComparer.Ordinal);
+            foreach (var instruction in Instructions)
+            {
+                if (GetName(instruction) is not { } name)
+                    continue;
+                if (instruction.OpCode == ILOpCode.Ldftn)
+                    addressTaken.Add(name);
+                else
+                    counts[name] = counts.TryGetValue(name, out int count) ? count + 1 : 1;
+            }
+
+            var inline = new Dictionary<string, ILInstruction[]>(StringComparer.Ordinal);
+            foreach (var (name, instructions) in Methods)
+            {
+                // A method whose address is taken is kept, so it is only inlined into its calls if it is that short
+                if (CanInline(name, instructions) && counts.TryGetValue(name, out int count) && (count == 1 && !addressTaken.Contains(name) || instructions.Length <= 2))
+                    inline.Add(name, instructions);
+            }
+            if (inline.Count == 0)
+                return;
+
+            Main = Inline(Main, inline);
+            for (int i = 0; i < Methods.Count; i++)
+            {
+                var (name, instructions) = Methods[i];
+                Methods[i] = (name, Inline(instructions, inline));
+            }
+            Update();
+        }
+    }
+
+    /// <summary>
+    /// Straight-line code ending with its only Ret, without a call to itself
+    /// </summary>
+    static bool CanInline(string name, ILInstruction[] instructions)
+    {
+        if (instructions.Length == 0 || instructions[instructions.Length - 1].OpCode != ILOpCode.Ret)
+            return false;
+        for (int i = 0; i < instructions.Length - 1; i++)
+        {
+            var instruction = instructions[i];
+            if (instruction.OpCode.IsBranch() || instruction.OpCode is ILOpCode.Ret or ILOpCode.Switch || GetName(instruction) == name)
+                return false;
+        }
+        return true;
+    }
+
+    ILInstruction[] Inline(ILInstruction[] instructions, Dictionary<string, ILInstruction[]> inline)
+    {
+        var list = new List<ILInstruction>(instructions.Length);
+        foreach (var instruction in instructions)
+        {
+            if (instruction.OpCode != ILOpCode.Call || GetName(instruction) is not { } name || !inline.TryGetValue(name, out var body))
+            {
+                list.Add(instruction);
+                continue;
+            }
+            // The body takes the offset of the call, so it maps to the same C# statement
+            _logger.WriteLine($"{nameof(ILOptimizations.Inlining)}: {name} at IL_{instruction.Offset:x4}");
+            Inlined++;
+            for (int i = 0; i < body.Length - 1; i++)
+            {
+                list.Add(body[i] with { Offset = instruction.Offset });
+            }
+        }
+        return list.ToArray();
+    }
+
+    /// <summary>
+    /// Finds the methods reachable from static void main again, dropping the ones that are no longer called
+    /// </summary>
+    void Update()
+    {
+        var methods = Methods.ToDictionary(m => m.Name, m => m.Instructions, StringComparer.Ordinal);
+        Methods.Clear();
+        External.Clear();
+        var visited = new HashSet<string>(StringComparer.Ordinal);
+        var queue = new Queue<ILInstruction[]>();
+        queue.Enqueue(Main);
+        while (queue.Count > 0)
+        {
+            foreach (var instruction in queue.Dequeue())
+            {
+                if (GetName(instruction) is not { } name || !visited.Add(name))
+                    continue;
+
+                if (!methods.TryGetValue(name, out var body))
+                {
+                    if (!_bodies.TryGetValue(name, out body))
+                        _bodies.Add(name, body = _readMethod(name));
+                }
+                if (body is null)
+                {
+                    External.Add(name);
+                    continue;
+                }
+                Methods.Add((name, body));
+                queue.Enqueue(body);
+            }
+        }
+    }
+
+    /// <summary>
+    /// The method a call or a function pointer refers to
+    /// </summary>
+    static string? GetName(ILInstruction instruction) =>
+        instruction.OpCode is ILOpCode.Call or ILOpCode.Ldftn && instruction.Callee is { IsLinked: true } callee ? callee.Name : null;
+}
@@ -0,0 +1,41 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Optimization passes over the 6502 code of static void main, after it is transpiled.
+/// TailCalls and CrossJumping also run over the linked methods.
+/// </summary>
+[Flags]
+public enum CodeOptimizations
+{
+    None = 0,
+    /// <summary>
+    /// Tracks the values of A, X, Y, the flags and RAM to remove or shorten loads of values already known
+    /// </summary>
+    Registers = 1,
+    /// <summary>
+    /// Turns `JSR f; RTS` into `JMP f`
+    /// </summary>
+    TailCalls = 2,
+    /// <summary>
+    /// Replaces a tail ending in RTS or JMP with a JMP to an identical tail, smaller but 3 cycles slower
+    /// </summary>
+    CrossJumping = 4,
+    /// <summary>
+    /// Rewrites short sequences with faster ones found by the superoptimizer
+    /// </summary>
+    Peephole = 8,
+    /// <summary>
+    /// Moves the locals a profile shows are hot to zero page, does nothing without a profile
+    /// </summary>
+    ZeroPage = 16,
+    All = Registers | TailCalls | CrossJumping | Peephole | ZeroPage,
+    /// <summary>
+    /// Uses the stable unofficial opcodes LAX, ALR, ANC and AXS where they are smaller or faster, not part of All
+    /// </summary>
+    Unofficial = 32,
+    /// <summary>
+    /// Skips the startup work a program does not need: clearing pages of RAM it never uses,
+    /// zerobss, copydata and NTSC detection, not part of All
+    /// </summary>
+    Boot = 64,
+}
@@ -0,0 +1,240 @@
+﻿using System.Globalization;
+using System.Reflection.Metadata;
+using System.Text;
+
+namespace dotnes;
+
+/// <summary>
+/// Estimates the bytes and cycles of the 6502 code generated for each C# statement, written as a JSON sidecar for the IDE
+/// </summary>
+class CostEstimator
+{
+    const ushort PRG_START = 0x8000;
+    const int MaxSteps = 256;
+    const int MaxDepth = 8;
+
+    readonly ILInstruction[] _instructions;
+    /// <summary>
+    /// Index of the IL instruction that wrote each byte of static void main
+    /// </summary>
+    readonly List<int> _owners = new();
+    readonly Dictionary<ushort, Cost?> _callees = new();
+
+    public CostEstimator(ILInstruction[] instructions) => _instructions = instructions;
+
+    /// <summary>
+    /// A range of IL from a PDB sequence point
+    /// </summary>
+    public record Statement(int ILOffset, string Document, int StartLine, int StartColumn, int EndLine, int EndColumn);
+
+    /// <summary>
+    /// Cycles of a subroutine, not exact if it branches or loops
+    /// </summary>
+    record Cost(int Cycles, bool Exact);
+
+    record Call(string Name, ushort Address, Cost? Cost);
+
+    /// <summary>
+    /// Called after each IL instruction of the second pass, any bytes from lowestLength on belong to it
+    /// </summary>
+    public void Record(int index, long lowestLength, long length)
+    {
+        int start = (int)Math.Min(lowestLength, _owners.Count);
+        _owners.RemoveRange(start, _owners.Count - start);
+        for (long i = start; i < length; i++)
+        {
+            _owners.Add(index);
+        }
+    }
+
+    /// <summary>
+    /// Called for each range of static void main removed by a 6502 optimization, in descending order
+    /// </summary>
+    public void Remove(int offset, int length) => _owners.RemoveRange(offset, length);
+
+    /// <summary>
+    /// Writes one JSON object per statement, on its own line so the analyzer can read it without a JSON library
+    /// </summary>
+    /// <param name="main">The bytes of static void main</param>
+    /// <param name="prg">PRG_ROM starting at $8000, or null if callee costs are unknown</param>
+    /// <param name="statements">Sequence points from the PDB, or null to report each IL instruction</param>
+    /// <param name="names">Names of subroutines that are not NESLib calls</param>
+    public void Write(TextWriter writer, byte[] main, byte[]? prg, IReadOnlyList<Statement>? statements, IReadOnlyDictionary<ushort, string> names)
+    {
+        var keys = new List<int>();
+        var bytes = new Dictionary<int, int>();
+        var cycles = new Dictionary<int, int>();
+        var calls = new Dictionary<int, List<Call>>();
+
+        int offset = 0;
+        while (offset < main.Length)
+        {
+            var owner = _instructions[_owners[offset]];
+            int key = statements is null ? owner.Offset : GetStatement(statements, owner.Offset);
+            if (!bytes.ContainsKey(key))
+            {
+                keys.Add(key);
+                bytes[key] = cycles[key] = 0;
+                calls[key] = new List<Call>();
+            }
+
+            // Data in static void main is not expected, count it as a single byte
+            var info = NESInstructionInfo.Get(main[offset]);
+            int length = info?.Length ?? 1;
+            bytes[key] += length;
+            cycles[key] += info?.Cycles ?? 0;
+            if (info?.Opcode == (byte)NESInstruction.JSR && offset + 2 < main.Length)
+            {
+                var address = (ushort)(main[offset + 1] | main[offset + 2] << 8);
+                string name = owner.OpCode == ILOpCode.Call && owner.String is not null ?
+                    owner.String :
+                    names.TryGetValue(address, out var n) ? n : $"${address:X4}";
+                // Without PRG_ROM, or when the walk gives up, fall back to the cycles in [NESBuiltIn]
+                var cost = Estimate(prg, address, 0);
+                if (cost is null && owner.Callee is { Attribute.Cycles: > 0 } callee && callee.Address == address)
+                    cost = new Cost(callee.Attribute.Cycles, Exact: false);
+                calls[key].Add(new Call(name, address, cost));
+            }
+            offset += length;
+        }
+
+        writer.WriteLine("{");
+        writer.WriteLine("  \"statements\": [");
+        for (int i = 0; i < keys.Count; i++)
+        {
+            int key = keys[i];
+            var builder = new StringBuilder("    {");
+            if (statements is null)
+            {
+                builder.Append($"\"ilOffset\": {key}");
+            }
+            else
+            {
+                var statement = statements[key];
+                builder.Append($"\"ilOffset\": {statement.ILOffset}, \"document\": {Quote(statement.Document)}, ");
+                builder.Append($"\"line\": {statement.StartLine}, \"column\": {statement.StartColumn}, \"endLine\": {statement.EndLine}, \"endColumn\": {statement.EndColumn}");
+            }
+
+            int total = cycles[key];
+            bool exact = true;
+            builder.Append($", \"bytes\": {bytes[key]}, \"cycles\": {cycles[key]}, \"calls\": [");
+            for (int j = 0; j < calls[key].Count; j++)
+            {
+                var call = calls[key][j];
+                if (j > 0)
+                    builder.Append(", ");
+                builder.Append($"{{\"name\": {Quote(call.Name)}, \"address\": {call.Address}");
+                if (call.Cost is null)
+                {
+                    exact = false;
+                }
+                else
+                {
+                    total += call.Cost.Cycles;
+                    exact &= call.Cost.Exact;
+                    builder.Append($", \"cycles\": {call.Cost.Cycles}, \"exact\": {(call.Cost.Exact ? "true" : "false")}");
+                }
+                builder.Append('}');
+            }
+            builder.Append($"], \"totalCycles\": {total}, \"exact\": {(exact ? "true" : "false")}}}");
+            if (i < keys.Count - 1)
+                builder.Append(',');
+            writer.WriteLine(builder.ToString());
+        }
+        writer.WriteLine("  ]");
+        writer.WriteLine("}");
+    }
+
+    /// <summary>
+    /// Index of the last statement that starts at or before the IL offset
+    /// </summary>
+    static int GetStatement(IReadOnlyList<Statement> statements, int ilOffset)
+    {
+        int index = 0;
+        for (int i = 0; i < statements.Count && statements[i].ILOffset <= ilOffset; i++)
+        {
+            index = i;
+        }
+        return index;
+    }
+
+    /// <summary>
+    /// Walks a subroutine until RTS, following JMP and JSR. Branches are assumed not taken,
+    /// so anything that branches is a lower bound. Indexed addressing assumes no page is crossed.
+    /// </summary>
+    Cost? Estimate(byte[]? prg, ushort address, int depth)
+    {
+        if (prg is null || depth > MaxDepth)
+            return null;
+        if (_callees.TryGetValue(address, out var cached))
+            return cached;
+
+        Cost? result = null;
+        int cycles = 0;
+        bool exact = true;
+        int pc = address;
+        for (int step = 0; step < MaxSteps; step++)
+        {
+            int offset = pc - PRG_START;
+            if (offset < 0 || offset >= prg.Length)
+                break;
+            var info = NESInstructionInfo.Get(prg[offset]);
+            if (info is null || info.Mnemonic is "BRK" or "RTI" || info.Mode == AddressMode.Indirect)
+                break;
+
+            cycles += info.Cycles;
+            if (info.Mnemonic == "RTS")
+            {
+                result = new Cost(cycles, exact);
+                break;
+            }
+            if (info.Mode == AddressMode.Relative)
+                exact = false;
+
+            if (info.Mode == AddressMode.Absolute && info.Mnemonic is "JMP" or "JSR")
+            {
+                if (offset + 2 >= prg.Length)
+                    break;
+                var target = (ushort)(prg[offset + 1] | prg[offset + 2] << 8);
+                if (info.Mnemonic == "JMP")
+                {
+                    pc = target;
+                    continue;
+                }
+                var callee = Estimate(prg, target, depth + 1);
+                if (callee is null)
+                    break;
+                cycles += callee.Cycles;
+                exact &= callee.Exact;
+            }
+            pc += info.Length;
+        }
+
+        _callees[address] = result;
+        return result;
+    }
+
+    static string Quote(string value)
+    {
+        var builder = new StringBuilder("\"");
+        foreach (var c in value)
+        {
+            switch (c)
+            {
+                case '"':
+                    builder.Append("\\\"");
+                    break;
+                case '\\':
+                    builder.Append("\\\\");
+                    break;
+                default:
+                    if (c < ' ')
+                        builder.Append("\\u").Append(((int)c).ToString("x4", CultureInfo.InvariantCulture));
+                    else
+                        builder.Append(c);
+                    break;
+            }
+        }
+        return builder.Append('"').ToString();
+    }
+}
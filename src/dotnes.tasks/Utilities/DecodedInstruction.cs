@@ -0,0 +1,44 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// A 6502 instruction at an offset in a block of code, for the CodeOptimizations passes
+/// </summary>
+record DecodedInstruction(int Offset, NESInstructionInfo Info, ushort Operand)
+{
+    public override string ToString() => Info.Length switch
+    {
+        2 when Info.Mode == AddressMode.Immediate => $"{Info.Mnemonic} #${Operand:X2}",
+        2 => $"{Info.Mnemonic} ${Operand:X2}",
+        3 => $"{Info.Mnemonic} ${Operand:X4}",
+        _ when Info.Mode == AddressMode.Accumulator => $"{Info.Mnemonic} A",
+        _ => Info.Mnemonic,
+    };
+
+    /// <summary>
+    /// Decodes straight-line code, returns null if it contains data or relative branches.
+    /// NOTE: removing bytes would move branch targets, which the passes do not handle yet.
+    /// </summary>
+    public static List<DecodedInstruction>? Decode(byte[] code, ILogger logger, CodeOptimizations pass)
+    {
+        var instructions = new List<DecodedInstruction>();
+        int offset = 0;
+        while (offset < code.Length)
+        {
+            var info = NESInstructionInfo.Get(code[offset]);
+            if (info is null || offset + info.Length > code.Length || info.Mode == AddressMode.Relative)
+            {
+                logger.WriteLine($"{pass}: skipped, ${code[offset]:X2} at +{offset:X4} is not straight-line code");
+                return null;
+            }
+            ushort operand = info.Length switch
+            {
+                2 => code[offset + 1],
+                3 => (ushort)(code[offset + 1] | code[offset + 2] << 8),
+                _ => 0,
+            };
+            instructions.Add(new DecodedInstruction(offset, info, operand));
+            offset += info.Length;
+        }
+        return instructions;
+    }
+}
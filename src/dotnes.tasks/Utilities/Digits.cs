@@ -0,0 +1,191 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Routines writing a number as digit tiles to PPU_DATA, for the holes of an interpolated string passed to vram_write.
+/// They write at the current VRAM address between the literal tiles, so like vram_write they only work with rendering off:
+/// with rendering on, draw numbers through the set_vram_update buffer instead.
+/// The font is ASCII, as for strings: the tile of `0` is $30.
+/// </summary>
+static class Digits
+{
+    /// <summary>
+    /// A byte in A, in decimal without leading zeros
+    /// </summary>
+    public const string Byte = "NES.Digits.Byte";
+
+    /// <summary>
+    /// A ushort in A/X, in decimal without leading zeros
+    /// </summary>
+    public const string UShort = "NES.Digits.UShort";
+
+    /// <summary>
+    /// A byte in A as 2 hex digits, so a packed BCD value such as $42 writes `42`
+    /// </summary>
+    public const string HexByte = "NES.Digits.HexByte";
+
+    /// <summary>
+    /// A ushort in A/X as 4 hex digits, or 4 BCD digits
+    /// </summary>
+    public const string HexUShort = "NES.Digits.HexUShort";
+
+    public static NESObject Object { get; } = Write();
+
+    /// <summary>
+    /// The routine takes a ushort in A/X, instead of a byte in A
+    /// </summary>
+    public static bool IsWide(string name) => name is UShort or HexUShort;
+
+    /// <summary>
+    /// A call to one of the routines, which takes the value of the hole
+    /// </summary>
+    public static NESLibBinding Get(string name)
+    {
+        var symbol = Object.Symbols.First(s => s.Name == name);
+        return new NESLibBinding(name, ParameterCount: 1, new NESBuiltInAttribute(name, 0)
+        {
+            Arguments = IsWide(name) ? NESRegisters.A | NESRegisters.X : NESRegisters.A,
+            Cycles = symbol.Cycles,
+        });
+    }
+
+    static NESObject Write()
+    {
+        using var writer = new Writer();
+        writer.WriteDecimal();
+        writer.WriteHex();
+        return writer.ToObject(Writer.Data);
+    }
+
+    class Writer : NESObjectWriter
+    {
+        // The value, shifted out a bit at a time, and its 5 BCD digits: ones and tens, hundreds and thousands, ten thousands
+        const byte Value = TEMP;
+        const byte Bcd = TEMP + 2;
+        const byte Tile0 = (byte)'0';
+
+        /// <summary>
+        /// Double dabble without decimal mode, which the 2A03 does not have: before each shift, a digit of 5 or more gets 3 added.
+        /// The table does it for both digits of a BCD byte at once, indexed by the byte.
+        /// </summary>
+        static readonly byte[] Dabble = Enumerable.Range(0, 0x9A).Select(b => (byte)(Adjust(b >> 4) << 4 | Adjust(b & 0x0F))).ToArray();
+
+        static readonly byte[] HexTiles = NESWriter.Encoding.GetBytes("0123456789ABCDEF");
+
+        const ushort DabbleOffset = 0;
+        static readonly ushort HexOffset = (ushort)Dabble.Length;
+
+        public static byte[] Data => [.. Dabble, .. HexTiles];
+
+        static int Adjust(int digit) => digit > 9 ? 0 : digit >= 5 ? digit + 3 : digit;
+
+        public void WriteDecimal()
+        {
+            // Byte: the value is the high byte, so 8 shifts take its bits
+            ushort byteOffset = Offset;
+            Write(NESInstruction.STA_zpg, Value + 1);
+            Write(NESInstruction.LDY, 8);
+            Write(NESInstruction.BNE_rel, 6);
+
+            ushort ushortOffset = Offset;
+            Write(NESInstruction.STA_zpg, Value);
+            Write(NESInstruction.STX_zpg, Value + 1);
+            Write(NESInstruction.LDY, 16);
+
+            Write(NESInstruction.LDA, 0);
+            Write(NESInstruction.STA_zpg, Bcd);
+            Write(NESInstruction.STA_zpg, Bcd + 1);
+            Write(NESInstruction.STA_zpg, Bcd + 2);
+
+            // Shift the next bit of the value into the BCD digits, the ten thousands are at most 6 and need no adjusting
+            ushort loop = Offset;
+            Write(NESInstruction.ASL_zpg, Value);
+            Write(NESInstruction.ROL_zpg, Value + 1);
+            for (byte i = 0; i < 2; i++)
+            {
+                Write(NESInstruction.LDX_zpg, (byte)(Bcd + i));
+                WriteLoadTable(DabbleOffset);
+                Write(NESInstruction.ROL_A);
+                Write(NESInstruction.STA_zpg, (byte)(Bcd + i));
+            }
+            Write(NESInstruction.ROL_zpg, Bcd + 2);
+            Write(NESInstruction.DEY_impl);
+            Write(NESInstruction.BNE_rel, (byte)(loop - (Offset + 2)));
+
+            // X is 0 until a digit is written, to skip leading zeros
+            Write(NESInstruction.LDX, 0);
+            Write(NESInstruction.LDA_zpg, Bcd + 2);
+            WriteDigit();
+            Write(NESInstruction.LDA_zpg, Bcd + 1);
+            WriteHighNibble();
+            WriteDigit();
+            Write(NESInstruction.LDA_zpg, Bcd + 1);
+            Write(NESInstruction.AND, 0x0F);
+            WriteDigit();
+            Write(NESInstruction.LDA_zpg, Bcd);
+            WriteHighNibble();
+            WriteDigit();
+
+            // The ones are written even if they are 0
+            Write(NESInstruction.LDA_zpg, Bcd);
+            Write(NESInstruction.AND, 0x0F);
+            Write(NESInstruction.ORA, Tile0);
+            Write(NESInstruction.STA_abs, PPU_DATA);
+            Write(NESInstruction.RTS_impl);
+
+            AddSymbol(Byte, byteOffset, Offset);
+            AddSymbol(UShort, ushortOffset, Offset);
+        }
+
+        void WriteHighNibble()
+        {
+            Write(NESInstruction.LSR_A);
+            Write(NESInstruction.LSR_A);
+            Write(NESInstruction.LSR_A);
+            Write(NESInstruction.LSR_A);
+        }
+
+        /// <summary>
+        /// Writes the digit in A, unless it and every digit before it are 0
+        /// </summary>
+        void WriteDigit()
+        {
+            Write(NESInstruction.BNE_rel, 4);
+            Write(NESInstruction.CPX, 0);
+            Write(NESInstruction.BEQ_rel, 7);
+            Write(NESInstruction.ORA, Tile0);
+            Write(NESInstruction.STA_abs, PPU_DATA);
+            Write(NESInstruction.LDX, 1);
+        }
+
+        public void WriteHex()
+        {
+            // HexUShort writes the high byte, then falls into HexByte with the low byte
+            ushort ushortOffset = Offset;
+            Write(NESInstruction.STA_zpg, Value);
+            Write(NESInstruction.TXA_impl);
+            WriteHexByte();
+            Write(NESInstruction.LDA_zpg, Value);
+
+            ushort byteOffset = Offset;
+            WriteHexByte();
+            Write(NESInstruction.RTS_impl);
+
+            AddSymbol(HexByte, byteOffset, Offset);
+            AddSymbol(HexUShort, ushortOffset, Offset);
+        }
+
+        void WriteHexByte()
+        {
+            Write(NESInstruction.PHA_impl);
+            WriteHighNibble();
+            Write(NESInstruction.TAX_impl);
+            WriteLoadTable(HexOffset);
+            Write(NESInstruction.STA_abs, PPU_DATA);
+            Write(NESInstruction.PLA_impl);
+            Write(NESInstruction.AND, 0x0F);
+            Write(NESInstruction.TAX_impl);
+            WriteLoadTable(HexOffset);
+            Write(NESInstruction.STA_abs, PPU_DATA);
+        }
+    }
+}
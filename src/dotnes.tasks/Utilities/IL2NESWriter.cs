@@ -23,9 +23,37 @@ class IL2NESWriter : NESWriter
     /// List of byte[] data
     /// </summary>
     readonly List<ImmutableArray<byte>> ByteArrays = new();
-    readonly ushort local = 0x324;
-    ushort ByteArrayOffset = 0;
+    internal const ushort local = 0x324;
+    /// <summary>
+    /// A value on the stack that is only known at run time, such as the return value of rand8
+    /// </summary>
+    const int Unknown = int.MinValue;
+    /// <summary>
+    /// Free zero page after the cc65 runtime's, where a profile can move hot locals
+    /// </summary>
+    internal const byte zeroPageLocal = 0x40;
+    /// <summary>
+    /// Address of the next byte[] value, set before writing a method linked after the destructor table.
+    /// Static void main leaves it 0, its byte[] values start at rodata.
+    /// </summary>
+    public ushort ByteArrayOffset { get; set; }
     ILOpCode previous;
+    /// <summary>
+    /// Length of the stream right after a function pointer known at build time was loaded into A/X, so calli can JSR to it
+    /// </summary>
+    long functionPointer = -1;
+    /// <summary>
+    /// Where the last constant or local was loaded, so a routine taking it in registers can load it again
+    /// </summary>
+    (long Start, long End, int Value, int? Address) loaded = (-1, -1, 0, null);
+    /// <summary>
+    /// Length of the stream right after a call that returned a value in A, or A/X, while it is still there
+    /// </summary>
+    long returned = -1;
+    /// <summary>
+    /// Bytes of each Unknown value on the stack, the last one on top
+    /// </summary>
+    readonly Stack<int> unknownSizes = new();
 
     /// <summary>
     /// NOTE: may not be exactly correct, this is the instructions inside zerobss:
@@ -49,7 +77,24 @@ class IL2NESWriter : NESWriter
     /// </summary>
     public int LocalCount { get; private set; }
 
-    record Local(int Value, int? Address = null);
+    /// <summary>
+    /// Shortest the stream has been since this was set, as SeekBack can remove bytes written for previous IL
+    /// </summary>
+    public long LowestLength { get; set; }
+
+    /// <summary>
+    /// Addresses in RAM of built-ins copied there by [RunFromRam], called instead of their PRG_ROM version
+    /// </summary>
+    public IReadOnlyDictionary<string, ushort>? RamAddresses { get; set; }
+
+    /// <summary>
+    /// Addresses of the methods of linked NESObjects, which move with the size of static void main
+    /// </summary>
+    public IReadOnlyDictionary<string, ushort>? LinkedAddresses { get; set; }
+
+    /// <param name="Function">The value is the address of a method, from ldftn</param>
+    /// <param name="Size">Bytes of a local stored from a value only known at run time, which is loaded into A, or A/X, like it</param>
+    record Local(int Value, int? Address = null, bool Function = false, int Size = 0);
 
     public void Write(ILOpCode code, ushort sizeOfMain)
     {
@@ -59,7 +104,28 @@ class IL2NESWriter : NESWriter
                 break;
             case ILOpCode.Dup:
                 if (Stack.Count > 0)
+                {
+                    // A value only known at run time is loaded into A, and pushed for the copy below it
+                    if (Stack.Peek() == Unknown)
+                    {
+                        int size = unknownSizes.Peek();
+                        if (_writer.BaseStream.Length != returned)
+                            Write(NESInstruction.JSR, (size == 2 ? popax : popa).GetAddressAfterMain(sizeOfMain));
+                        Write(NESInstruction.JSR, (size == 2 ? pushax : pusha).GetAddressAfterMain(sizeOfMain));
+                        unknownSizes.Push(size);
+                        returned = _writer.BaseStream.Length;
+                    }
                     Stack.Push(Stack.Peek());
+                }
+                break;
+            case ILOpCode.Pop:
+                // The value a call returned in A is not used
+                if (Stack.Count == 0 || Stack.Pop() != Unknown)
+                    throw new NotImplementedException("pop is only implemented for the return value of a call!");
+                if (_writer.BaseStream.Length != returned)
+                    Write(NESInstruction.JSR, (unknownSizes.Peek() == 2 ? popax : popa).GetAddressAfterMain(sizeOfMain));
+                unknownSizes.Pop();
+                returned = -1;
                 break;
             case ILOpCode.Ldc_i4_0:
                 WriteLdc(0, sizeOfMain);
@@ -89,47 +155,67 @@ class IL2NESWriter : NESWriter
                 WriteLdc(8, sizeOfMain);
                 break;
             case ILOpCode.Stloc_0:
-                if (previous == ILOpCode.Ldtoken)
+                if (previous == ILOpCode.Ldftn)
+                {
+                    SeekBack(4);
+                    Locals[0] = new Local(Stack.Pop(), Function: true);
+                }
+                else if (previous == ILOpCode.Ldtoken)
                 {
                     SeekBack(4);
                     Locals[0] = new Local(Stack.Pop());
                 }
                 else
                 {
-                    WriteStloc(Locals[0] = new Local(Stack.Pop(), local));
+                    Locals[0] = WriteStloc(Stack.Pop(), local);
                 }
                 break;
             case ILOpCode.Stloc_1:
-                if (previous == ILOpCode.Ldtoken)
+                if (previous == ILOpCode.Ldftn)
+                {
+                    SeekBack(4);
+                    Locals[1] = new Local(Stack.Pop(), Function: true);
+                }
+                else if (previous == ILOpCode.Ldtoken)
                 {
                     SeekBack(4);
                     Locals[1] = new Local(Stack.Pop());
                 }
                 else
                 {
-                    WriteStloc(Locals[1] = new Local(Stack.Pop(), local + 1));
+                    Locals[1] = WriteStloc(Stack.Pop(), local + 1);
                 }
                 break;
             case ILOpCode.Stloc_2:
-                if (previous == ILOpCode.Ldtoken)
+                if (previous == ILOpCode.Ldftn)
+                {
+                    SeekBack(4);
+                    Locals[2] = new Local(Stack.Pop(), Function: true);
+                }
+                else if (previous == ILOpCode.Ldtoken)
                 {
                     SeekBack(4);
                     Locals[2] = new Local(Stack.Pop());
                 }
                 else
                 {
-                    WriteStloc(Locals[2] = new Local(Stack.Pop(), local + 2));
+                    Locals[2] = WriteStloc(Stack.Pop(), local + 2);
                 }
                 break;
             case ILOpCode.Stloc_3:
-                if (previous == ILOpCode.Ldtoken)
+                if (previous == ILOpCode.Ldftn)
+                {
+                    SeekBack(4);
+                    Locals[3] = new Local(Stack.Pop(), Function: true);
+                }
+                else if (previous == ILOpCode.Ldtoken)
                 {
                     SeekBack(4);
                     Locals[3] = new Local(Stack.Pop());
                 }
                 else
                 {
-                    WriteStloc(Locals[3] = new Local(Stack.Pop(), local + 3));
+                    Locals[3] = WriteStloc(Stack.Pop(), local + 3);
                 }
                 break;
             case ILOpCode.Ldloc_0:
@@ -151,8 +237,20 @@ class IL2NESWriter : NESWriter
                 // Do nothing
                 break;
             case ILOpCode.Add:
+                if (Stack.Take(2).Contains(Unknown))
+                    throw new NotImplementedException("add is not implemented for a value only known at run time!");
                 Stack.Push(Stack.Pop() + Stack.Pop());
                 break;
+            case ILOpCode.Ret:
+                Write(NESInstruction.RTS_impl);
+                break;
+            case ILOpCode.Calli:
+                // Devirtualized: the target is a constant, so the LDX/LDA of it becomes the operand of a JSR
+                if (_writer.BaseStream.Length != functionPointer)
+                    throw new NotImplementedException("calli is only implemented for function pointers known at build time!");
+                SeekBack(4);
+                Write(NESInstruction.JSR, checked((ushort)Stack.Pop()));
+                break;
             default:
                 throw new NotImplementedException($"OpCode {code} with no operands is not implemented!");
         }
@@ -190,11 +288,13 @@ class IL2NESWriter : NESWriter
                 }
                 break;
             case ILOpCode.Stloc_s:
-                if (previous == ILOpCode.Ldtoken)
+                if (previous is ILOpCode.Ldtoken or ILOpCode.Ldftn)
                 {
                     SeekBack(4);
                 }
-                Locals[operand] = new Local(Stack.Pop());
+                if (Stack.Peek() == Unknown)
+                    throw new NotImplementedException($"{code} is not implemented for a value only known at run time!");
+                Locals[operand] = new Local(Stack.Pop(), Function: previous == ILOpCode.Ldftn);
                 break;
             case ILOpCode.Ldloc_s:
                 WriteLdloc(Locals[operand], sizeOfMain);
@@ -212,6 +312,7 @@ class IL2NESWriter : NESWriter
             case ILOpCode.Nop:
                 break;
             case ILOpCode.Ldstr:
+                PushReturned(sizeOfMain);
                 //TODO: hardcoded until string table figured out
                 Write(NESInstruction.LDA, 0xF1);
                 Write(NESInstruction.LDX, 0x85);
@@ -220,53 +321,97 @@ class IL2NESWriter : NESWriter
                 Write(ILOpCode.Ldc_i4_s, operand.Length, sizeOfMain);
                 break;
             case ILOpCode.Call:
-                switch (operand)
-                {
-                    case nameof(NTADR_A):
-                    case nameof(NTADR_B):
-                    case nameof(NTADR_C):
-                    case nameof(NTADR_D):
-                        if (Stack.Count < 2)
-                        {
-                            throw new InvalidOperationException($"{operand} was called with less than 2 on the stack.");
-                        }
-                        var address = operand switch
-                        {
-                            nameof(NTADR_A) => NTADR_A(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
-                            nameof(NTADR_B) => NTADR_B(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
-                            nameof(NTADR_C) => NTADR_C(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
-                            nameof(NTADR_D) => NTADR_D(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
-                            _ => throw new InvalidOperationException($"Address lookup of {operand} not implemented!"),
-                        };
-                        SeekBack(7);
-                        //TODO: these are hardcoded until I figure this out
-                        Write(NESInstruction.LDX, 0x20);
-                        Write(NESInstruction.LDA, 0x42);
-                        Stack.Push(address);
-                        break;
-                    default:
-                        Write(NESInstruction.JSR, GetAddress(operand));
-                        break;
-                }
-                // Pop N times
-                int args = GetNumberOfArguments(operand);
-                for (int i = 0; i < args; i++)
-                {
-                    if (Stack.Count > 0)
-                        Stack.Pop();
-                }
-                break;
+                Write(code, NESLibBinding.Get(operand), sizeOfMain);
+                return;
             default:
                 throw new NotImplementedException($"OpCode {code} with String operand is not implemented!");
         }
         previous = code;
     }
 
+    /// <summary>
+    /// Writes a call to a NESLib method, resolved from its [NESBuiltIn] attribute, or loads the address of a method with ldftn
+    /// </summary>
+    public void Write(ILOpCode code, NESLibBinding callee, ushort sizeOfMain)
+    {
+        if (code == ILOpCode.Ldftn)
+        {
+            WriteFunctionPointer(GetAddress(callee), sizeOfMain);
+            previous = code;
+            return;
+        }
+        if (code != ILOpCode.Call)
+            throw new NotImplementedException($"OpCode {code} with a method operand is not implemented!");
+
+        if (callee.IsIntrinsic)
+        {
+            if (Stack.Count < 2)
+            {
+                throw new InvalidOperationException($"{callee.Name} was called with less than 2 on the stack.");
+            }
+            if (Stack.Take(2).Contains(Unknown))
+                throw new NotImplementedException($"{callee.Name} is only implemented for values known at build time!");
+            var address = callee.Name switch
+            {
+                nameof(NTADR_A) => NTADR_A(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
+                nameof(NTADR_B) => NTADR_B(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
+                nameof(NTADR_C) => NTADR_C(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
+                nameof(NTADR_D) => NTADR_D(checked((byte)Stack.Pop()), checked((byte)Stack.Pop())),
+                _ => throw new InvalidOperationException($"Address lookup of {callee.Name} not implemented!"),
+            };
+            SeekBack(7);
+            //TODO: these are hardcoded until I figure this out
+            Write(NESInstruction.LDX, 0x20);
+            Write(NESInstruction.LDA, 0x42);
+            Stack.Push(address);
+        }
+        else
+        {
+            if (Digits.Object.Contains(callee.Name))
+                WriteDigits(callee);
+            // An argument left in A is pushed before a call that returns the next one, as in pal_col(1, rand8())
+            else if (LastLDA && callee.ParameterCount == 0)
+                Write(NESInstruction.JSR, pusha.GetAddressAfterMain(sizeOfMain));
+            else if (callee.ParameterCount == 0)
+                PushReturned(sizeOfMain);
+            // A returned value pushed before other arguments were loaded is the last argument, it is popped back into A
+            else if (Stack.Count > 0 && Stack.Peek() == Unknown && _writer.BaseStream.Length != returned)
+                Write(NESInstruction.JSR, (unknownSizes.Peek() == 2 ? popax : popa).GetAddressAfterMain(sizeOfMain));
+            Write(NESInstruction.JSR, GetAddress(callee));
+
+            // Pop N times, the arguments of an intrinsic were popped above
+            for (int i = 0; i < callee.ParameterCount; i++)
+            {
+                if (Stack.Count > 0 && Stack.Pop() == Unknown)
+                    unknownSizes.Pop();
+            }
+            if (callee.ReturnSize > 0)
+            {
+                Stack.Push(Unknown);
+                unknownSizes.Push(callee.ReturnSize);
+                returned = _writer.BaseStream.Length;
+            }
+        }
+        previous = code;
+    }
+
+    ushort GetAddress(NESLibBinding callee)
+    {
+        if (RamAddresses is not null && RamAddresses.TryGetValue(callee.Name, out var ram))
+            return ram;
+        if (LinkedAddresses is not null && LinkedAddresses.TryGetValue(callee.Name, out var linked))
+            return linked;
+        if (callee.IsLinked)
+            throw new NotImplementedException($"{callee.Name} is not implemented!");
+        return callee.Address;
+    }
+
     public void Write(ILOpCode code, ImmutableArray<byte> operand, ushort sizeOfMain)
     {
         switch (code)
         {
             case ILOpCode.Ldtoken:
+                PushReturned(sizeOfMain);
                 if (ByteArrayOffset == 0)
                     ByteArrayOffset = rodata.GetAddressAfterMain(sizeOfMain);
                 Write(NESInstruction.LDA, (byte)(ByteArrayOffset & 0xff));
@@ -275,6 +420,13 @@ class IL2NESWriter : NESWriter
                 ByteArrayOffset = (ushort)(ByteArrayOffset + operand.Length);
                 ByteArrays.Add(operand);
                 break;
+            case ILOpCode.Ldstr:
+                // Literal tiles of an interpolated string, in the byte[] table: the address is pushed and the length is in A/X
+                Write(ILOpCode.Ldtoken, operand, sizeOfMain);
+                Write(NESInstruction.JSR, pushax.GetAddressAfterMain(sizeOfMain));
+                Write(NESInstruction.LDX, checked((byte)(operand.Length >> 8)));
+                Write(NESInstruction.LDA, (byte)(operand.Length & 0xff));
+                break;
             default:
                 throw new NotImplementedException($"OpCode {code} with byte[] operand is not implemented!");
         }
@@ -295,110 +447,26 @@ class IL2NESWriter : NESWriter
         }
     }
 
-    static ushort GetAddress(string name)
-    {
-        switch (name)
-        {
-            case nameof(pal_col):
-                return 0x823E;
-            case nameof(pal_bg):
-                return 0x822B;
-            case nameof(pal_clear):
-                return 0x824E;
-            case nameof(pal_all):
-                return 0x8211;
-            case nameof(pal_spr):
-                return 0x8235;
-            case nameof(pal_spr_bright):
-                return 0x825D;
-            case nameof(ppu_on_all):
-                return 0x8289;
-            case nameof(vram_adr):
-                return 0x83D4;
-            case nameof(ppu_wait_frame):
-                return 0x82DB;
-            case nameof(ppu_on_bg):
-                return 0x8292;
-            case nameof(ppu_on_spr):
-                return 0x8298;
-            case nameof(rand):
-                return 0x860C;
-            case nameof(rand8):
-                return 0x860C;
-            case nameof(rand16):
-                return 0x8617;
-            case nameof(set_rand):
-                return 0x8623;
-            case nameof(delay):
-                return 0x841A;
-            case nameof(nesclock):
-                return 0x8415;
-            case nameof(oam_clear):
-                return 0x82AE;
-            case nameof(oam_hide_rest):
-                return 0x82CE;
-            case nameof(oam_size):
-                return 0x82BC;
-            case nameof(vram_fill):
-                return 0x83DF;
-            case nameof(vram_write):
-                return 0x834F;
-            case nameof(vram_put):
-                return 0x83DB;
-            case nameof(vram_inc):
-                return 0x8401;
-            case nameof(set_vram_update):
-                return 0x8376;
-            case nameof(set_ppu_ctrl_var):
-                return 0x82AB;
-            case nameof(scroll):
-                return 0x82FB;
-            default:
-                throw new NotImplementedException($"{nameof(GetAddress)} for {name} is not implemented!");
-        }
-    }
-
-    static int GetNumberOfArguments(string name)
+    /// <summary>
+    /// A local stored from a value only known at run time is stored from A, or A/X, right after the call that returned it
+    /// </summary>
+    Local WriteStloc(int value, ushort address)
     {
-        switch (name)
+        if (value != Unknown)
         {
-            case nameof(ppu_on_bg):
-            case nameof(ppu_on_spr):
-            case nameof(pal_clear):
-            case nameof(ppu_on_all):
-            case nameof(ppu_wait_frame):
-            case nameof(rand):
-            case nameof(rand8): 
-            case nameof(rand16):
-            case nameof(nesclock):
-            case nameof(oam_clear):
-                return 0;
-            case nameof(vram_adr):
-            case nameof(vram_write):
-            case nameof(vram_put):
-            case nameof(set_vram_update):
-            case nameof(set_ppu_ctrl_var):
-            case nameof(pal_bg):
-            case nameof(pal_spr_bright):
-            case nameof(pal_spr):
-            case nameof(pal_all):
-            case nameof(set_rand):    
-            case nameof(oam_hide_rest):
-            case nameof(oam_size):
-                return 1;
-            case nameof(pal_col):
-            case nameof(vram_fill):
-            case nameof(NTADR_A):
-            case nameof(NTADR_B):
-            case nameof(NTADR_C):
-            case nameof(NTADR_D):
-            case nameof(scroll):
-                return 2;
-            case nameof(oam_spr):
-                return 5;
-            default:
-                throw new NotImplementedException($"{nameof(GetNumberOfArguments)} for {name} is not implemented!");
+            var known = new Local(value, address);
+            WriteStloc(known);
+            return known;
         }
+        int size = unknownSizes.Pop();
+        if (_writer.BaseStream.Length != returned)
+            throw new NotImplementedException("stloc is only implemented for a value known at build time or the return value of the call just before it!");
+        LocalCount += size;
+        Write(NESInstruction.STA_abs, address);
+        if (size == 2)
+            Write(NESInstruction.STX_abs, (ushort)(address + 1));
+        returned = -1;
+        return new Local(Unknown, address, Size: size);
     }
 
     void WriteStloc(Local local)
@@ -419,8 +487,8 @@ class IL2NESWriter : NESWriter
         {
             LocalCount += 2;
             SeekBack(8);
-            Write(NESInstruction.LDX, 0x03);
-            Write(NESInstruction.LDA, 0xC0);
+            Write(NESInstruction.LDX, (byte)(local.Value >> 8));
+            Write(NESInstruction.LDA, (byte)(local.Value & 0xff));
             Write(NESInstruction.STA_abs, (ushort)local.Address);
             Write(NESInstruction.STX_abs, (ushort)(local.Address + 1));
             Write(NESInstruction.LDA, 0x28);
@@ -434,27 +502,64 @@ class IL2NESWriter : NESWriter
 
     void WriteLdc(ushort operand, ushort sizeOfMain)
     {
+        PushReturned(sizeOfMain);
         if (LastLDA)
         {
             Write(NESInstruction.JSR, pusha.GetAddressAfterMain(sizeOfMain));
         }
+        long start = _writer.BaseStream.Length;
         Write(NESInstruction.LDX, checked((byte)(operand >> 8)));
         Write(NESInstruction.LDA, checked((byte)(operand & 0xff)));
         Stack.Push(operand);
+        loaded = (start, _writer.BaseStream.Length, operand, null);
     }
 
     void WriteLdc(byte operand, ushort sizeOfMain)
     {
+        PushReturned(sizeOfMain);
         if (LastLDA)
         {
             Write(NESInstruction.JSR, pusha.GetAddressAfterMain(sizeOfMain));
         }
+        long start = _writer.BaseStream.Length;
         Write(NESInstruction.LDA, operand);
         Stack.Push(operand);
+        loaded = (start, _writer.BaseStream.Length, operand, null);
+    }
+
+    /// <summary>
+    /// A 16-bit code address in A/X, like WriteLdc
+    /// </summary>
+    void WriteFunctionPointer(ushort address, ushort sizeOfMain)
+    {
+        WriteLdc(address, sizeOfMain);
+        functionPointer = _writer.BaseStream.Length;
     }
 
     void WriteLdloc(Local local, ushort sizeOfMain)
     {
+        if (local.Function)
+        {
+            WriteFunctionPointer(checked((ushort)local.Value), sizeOfMain);
+            return;
+        }
+        PushReturned(sizeOfMain);
+        if (local.Value == Unknown)
+        {
+            if (LastLDA)
+            {
+                Write(NESInstruction.JSR, pusha.GetAddressAfterMain(sizeOfMain));
+            }
+            // Loaded like the return value of a call, it is pushed only if another argument follows
+            Write(NESInstruction.LDA_abs, (ushort)local.Address!);
+            if (local.Size == 2)
+                Write(NESInstruction.LDX_abs, (ushort)(local.Address + 1));
+            Stack.Push(Unknown);
+            unknownSizes.Push(local.Size);
+            returned = _writer.BaseStream.Length;
+            return;
+        }
+        long start = _writer.BaseStream.Length;
         if (local.Address is not null)
         {
             // This is actually a local variable
@@ -466,6 +571,7 @@ class IL2NESWriter : NESWriter
             else if (local.Value < ushort.MaxValue)
             {
                 Write(NESInstruction.JSR, pusha.GetAddressAfterMain(sizeOfMain));
+                start = _writer.BaseStream.Length;
                 Write(NESInstruction.LDA_abs, (ushort)local.Address);
                 Write(NESInstruction.LDX_abs, (ushort)(local.Address + 1));
             }
@@ -484,6 +590,49 @@ class IL2NESWriter : NESWriter
             Write(NESInstruction.LDA, 0x40);
         }
         Stack.Push(local.Value);
+        loaded = (start, _writer.BaseStream.Length, local.Value, local.Address);
+    }
+
+    /// <summary>
+    /// The routines of Digits take the value in A, or A/X, instead of on the cc65 stack:
+    /// the constant or local just loaded is loaded again that way.
+    /// </summary>
+    void WriteDigits(NESLibBinding callee)
+    {
+        bool wide = Digits.IsWide(callee.Name);
+        if (_writer.BaseStream.Length == returned)
+        {
+            // The value a call returned is already in A, or A/X
+            if (wide && unknownSizes.Peek() == 1)
+                Write(NESInstruction.LDX, 0x00);
+            return;
+        }
+        if (loaded.End != _writer.BaseStream.Length || Stack.Count == 0 || Stack.Peek() != loaded.Value)
+            throw new NotImplementedException($"{callee.Name} is only implemented for a constant or a local!");
+        SeekBack((int)(loaded.End - loaded.Start));
+        if (loaded.Address is int address)
+        {
+            Write(NESInstruction.LDA_abs, (ushort)address);
+            if (wide)
+                Write(NESInstruction.LDX_abs, (ushort)(address + 1));
+        }
+        else
+        {
+            Write(NESInstruction.LDA, (byte)(loaded.Value & 0xff));
+            if (wide)
+                Write(NESInstruction.LDX, checked((byte)(loaded.Value >> 8)));
+        }
+    }
+
+    /// <summary>
+    /// Pushes the value a call returned in A, or A/X, before A is loaded with the next argument
+    /// </summary>
+    void PushReturned(ushort sizeOfMain)
+    {
+        if (_writer.BaseStream.Length != returned)
+            return;
+        Write(NESInstruction.JSR, (unknownSizes.Peek() == 2 ? pushax : pusha).GetAddressAfterMain(sizeOfMain));
+        returned = -1;
     }
 
     void SeekBack(int length)
@@ -497,5 +646,6 @@ class IL2NESWriter : NESWriter
         {
             _writer.BaseStream.SetLength(_writer.BaseStream.Length - length);
         }
+        LowestLength = Math.Min(LowestLength, _writer.BaseStream.Length);
     }
 }
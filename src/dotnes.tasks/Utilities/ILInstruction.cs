@@ -6,4 +6,15 @@ namespace dotnes;
 /// <summary>
 /// Holds info about IL
 /// </summary>
-record ILInstruction(ILOpCode OpCode, int? Integer = null, string? String = null, ImmutableArray<byte>? Bytes = null);
+record ILInstruction(ILOpCode OpCode, int? Integer = null, string? String = null, ImmutableArray<byte>? Bytes = null)
+{
+    /// <summary>
+    /// Offset in the method body, used to map to PDB sequence points
+    /// </summary>
+    internal int Offset { get; init; }
+
+    /// <summary>
+    /// The NESLib method of a call, resolved once per method handle
+    /// </summary>
+    internal NESLibBinding? Callee { get; init; }
+}
@@ -0,0 +1,36 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Optimization passes over the IL of static void main, before it is transpiled
+/// </summary>
+[Flags]
+public enum ILOptimizations
+{
+    None = 0,
+    /// <summary>
+    /// Removes Nop and unreachable instructions after an unconditional branch
+    /// </summary>
+    DeadCode = 1,
+    /// <summary>
+    /// Removes stores to locals that are never read, along with the value stored
+    /// </summary>
+    DeadStores = 2,
+    /// <summary>
+    /// Replaces reads of a local assigned once with a constant by the constant
+    /// </summary>
+    ConstantPropagation = 4,
+    /// <summary>
+    /// Replaces reads of a local assigned once from another local by the other local
+    /// </summary>
+    CopyPropagation = 8,
+    /// <summary>
+    /// Replaces calls to methods of the program called once, or that only call another method, by their body
+    /// </summary>
+    Inlining = 16,
+    /// <summary>
+    /// Replaces arithmetic, bitwise operations and comparisons of constants by their result,
+    /// and branches on a constant by a br or by nothing
+    /// </summary>
+    ConstantFolding = 32,
+    All = DeadCode | DeadStores | ConstantPropagation | CopyPropagation | Inlining | ConstantFolding,
+}
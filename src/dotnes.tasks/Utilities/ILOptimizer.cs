@@ -0,0 +1,402 @@
+﻿using System.Reflection.Metadata;
+
+namespace dotnes;
+
+/// <summary>
+/// Optimizes the decoded IL of static void main, so C# written for readability
+/// (locals for constants, temporaries) transpiles to the same 6502 code as the compact version.
+/// NOTE: the passes treat main as straight-line code, anything a branch jumps into is left alone.
+/// </summary>
+class ILOptimizer
+{
+    readonly ILogger _logger;
+
+    public ILOptimizer(ILogger? logger = null) => _logger = logger ?? new NullLogger();
+
+    /// <summary>
+    /// Number of changes made by each pass
+    /// </summary>
+    public Dictionary<ILOptimizations, int> Changes { get; } = new();
+
+    class Local
+    {
+        public List<int> Stores { get; } = new();
+        public List<int> Loads { get; } = new();
+        public bool AddressTaken { get; set; }
+    }
+
+    public ILInstruction[] Optimize(ILInstruction[] instructions, ILOptimizations optimizations)
+    {
+        var list = new List<ILInstruction>(instructions);
+        var targets = GetBranchTargets(list);
+
+        if ((optimizations & ILOptimizations.DeadCode) != 0)
+            RemoveDeadCode(list, targets);
+
+        // Propagating a value can make a store dead, removing a store can make another propagation possible
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            if ((optimizations & ILOptimizations.ConstantPropagation) != 0)
+                changed |= Propagate(list, targets, ILOptimizations.ConstantPropagation);
+            if ((optimizations & ILOptimizations.CopyPropagation) != 0)
+                changed |= Propagate(list, targets, ILOptimizations.CopyPropagation);
+            if ((optimizations & ILOptimizations.DeadStores) != 0)
+                changed |= RemoveDeadStores(list, targets);
+            if ((optimizations & ILOptimizations.ConstantFolding) != 0 && Fold(list, targets))
+            {
+                // A branch on a constant can leave code behind it unreachable
+                if ((optimizations & ILOptimizations.DeadCode) != 0)
+                    RemoveDeadCode(list, targets);
+                changed = true;
+            }
+        }
+
+        return list.ToArray();
+    }
+
+    void Report(ILOptimizations pass, string message)
+    {
+        Changes[pass] = Changes.TryGetValue(pass, out int count) ? count + 1 : 1;
+        _logger.WriteLine($"{pass}: {message}");
+    }
+
+    static string Format(ILInstruction instruction) =>
+        $"IL_{instruction.Offset:x4} {instruction.OpCode}{(instruction.Integer is null ? "" : " " + instruction.Integer)}";
+
+    void RemoveDeadCode(List<ILInstruction> list, HashSet<int> targets)
+    {
+        bool reachable = true;
+        for (int i = 0; i < list.Count; i++)
+        {
+            var instruction = list[i];
+            bool target = targets.Contains(instruction.Offset);
+            if (target)
+                reachable = true;
+
+            // A nop a branch jumps to is kept, it is where the branch lands
+            if (!reachable || instruction.OpCode == ILOpCode.Nop && !target)
+            {
+                Report(ILOptimizations.DeadCode, $"removed {Format(instruction)}");
+                list.RemoveAt(i--);
+                continue;
+            }
+
+            if (IsUnconditional(instruction.OpCode))
+                reachable = false;
+        }
+    }
+
+    bool Propagate(List<ILInstruction> list, HashSet<int> targets, ILOptimizations pass)
+    {
+        bool changed = false;
+        foreach (var pair in GetLocals(list))
+        {
+            var local = pair.Value;
+            if (local.AddressTaken || local.Stores.Count != 1 || local.Loads.Count == 0)
+                continue;
+
+            int store = local.Stores[0];
+            if (store == 0)
+                continue;
+            var value = list[store - 1];
+            int? source = null;
+            if (pass == ILOptimizations.ConstantPropagation)
+            {
+                // A function pointer is a constant too, so a call through it is devirtualized
+                if (GetConstant(value) is null && value.OpCode != ILOpCode.Ldftn)
+                    continue;
+            }
+            else
+            {
+                source = GetLocal(value, out var kind);
+                if (source is null || kind != LocalAccess.Load || source == pair.Key)
+                    continue;
+            }
+
+            // Every read must come after the store, with nothing jumping in between
+            int last = local.Loads.Max();
+            if (local.Loads.Min() < store || HasTarget(list, targets, store, last))
+                continue;
+            // A copy is only valid if the source does not change before the last read
+            if (source is not null && GetLocals(list).TryGetValue(source.Value, out var other) &&
+                (other.AddressTaken || other.Stores.Any(s => s > store && s < last)))
+                continue;
+
+            foreach (int load in local.Loads)
+            {
+                Report(pass, $"{Format(list[load])} => {Format(value)}");
+                list[load] = value with { Offset = list[load].Offset };
+            }
+            changed = true;
+        }
+        return changed;
+    }
+
+    bool RemoveDeadStores(List<ILInstruction> list, HashSet<int> targets)
+    {
+        foreach (var pair in GetLocals(list))
+        {
+            var local = pair.Value;
+            if (local.AddressTaken || local.Loads.Count > 0 || local.Stores.Count == 0)
+                continue;
+
+            // Remove from the end, so the other indexes stay valid
+            bool changed = false;
+            foreach (int store in local.Stores.OrderByDescending(s => s))
+            {
+                int length = GetValueLength(list, store);
+                if (length == 0 || HasTarget(list, targets, store - length, store))
+                    continue;
+
+                int start = store - length;
+                Report(ILOptimizations.DeadStores, $"removed {string.Join(", ", list.Skip(start).Take(length + 1).Select(Format))}");
+                list.RemoveRange(start, length + 1);
+                changed = true;
+            }
+            // Indexes of the other locals are stale now
+            if (changed)
+                return true;
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Folds operations on constants, such as a [Flags] enum value tested with `&amp;` once ConstantPropagation made it a constant.
+    /// A conditional branch on a constant becomes a br if taken, or is removed, and a br to the next instruction is removed.
+    /// Nothing a branch jumps to is removed, its offset is the only label the branch has.
+    /// </summary>
+    bool Fold(List<ILInstruction> list, HashSet<int> targets)
+    {
+        bool changed = false;
+        for (int i = 0; i < list.Count; i++)
+        {
+            var instruction = list[i];
+            if (i >= 2 && GetConstant(list[i - 2]) is int left && GetConstant(list[i - 1]) is int right &&
+                Fold(instruction.OpCode, left, right) is int result && !HasTarget(list, targets, i - 2, i))
+            {
+                Report(ILOptimizations.ConstantFolding, $"{Format(list[i - 2])}, {Format(list[i - 1])}, {Format(instruction)} => {result}");
+                list[i - 2] = new ILInstruction(ILOpCode.Ldc_i4, result) { Offset = list[i - 2].Offset };
+                list.RemoveRange(i - 1, 2);
+                i -= 2;
+                changed = true;
+            }
+            else if (i >= 1 && GetConstant(list[i - 1]) is int value &&
+                Fold(instruction.OpCode, value) is int unary && !HasTarget(list, targets, i - 1, i))
+            {
+                Report(ILOptimizations.ConstantFolding, $"{Format(list[i - 1])}, {Format(instruction)} => {unary}");
+                list[i - 1] = new ILInstruction(ILOpCode.Ldc_i4, unary) { Offset = list[i - 1].Offset };
+                list.RemoveAt(i);
+                i -= 1;
+                changed = true;
+            }
+            else if (i >= 1 && GetConstant(list[i - 1]) is int condition &&
+                instruction.OpCode is ILOpCode.Brtrue or ILOpCode.Brtrue_s or ILOpCode.Brfalse or ILOpCode.Brfalse_s &&
+                !HasTarget(list, targets, i - 2, i))
+            {
+                bool taken = (condition != 0) == (instruction.OpCode is ILOpCode.Brtrue or ILOpCode.Brtrue_s);
+                Report(ILOptimizations.ConstantFolding, $"{Format(list[i - 1])}, {Format(instruction)} => {(taken ? "br" : "removed")}");
+                if (taken)
+                {
+                    // The br keeps the offset of the branch, so its operand still points at the same target
+                    list[i] = instruction with { OpCode = instruction.OpCode.GetBranchOperandSize() == 1 ? ILOpCode.Br_s : ILOpCode.Br };
+                    list.RemoveAt(i - 1);
+                    i -= 1;
+                }
+                else
+                {
+                    list.RemoveRange(i - 1, 2);
+                    i -= 2;
+                }
+                changed = true;
+            }
+            else if (instruction.OpCode is ILOpCode.Br or ILOpCode.Br_s && i + 1 < list.Count && GetTarget(instruction) == list[i + 1].Offset &&
+                !targets.Contains(instruction.Offset))
+            {
+                Report(ILOptimizations.ConstantFolding, $"removed {Format(instruction)}");
+                list.RemoveAt(i--);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    static int? Fold(ILOpCode code, int left, int right) => code switch
+    {
+        ILOpCode.Add => left + right,
+        ILOpCode.Sub => left - right,
+        ILOpCode.Mul => left * right,
+        // Like a division by zero, int.MinValue / -1 throws at run time and is left to the 6502
+        ILOpCode.Div when right != 0 && !(left == int.MinValue && right == -1) => left / right,
+        ILOpCode.Rem when right != 0 && !(left == int.MinValue && right == -1) => left % right,
+        ILOpCode.And => left & right,
+        ILOpCode.Or => left | right,
+        ILOpCode.Xor => left ^ right,
+        ILOpCode.Shl => left << right,
+        ILOpCode.Shr => left >> right,
+        ILOpCode.Shr_un => (int)((uint)left >> right),
+        ILOpCode.Ceq => left == right ? 1 : 0,
+        ILOpCode.Cgt => left > right ? 1 : 0,
+        ILOpCode.Cgt_un => (uint)left > (uint)right ? 1 : 0,
+        ILOpCode.Clt => left < right ? 1 : 0,
+        ILOpCode.Clt_un => (uint)left < (uint)right ? 1 : 0,
+        _ => null,
+    };
+
+    static int? Fold(ILOpCode code, int value) => code switch
+    {
+        ILOpCode.Not => ~value,
+        ILOpCode.Neg => -value,
+        ILOpCode.Conv_u1 => (byte)value,
+        ILOpCode.Conv_i1 => (sbyte)value,
+        ILOpCode.Conv_u2 => (ushort)value,
+        ILOpCode.Conv_i2 => (short)value,
+        ILOpCode.Conv_u4 or ILOpCode.Conv_i4 => value,
+        _ => null,
+    };
+
+    /// <summary>
+    /// Number of instructions that push the value stored at the index, 0 if they could have side effects
+    /// </summary>
+    static int GetValueLength(List<ILInstruction> list, int store)
+    {
+        if (store == 0)
+            return 0;
+        var value = list[store - 1];
+        if (GetConstant(value) is not null || value.OpCode == ILOpCode.Ldftn || GetLocal(value, out var kind) is not null && kind == LocalAccess.Load)
+            return 1;
+
+        // A byte[] initialized from an RVA field: ldc, newarr, dup, ldtoken (InitializeArray is skipped when decoding)
+        if (store >= 4 &&
+            list[store - 1].OpCode == ILOpCode.Ldtoken &&
+            list[store - 2].OpCode == ILOpCode.Dup &&
+            list[store - 3].OpCode == ILOpCode.Newarr &&
+            GetConstant(list[store - 4]) is not null)
+            return 4;
+
+        return 0;
+    }
+
+    /// <summary>
+    /// True if a branch jumps to any instruction after start, up to and including end
+    /// </summary>
+    static bool HasTarget(List<ILInstruction> list, HashSet<int> targets, int start, int end)
+    {
+        for (int i = start + 1; i <= end && i < list.Count; i++)
+        {
+            if (targets.Contains(list[i].Offset))
+                return true;
+        }
+        return false;
+    }
+
+    static HashSet<int> GetBranchTargets(List<ILInstruction> list)
+    {
+        var targets = new HashSet<int>();
+        foreach (var instruction in list)
+        {
+            if (!instruction.OpCode.IsBranch() || instruction.Integer is null)
+                continue;
+            targets.Add(GetTarget(instruction));
+        }
+        return targets;
+    }
+
+    static int GetTarget(ILInstruction instruction)
+    {
+        int size = instruction.OpCode.GetBranchOperandSize();
+        // Short branches are decoded as an unsigned byte
+        int delta = size == 1 ? (sbyte)instruction.Integer!.Value : instruction.Integer!.Value;
+        return instruction.Offset + 1 + size + delta;
+    }
+
+    static bool IsUnconditional(ILOpCode code) => code is
+        ILOpCode.Br or ILOpCode.Br_s or ILOpCode.Leave or ILOpCode.Leave_s or
+        ILOpCode.Ret or ILOpCode.Throw or ILOpCode.Rethrow;
+
+    Dictionary<int, Local> GetLocals(List<ILInstruction> list)
+    {
+        var locals = new Dictionary<int, Local>();
+        for (int i = 0; i < list.Count; i++)
+        {
+            var index = GetLocal(list[i], out var kind);
+            if (index is null)
+                continue;
+            if (!locals.TryGetValue(index.Value, out var local))
+                locals[index.Value] = local = new Local();
+            switch (kind)
+            {
+                case LocalAccess.Load:
+                    local.Loads.Add(i);
+                    break;
+                case LocalAccess.Store:
+                    local.Stores.Add(i);
+                    break;
+                default:
+                    local.AddressTaken = true;
+                    break;
+            }
+        }
+        return locals;
+    }
+
+    enum LocalAccess
+    {
+        Load,
+        Store,
+        Address,
+    }
+
+    static int? GetLocal(ILInstruction instruction, out LocalAccess kind)
+    {
+        kind = LocalAccess.Load;
+        switch (instruction.OpCode)
+        {
+            case ILOpCode.Ldloc_0: return 0;
+            case ILOpCode.Ldloc_1: return 1;
+            case ILOpCode.Ldloc_2: return 2;
+            case ILOpCode.Ldloc_3: return 3;
+            case ILOpCode.Ldloc_s:
+            case ILOpCode.Ldloc:
+                return instruction.Integer;
+        }
+        kind = LocalAccess.Store;
+        switch (instruction.OpCode)
+        {
+            case ILOpCode.Stloc_0: return 0;
+            case ILOpCode.Stloc_1: return 1;
+            case ILOpCode.Stloc_2: return 2;
+            case ILOpCode.Stloc_3: return 3;
+            case ILOpCode.Stloc_s:
+            case ILOpCode.Stloc:
+                return instruction.Integer;
+        }
+        kind = LocalAccess.Address;
+        switch (instruction.OpCode)
+        {
+            case ILOpCode.Ldloca_s:
+            case ILOpCode.Ldloca:
+                return instruction.Integer;
+        }
+        return null;
+    }
+
+    internal static int? GetConstant(ILInstruction instruction) => instruction.OpCode switch
+    {
+        ILOpCode.Ldc_i4_m1 => -1,
+        ILOpCode.Ldc_i4_0 => 0,
+        ILOpCode.Ldc_i4_1 => 1,
+        ILOpCode.Ldc_i4_2 => 2,
+        ILOpCode.Ldc_i4_3 => 3,
+        ILOpCode.Ldc_i4_4 => 4,
+        ILOpCode.Ldc_i4_5 => 5,
+        ILOpCode.Ldc_i4_6 => 6,
+        ILOpCode.Ldc_i4_7 => 7,
+        ILOpCode.Ldc_i4_8 => 8,
+        // ldc.i4.s is decoded as an unsigned byte, like a short branch
+        ILOpCode.Ldc_i4_s => (sbyte)instruction.Integer!.Value,
+        ILOpCode.Ldc_i4 => instruction.Integer,
+        _ => null,
+    };
+}
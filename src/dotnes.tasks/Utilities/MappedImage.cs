@@ -0,0 +1,45 @@
+﻿using System.IO.MemoryMappedFiles;
+
+namespace dotnes;
+
+/// <summary>
+/// A read-only, memory-mapped view of a file, such as a .NET assembly.
+/// PEReader can read the image in place, instead of copying it into managed memory.
+/// WARNING: It is incorrect to use Pointer after this has been disposed.
+/// </summary>
+unsafe class MappedImage : IDisposable
+{
+    readonly MemoryMappedFile _file;
+    readonly MemoryMappedViewAccessor _view;
+
+    public MappedImage(string path)
+    {
+        Length = checked((int)new FileInfo(path).Length);
+        if (Length == 0)
+            throw new BadImageFormatException($"Empty file: {path}");
+
+        _file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, mapName: null, capacity: 0, MemoryMappedFileAccess.Read);
+        _view = _file.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read);
+
+        byte* pointer = null;
+        _view.SafeMemoryMappedViewHandle.AcquirePointer(ref pointer);
+        Pointer = pointer + _view.PointerOffset;
+    }
+
+    /// <summary>
+    /// Start of the mapped file
+    /// </summary>
+    public byte* Pointer { get; }
+
+    /// <summary>
+    /// Length of the file, the view itself is rounded up to the page size
+    /// </summary>
+    public int Length { get; }
+
+    public void Dispose()
+    {
+        _view.SafeMemoryMappedViewHandle.ReleasePointer();
+        _view.Dispose();
+        _file.Dispose();
+    }
+}
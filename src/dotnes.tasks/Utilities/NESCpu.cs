@@ -0,0 +1,368 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// A small model of the NES's 6502, the 2A03, enough to run straight-line code and the built-ins.
+/// Implements the official instructions and the stable unofficial ones, without decimal mode which the 2A03 does not have.
+/// </summary>
+class NESCpu
+{
+    const ushort STACK = 0x0100;
+    const ushort NMI_VECTOR = 0xFFFA;
+    const ushort RESET_VECTOR = 0xFFFC;
+    const ushort IRQ_VECTOR = 0xFFFE;
+
+    public byte A, X, Y;
+    public byte S = 0xFD;
+    public bool C, Z, I, D, V, N;
+    public ushort PC;
+    public long Cycles;
+
+    /// <summary>
+    /// All 64KB of the address space, the PPU and APU registers are plain memory
+    /// </summary>
+    public readonly byte[] Memory = new byte[0x10000];
+
+    /// <summary>
+    /// Optional handler for reads of the PPU, APU and controller registers at $2000-$401F
+    /// </summary>
+    public Func<ushort, byte>? ReadRegister { get; set; }
+
+    /// <summary>
+    /// Optional handler for writes to the PPU, APU and controller registers, they are stored in Memory either way
+    /// </summary>
+    public Action<ushort, byte>? WriteRegister { get; set; }
+
+    /// <summary>
+    /// Optional count of the instructions run at each address
+    /// </summary>
+    public long[]? Executions { get; set; }
+
+    /// <summary>
+    /// Optional count of the reads and writes to each address by instructions, not including the stack
+    /// </summary>
+    public long[]? Accesses { get; set; }
+
+    /// <summary>
+    /// The status register, as pushed by PHP
+    /// </summary>
+    public byte P
+    {
+        get => (byte)((N ? 0x80 : 0) | (V ? 0x40 : 0) | 0x20 | (D ? 0x08 : 0) | (I ? 0x04 : 0) | (Z ? 0x02 : 0) | (C ? 0x01 : 0));
+        set
+        {
+            N = (value & 0x80) != 0;
+            V = (value & 0x40) != 0;
+            D = (value & 0x08) != 0;
+            I = (value & 0x04) != 0;
+            Z = (value & 0x02) != 0;
+            C = (value & 0x01) != 0;
+        }
+    }
+
+    /// <summary>
+    /// Copies code to an address and runs it until it jumps or returns outside of it, subroutines it calls are run too
+    /// </summary>
+    public void Run(byte[] code, ushort address, int maxSteps = 10_000)
+    {
+        Array.Copy(code, 0, Memory, address, code.Length);
+        PC = address;
+        byte stack = S;
+        for (int i = 0; i < maxSteps; i++)
+        {
+            if ((PC < address || PC >= address + code.Length) && S >= stack)
+                return;
+            Step();
+        }
+        throw new InvalidOperationException($"Code at ${address:X4} did not finish in {maxSteps} steps!");
+    }
+
+    /// <summary>
+    /// Runs a single instruction
+    /// </summary>
+    public void Step()
+    {
+        if (Executions is not null)
+            Executions[PC]++;
+        byte opcode = Memory[PC];
+        var info = NESInstructionInfo.Get(opcode) ??
+            throw new NotImplementedException($"Opcode ${opcode:X2} at ${PC:X4} is not implemented!");
+
+        ushort address = 0;
+        bool crossed = false;
+        switch (info.Mode)
+        {
+            case AddressMode.Immediate:
+                address = (ushort)(PC + 1);
+                break;
+            case AddressMode.ZeroPage:
+                address = Memory[(ushort)(PC + 1)];
+                break;
+            case AddressMode.ZeroPageX:
+                address = (byte)(Memory[(ushort)(PC + 1)] + X);
+                break;
+            case AddressMode.ZeroPageY:
+                address = (byte)(Memory[(ushort)(PC + 1)] + Y);
+                break;
+            case AddressMode.Absolute:
+                address = ReadWord((ushort)(PC + 1));
+                break;
+            case AddressMode.AbsoluteX:
+                address = Index(ReadWord((ushort)(PC + 1)), X, out crossed);
+                break;
+            case AddressMode.AbsoluteY:
+                address = Index(ReadWord((ushort)(PC + 1)), Y, out crossed);
+                break;
+            case AddressMode.Indirect:
+            {
+                // JMP ($xxFF) reads the high byte from $xx00
+                ushort pointer = ReadWord((ushort)(PC + 1));
+                address = (ushort)(Memory[pointer] | Memory[(ushort)((pointer & 0xFF00) | (byte)(pointer + 1))] << 8);
+                break;
+            }
+            case AddressMode.IndirectX:
+                address = ReadZeroPageWord((byte)(Memory[(ushort)(PC + 1)] + X));
+                break;
+            case AddressMode.IndirectY:
+                address = Index(ReadZeroPageWord(Memory[(ushort)(PC + 1)]), Y, out crossed);
+                break;
+            case AddressMode.Relative:
+                address = (ushort)(PC + 2 + (sbyte)Memory[(ushort)(PC + 1)]);
+                break;
+        }
+        PC = (ushort)(PC + info.Length);
+        Cycles += info.Cycles;
+        if (crossed && info.PageCross)
+            Cycles++;
+
+        switch (info.Mnemonic)
+        {
+            case "LDA": A = SetNZ(Read(address)); break;
+            case "LDX": X = SetNZ(Read(address)); break;
+            case "LDY": Y = SetNZ(Read(address)); break;
+            case "STA": Write(address, A); break;
+            case "STX": Write(address, X); break;
+            case "STY": Write(address, Y); break;
+            case "TAX": X = SetNZ(A); break;
+            case "TAY": Y = SetNZ(A); break;
+            case "TXA": A = SetNZ(X); break;
+            case "TYA": A = SetNZ(Y); break;
+            case "TSX": X = SetNZ(S); break;
+            case "TXS": S = X; break;
+            case "PHA": Push(A); break;
+            case "PHP": Push((byte)(P | 0x10)); break;
+            case "PLA": A = SetNZ(Pull()); break;
+            case "PLP": P = Pull(); break;
+            case "AND": A = SetNZ((byte)(A & Read(address))); break;
+            case "ORA": A = SetNZ((byte)(A | Read(address))); break;
+            case "EOR": A = SetNZ((byte)(A ^ Read(address))); break;
+            case "ADC": Add(Read(address)); break;
+            case "SBC": Add((byte)~Read(address)); break;
+            case "CMP": Compare(A, Read(address)); break;
+            case "CPX": Compare(X, Read(address)); break;
+            case "CPY": Compare(Y, Read(address)); break;
+            case "BIT":
+            {
+                byte value = Read(address);
+                Z = (A & value) == 0;
+                N = (value & 0x80) != 0;
+                V = (value & 0x40) != 0;
+                break;
+            }
+            case "INC": Write(address, SetNZ((byte)(Read(address) + 1))); break;
+            case "DEC": Write(address, SetNZ((byte)(Read(address) - 1))); break;
+            case "INX": X = SetNZ((byte)(X + 1)); break;
+            case "INY": Y = SetNZ((byte)(Y + 1)); break;
+            case "DEX": X = SetNZ((byte)(X - 1)); break;
+            case "DEY": Y = SetNZ((byte)(Y - 1)); break;
+            case "ASL":
+            case "LSR":
+            case "ROL":
+            case "ROR":
+            {
+                byte value = info.Mode == AddressMode.Accumulator ? A : Read(address);
+                bool carry = C;
+                byte result;
+                if (info.Mnemonic is "ASL" or "ROL")
+                {
+                    C = (value & 0x80) != 0;
+                    result = (byte)(value << 1 | (info.Mnemonic == "ROL" && carry ? 1 : 0));
+                }
+                else
+                {
+                    C = (value & 0x01) != 0;
+                    result = (byte)(value >> 1 | (info.Mnemonic == "ROR" && carry ? 0x80 : 0));
+                }
+                SetNZ(result);
+                if (info.Mode == AddressMode.Accumulator)
+                    A = result;
+                else
+                    Write(address, result);
+                break;
+            }
+            case "BCC": Branch(!C, address); break;
+            case "BCS": Branch(C, address); break;
+            case "BNE": Branch(!Z, address); break;
+            case "BEQ": Branch(Z, address); break;
+            case "BPL": Branch(!N, address); break;
+            case "BMI": Branch(N, address); break;
+            case "BVC": Branch(!V, address); break;
+            case "BVS": Branch(V, address); break;
+            case "JMP": PC = address; break;
+            case "JSR":
+                PushWord((ushort)(PC - 1));
+                PC = address;
+                break;
+            case "RTS": PC = (ushort)(PullWord() + 1); break;
+            case "RTI":
+                P = Pull();
+                PC = PullWord();
+                break;
+            case "BRK":
+                PushWord((ushort)(PC + 1));
+                Push((byte)(P | 0x10));
+                I = true;
+                PC = ReadWord(IRQ_VECTOR);
+                break;
+            case "CLC": C = false; break;
+            case "SEC": C = true; break;
+            case "CLI": I = false; break;
+            case "SEI": I = true; break;
+            case "CLD": D = false; break;
+            case "SED": D = true; break;
+            case "CLV": V = false; break;
+            case "NOP": break;
+            // Unofficial
+            case "LAX": A = X = SetNZ(Read(address)); break;
+            case "SAX": Write(address, (byte)(A & X)); break;
+            case "DCP":
+            {
+                byte value = (byte)(Read(address) - 1);
+                Write(address, value);
+                Compare(A, value);
+                break;
+            }
+            case "ISC":
+            {
+                byte value = (byte)(Read(address) + 1);
+                Write(address, value);
+                Add((byte)~value);
+                break;
+            }
+            case "AXS":
+            {
+                byte value = Read(address);
+                int ax = A & X;
+                C = ax >= value;
+                X = SetNZ((byte)(ax - value));
+                break;
+            }
+            case "ANC":
+                A = SetNZ((byte)(A & Read(address)));
+                C = N;
+                break;
+            case "ALR":
+                A = (byte)(A & Read(address));
+                C = (A & 0x01) != 0;
+                A = SetNZ((byte)(A >> 1));
+                break;
+            default:
+                throw new NotImplementedException($"{info.Mnemonic} at ${PC - info.Length:X4} is not implemented!");
+        }
+    }
+
+    /// <summary>
+    /// Starts at the reset vector, like powering on the NES
+    /// </summary>
+    public void Reset()
+    {
+        S = 0xFD;
+        I = true;
+        PC = ReadWord(RESET_VECTOR);
+        Cycles += 7;
+    }
+
+    /// <summary>
+    /// Triggers a non-maskable interrupt, like the PPU does at the start of vblank
+    /// </summary>
+    public void NMI()
+    {
+        PushWord(PC);
+        Push(P);
+        I = true;
+        PC = ReadWord(NMI_VECTOR);
+        Cycles += 7;
+    }
+
+    byte Read(ushort address)
+    {
+        if (Accesses is not null)
+            Accesses[address]++;
+        if (ReadRegister is not null && address is >= 0x2000 and < 0x4020)
+            return ReadRegister(address);
+        return Memory[address];
+    }
+
+    void Write(ushort address, byte value)
+    {
+        if (Accesses is not null)
+            Accesses[address]++;
+        Memory[address] = value;
+        if (WriteRegister is not null && address is >= 0x2000 and < 0x4020)
+            WriteRegister(address, value);
+    }
+
+    byte SetNZ(byte value)
+    {
+        Z = value == 0;
+        N = (value & 0x80) != 0;
+        return value;
+    }
+
+    /// <summary>
+    /// ADC, and SBC with the operand inverted
+    /// </summary>
+    void Add(byte value)
+    {
+        int sum = A + value + (C ? 1 : 0);
+        V = (~(A ^ value) & (A ^ sum) & 0x80) != 0;
+        C = sum > 0xFF;
+        A = SetNZ((byte)sum);
+    }
+
+    void Compare(byte register, byte value)
+    {
+        C = register >= value;
+        SetNZ((byte)(register - value));
+    }
+
+    void Branch(bool condition, ushort address)
+    {
+        if (!condition)
+            return;
+        Cycles += (PC & 0xFF00) == (address & 0xFF00) ? 1 : 2;
+        PC = address;
+    }
+
+    static ushort Index(ushort address, byte index, out bool crossed)
+    {
+        var result = (ushort)(address + index);
+        crossed = (address & 0xFF00) != (result & 0xFF00);
+        return result;
+    }
+
+    ushort ReadWord(ushort address) => (ushort)(Memory[address] | Memory[(ushort)(address + 1)] << 8);
+
+    ushort ReadZeroPageWord(byte address) => (ushort)(Memory[address] | Memory[(byte)(address + 1)] << 8);
+
+    void Push(byte value) => Memory[STACK + S--] = value;
+
+    byte Pull() => Memory[STACK + ++S];
+
+    void PushWord(ushort value)
+    {
+        Push((byte)(value >> 8));
+        Push((byte)value);
+    }
+
+    ushort PullWord() => (ushort)(Pull() | Pull() << 8);
+}
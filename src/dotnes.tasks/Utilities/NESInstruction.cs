@@ -51,6 +51,10 @@ enum NESInstruction : byte
     /// Branch on Result Plus
     /// </summary>
     BPL       = 0x10,
+    /// <summary>
+    /// Clear Carry Flag
+    /// </summary>
+    CLC_impl  = 0x18,
 
     // 2
     /// <summary>
@@ -122,6 +126,14 @@ enum NESInstruction : byte
     /// Push Accumulator on Stack
     /// </summary>
     PHA_impl  = 0x48,
+    /// <summary>
+    /// Exclusive-OR Memory with Accumulator
+    /// </summary>
+    EOR       = 0x49,
+    /// <summary>
+    /// Shift One Bit Right (Memory or Accumulator)
+    /// </summary>
+    LSR_A     = 0x4A,
     //TODO: 4-5
 
     // 6
@@ -172,6 +184,10 @@ enum NESInstruction : byte
     /// Set Interrupt Disable Status
     /// </summary>
     SEI_impl  = 0x78,
+    /// <summary>
+    /// Add Memory to Accumulator with Carry
+    /// </summary>
+    ADC_abs_X = 0x7D,
 
     /// <summary>
     /// Store Accumulator in Memory
@@ -335,6 +351,10 @@ enum NESInstruction : byte
     /// </summary>
     DEX_impl  = 0xCA,
     /// <summary>
+    /// Compare Memory with Accumulator
+    /// </summary>
+    CMP_abs   = 0xCD,
+    /// <summary>
     /// Decrement Memory by One
     /// </summary>
     DEC_abs   = 0xCE,
@@ -390,6 +410,10 @@ enum NESInstruction : byte
     /// </summary>
     SBC       = 0xE9,
     /// <summary>
+    /// No Operation
+    /// </summary>
+    NOP_impl  = 0xEA,
+    /// <summary>
     /// Increment Memory by One
     /// </summary>
     INC_abs   = 0xEE,
@@ -401,4 +425,51 @@ enum NESInstruction : byte
     /// Branch on Result Zero
     /// </summary>
     BEQ_rel   = 0xF0,
+
+    // Unofficial, stable on the 2A03, only used with CodeOptimizations.Unofficial
+
+    /// <summary>
+    /// AND Memory with Accumulator, then Carry = Negative
+    /// </summary>
+    ANC       = 0x0B,
+    /// <summary>
+    /// AND Memory with Accumulator, then Shift One Bit Right
+    /// </summary>
+    ALR       = 0x4B,
+    /// <summary>
+    /// Store Accumulator AND Index X in Memory
+    /// </summary>
+    SAX_zpg   = 0x87,
+    /// <summary>
+    /// Store Accumulator AND Index X in Memory
+    /// </summary>
+    SAX_abs   = 0x8F,
+    /// <summary>
+    /// Load Accumulator and Index X with Memory
+    /// </summary>
+    LAX_zpg   = 0xA7,
+    /// <summary>
+    /// Load Accumulator and Index X with Memory
+    /// </summary>
+    LAX_abs   = 0xAF,
+    /// <summary>
+    /// Decrement Memory by One, then Compare with Accumulator
+    /// </summary>
+    DCP_zpg   = 0xC7,
+    /// <summary>
+    /// Index X = Accumulator AND Index X minus Memory, without Borrow
+    /// </summary>
+    AXS       = 0xCB,
+    /// <summary>
+    /// Decrement Memory by One, then Compare with Accumulator
+    /// </summary>
+    DCP_abs   = 0xCF,
+    /// <summary>
+    /// Increment Memory by One, then Subtract from Accumulator with Borrow
+    /// </summary>
+    ISC_zpg   = 0xE7,
+    /// <summary>
+    /// Increment Memory by One, then Subtract from Accumulator with Borrow
+    /// </summary>
+    ISC_abs   = 0xEF,
 }
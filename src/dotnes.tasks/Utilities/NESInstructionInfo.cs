@@ -0,0 +1,260 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// 6502 addressing modes, which decide the length of an instruction
+/// </summary>
+enum AddressMode : byte
+{
+    Implied,
+    Accumulator,
+    Immediate,
+    ZeroPage,
+    ZeroPageX,
+    ZeroPageY,
+    Absolute,
+    AbsoluteX,
+    AbsoluteY,
+    Indirect,
+    IndirectX,
+    IndirectY,
+    Relative,
+}
+
+/// <summary>
+/// Length and timing of a 6502 opcode, including the ones not listed in NESInstruction
+/// 
+/// See: https://www.masswerk.at/6502/6502_instruction_set.html
+/// </summary>
+/// <param name="Cycles">Cycles for the common case: branches not taken, no page boundary crossed</param>
+/// <param name="PageCross">Takes one more cycle when the address crosses a page, or two for a taken branch</param>
+/// <param name="Unofficial">Not a documented 6502 instruction, but stable on the 2A03</param>
+record NESInstructionInfo(byte Opcode, string Mnemonic, AddressMode Mode, byte Cycles, bool PageCross = false, bool Unofficial = false)
+{
+    /// <summary>
+    /// Size of the instruction in bytes, including the opcode
+    /// </summary>
+    public int Length => Mode switch
+    {
+        AddressMode.Implied or AddressMode.Accumulator => 1,
+        AddressMode.Absolute or AddressMode.AbsoluteX or AddressMode.AbsoluteY or AddressMode.Indirect => 3,
+        _ => 2,
+    };
+
+    /// <summary>
+    /// Returns null for opcodes that are neither official 6502 instructions nor stable unofficial ones
+    /// </summary>
+    public static NESInstructionInfo? Get(byte opcode) => table[opcode];
+
+    public static NESInstructionInfo Get(NESInstruction instruction) =>
+        table[(byte)instruction] ?? throw new NotImplementedException($"No timing for {instruction}!");
+
+    /// <summary>
+    /// The official opcode of a mnemonic in an addressing mode, or null if there is none
+    /// </summary>
+    public static NESInstructionInfo? Get(string mnemonic, AddressMode mode) =>
+        Array.Find(official, i => i.Mnemonic == mnemonic && i.Mode == mode);
+
+    static readonly NESInstructionInfo[] official =
+    [
+        new(0x00, "BRK", AddressMode.Implied, 7),
+        new(0x01, "ORA", AddressMode.IndirectX, 6),
+        new(0x05, "ORA", AddressMode.ZeroPage, 3),
+        new(0x06, "ASL", AddressMode.ZeroPage, 5),
+        new(0x08, "PHP", AddressMode.Implied, 3),
+        new(0x09, "ORA", AddressMode.Immediate, 2),
+        new(0x0A, "ASL", AddressMode.Accumulator, 2),
+        new(0x0D, "ORA", AddressMode.Absolute, 4),
+        new(0x0E, "ASL", AddressMode.Absolute, 6),
+        new(0x10, "BPL", AddressMode.Relative, 2, PageCross: true),
+        new(0x11, "ORA", AddressMode.IndirectY, 5, PageCross: true),
+        new(0x15, "ORA", AddressMode.ZeroPageX, 4),
+        new(0x16, "ASL", AddressMode.ZeroPageX, 6),
+        new(0x18, "CLC", AddressMode.Implied, 2),
+        new(0x19, "ORA", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0x1D, "ORA", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0x1E, "ASL", AddressMode.AbsoluteX, 7),
+        new(0x20, "JSR", AddressMode.Absolute, 6),
+        new(0x21, "AND", AddressMode.IndirectX, 6),
+        new(0x24, "BIT", AddressMode.ZeroPage, 3),
+        new(0x25, "AND", AddressMode.ZeroPage, 3),
+        new(0x26, "ROL", AddressMode.ZeroPage, 5),
+        new(0x28, "PLP", AddressMode.Implied, 4),
+        new(0x29, "AND", AddressMode.Immediate, 2),
+        new(0x2A, "ROL", AddressMode.Accumulator, 2),
+        new(0x2C, "BIT", AddressMode.Absolute, 4),
+        new(0x2D, "AND", AddressMode.Absolute, 4),
+        new(0x2E, "ROL", AddressMode.Absolute, 6),
+        new(0x30, "BMI", AddressMode.Relative, 2, PageCross: true),
+        new(0x31, "AND", AddressMode.IndirectY, 5, PageCross: true),
+        new(0x35, "AND", AddressMode.ZeroPageX, 4),
+        new(0x36, "ROL", AddressMode.ZeroPageX, 6),
+        new(0x38, "SEC", AddressMode.Implied, 2),
+        new(0x39, "AND", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0x3D, "AND", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0x3E, "ROL", AddressMode.AbsoluteX, 7),
+        new(0x40, "RTI", AddressMode.Implied, 6),
+        new(0x41, "EOR", AddressMode.IndirectX, 6),
+        new(0x45, "EOR", AddressMode.ZeroPage, 3),
+        new(0x46, "LSR", AddressMode.ZeroPage, 5),
+        new(0x48, "PHA", AddressMode.Implied, 3),
+        new(0x49, "EOR", AddressMode.Immediate, 2),
+        new(0x4A, "LSR", AddressMode.Accumulator, 2),
+        new(0x4C, "JMP", AddressMode.Absolute, 3),
+        new(0x4D, "EOR", AddressMode.Absolute, 4),
+        new(0x4E, "LSR", AddressMode.Absolute, 6),
+        new(0x50, "BVC", AddressMode.Relative, 2, PageCross: true),
+        new(0x51, "EOR", AddressMode.IndirectY, 5, PageCross: true),
+        new(0x55, "EOR", AddressMode.ZeroPageX, 4),
+        new(0x56, "LSR", AddressMode.ZeroPageX, 6),
+        new(0x58, "CLI", AddressMode.Implied, 2),
+        new(0x59, "EOR", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0x5D, "EOR", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0x5E, "LSR", AddressMode.AbsoluteX, 7),
+        new(0x60, "RTS", AddressMode.Implied, 6),
+        new(0x61, "ADC", AddressMode.IndirectX, 6),
+        new(0x65, "ADC", AddressMode.ZeroPage, 3),
+        new(0x66, "ROR", AddressMode.ZeroPage, 5),
+        new(0x68, "PLA", AddressMode.Implied, 4),
+        new(0x69, "ADC", AddressMode.Immediate, 2),
+        new(0x6A, "ROR", AddressMode.Accumulator, 2),
+        new(0x6C, "JMP", AddressMode.Indirect, 5),
+        new(0x6D, "ADC", AddressMode.Absolute, 4),
+        new(0x6E, "ROR", AddressMode.Absolute, 6),
+        new(0x70, "BVS", AddressMode.Relative, 2, PageCross: true),
+        new(0x71, "ADC", AddressMode.IndirectY, 5, PageCross: true),
+        new(0x75, "ADC", AddressMode.ZeroPageX, 4),
+        new(0x76, "ROR", AddressMode.ZeroPageX, 6),
+        new(0x78, "SEI", AddressMode.Implied, 2),
+        new(0x79, "ADC", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0x7D, "ADC", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0x7E, "ROR", AddressMode.AbsoluteX, 7),
+        new(0x81, "STA", AddressMode.IndirectX, 6),
+        new(0x84, "STY", AddressMode.ZeroPage, 3),
+        new(0x85, "STA", AddressMode.ZeroPage, 3),
+        new(0x86, "STX", AddressMode.ZeroPage, 3),
+        new(0x88, "DEY", AddressMode.Implied, 2),
+        new(0x8A, "TXA", AddressMode.Implied, 2),
+        new(0x8C, "STY", AddressMode.Absolute, 4),
+        new(0x8D, "STA", AddressMode.Absolute, 4),
+        new(0x8E, "STX", AddressMode.Absolute, 4),
+        new(0x90, "BCC", AddressMode.Relative, 2, PageCross: true),
+        new(0x91, "STA", AddressMode.IndirectY, 6),
+        new(0x94, "STY", AddressMode.ZeroPageX, 4),
+        new(0x95, "STA", AddressMode.ZeroPageX, 4),
+        new(0x96, "STX", AddressMode.ZeroPageY, 4),
+        new(0x98, "TYA", AddressMode.Implied, 2),
+        new(0x99, "STA", AddressMode.AbsoluteY, 5),
+        new(0x9A, "TXS", AddressMode.Implied, 2),
+        new(0x9D, "STA", AddressMode.AbsoluteX, 5),
+        new(0xA0, "LDY", AddressMode.Immediate, 2),
+        new(0xA1, "LDA", AddressMode.IndirectX, 6),
+        new(0xA2, "LDX", AddressMode.Immediate, 2),
+        new(0xA4, "LDY", AddressMode.ZeroPage, 3),
+        new(0xA5, "LDA", AddressMode.ZeroPage, 3),
+        new(0xA6, "LDX", AddressMode.ZeroPage, 3),
+        new(0xA8, "TAY", AddressMode.Implied, 2),
+        new(0xA9, "LDA", AddressMode.Immediate, 2),
+        new(0xAA, "TAX", AddressMode.Implied, 2),
+        new(0xAC, "LDY", AddressMode.Absolute, 4),
+        new(0xAD, "LDA", AddressMode.Absolute, 4),
+        new(0xAE, "LDX", AddressMode.Absolute, 4),
+        new(0xB0, "BCS", AddressMode.Relative, 2, PageCross: true),
+        new(0xB1, "LDA", AddressMode.IndirectY, 5, PageCross: true),
+        new(0xB4, "LDY", AddressMode.ZeroPageX, 4),
+        new(0xB5, "LDA", AddressMode.ZeroPageX, 4),
+        new(0xB6, "LDX", AddressMode.ZeroPageY, 4),
+        new(0xB8, "CLV", AddressMode.Implied, 2),
+        new(0xB9, "LDA", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0xBA, "TSX", AddressMode.Implied, 2),
+        new(0xBC, "LDY", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0xBD, "LDA", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0xBE, "LDX", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0xC0, "CPY", AddressMode.Immediate, 2),
+        new(0xC1, "CMP", AddressMode.IndirectX, 6),
+        new(0xC4, "CPY", AddressMode.ZeroPage, 3),
+        new(0xC5, "CMP", AddressMode.ZeroPage, 3),
+        new(0xC6, "DEC", AddressMode.ZeroPage, 5),
+        new(0xC8, "INY", AddressMode.Implied, 2),
+        new(0xC9, "CMP", AddressMode.Immediate, 2),
+        new(0xCA, "DEX", AddressMode.Implied, 2),
+        new(0xCC, "CPY", AddressMode.Absolute, 4),
+        new(0xCD, "CMP", AddressMode.Absolute, 4),
+        new(0xCE, "DEC", AddressMode.Absolute, 6),
+        new(0xD0, "BNE", AddressMode.Relative, 2, PageCross: true),
+        new(0xD1, "CMP", AddressMode.IndirectY, 5, PageCross: true),
+        new(0xD5, "CMP", AddressMode.ZeroPageX, 4),
+        new(0xD6, "DEC", AddressMode.ZeroPageX, 6),
+        new(0xD8, "CLD", AddressMode.Implied, 2),
+        new(0xD9, "CMP", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0xDD, "CMP", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0xDE, "DEC", AddressMode.AbsoluteX, 7),
+        new(0xE0, "CPX", AddressMode.Immediate, 2),
+        new(0xE1, "SBC", AddressMode.IndirectX, 6),
+        new(0xE4, "CPX", AddressMode.ZeroPage, 3),
+        new(0xE5, "SBC", AddressMode.ZeroPage, 3),
+        new(0xE6, "INC", AddressMode.ZeroPage, 5),
+        new(0xE8, "INX", AddressMode.Implied, 2),
+        new(0xE9, "SBC", AddressMode.Immediate, 2),
+        new(0xEA, "NOP", AddressMode.Implied, 2),
+        new(0xEC, "CPX", AddressMode.Absolute, 4),
+        new(0xED, "SBC", AddressMode.Absolute, 4),
+        new(0xEE, "INC", AddressMode.Absolute, 6),
+        new(0xF0, "BEQ", AddressMode.Relative, 2, PageCross: true),
+        new(0xF1, "SBC", AddressMode.IndirectY, 5, PageCross: true),
+        new(0xF5, "SBC", AddressMode.ZeroPageX, 4),
+        new(0xF6, "INC", AddressMode.ZeroPageX, 6),
+        new(0xF8, "SED", AddressMode.Implied, 2),
+        new(0xF9, "SBC", AddressMode.AbsoluteY, 4, PageCross: true),
+        new(0xFD, "SBC", AddressMode.AbsoluteX, 4, PageCross: true),
+        new(0xFE, "INC", AddressMode.AbsoluteX, 7),
+    ];
+
+    /// <summary>
+    /// Unofficial opcodes that behave the same on every 2A03, the unstable ones and immediate LAX are left out
+    /// 
+    /// See: https://www.nesdev.org/wiki/CPU_unofficial_opcodes
+    /// </summary>
+    static readonly NESInstructionInfo[] unofficial =
+    [
+        new(0x0B, "ANC", AddressMode.Immediate, 2, Unofficial: true),
+        new(0x4B, "ALR", AddressMode.Immediate, 2, Unofficial: true),
+        new(0x83, "SAX", AddressMode.IndirectX, 6, Unofficial: true),
+        new(0x87, "SAX", AddressMode.ZeroPage, 3, Unofficial: true),
+        new(0x8F, "SAX", AddressMode.Absolute, 4, Unofficial: true),
+        new(0x97, "SAX", AddressMode.ZeroPageY, 4, Unofficial: true),
+        new(0xA3, "LAX", AddressMode.IndirectX, 6, Unofficial: true),
+        new(0xA7, "LAX", AddressMode.ZeroPage, 3, Unofficial: true),
+        new(0xAF, "LAX", AddressMode.Absolute, 4, Unofficial: true),
+        new(0xB3, "LAX", AddressMode.IndirectY, 5, PageCross: true, Unofficial: true),
+        new(0xB7, "LAX", AddressMode.ZeroPageY, 4, Unofficial: true),
+        new(0xBF, "LAX", AddressMode.AbsoluteY, 4, PageCross: true, Unofficial: true),
+        new(0xC3, "DCP", AddressMode.IndirectX, 8, Unofficial: true),
+        new(0xC7, "DCP", AddressMode.ZeroPage, 5, Unofficial: true),
+        new(0xCB, "AXS", AddressMode.Immediate, 2, Unofficial: true),
+        new(0xCF, "DCP", AddressMode.Absolute, 6, Unofficial: true),
+        new(0xD3, "DCP", AddressMode.IndirectY, 8, Unofficial: true),
+        new(0xD7, "DCP", AddressMode.ZeroPageX, 6, Unofficial: true),
+        new(0xDB, "DCP", AddressMode.AbsoluteY, 7, Unofficial: true),
+        new(0xDF, "DCP", AddressMode.AbsoluteX, 7, Unofficial: true),
+        new(0xE3, "ISC", AddressMode.IndirectX, 8, Unofficial: true),
+        new(0xE7, "ISC", AddressMode.ZeroPage, 5, Unofficial: true),
+        new(0xEF, "ISC", AddressMode.Absolute, 6, Unofficial: true),
+        new(0xF3, "ISC", AddressMode.IndirectY, 8, Unofficial: true),
+        new(0xF7, "ISC", AddressMode.ZeroPageX, 6, Unofficial: true),
+        new(0xFB, "ISC", AddressMode.AbsoluteY, 7, Unofficial: true),
+        new(0xFF, "ISC", AddressMode.AbsoluteX, 7, Unofficial: true),
+    ];
+
+    // NOTE: must come after the opcode lists, static fields are initialized in order
+    static readonly NESInstructionInfo?[] table = Create();
+
+    static NESInstructionInfo?[] Create()
+    {
+        var table = new NESInstructionInfo?[256];
+        foreach (var info in official.Concat(unofficial))
+        {
+            table[info.Opcode] = info;
+        }
+        return table;
+    }
+}
@@ -0,0 +1,103 @@
+﻿using System.Reflection;
+using System.Reflection.Metadata;
+
+namespace dotnes;
+
+/// <summary>
+/// A NESLib method the transpiler can call, read once from its [NESBuiltIn] attribute
+/// </summary>
+/// <param name="Name">Name of the method in NESLib, or the full name of a method of the other classes of neslib such as `NES.Fade.To`</param>
+/// <param name="ParameterCount">Number of arguments, from the method's parameters</param>
+/// <param name="ReturnSize">Bytes of the value the routine returns in A, or A/X, 0 for void</param>
+record NESLibBinding(string Name, int ParameterCount, NESBuiltInAttribute Attribute, int ReturnSize = 0)
+{
+    static readonly Dictionary<string, NESLibBinding> bindings = Read();
+
+    public ushort Address => Attribute.Address;
+
+    public bool IsIntrinsic => Attribute.CallingConvention == NESCallingConvention.Intrinsic;
+
+    /// <summary>
+    /// A method of the program or of a NESObject, its address is only known when it is linked
+    /// </summary>
+    public bool IsLinked => Address == 0 && !IsIntrinsic;
+
+    /// <summary>
+    /// What the routine leaves in the registers, for the register optimizer
+    /// </summary>
+    public BuiltInEffects Effects { get; } = new(
+        (Registers)(NESRegisters.All & ~Attribute.Clobbers),
+        Attribute.A < 0 ? null : (byte)Attribute.A,
+        Attribute.X < 0 ? null : (byte)Attribute.X,
+        Attribute.Y < 0 ? null : (byte)Attribute.Y);
+
+    /// <summary>
+    /// Every method of neslib with a [NESBuiltIn] attribute
+    /// </summary>
+    public static IEnumerable<NESLibBinding> All => bindings.Values;
+
+    public static NESLibBinding? TryGet(string name) => bindings.TryGetValue(name, out var binding) ? binding : null;
+
+    public static NESLibBinding Get(string name) =>
+        TryGet(name) ?? throw new NotImplementedException($"{(name.Contains('.') ? name : $"{nameof(NESLib)}.{name}")} is not implemented!");
+
+    /// <summary>
+    /// A call to a static void method without parameters, named like `Namespace.Type.Method`
+    /// </summary>
+    /// <param name="cycles">Cycles of the method from its NESObject, if it is precompiled</param>
+    public static NESLibBinding Linked(string name, int cycles = 0) =>
+        new(name, ParameterCount: 0, new NESBuiltInAttribute(name, 0) { Cycles = cycles });
+
+    /// <summary>
+    /// Resolves the operand of a call in static void main, or null if it is not a NESLib method
+    /// </summary>
+    public static NESLibBinding? Resolve(MetadataReader reader, EntityHandle handle)
+    {
+        if (handle.Kind != HandleKind.MemberReference)
+            return null;
+        var member = reader.GetMemberReference((MemberReferenceHandle)handle);
+        if (member.Parent.Kind != HandleKind.TypeReference)
+            return null;
+        var type = reader.GetTypeReference((TypeReferenceHandle)member.Parent);
+        if (type.ResolutionScope.Kind != HandleKind.AssemblyReference ||
+            !reader.StringComparer.Equals(reader.GetAssemblyReference((AssemblyReferenceHandle)type.ResolutionScope).Name, typeof(NESLib).Assembly.GetName().Name!))
+            return null;
+        string name = reader.GetString(member.Name);
+        return reader.StringComparer.Equals(type.Name, nameof(NESLib)) ?
+            Get(name) :
+            Get($"{reader.GetString(type.Namespace)}.{reader.GetString(type.Name)}.{name}");
+    }
+
+    static Dictionary<string, NESLibBinding> Read()
+    {
+        var bindings = new Dictionary<string, NESLibBinding>(StringComparer.Ordinal);
+        // Any class of neslib can have [NESBuiltIn] methods, those of NESLib are bound by name and the others by full name
+        foreach (var method in typeof(NESLib).Assembly.GetExportedTypes().SelectMany(t => t.GetMethods(BindingFlags.Public | BindingFlags.Static)))
+        {
+            var attribute = method.GetCustomAttribute<NESBuiltInAttribute>();
+            if (attribute is null)
+                continue;
+            string name = method.DeclaringType == typeof(NESLib) ? method.Name : $"{method.DeclaringType!.FullName}.{method.Name}";
+            // Overloads such as vram_write(string) and vram_write(byte[]) call the same routine
+            if (bindings.TryGetValue(name, out var existing))
+            {
+                if (existing.Address != attribute.Address || existing.ParameterCount != method.GetParameters().Length)
+                    throw new InvalidOperationException($"Overloads of {method.DeclaringType!.Name}.{method.Name} must call the same routine.");
+                continue;
+            }
+            bindings.Add(name, new NESLibBinding(name, method.GetParameters().Length, attribute, GetSize(method.ReturnType)));
+        }
+        return bindings;
+    }
+
+    static int GetSize(Type type)
+    {
+        if (type == typeof(void))
+            return 0;
+        if (type == typeof(byte) || type == typeof(sbyte) || type == typeof(bool))
+            return 1;
+        if (type == typeof(ushort) || type == typeof(short))
+            return 2;
+        throw new NotImplementedException($"Return type {type.Name} is not implemented!");
+    }
+}
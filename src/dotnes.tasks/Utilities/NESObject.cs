@@ -0,0 +1,238 @@
+﻿using System.Globalization;
+
+namespace dotnes;
+
+/// <summary>
+/// The static methods of a class library, transpiled once and linked into a ROM after its destructor table.
+/// Code is written as if static void main were empty, relocations fix it up for the ROM it is linked into.
+/// </summary>
+class NESObject
+{
+    public const string Extension = ".nesobj";
+    const int Version = 1;
+    const int BytesPerLine = 32;
+
+    public enum RelocationKind
+    {
+        /// <summary>
+        /// A word addressing the cc65 runtime after static void main, the size of main is added to it
+        /// </summary>
+        AfterMain,
+        /// <summary>
+        /// The low byte of an address in Data
+        /// </summary>
+        DataLow,
+        /// <summary>
+        /// The high byte of an address in Data
+        /// </summary>
+        DataHigh,
+        /// <summary>
+        /// A word addressing Code, such as a JSR between the routines of one object, the address it is linked at is added to it
+        /// </summary>
+        Code,
+    }
+
+    /// <summary>
+    /// A method, called by its full name such as `Engine.Title.Draw`
+    /// </summary>
+    /// <param name="Cycles">Cycles of one pass through the method including the RTS, not counting the routines it calls</param>
+    public record Symbol(string Name, ushort Offset, ushort Length, int Cycles);
+
+    /// <param name="Offset">Offset in Code to fix up</param>
+    /// <param name="Addend">Offset in Data, for DataLow and DataHigh</param>
+    public record Relocation(ushort Offset, RelocationKind Kind, ushort Addend = 0);
+
+    public byte[] Code { get; set; } = [];
+
+    /// <summary>
+    /// byte[] values, placed right after Code
+    /// </summary>
+    public byte[] Data { get; set; } = [];
+
+    public List<Symbol> Symbols { get; } = new();
+
+    public List<Relocation> Relocations { get; } = new();
+
+    public int Length => Code.Length + Data.Length;
+
+    public bool Contains(string name) => Symbols.Any(s => s.Name == name);
+
+    /// <summary>
+    /// Sets the Cycles of each symbol to one pass through its code, for the objects of built-in routines
+    /// </summary>
+    public void SetCycles()
+    {
+        for (int i = 0; i < Symbols.Count; i++)
+        {
+            var symbol = Symbols[i];
+            int cycles = 0;
+            for (int offset = symbol.Offset; offset < symbol.Offset + symbol.Length;)
+            {
+                var info = NESInstructionInfo.Get(Code[offset])!;
+                cycles += info.Cycles;
+                offset += info.Length;
+            }
+            Symbols[i] = symbol with { Cycles = cycles };
+        }
+    }
+
+    /// <summary>
+    /// True if a method has a JSR or JMP to address, such as a routine of NESLib, which is not relocated
+    /// </summary>
+    public bool Calls(ushort address)
+    {
+        foreach (var symbol in Symbols)
+        {
+            for (int offset = symbol.Offset; offset < symbol.Offset + symbol.Length;)
+            {
+                var info = NESInstructionInfo.Get(Code[offset])!;
+                if (Code[offset] is (byte)NESInstruction.JSR or (byte)NESInstruction.JMP_abs &&
+                    (Code[offset + 1] | Code[offset + 2] << 8) == address)
+                    return true;
+                offset += info.Length;
+            }
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Address of each method, when the object is linked at address
+    /// </summary>
+    public Dictionary<string, ushort> GetAddresses(ushort address)
+    {
+        var addresses = new Dictionary<string, ushort>(StringComparer.Ordinal);
+        foreach (var symbol in Symbols)
+        {
+            addresses[symbol.Name] = (ushort)(address + symbol.Offset);
+        }
+        return addresses;
+    }
+
+    /// <summary>
+    /// Code and Data with the relocations applied, for a ROM where they start at address
+    /// </summary>
+    public byte[] Link(ushort address, ushort sizeOfMain)
+    {
+        var bytes = new byte[Length];
+        Code.CopyTo(bytes, 0);
+        Data.CopyTo(bytes, Code.Length);
+
+        ushort data = (ushort)(address + Code.Length);
+        foreach (var relocation in Relocations)
+        {
+            int offset = relocation.Offset;
+            switch (relocation.Kind)
+            {
+                case RelocationKind.AfterMain:
+                    ushort value = (ushort)(bytes[offset] | bytes[offset + 1] << 8);
+                    value = value.GetAddressAfterMain(sizeOfMain);
+                    bytes[offset] = (byte)(value & 0xFF);
+                    bytes[offset + 1] = (byte)(value >> 8);
+                    break;
+                case RelocationKind.Code:
+                    value = (ushort)(bytes[offset] | bytes[offset + 1] << 8);
+                    value = (ushort)(value + address);
+                    bytes[offset] = (byte)(value & 0xFF);
+                    bytes[offset + 1] = (byte)(value >> 8);
+                    break;
+                case RelocationKind.DataLow:
+                    bytes[offset] = (byte)((data + relocation.Addend) & 0xFF);
+                    break;
+                case RelocationKind.DataHigh:
+                    bytes[offset] = (byte)((data + relocation.Addend) >> 8);
+                    break;
+                default:
+                    throw new NotImplementedException($"Relocation {relocation.Kind} is not implemented!");
+            }
+        }
+        return bytes;
+    }
+
+    /// <summary>
+    /// One item per line, such as `symbol Engine.Title.Draw $0000 23 57`, so objects diff well
+    /// </summary>
+    public void Write(TextWriter writer)
+    {
+        writer.WriteLine($"# dotnes object");
+        writer.WriteLine($"version {Version}");
+        WriteBytes(writer, "code", Code);
+        WriteBytes(writer, "data", Data);
+        foreach (var symbol in Symbols)
+        {
+            writer.WriteLine($"symbol {symbol.Name} ${symbol.Offset:X4} {symbol.Length} {symbol.Cycles}");
+        }
+        foreach (var relocation in Relocations)
+        {
+            writer.WriteLine(relocation.Kind is RelocationKind.AfterMain or RelocationKind.Code ?
+                $"reloc ${relocation.Offset:X4} {relocation.Kind}" :
+                $"reloc ${relocation.Offset:X4} {relocation.Kind} ${relocation.Addend:X4}");
+        }
+    }
+
+    static void WriteBytes(TextWriter writer, string name, byte[] bytes)
+    {
+        for (int i = 0; i < bytes.Length; i += BytesPerLine)
+        {
+            writer.WriteLine($"{name} {ToHex(bytes, i, Math.Min(BytesPerLine, bytes.Length - i))}");
+        }
+    }
+
+    static string ToHex(byte[] bytes, int offset, int length) => BitConverter.ToString(bytes, offset, length).Replace("-", "");
+
+    static byte[] FromHex(string text)
+    {
+        if (text.Length % 2 != 0)
+            throw new FormatException($"Invalid hex: {text}");
+        var bytes = new byte[text.Length / 2];
+        for (int i = 0; i < bytes.Length; i++)
+        {
+            bytes[i] = byte.Parse(text.Substring(i * 2, 2), NumberStyles.HexNumber, CultureInfo.InvariantCulture);
+        }
+        return bytes;
+    }
+
+    public static NESObject Read(TextReader reader)
+    {
+        var obj = new NESObject();
+        var code = new List<byte>();
+        var data = new List<byte>();
+        string? line;
+        while ((line = reader.ReadLine()) is not null)
+        {
+            if (string.IsNullOrWhiteSpace(line) || line.StartsWith("#", StringComparison.Ordinal))
+                continue;
+
+            var parts = line.Split((char[]?)null, StringSplitOptions.RemoveEmptyEntries);
+            switch (parts[0])
+            {
+                case "version" when parts.Length == 2:
+                    int version = int.Parse(parts[1], CultureInfo.InvariantCulture);
+                    if (version != Version)
+                        throw new FormatException($"NES object version {version} is not supported, expected {Version}. Rebuild the class library.");
+                    break;
+                case "code" when parts.Length == 2:
+                    code.AddRange(FromHex(parts[1]));
+                    break;
+                case "data" when parts.Length == 2:
+                    data.AddRange(FromHex(parts[1]));
+                    break;
+                case "symbol" when parts.Length == 5:
+                    obj.Symbols.Add(new Symbol(parts[1], ParseAddress(parts[2]),
+                        ushort.Parse(parts[3], CultureInfo.InvariantCulture), int.Parse(parts[4], CultureInfo.InvariantCulture)));
+                    break;
+                case "reloc" when parts.Length is 3 or 4:
+                    var kind = (RelocationKind)Enum.Parse(typeof(RelocationKind), parts[2]);
+                    obj.Relocations.Add(new Relocation(ParseAddress(parts[1]), kind, parts.Length == 4 ? ParseAddress(parts[3]) : (ushort)0));
+                    break;
+                default:
+                    throw new FormatException($"Invalid NES object line: {line}");
+            }
+        }
+        obj.Code = code.ToArray();
+        obj.Data = data.ToArray();
+        return obj;
+    }
+
+    static ushort ParseAddress(string text) =>
+        ushort.Parse(text.TrimStart('$'), NumberStyles.HexNumber, CultureInfo.InvariantCulture);
+}
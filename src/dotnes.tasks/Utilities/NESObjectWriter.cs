@@ -0,0 +1,41 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Writes the routines of a built-in object, such as Digits or Rand, which is linked like a NESObject only into ROMs that call it.
+/// Code is written from offset 0, the relocations fix it up for the address it is linked at.
+/// </summary>
+abstract class NESObjectWriter() : NESWriter(new MemoryStream())
+{
+    readonly NESObject _object = new();
+
+    protected ushort Offset => (ushort)BaseStream.Position;
+
+    protected void AddSymbol(string name, ushort offset, ushort end) => _object.Symbols.Add(new NESObject.Symbol(name, offset, (ushort)(end - offset), 0));
+
+    /// <summary>
+    /// Relocates the word just written as the operand of an instruction
+    /// </summary>
+    protected void AddRelocation(NESObject.RelocationKind kind) => _object.Relocations.Add(new NESObject.Relocation((ushort)(Offset - 2), kind));
+
+    /// <summary>
+    /// LDA table,X with the address of the table, at dataOffset in Data, fixed up when it is linked
+    /// </summary>
+    protected void WriteLoadTable(ushort dataOffset = 0)
+    {
+        Write(NESInstruction.LDA_abs_X, (ushort)0);
+        _object.Relocations.Add(new NESObject.Relocation((ushort)(Offset - 2), NESObject.RelocationKind.DataLow, dataOffset));
+        _object.Relocations.Add(new NESObject.Relocation((ushort)(Offset - 1), NESObject.RelocationKind.DataHigh, dataOffset));
+    }
+
+    /// <summary>
+    /// The object of the routines written, with data placed after the code
+    /// </summary>
+    public NESObject ToObject(byte[]? data = null)
+    {
+        Flush();
+        _object.Code = ((MemoryStream)BaseStream).ToArray();
+        _object.Data = data ?? [];
+        _object.SetCycles();
+        return _object;
+    }
+}
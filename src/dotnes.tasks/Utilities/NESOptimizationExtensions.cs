@@ -0,0 +1,26 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// The optimization passes each NESOptimization level turns on
+/// </summary>
+static class NESOptimizationExtensions
+{
+    public static ILOptimizations GetILOptimizations(this NESOptimization optimization) =>
+        optimization == NESOptimization.None ? ILOptimizations.None : ILOptimizations.All;
+
+    /// <summary>
+    /// Cross-jumping is the only pass that makes code slower, Speed leaves it out
+    /// </summary>
+    public static CodeOptimizations GetCodeOptimizations(this NESOptimization optimization) => optimization switch
+    {
+        NESOptimization.None => CodeOptimizations.None,
+        NESOptimization.Speed => CodeOptimizations.All & ~CodeOptimizations.CrossJumping,
+        _ => CodeOptimizations.All,
+    };
+
+    /// <summary>
+    /// The shortest tail worth 3 more cycles for a JMP: any saving for Size, at least 5 bytes for Balanced
+    /// </summary>
+    public static int GetMinTailLength(this NESOptimization optimization) =>
+        optimization == NESOptimization.Balanced ? 8 : TailCallOptimizer.DefaultMinTailLength;
+}
@@ -0,0 +1,69 @@
+﻿using System.Globalization;
+
+namespace dotnes;
+
+/// <summary>
+/// Execution counts recorded by Profiler, used by a later build to place hot variables
+/// </summary>
+class NESProfile
+{
+    public int Frames { get; set; }
+
+    /// <summary>
+    /// Instructions run at each address of PRG_ROM
+    /// </summary>
+    public Dictionary<ushort, long> Code { get; } = new();
+
+    /// <summary>
+    /// Reads and writes of each address of RAM, not including the stack
+    /// </summary>
+    public Dictionary<ushort, long> RAM { get; } = new();
+
+    /// <summary>
+    /// One count per line, such as `ram $0325 12`, sorted by address so profiles diff well
+    /// </summary>
+    public void Write(TextWriter writer)
+    {
+        writer.WriteLine($"# dotnes profile");
+        writer.WriteLine($"frames {Frames}");
+        foreach (var pair in Code.OrderBy(p => p.Key))
+        {
+            writer.WriteLine($"code ${pair.Key:X4} {pair.Value}");
+        }
+        foreach (var pair in RAM.OrderBy(p => p.Key))
+        {
+            writer.WriteLine($"ram ${pair.Key:X4} {pair.Value}");
+        }
+    }
+
+    public static NESProfile Read(TextReader reader)
+    {
+        var profile = new NESProfile();
+        string? line;
+        while ((line = reader.ReadLine()) is not null)
+        {
+            if (string.IsNullOrWhiteSpace(line) || line.StartsWith("#", StringComparison.Ordinal))
+                continue;
+
+            var parts = line.Split((char[]?)null, StringSplitOptions.RemoveEmptyEntries);
+            switch (parts[0])
+            {
+                case "frames" when parts.Length == 2:
+                    profile.Frames = int.Parse(parts[1], CultureInfo.InvariantCulture);
+                    break;
+                case "code" when parts.Length == 3:
+                    profile.Code[ParseAddress(parts[1])] = long.Parse(parts[2], CultureInfo.InvariantCulture);
+                    break;
+                case "ram" when parts.Length == 3:
+                    profile.RAM[ParseAddress(parts[1])] = long.Parse(parts[2], CultureInfo.InvariantCulture);
+                    break;
+                default:
+                    throw new FormatException($"Invalid profile line: {line}");
+            }
+        }
+        return profile;
+    }
+
+    static ushort ParseAddress(string text) =>
+        ushort.Parse(text.TrimStart('$'), NumberStyles.HexNumber, CultureInfo.InvariantCulture);
+}
@@ -1,5 +1,4 @@
-﻿using System.Buffers;
-using System.Text;
+﻿using System.Text;
 
 namespace dotnes;
 
@@ -37,10 +36,18 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
     protected const int ptr1 = 0x2A;
     protected const int ptr2 = 0x2C;
     protected const int tmp1 = 0x32;
+    /// <summary>
+    /// Seed of rand8 and rand16, the 2 bytes after regbank of the cc65 runtime
+    /// </summary>
+    protected const int RAND_SEED = 0x3C;
     protected const int PRG_FILEOFFS = 0x10;
     protected const int PPU_MASK_VAR = 0x12;
     protected const ushort OAM_BUF = 0x0200;
     protected const ushort PAL_BUF = 0x01C0;
+    /// <summary>
+    /// State of NES.Fade, the 8 bytes below PAL_BUF, which the hardware stack does not reach
+    /// </summary>
+    protected const ushort FADE = 0x01B8;
     protected const ushort condes = 0x0300;
     protected const ushort PPU_CTRL = 0x2000;
     protected const ushort PPU_MASK = 0x2001;
@@ -70,12 +77,30 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
     protected const ushort zerobss = 0x858B;
     protected const ushort rodata = 0x85AE;
     protected const ushort donelib = 0x84FD;
+    /// <summary>
+    /// Start of `static void main()`
+    /// </summary>
+    internal const ushort main = 0x8500;
 
     protected readonly BinaryWriter _writer = new(stream, Encoding, leaveOpen);
     protected readonly ILogger _logger = logger ?? new NullLogger();
 
     public bool LastLDA { get; private set; }
 
+    /// <summary>
+    /// What the reset path of a program needs, for CodeOptimizations.Boot
+    /// </summary>
+    /// <param name="LastPage">Highest page of RAM to clear, the one with the last local</param>
+    /// <param name="DetectNTSC">If ppu_system or ppu_wait_frame read the result of NTSC detection</param>
+    /// <param name="Fade">If NES.Fade is linked, page 1 is cleared for its state at FADE</param>
+    public record BootProgram(byte LastPage, bool DetectNTSC, bool Fade = false);
+
+    /// <summary>
+    /// Specializes the reset path to a program, null for the full startup of crt0.s.
+    /// Built-in addresses are fixed, so skipped code becomes a branch over unused bytes.
+    /// </summary>
+    public BootProgram? Boot { get; set; }
+
     public Stream BaseStream => _writer.BaseStream;
 
     /// <summary>
@@ -185,19 +210,18 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
     /// <summary>
     /// Writes a string in ASCI form, including a trailing \0
     /// </summary>
-    public void WriteString(string text)
+    public void WriteString(string text) => WriteString(text.AsSpan());
+
+    /// <summary>
+    /// Writes a string in ASCI form, including a trailing \0
+    /// NOTE: non-ASCII characters are written as '?', the same as Encoding.ASCII
+    /// </summary>
+    public void WriteString(ReadOnlySpan<char> text)
     {
         LastLDA = false;
-        int length = Encoding.GetByteCount(text);
-        var bytes = ArrayPool<byte>.Shared.Rent(length);
-        try
-        {
-            length = Encoding.GetBytes(text, 0, text.Length, bytes, 0);
-            _writer.Write(bytes, 0, length);
-        }
-        finally
+        foreach (char c in text)
         {
-            ArrayPool<byte>.Shared.Return(bytes);
+            _writer.Write(c < 0x80 ? (byte)c : (byte)'?');
         }
         //TODO: I don't know if there is a 0 between each string, or if this denotes the end of the table
         _writer.Write((byte)0);
@@ -323,6 +347,20 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
         Write_zerobss(locals);
     }
 
+    /// <summary>
+    /// Addresses of the cc65 runtime routines written after `static void main()`
+    /// </summary>
+    public static Dictionary<ushort, string> GetFinalBuiltInAddresses(ushort sizeOfMain) => new()
+    {
+        [donelib.GetAddressAfterMain(sizeOfMain)] = nameof(donelib),
+        [copydata.GetAddressAfterMain(sizeOfMain)] = nameof(copydata),
+        [popax.GetAddressAfterMain(sizeOfMain)] = nameof(popax),
+        [popa.GetAddressAfterMain(sizeOfMain)] = nameof(popa),
+        [pusha.GetAddressAfterMain(sizeOfMain)] = nameof(pusha),
+        [pushax.GetAddressAfterMain(sizeOfMain)] = nameof(pushax),
+        [zerobss.GetAddressAfterMain(sizeOfMain)] = nameof(zerobss),
+    };
+
     /// <summary>
     /// Writes a built-in method from NESLib
     /// </summary>
@@ -1054,6 +1092,164 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
         }
     }
 
+    /// <summary>
+    /// RAM that [RunFromRam] built-ins run from, above the locals and below the C stack
+    /// </summary>
+    internal const ushort RAM_CODE = 0x0600;
+    const int RAM_CODE_SIZE = 0xFF;
+    /// <summary>
+    /// The routine that copies [RunFromRam] built-ins, and their code, end at the interrupt vectors
+    /// </summary>
+    const ushort RAM_CODE_ROM_END = 0xFFFA;
+    const int COPY_RAM_SIZE = 12;
+
+    /// <summary>
+    /// Built-ins that have a version that runs from RAM
+    /// </summary>
+    public static readonly string[] RamBuiltIns = [nameof(NESLib.vram_write)];
+
+    /// <summary>
+    /// Lays out [RunFromRam] built-ins in RAM, in the order given
+    /// </summary>
+    public static Dictionary<string, ushort> GetRamAddresses(IEnumerable<string> names)
+    {
+        var addresses = new Dictionary<string, ushort>();
+        int address = RAM_CODE;
+        foreach (var name in names)
+        {
+            if (addresses.ContainsKey(name))
+                continue;
+            if (!RamBuiltIns.Contains(name))
+                throw new NotImplementedException($"Running {name} from RAM is not implemented!");
+            addresses[name] = (ushort)address;
+            address += GetRamBuiltIn(name, 0, 0).Length;
+        }
+        if (address - RAM_CODE > RAM_CODE_SIZE)
+            throw new NotImplementedException($"[RunFromRam] built-ins of {address - RAM_CODE} bytes do not fit in {RAM_CODE_SIZE} bytes of RAM!");
+        return addresses;
+    }
+
+    /// <summary>
+    /// Address in PRG_ROM of copyram, which static void main calls first
+    /// </summary>
+    public static ushort GetCopyRamAddress(IReadOnlyDictionary<string, ushort> addresses) =>
+        (ushort)(RAM_CODE_ROM_END - COPY_RAM_SIZE - addresses.Keys.Sum(n => GetRamBuiltIn(n, 0, 0).Length));
+
+    /// <summary>
+    /// Writes copyram and the code of the [RunFromRam] built-ins it copies, to end at the interrupt vectors.
+    /// cc65's copydata only copies the DATA segment, its size is fixed in the startup code.
+    /// </summary>
+    public void WriteRamBuiltIns(IReadOnlyDictionary<string, ushort> addresses, ushort sizeOfMain)
+    {
+        var code = GetRamCode(addresses, sizeOfMain);
+        ushort image = (ushort)(GetCopyRamAddress(addresses) + COPY_RAM_SIZE);
+        /*
+         * LDX #size                    ; copyram
+         * LDA image-1,x
+         * STA RAM_CODE-1,x
+         * DEX
+         * BNE -9
+         * RTS
+         */
+        Write(NESInstruction.LDX, checked((byte)code.Length));
+        Write(NESInstruction.LDA_abs_X, (ushort)(image - 1));
+        Write(NESInstruction.STA_abs_X, (ushort)(RAM_CODE - 1));
+        Write(NESInstruction.DEX_impl);
+        Write(NESInstruction.BNE_rel, 0xF7);
+        Write(NESInstruction.RTS_impl);
+        Write(code);
+    }
+
+    /// <summary>
+    /// The code of the [RunFromRam] built-ins, as copied to RAM_CODE
+    /// </summary>
+    public static byte[] GetRamCode(IReadOnlyDictionary<string, ushort> addresses, ushort sizeOfMain) => addresses
+        .OrderBy(p => p.Value)
+        .SelectMany(p => GetRamBuiltIn(p.Key, p.Value, sizeOfMain))
+        .ToArray();
+
+    /// <summary>
+    /// The version of a built-in that runs at an address in RAM, and patches its own operands
+    /// </summary>
+    static byte[] GetRamBuiltIn(string name, ushort address, ushort sizeOfMain)
+    {
+        using var memoryStream = new MemoryStream();
+        using (var writer = new NESWriter(memoryStream, leaveOpen: true))
+        {
+            writer.WriteRamBuiltIn(name, address, sizeOfMain);
+        }
+        return memoryStream.ToArray();
+    }
+
+    void WriteRamBuiltIn(string name, ushort address, ushort sizeOfMain)
+    {
+        switch (name)
+        {
+            case nameof(NESLib.vram_write):
+            {
+                /*
+                 * +00 STA TEMP                 ; _vram_write, from RAM
+                 * +02 STX TEMP+1
+                 * +04 JSR popax
+                 * +07 STA @1+1                 ; patch the source address, instead of LDA (ptr),y
+                 * +0A STX @1+2
+                 * +0D STA @2+1
+                 * +10 STX @2+2
+                 * +13 LDY #$00
+                 * +15 LDX TEMP+1               ; whole pages
+                 * +17 BEQ +2B
+                 * +19 LDA $FFFF,y              ; @1
+                 * +1C STA $2007
+                 * +1F INY
+                 * +20 BNE +19
+                 * +22 INC @1+2
+                 * +25 INC @2+2
+                 * +28 DEX
+                 * +29 BNE +19
+                 * +2B LDX TEMP                 ; the rest
+                 * +2D BEQ +39
+                 * +2F LDA $FFFF,y              ; @2
+                 * +32 STA $2007
+                 * +35 INY
+                 * +36 DEX
+                 * +37 BNE +2F
+                 * +39 RTS
+                 */
+                ushort page = (ushort)(address + 0x19);
+                ushort rest = (ushort)(address + 0x2F);
+                Write(NESInstruction.STA_zpg, TEMP);
+                Write(NESInstruction.STX_zpg, TEMP + 1);
+                Write(NESInstruction.JSR, popax.GetAddressAfterMain(sizeOfMain));
+                Write(NESInstruction.STA_abs, (ushort)(page + 1));
+                Write(NESInstruction.STX_abs, (ushort)(page + 2));
+                Write(NESInstruction.STA_abs, (ushort)(rest + 1));
+                Write(NESInstruction.STX_abs, (ushort)(rest + 2));
+                Write(NESInstruction.LDY, 0x00);
+                Write(NESInstruction.LDX_zpg, TEMP + 1);
+                Write(NESInstruction.BEQ_rel, 0x12);
+                Write(NESInstruction.LDA_abs_y, 0xFFFF);
+                Write(NESInstruction.STA_abs, PPU_DATA);
+                Write(NESInstruction.INY_impl);
+                Write(NESInstruction.BNE_rel, 0xF7);
+                Write(NESInstruction.INC_abs, (ushort)(page + 2));
+                Write(NESInstruction.INC_abs, (ushort)(rest + 2));
+                Write(NESInstruction.DEX_impl);
+                Write(NESInstruction.BNE_rel, 0xEE);
+                Write(NESInstruction.LDX_zpg, TEMP);
+                Write(NESInstruction.BEQ_rel, 0x0A);
+                Write(NESInstruction.LDA_abs_y, 0xFFFF);
+                Write(NESInstruction.STA_abs, PPU_DATA);
+                Write(NESInstruction.INY_impl);
+                Write(NESInstruction.DEX_impl);
+                Write(NESInstruction.BNE_rel, 0xF6);
+                Write(NESInstruction.RTS_impl);
+                break;
+            }
+            default:
+                throw new NotImplementedException($"Running {name} from RAM is not implemented!");
+        }
+    }
+
     void Write_exit()
     {
         /*
@@ -1191,20 +1387,64 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
         *     lda #%00000110
         *     sta <PPU_MASK_VAR
         */
-        Write(NESInstruction.TXA_impl);
-        Write(NESInstruction.STA_zpg_X, 0x00);
-        for (int i = 1; i <= 7; i++)
+        if (Boot is null)
         {
-            Write(NESInstruction.STA_abs_X, (ushort)(0x0100 * i));
+            Write(NESInstruction.TXA_impl);
+            Write(NESInstruction.STA_zpg_X, 0x00);
+            for (int i = 1; i <= 7; i++)
+            {
+                Write(NESInstruction.STA_abs_X, (ushort)(0x0100 * i));
+            }
+            Write(NESInstruction.INX_impl);
+            Write(NESInstruction.BNE_rel, 0xE6);
+            Write(NESInstruction.LDA, 0x04);
+            Write(NESInstruction.JSR, 0x8279);
+            Write(NESInstruction.JSR, 0x824E);
+            Write(NESInstruction.JSR, 0x82AE);
+            Write(NESInstruction.JSR, zerobss.GetAddressAfterMain(sizeOfMain));
+            Write(NESInstruction.JSR, copydata.GetAddressAfterMain(sizeOfMain));
+        }
+        else
+        {
+            /*
+             * Only zero page and the pages from BSS to the last local are cleared: the stack page and
+             * OAM_BUF are set by pal_clear and oam_clear, and the C stack is written before it is read.
+             * The stack page is cleared too if NES.Fade keeps its state there.
+             * zerobss clears BSS again, and copydata copies condes, which is never called without
+             * constructors. Both are skipped, by branching over the rest of the loop's bytes.
+             *     txa
+             * @1:
+             *     sta $000,x
+             *     sta $100,x               ; NES.Fade
+             *     sta $300,x
+             *     inx
+             *     bne @1
+             *     beq @2                   ; always, after the loop
+             *     ...
+             * @2:
+             *     lda #4
+             */
+            const int LoopSize = 27, SkippedSize = 6;
+            int pages = Boot.LastPage - (condes >> 8) + 1 + (Boot.Fade ? 1 : 0);
+            int loopSize = 6 + 3 * pages;
+            int unused = LoopSize + SkippedSize - loopSize - 2;
+            Write(NESInstruction.TXA_impl);
+            Write(NESInstruction.STA_zpg_X, 0x00);
+            if (Boot.Fade)
+                Write(NESInstruction.STA_abs_X, (ushort)0x0100);
+            for (int i = condes >> 8; i <= Boot.LastPage; i++)
+            {
+                Write(NESInstruction.STA_abs_X, (ushort)(0x0100 * i));
+            }
+            Write(NESInstruction.INX_impl);
+            Write(NESInstruction.BNE_rel, (byte)(1 - loopSize));
+            Write(NESInstruction.BEQ_rel, checked((byte)unused));
+            WriteUnused(unused);
+            Write(NESInstruction.LDA, 0x04);
+            Write(NESInstruction.JSR, 0x8279);
+            Write(NESInstruction.JSR, 0x824E);
+            Write(NESInstruction.JSR, 0x82AE);
         }
-        Write(NESInstruction.INX_impl);
-        Write(NESInstruction.BNE_rel, 0xE6);
-        Write(NESInstruction.LDA, 0x04);
-        Write(NESInstruction.JSR, 0x8279);
-        Write(NESInstruction.JSR, 0x824E);
-        Write(NESInstruction.JSR, 0x82AE);
-        Write(NESInstruction.JSR, zerobss.GetAddressAfterMain(sizeOfMain));
-        Write(NESInstruction.JSR, copydata.GetAddressAfterMain(sizeOfMain));
         Write(NESInstruction.LDA, 0x00);
         Write(NESInstruction.STA_zpg, sp);
         Write(NESInstruction.LDA, PAL_BG_PTR);
@@ -1223,6 +1463,17 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
         Write(NESInstruction.STA_zpg, 0x12);
     }
 
+    /// <summary>
+    /// Bytes a specialized built-in branches over, so the built-ins after it keep their addresses
+    /// </summary>
+    void WriteUnused(int length)
+    {
+        for (int i = 0; i < length; i++)
+        {
+            Write(NESInstruction.NOP_impl);
+        }
+    }
+
     void Write_waitSync3()
     {
         // https://github.com/clbr/neslib/blob/d061b0f7f1a449941111c31eee0fc2e85b1826d7/crt0.s#L197
@@ -1251,21 +1502,32 @@ class NESWriter(Stream stream, bool leaveOpen = false, ILogger? logger = null) :
          * 8D 03 20
          * 4C 00 85
          */
-        Write(NESInstruction.LDX, 0x34);
-        Write(NESInstruction.LDY, 0x18);
-        Write(NESInstruction.DEX_impl);
-        Write(NESInstruction.BNE_rel, 0xFD);
-        Write(NESInstruction.DEY_impl);
-        Write(NESInstruction.BNE_rel, 0xFA);
-        Write(NESInstruction.LDA_abs, PPU_STATUS);
-        Write(NESInstruction.AND, 0x80);
-        Write(NESInstruction.STA_zpg, 0x00);
+        if (Boot is null || Boot.DetectNTSC)
+        {
+            Write(NESInstruction.LDX, 0x34);
+            Write(NESInstruction.LDY, 0x18);
+            Write(NESInstruction.DEX_impl);
+            Write(NESInstruction.BNE_rel, 0xFD);
+            Write(NESInstruction.DEY_impl);
+            Write(NESInstruction.BNE_rel, 0xFA);
+            Write(NESInstruction.LDA_abs, PPU_STATUS);
+            Write(NESInstruction.AND, 0x80);
+            Write(NESInstruction.STA_zpg, 0x00);
+        }
+        else
+        {
+            // Nothing reads NTSC_MODE, so skip the delay loop of almost a frame.
+            // waitSync3 leaves Z clear, so BNE is always taken.
+            const int DetectSize = 17;
+            Write(NESInstruction.BNE_rel, DetectSize - 2);
+            WriteUnused(DetectSize - 2);
+        }
         Write(NESInstruction.JSR, 0x8280);
         Write(NESInstruction.LDA, 0x00);
         Write(NESInstruction.STA_abs, PPU_SCROLL);
         Write(NESInstruction.STA_abs, PPU_SCROLL);
         Write(NESInstruction.STA_abs, PPU_OAM_ADDR);
-        Write(NESInstruction.JMP_abs, 0x8500);
+        Write(NESInstruction.JMP_abs, main);
     }
 
     void Write_nmi()
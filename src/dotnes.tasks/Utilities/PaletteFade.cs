@@ -0,0 +1,158 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// The routines of NES.Fade.
+/// They set PAL_BG_PTR and PAL_SPR_PTR as pal_bright does, so the NMI uploads the palette only when the level changes.
+/// The background and the sprites fade through the tables of pal_bright, or each through its own custom tables.
+/// </summary>
+static class PaletteFade
+{
+    public const string To = "NES.Fade.To";
+    public const string Start = "NES.Fade.Start";
+    public const string Update = "NES.Fade.Update";
+    public const string SetTables = "NES.Fade.SetTables";
+    public const string SetSpriteTables = "NES.Fade.SetSpriteTables";
+
+    public static NESObject Object { get; } = Write();
+
+    static NESObject Write()
+    {
+        using var writer = new Writer();
+        writer.WriteFade();
+        return writer.ToObject();
+    }
+
+    class Writer : NESObjectWriter
+    {
+        // Custom tables of the background and of the sprites, 0 for the tables of pal_bright, in the order of PAL_BG_PTR and PAL_SPR_PTR.
+        // Then the level XOR 4, so the cleared RAM is the normal brightness pal_bright(4) sets on reset,
+        // the level faded to, frames per level and frames until the next.
+        const ushort Tables = FADE;
+        const ushort SpriteTables = FADE + 2;
+        const ushort Level = FADE + 4;
+        const ushort Target = FADE + 5;
+        const ushort Frames = FADE + 6;
+        const ushort Count = FADE + 7;
+        const byte Normal = 4;
+
+        /// <summary>
+        /// A JSR or JMP to another routine of the object, fixed up when it is linked
+        /// </summary>
+        void WriteCall(NESInstruction instruction, ushort offset)
+        {
+            Write(instruction, offset);
+            AddRelocation(NESObject.RelocationKind.Code);
+        }
+
+        void WriteBranch(NESInstruction instruction, ushort offset) => Write(instruction, (byte)(offset - (Offset + 2)));
+
+        /// <summary>
+        /// The current level in A, and Z if it is the level faded to
+        /// </summary>
+        void WriteCompareLevel()
+        {
+            Write(NESInstruction.LDA_abs, Level);
+            Write(NESInstruction.EOR, Normal);
+            Write(NESInstruction.CMP_abs, Target);
+        }
+
+        public void WriteFade()
+        {
+            // SetTables sets the tables of the background, and falls into SetSpriteTables with the same tables
+            ushort setTables = Offset;
+            Write(NESInstruction.STA_abs, Tables);
+            Write(NESInstruction.STX_abs, Tables + 1);
+
+            // SetSpriteTables keeps the level, and falls into SetLevel with it
+            ushort setSpriteTables = Offset;
+            Write(NESInstruction.STA_abs, SpriteTables);
+            Write(NESInstruction.STX_abs, SpriteTables + 1);
+            Write(NESInstruction.LDA_abs, Level);
+            Write(NESInstruction.EOR, Normal);
+
+            // SetLevel: the level in A, kept in Y.
+            // Custom tables are 64 bytes each, the level times 64 is its 2 low bits in the high bits of TEMP, and the others in TEMP + 1.
+            ushort setLevel = Offset;
+            Write(NESInstruction.TAY_impl);
+            Write(NESInstruction.EOR, Normal);
+            Write(NESInstruction.STA_abs, Level);
+            Write(NESInstruction.LDA, 0);
+            Write(NESInstruction.STA_zpg, TEMP);
+            Write(NESInstruction.TYA_impl);
+            Write(NESInstruction.LSR_A);
+            Write(NESInstruction.ROR_zpg, TEMP);
+            Write(NESInstruction.LSR_A);
+            Write(NESInstruction.ROR_zpg, TEMP);
+            Write(NESInstruction.STA_zpg, TEMP + 1);
+
+            // X is 2 for PAL_SPR_PTR and SpriteTables, then 0 for PAL_BG_PTR and Tables
+            Write(NESInstruction.LDX, 2);
+            ushort pointers = Offset;
+            Write(NESInstruction.LDA_abs_X, Tables + 1);
+            Write(NESInstruction.BNE_rel, 10);
+            Write(NESInstruction.LDA_abs_y, palBrightTableL);
+            Write(NESInstruction.STA_zpg_X, PAL_BG_PTR);
+            Write(NESInstruction.LDA_abs_y, palBrightTableH);
+            Write(NESInstruction.BNE_rel, 13);
+            Write(NESInstruction.LDA_zpg, TEMP);
+            Write(NESInstruction.CLC_impl);
+            Write(NESInstruction.ADC_abs_X, Tables);
+            Write(NESInstruction.STA_zpg_X, PAL_BG_PTR);
+            Write(NESInstruction.LDA_zpg, TEMP + 1);
+            Write(NESInstruction.ADC_abs_X, Tables + 1);
+            Write(NESInstruction.STA_zpg_X, PAL_BG_PTR + 1);
+            Write(NESInstruction.DEX_impl);
+            Write(NESInstruction.DEX_impl);
+            WriteBranch(NESInstruction.BPL, pointers);
+
+            // The high byte of a table in PRG_ROM is not 0, so it also flags the palette to upload
+            Write(NESInstruction.STA_zpg, PAL_UPDATE);
+            Write(NESInstruction.RTS_impl);
+            AddSymbol(SetTables, setTables, Offset);
+            AddSymbol(SetSpriteTables, setSpriteTables, Offset);
+
+            // Start: the level on the C stack, the frames in A, 0 frames sets the level at once
+            ushort start = Offset;
+            Write(NESInstruction.STA_abs, Frames);
+            Write(NESInstruction.STA_abs, Count);
+            Write(NESInstruction.JSR, popa);
+            AddRelocation(NESObject.RelocationKind.AfterMain);
+            Write(NESInstruction.STA_abs, Target);
+            Write(NESInstruction.LDX_abs, Frames);
+            WriteBranch(NESInstruction.BEQ_rel, setLevel);
+            Write(NESInstruction.RTS_impl);
+            AddSymbol(Start, start, Offset);
+
+            // Update: nothing to do without a fade, as Frames is 0 in the cleared RAM, once the level is there, or until Count frames have passed.
+            // The carry of the compare is set if the level is above the one faded to.
+            ushort update = Offset;
+            Write(NESInstruction.LDX_abs, Frames);
+            Write(NESInstruction.BEQ_rel, 31);
+            WriteCompareLevel();
+            Write(NESInstruction.BEQ_rel, 21);
+            Write(NESInstruction.DEC_abs, Count);
+            Write(NESInstruction.BNE_rel, 16);
+            Write(NESInstruction.LDX_abs, Frames);
+            Write(NESInstruction.STX_abs, Count);
+            Write(NESInstruction.BCC, 4);
+            Write(NESInstruction.SBC, 1);
+            WriteBranch(NESInstruction.BCS, setLevel);
+            Write(NESInstruction.ADC, 1);
+            WriteBranch(NESInstruction.BCC, setLevel);
+            Write(NESInstruction.RTS_impl);
+            AddSymbol(Update, update, Offset);
+
+            // To: Start, then Update after each NMI until the level is there
+            ushort to = Offset;
+            WriteCall(NESInstruction.JSR, start);
+            ushort loop = Offset;
+            WriteCompareLevel();
+            Write(NESInstruction.BNE_rel, 1);
+            Write(NESInstruction.RTS_impl);
+            Write(NESInstruction.JSR, ppu_wait_nmi);
+            WriteCall(NESInstruction.JSR, update);
+            WriteCall(NESInstruction.JMP_abs, loop);
+            AddSymbol(To, to, Offset);
+        }
+    }
+}
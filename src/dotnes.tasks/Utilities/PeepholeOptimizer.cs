@@ -0,0 +1,163 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Applies the superoptimizer's rewrites to 6502 code, when the outputs a rewrite changes are not used afterwards
+/// </summary>
+class PeepholeOptimizer
+{
+    const Outputs NZ = Outputs.Zero | Outputs.Negative;
+    const Outputs Flags = Outputs.Carry | NZ | Outputs.Overflow;
+
+    readonly ILogger _logger;
+    readonly IReadOnlyList<PeepholeRule> _rules;
+
+    public PeepholeOptimizer(ILogger? logger = null, IReadOnlyList<PeepholeRule>? rules = null)
+    {
+        _logger = logger ?? new NullLogger();
+        // Longest patterns first
+        _rules = (rules ?? PeepholeRule.Default).OrderByDescending(r => r.Pattern.Length).ToArray();
+    }
+
+    public int BytesSaved { get; private set; }
+
+    public int CyclesSaved { get; private set; }
+
+    /// <summary>
+    /// Returns the optimized code, and adds the ranges of the original code that were removed
+    /// </summary>
+    public byte[] Optimize(byte[] code, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.Peephole);
+        if (instructions is null)
+            return code;
+
+        var output = new List<byte>(code.Length);
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var instruction = instructions[i];
+            byte[]? replacement = null;
+            int end = i;
+            foreach (var rule in _rules)
+            {
+                replacement = Match(instructions, i, rule, out end);
+                if (replacement is not null)
+                    break;
+            }
+            if (replacement is null)
+            {
+                output.AddRange(code.Skip(instruction.Offset).Take(instruction.Info.Length));
+                continue;
+            }
+
+            var last = instructions[end - 1];
+            var pattern = code[instruction.Offset..(last.Offset + last.Info.Length)];
+            int cycles = instructions.Skip(i).Take(end - i).Sum(n => n.Info.Cycles) -
+                (DecodedInstruction.Decode(replacement, _logger, CodeOptimizations.Peephole)?.Sum(n => n.Info.Cycles) ?? 0);
+            BytesSaved += pattern.Length - replacement.Length;
+            CyclesSaved += cycles;
+            if (pattern.Length > replacement.Length)
+                removed?.Add((instruction.Offset + replacement.Length, pattern.Length - replacement.Length));
+            output.AddRange(replacement);
+            _logger.WriteLine($"{nameof(CodeOptimizations.Peephole)}: +{instruction.Offset:X4} {Superoptimizer.Disassemble(pattern)} => {Superoptimizer.Disassemble(replacement)}, {cycles} cycles saved");
+            i = end - 1;
+        }
+        return output.ToArray();
+    }
+
+    /// <summary>
+    /// The replacement if the pattern is at instruction index, the replacement is not longer, and nothing after it reads what the rule changes
+    /// </summary>
+    static byte[]? Match(List<DecodedInstruction> instructions, int index, PeepholeRule rule, out int end)
+    {
+        var replacement = rule.Match(instructions, index, out end);
+        if (replacement is null)
+            return null;
+        var last = instructions[end - 1];
+        if (replacement.Length > last.Offset + last.Info.Length - instructions[index].Offset || (GetLive(instructions, end) & ~rule.Preserves) != 0)
+            return null;
+        return replacement;
+    }
+
+    /// <summary>
+    /// Outputs read by the code from index on, before it writes them again.
+    /// Subroutines take arguments in A and X, and never expect flags or Y.
+    /// A JMP may be a tail call or a jump into a shared tail, which read A and X as well.
+    /// </summary>
+    internal static Outputs GetLive(List<DecodedInstruction> instructions, int index)
+    {
+        var live = Outputs.Memory;
+        var written = Outputs.None;
+        for (int i = index; i < instructions.Count; i++)
+        {
+            var info = instructions[i].Info;
+            switch (info.Mnemonic)
+            {
+                case "JSR":
+                case "RTS":
+                case "JMP":
+                    return live | (Outputs.A | Outputs.X) & ~written;
+                case "BRK":
+                case "RTI":
+                    return live | Outputs.All & ~written;
+            }
+            var (reads, writes) = GetEffects(info);
+            live |= reads & ~written;
+            written |= writes;
+        }
+        return live | Outputs.All & ~written;
+    }
+
+    static (Outputs Reads, Outputs Writes) GetEffects(NESInstructionInfo info)
+    {
+        var index = info.Mode switch
+        {
+            AddressMode.ZeroPageX or AddressMode.AbsoluteX or AddressMode.IndirectX => Outputs.X,
+            AddressMode.ZeroPageY or AddressMode.AbsoluteY or AddressMode.IndirectY => Outputs.Y,
+            _ => Outputs.None,
+        };
+        bool accumulator = info.Mode == AddressMode.Accumulator;
+        return info.Mnemonic switch
+        {
+            "LDA" => (index, Outputs.A | NZ),
+            "LDX" => (index, Outputs.X | NZ),
+            "LDY" => (index, Outputs.Y | NZ),
+            "STA" => (index | Outputs.A, Outputs.None),
+            "STX" => (index | Outputs.X, Outputs.None),
+            "STY" => (index | Outputs.Y, Outputs.None),
+            "TAX" => (Outputs.A, Outputs.X | NZ),
+            "TAY" => (Outputs.A, Outputs.Y | NZ),
+            "TXA" => (Outputs.X, Outputs.A | NZ),
+            "TYA" => (Outputs.Y, Outputs.A | NZ),
+            "TSX" => (Outputs.None, Outputs.X | NZ),
+            "TXS" => (Outputs.X, Outputs.None),
+            "PHA" => (Outputs.A, Outputs.None),
+            "PHP" => (Flags, Outputs.None),
+            "PLA" => (Outputs.None, Outputs.A | NZ),
+            "PLP" => (Outputs.None, Flags),
+            "AND" or "ORA" or "EOR" => (index | Outputs.A, Outputs.A | NZ),
+            "ADC" or "SBC" => (index | Outputs.A | Outputs.Carry, Outputs.A | Flags),
+            "CMP" => (index | Outputs.A, NZ | Outputs.Carry),
+            "CPX" => (Outputs.X, NZ | Outputs.Carry),
+            "CPY" => (Outputs.Y, NZ | Outputs.Carry),
+            "BIT" => (Outputs.A, NZ | Outputs.Overflow),
+            "INC" or "DEC" => (index, NZ),
+            "INX" or "DEX" => (Outputs.X, Outputs.X | NZ),
+            "INY" or "DEY" => (Outputs.Y, Outputs.Y | NZ),
+            "ASL" or "LSR" when accumulator => (Outputs.A, Outputs.A | NZ | Outputs.Carry),
+            "ASL" or "LSR" => (index, NZ | Outputs.Carry),
+            "ROL" or "ROR" when accumulator => (Outputs.A | Outputs.Carry, Outputs.A | NZ | Outputs.Carry),
+            "ROL" or "ROR" => (index | Outputs.Carry, NZ | Outputs.Carry),
+            "CLC" or "SEC" => (Outputs.None, Outputs.Carry),
+            "CLV" => (Outputs.None, Outputs.Overflow),
+            "NOP" or "CLI" or "SEI" or "CLD" or "SED" => (Outputs.None, Outputs.None),
+            "LAX" => (index, Outputs.A | Outputs.X | NZ),
+            "SAX" => (index | Outputs.A | Outputs.X, Outputs.None),
+            "DCP" => (index | Outputs.A, NZ | Outputs.Carry),
+            "ISC" => (index | Outputs.A | Outputs.Carry, Outputs.A | Flags),
+            "AXS" => (Outputs.A | Outputs.X, Outputs.X | NZ | Outputs.Carry),
+            "ANC" or "ALR" => (Outputs.A, Outputs.A | NZ | Outputs.Carry),
+            // Branches are not decoded, anything else reads everything
+            _ => (Outputs.All, Outputs.None),
+        };
+    }
+}
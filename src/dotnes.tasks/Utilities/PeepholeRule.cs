@@ -0,0 +1,176 @@
+﻿using System.Globalization;
+using System.Reflection;
+using System.Text;
+
+namespace dotnes;
+
+/// <summary>
+/// Parts of the CPU state a sequence of 6502 code produces
+/// </summary>
+[Flags]
+enum Outputs : byte
+{
+    None = 0,
+    A = 0x01,
+    X = 0x02,
+    Y = 0x04,
+    Carry = 0x08,
+    Zero = 0x10,
+    Negative = 0x20,
+    Overflow = 0x40,
+    /// <summary>
+    /// RAM and the stack pointer
+    /// </summary>
+    Memory = 0x80,
+    All = 0xFF,
+}
+
+/// <summary>
+/// A rewrite from the superoptimizer: the replacement gives the same outputs as the pattern for the ones in Preserves.
+/// The superoptimizer runs rules on zero page $10, $11 and so on, so each zero page operand is a wildcard,
+/// written xx, yy in peephole.txt: it matches any address in RAM, zero page or absolute, the same one wherever it appears.
+/// </summary>
+record PeepholeRule(byte[] Pattern, byte[] Replacement, Outputs Preserves)
+{
+    const string ResourceName = "peephole.txt";
+
+    /// <summary>
+    /// Address of the first wildcard when the rule runs on NESCpu, the next ones follow it
+    /// </summary>
+    internal const byte FirstOperand = 0x10;
+
+    /// <summary>
+    /// RAM and its mirrors, the PPU and APU registers after it are not plain memory
+    /// </summary>
+    const ushort RamEnd = 0x2000;
+
+    static readonly string[] wildcards = ["xx", "yy", "zz", "ww"];
+
+    static readonly Lazy<PeepholeRule[]> rules = new(() =>
+    {
+        using var stream = typeof(PeepholeRule).GetTypeInfo().Assembly.GetManifestResourceStream(ResourceName) ??
+            throw new InvalidOperationException($"Embedded resource {ResourceName} not found!");
+        using var reader = new StreamReader(stream);
+        return Read(reader).ToArray();
+    });
+
+    readonly List<DecodedInstruction> instructions = Decode(Pattern);
+
+    /// <summary>
+    /// The rules shipped with dotnes, generated with Superoptimizer.Generate
+    /// </summary>
+    public static IReadOnlyList<PeepholeRule> Default => rules.Value;
+
+    /// <summary>
+    /// One rule per line: `pattern => replacement : outputs`, bytes in hex or a wildcard, and # starts a comment
+    /// </summary>
+    public static IEnumerable<PeepholeRule> Read(TextReader reader)
+    {
+        string? line;
+        while ((line = reader.ReadLine()) is not null)
+        {
+            int comment = line.IndexOf('#');
+            if (comment >= 0)
+                line = line.Substring(0, comment);
+            if (string.IsNullOrWhiteSpace(line))
+                continue;
+
+            int arrow = line.IndexOf("=>", StringComparison.Ordinal);
+            int colon = line.IndexOf(':');
+            if (arrow < 0 || colon < arrow)
+                throw new FormatException($"Invalid peephole rule: {line}");
+            yield return new PeepholeRule(
+                FromHex(line.Substring(0, arrow)),
+                FromHex(line.Substring(arrow + 2, colon - arrow - 2)),
+                (Outputs)Enum.Parse(typeof(Outputs), line.Substring(colon + 1)));
+        }
+    }
+
+    /// <summary>
+    /// Matches the pattern at index in decoded code, and returns the replacement with the addresses the wildcards matched.
+    /// end is the index after the pattern.
+    /// </summary>
+    public byte[]? Match(List<DecodedInstruction> code, int index, out int end)
+    {
+        end = index + instructions.Count;
+        if (end > code.Count)
+            return null;
+
+        var addresses = new Dictionary<byte, ushort>();
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var expected = instructions[i];
+            var actual = code[index + i];
+            if (expected.Info.Mode != AddressMode.ZeroPage)
+            {
+                if (actual.Info != expected.Info || actual.Operand != expected.Operand)
+                    return null;
+            }
+            else if (actual.Info.Mnemonic != expected.Info.Mnemonic || actual.Info.Mode is not (AddressMode.ZeroPage or AddressMode.Absolute) || actual.Operand >= RamEnd ||
+                (addresses.TryGetValue((byte)expected.Operand, out var address) ? address != actual.Operand : addresses.ContainsValue(actual.Operand)))
+            {
+                return null;
+            }
+            else
+            {
+                addresses[(byte)expected.Operand] = actual.Operand;
+            }
+        }
+
+        var replacement = new List<byte>();
+        foreach (var instruction in Decode(Replacement))
+        {
+            if (instruction.Info.Mode != AddressMode.ZeroPage)
+            {
+                replacement.AddRange(Replacement.AsSpan(instruction.Offset, instruction.Info.Length).ToArray());
+                continue;
+            }
+            ushort address = addresses[(byte)instruction.Operand];
+            if (address <= byte.MaxValue)
+            {
+                replacement.Add(instruction.Info.Opcode);
+                replacement.Add((byte)address);
+                continue;
+            }
+            var absolute = NESInstructionInfo.Get(instruction.Info.Mnemonic, AddressMode.Absolute) ??
+                throw new InvalidOperationException($"{instruction.Info.Mnemonic} has no absolute addressing mode!");
+            replacement.Add(absolute.Opcode);
+            replacement.Add((byte)address);
+            replacement.Add((byte)(address >> 8));
+        }
+        return replacement.ToArray();
+    }
+
+    public override string ToString() => $"{ToHex(Pattern, wildcard: true)} => {ToHex(Replacement, wildcard: true)} : {Preserves}";
+
+    /// <param name="wildcard">Write zero page operands as their wildcard</param>
+    public static string ToHex(byte[] bytes, bool wildcard = false)
+    {
+        var text = new StringBuilder(BitConverter.ToString(bytes).Replace("-", ""));
+        if (wildcard)
+        {
+            foreach (var instruction in Decode(bytes).Where(i => i.Info.Mode == AddressMode.ZeroPage))
+            {
+                text.Remove(2 * instruction.Offset + 2, 2).Insert(2 * instruction.Offset + 2, wildcards[instruction.Operand - FirstOperand]);
+            }
+        }
+        return text.ToString();
+    }
+
+    static List<DecodedInstruction> Decode(byte[] code) =>
+        DecodedInstruction.Decode(code, new NullLogger(), CodeOptimizations.Peephole) ??
+            throw new FormatException($"Invalid peephole rule: {BitConverter.ToString(code)} is not straight-line code");
+
+    static byte[] FromHex(string text)
+    {
+        text = text.Trim();
+        var bytes = new byte[text.Length / 2];
+        for (int i = 0; i < bytes.Length; i++)
+        {
+            var token = text.Substring(i * 2, 2);
+            int wildcard = Array.IndexOf(wildcards, token);
+            bytes[i] = wildcard >= 0 ? (byte)(FirstOperand + wildcard) : byte.Parse(token, NumberStyles.HexNumber, CultureInfo.InvariantCulture);
+        }
+        return bytes;
+    }
+}
@@ -0,0 +1,154 @@
+﻿using System.Globalization;
+
+namespace dotnes;
+
+/// <summary>
+/// Buttons of the standard controller, in the order $4016 returns them
+/// </summary>
+[Flags]
+enum Buttons : byte
+{
+    None = 0,
+    A = 0x01,
+    B = 0x02,
+    Select = 0x04,
+    Start = 0x08,
+    Up = 0x10,
+    Down = 0x20,
+    Left = 0x40,
+    Right = 0x80,
+}
+
+/// <summary>
+/// Runs a ROM headless on NESCpu for a number of frames, with recorded input, and counts what runs.
+/// There is no PPU: vblank is always set in PPU_STATUS and NMI fires once per frame when enabled.
+/// </summary>
+class Profiler
+{
+    /// <summary>
+    /// CPU cycles per NTSC frame
+    /// </summary>
+    const int CyclesPerFrame = 29781;
+    const int HEADER_SIZE = 16;
+    const ushort PRG_START = 0x8000;
+    const ushort PPU_CTRL = 0x2000;
+    const ushort PPU_STATUS = 0x2002;
+    const ushort JOYPAD1 = 0x4016;
+
+    readonly byte[] _rom;
+    readonly ILogger _logger;
+    readonly List<(int Frame, Buttons Buttons)> _input = new();
+    Buttons _buttons;
+    byte _shift;
+
+    public Profiler(byte[] rom, ILogger? logger = null)
+    {
+        _rom = rom;
+        _logger = logger ?? new NullLogger();
+    }
+
+    public int Frames { get; set; } = 600;
+
+    /// <summary>
+    /// Reads an input script, each line is the frame the buttons are pressed from, such as `120 Start` or `300 Left A`
+    /// </summary>
+    public void ReadInput(TextReader reader)
+    {
+        string? line;
+        while ((line = reader.ReadLine()) is not null)
+        {
+            int comment = line.IndexOf('#');
+            if (comment >= 0)
+                line = line.Substring(0, comment);
+            var parts = line.Split((char[]?)null, StringSplitOptions.RemoveEmptyEntries);
+            if (parts.Length == 0)
+                continue;
+
+            var buttons = Buttons.None;
+            foreach (var part in parts.Skip(1))
+            {
+                buttons |= (Buttons)Enum.Parse(typeof(Buttons), part, ignoreCase: true);
+            }
+            _input.Add((int.Parse(parts[0], CultureInfo.InvariantCulture), buttons));
+        }
+        _input.Sort((a, b) => a.Frame.CompareTo(b.Frame));
+    }
+
+    public NESProfile Run()
+    {
+        var cpu = new NESCpu
+        {
+            Executions = new long[0x10000],
+            Accesses = new long[0x10000],
+            WriteRegister = WriteRegister,
+        };
+        cpu.ReadRegister = ReadRegister;
+        LoadPRG(cpu);
+        cpu.Reset();
+
+        int input = 0;
+        for (int frame = 0; frame < Frames; frame++)
+        {
+            while (input < _input.Count && _input[input].Frame <= frame)
+            {
+                _buttons = _input[input++].Buttons;
+            }
+            long end = (frame + 1L) * CyclesPerFrame;
+            while (cpu.Cycles < end)
+            {
+                cpu.Step();
+            }
+            if ((cpu.Memory[PPU_CTRL] & 0x80) != 0)
+                cpu.NMI();
+        }
+
+        var profile = new NESProfile { Frames = Frames };
+        for (int address = 0; address < 0x10000; address++)
+        {
+            if (address >= PRG_START && cpu.Executions[address] > 0)
+                profile.Code[(ushort)address] = cpu.Executions[address];
+            // The stack page is only used through PHA, JSR, etc. which are not counted
+            else if (address < 0x0800 && cpu.Accesses[address] > 0)
+                profile.RAM[(ushort)address] = cpu.Accesses[address];
+        }
+        _logger.WriteLine($"Profiled {Frames} frames, {cpu.Cycles} cycles");
+        return profile;
+
+        byte ReadRegister(ushort address)
+        {
+            switch (address)
+            {
+                case PPU_STATUS:
+                    return 0x80;
+                case JOYPAD1:
+                    byte value = (byte)(((byte)_buttons >> _shift) & 1);
+                    if (_shift < 8)
+                        _shift++;
+                    return value;
+                default:
+                    return cpu.Memory[address];
+            }
+        }
+    }
+
+    void WriteRegister(ushort address, byte value)
+    {
+        if (address == JOYPAD1 && (value & 1) != 0)
+            _shift = 0;
+    }
+
+    /// <summary>
+    /// NROM: 16KB of PRG_ROM is mirrored at $C000, 32KB fill $8000-$FFFF
+    /// </summary>
+    void LoadPRG(NESCpu cpu)
+    {
+        int banks = _rom[4];
+        int size = banks * NESWriter.PRG_ROM_BLOCK_SIZE;
+        if (banks is < 1 or > 2 || _rom.Length < HEADER_SIZE + size)
+            throw new NotImplementedException($"Profiling ROMs with {banks} PRG_ROM banks is not implemented!");
+        for (int address = PRG_START; address < 0x10000; address += size)
+        {
+            Array.Copy(_rom, HEADER_SIZE, cpu.Memory, address, size);
+        }
+    }
+}
@@ -0,0 +1,257 @@
+﻿using System.Text;
+
+namespace dotnes;
+
+/// <summary>
+/// Where a program's 2 KB of RAM goes, with the worst-case depth of the hardware and C stacks from the call graph
+/// </summary>
+class RamBudget
+{
+    const ushort ZP_LOCALS = IL2NESWriter.zeroPageLocal;
+    const ushort PAL_BUF = 0x01C0;
+    const int PAL_BUF_SIZE = 0x20;
+    const ushort FADE = 0x01B8;
+    const int FADE_SIZE = PAL_BUF - FADE;
+    /// <summary>
+    /// startup does `LDX #$FF; TXS`, so the hardware stack grows down from $01FF until it reaches PAL_BUF
+    /// </summary>
+    const ushort HARDWARE_STACK = PAL_BUF + PAL_BUF_SIZE;
+    const ushort OAM_BUF = 0x0200;
+    const ushort BSS = 0x0300;
+    const ushort NMI_CALLBACK = 0x14;
+    const ushort condes = BSS;
+    const ushort C_STACK = 0x0700;
+    const ushort RAM_END = 0x0800;
+    const ushort PRG_START = 0x8000;
+    const ushort NMI_VECTOR = 0xFFFA;
+    const ushort RESET_VECTOR = 0xFFFC;
+    /// <summary>
+    /// The 6502 pushes PC and P before it runs the NMI handler
+    /// </summary>
+    const int INTERRUPT_SIZE = 3;
+    const int MaxSteps = 100_000;
+
+    /// <summary>
+    /// A range of RAM, and how many bytes of it the program uses
+    /// </summary>
+    public record Region(string Name, ushort Start, int Size, int Used)
+    {
+        public bool Overflows => Used > Size;
+    }
+
+    /// <summary>
+    /// Deepest a subroutine takes the hardware stack and the C stack, and how much it leaves on the C stack when it returns
+    /// </summary>
+    record Depth(int Hardware, int CStack, int CStackDelta);
+
+    readonly byte[] _memory = new byte[0x10000];
+    readonly Dictionary<ushort, Depth> _depths = new();
+    readonly HashSet<ushort> _walking = new();
+    readonly Dictionary<ushort, int> _cStackDeltas = new();
+    int _steps;
+
+    public List<Region> Regions { get; } = new();
+
+    /// <summary>
+    /// False if the stack depths are a guess: PRG_ROM was not available, or the call graph has recursion or an indirect jump
+    /// </summary>
+    public bool Exact { get; private set; } = true;
+
+    /// <summary>
+    /// Deepest the hardware stack gets running main, plus an NMI at that point
+    /// </summary>
+    public int HardwareStack { get; private set; }
+
+    /// <summary>
+    /// Deepest the C stack gets, from the arguments pushed with pusha and pushax
+    /// </summary>
+    public int CStack { get; private set; }
+
+    public IEnumerable<Region> Overflows => Regions.Where(r => r.Overflows);
+
+    /// <param name="prg">PRG_ROM starting at $8000, or null if the call graph is unknown</param>
+    /// <param name="main">The bytes of static void main</param>
+    /// <param name="locals">Bytes of locals main has after condes</param>
+    /// <param name="ramCode">Code of the [RunFromRam] built-ins, copied to RAM_CODE</param>
+    /// <param name="names">Names of the cc65 runtime routines written after main</param>
+    /// <param name="fade">If NES.Fade is linked, with its state below PAL_BUF</param>
+    public RamBudget(byte[]? prg, byte[] main, int locals, byte[] ramCode, IReadOnlyDictionary<ushort, string> names, bool fade = false)
+    {
+        foreach (var pair in names)
+        {
+            int delta = pair.Value switch
+            {
+                "pusha" => 1,
+                "pushax" => 2,
+                "popa" => -1,
+                "popax" => -2,
+                _ => 0,
+            };
+            if (delta != 0)
+                _cStackDeltas[pair.Key] = delta;
+        }
+
+        if (prg is null)
+        {
+            Exact = false;
+        }
+        else
+        {
+            Array.Copy(prg, 0, _memory, PRG_START, Math.Min(prg.Length, _memory.Length - PRG_START));
+            Array.Copy(ramCode, 0, _memory, NESWriter.RAM_CODE, ramCode.Length);
+            // Code startup leaves in RAM: NMICallback is `JMP $8210`, an RTS, and there are no constructors at condes
+            _memory[NMI_CALLBACK] = (byte)NESInstruction.JMP_abs;
+            _memory[NMI_CALLBACK + 1] = 0x10;
+            _memory[NMI_CALLBACK + 2] = 0x82;
+            _memory[condes] = (byte)NESInstruction.RTS_impl;
+            var reset = Walk(ReadWord(RESET_VECTOR));
+            var nmi = Walk(ReadWord(NMI_VECTOR));
+            HardwareStack = reset.Hardware + INTERRUPT_SIZE + nmi.Hardware;
+            CStack = reset.CStack;
+        }
+
+        ushort bssEnd = ramCode.Length > 0 ? NESWriter.RAM_CODE : C_STACK;
+        Regions.Add(new Region("cc65 runtime zero page", 0x0000, ZP_LOCALS, ZP_LOCALS));
+        Regions.Add(new Region("zero page locals", ZP_LOCALS, 0x100 - ZP_LOCALS, GetZeroPageLocals(main)));
+        Regions.Add(new Region("hardware stack", HARDWARE_STACK, OAM_BUF - HARDWARE_STACK, HardwareStack));
+        if (fade)
+            Regions.Add(new Region("NES.Fade", FADE, FADE_SIZE, FADE_SIZE));
+        Regions.Add(new Region("PAL_BUF", PAL_BUF, PAL_BUF_SIZE, PAL_BUF_SIZE));
+        Regions.Add(new Region("OAM_BUF", OAM_BUF, 0x100, 0x100));
+        Regions.Add(new Region("BSS, locals", BSS, bssEnd - BSS, IL2NESWriter.local + 1 - BSS + locals));
+        if (ramCode.Length > 0)
+            Regions.Add(new Region("[RunFromRam] code", NESWriter.RAM_CODE, C_STACK - NESWriter.RAM_CODE, ramCode.Length));
+        Regions.Add(new Region("C stack", C_STACK, RAM_END - C_STACK, CStack));
+    }
+
+    /// <summary>
+    /// Writes the map, one region per line
+    /// </summary>
+    public void Write(TextWriter writer)
+    {
+        writer.WriteLine($"RAM map{(Exact ? "" : ", stack depths are a lower bound")}:");
+        foreach (var region in Regions)
+        {
+            var line = new StringBuilder($"  ${region.Start:X4}-${region.Start + region.Size - 1:X4} {region.Name,-24}{region.Used,5} of {region.Size,4} bytes");
+            if (region.Overflows)
+                line.Append($", {region.Used - region.Size} bytes over");
+            writer.WriteLine(line.ToString());
+        }
+        int used = Regions.Sum(r => Math.Min(r.Used, r.Size));
+        int size = Regions.Sum(r => r.Size);
+        writer.WriteLine($"  {used} of {size} bytes used, {size - used} free");
+    }
+
+    public override string ToString()
+    {
+        using var writer = new StringWriter();
+        Write(writer);
+        return writer.ToString();
+    }
+
+    /// <summary>
+    /// Zero page locals are the zero page operands of main above the cc65 runtime's
+    /// </summary>
+    static int GetZeroPageLocals(byte[] main)
+    {
+        var addresses = new HashSet<byte>();
+        int offset = 0;
+        while (offset < main.Length)
+        {
+            var info = NESInstructionInfo.Get(main[offset]);
+            if (info is null)
+            {
+                offset++;
+                continue;
+            }
+            if (info.Mode is AddressMode.ZeroPage or AddressMode.ZeroPageX or AddressMode.ZeroPageY && offset + 1 < main.Length && main[offset + 1] >= ZP_LOCALS)
+                addresses.Add(main[offset + 1]);
+            offset += info.Length;
+        }
+        return addresses.Count;
+    }
+
+    /// <summary>
+    /// Follows every path through a subroutine until RTS or RTI, and the subroutines it calls.
+    /// A loop is walked once, so pushes inside it are expected to balance.
+    /// </summary>
+    Depth Walk(ushort address)
+    {
+        if (_depths.TryGetValue(address, out var cached))
+            return cached;
+        if (!_walking.Add(address))
+        {
+            Exact = false;
+            return new Depth(0, 0, 0);
+        }
+
+        int hardware = 0, cStack = 0;
+        int? delta = null;
+        var visited = new HashSet<ushort>();
+        var paths = new Stack<(ushort PC, int Hardware, int CStack)>();
+        paths.Push((address, 0, 0));
+        while (paths.Count > 0)
+        {
+            var (pc, h, c) = paths.Pop();
+            while (visited.Add(pc))
+            {
+                if (++_steps > MaxSteps)
+                {
+                    Exact = false;
+                    break;
+                }
+                hardware = Math.Max(hardware, h);
+                cStack = Math.Max(cStack, c);
+                var info = NESInstructionInfo.Get(_memory[pc]);
+                if (info is null || info.Mnemonic is "BRK" || info.Mode == AddressMode.Indirect)
+                {
+                    Exact = false;
+                    break;
+                }
+                if (info.Mnemonic is "RTS" or "RTI")
+                {
+                    delta = Math.Max(delta ?? c, c);
+                    break;
+                }
+
+                ushort operand = (ushort)(_memory[(ushort)(pc + 1)] | _memory[(ushort)(pc + 2)] << 8);
+                switch (info.Mnemonic)
+                {
+                    case "PHA":
+                    case "PHP":
+                        h++;
+                        break;
+                    case "PLA":
+                    case "PLP":
+                        h--;
+                        break;
+                    case "JMP":
+                        pc = operand;
+                        continue;
+                    case "JSR":
+                        if (_cStackDeltas.TryGetValue(operand, out var pushed))
+                        {
+                            hardware = Math.Max(hardware, h + 2);
+                            c += pushed;
+                        }
+                        else
+                        {
+                            var callee = Walk(operand);
+                            hardware = Math.Max(hardware, h + 2 + callee.Hardware);
+                            cStack = Math.Max(cStack, c + callee.CStack);
+                            c += callee.CStackDelta;
+                        }
+                        break;
+                }
+                if (info.Mode == AddressMode.Relative)
+                    paths.Push(((ushort)(pc + 2 + (sbyte)_memory[(ushort)(pc + 1)]), h, c));
+                pc = (ushort)(pc + info.Length);
+            }
+        }
+
+        _walking.Remove(address);
+        return _depths[address] = new Depth(hardware, cStack, delta ?? 0);
+    }
+
+    ushort ReadWord(ushort address) => (ushort)(_memory[address] | _memory[(ushort)(address + 1)] << 8);
+}
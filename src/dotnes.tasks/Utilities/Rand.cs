@@ -0,0 +1,157 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// rand8, rand16 and set_rand of neslib.
+/// rand8 steps the two 8-bit Galois LFSRs of neslib in the bytes of RAND_SEED, with its rand1 and rand2 inlined.
+/// rand16 steps RAND_SEED as one 16-bit Galois LFSR, which does not repeat for 65535 values instead of 255.
+/// </summary>
+static class Rand
+{
+    /// <summary>
+    /// The values of rand8 from the seed RAM is cleared to, generated when the ROM is built.
+    /// rand8 increments the low byte of the seed before its load, so the first value is at index 1.
+    /// </summary>
+    public static byte[] Table { get; } = WriteTable();
+
+    /// <summary>
+    /// The routines as in neslib
+    /// </summary>
+    public static NESObject Lfsr { get; } = Write(table: false);
+
+    /// <summary>
+    /// rand8 is one indexed load from Table, the other routines are the same as in Lfsr
+    /// </summary>
+    public static NESObject Lookup { get; } = Write(table: true);
+
+    /// <summary>
+    /// Feedback of the LFSRs in the low and the high byte of the seed, and of the 16-bit LFSR, x^16 + x^5 + x^3 + x^2 + 1
+    /// </summary>
+    const byte Tap1 = 0xCF, Tap2 = 0xD7, Tap16 = 0x2D;
+
+    /// <summary>
+    /// Replaces a byte of the seed that is 0, the one value an LFSR never leaves. RAM is cleared on reset, so it is the first seed.
+    /// rand16 replaces a seed of 0 with $00FF.
+    /// </summary>
+    const byte ZeroSeed = 0xFD;
+
+    /// <summary>
+    /// One step of both LFSRs, and the value rand8 returns
+    /// </summary>
+    public static byte Next(ref ushort seed)
+    {
+        var low = Shift((byte)(seed & 0xFF), Tap1, out _);
+        var high = Shift((byte)(seed >> 8), Tap2, out bool carry);
+        seed = (ushort)(high << 8 | low);
+        return (byte)(low + high + (carry ? 1 : 0));
+    }
+
+    /// <summary>
+    /// One step of the 16-bit LFSR, which rand16 returns
+    /// </summary>
+    public static ushort Next16(ref ushort seed)
+    {
+        if (seed == 0)
+            seed = 0x00FF;
+        bool carry = seed >= 0x8000;
+        seed <<= 1;
+        if (carry)
+            seed ^= Tap16;
+        return seed;
+    }
+
+    static byte Shift(byte value, byte tap, out bool carry)
+    {
+        if (value == 0)
+            value = ZeroSeed;
+        carry = value >= 0x80;
+        value <<= 1;
+        return carry ? (byte)(value ^ tap) : value;
+    }
+
+    static byte[] WriteTable()
+    {
+        var table = new byte[256];
+        ushort seed = 0;
+        for (int i = 1; i <= table.Length; i++)
+        {
+            table[i & 0xFF] = Next(ref seed);
+        }
+        return table;
+    }
+
+    static NESObject Write(bool table)
+    {
+        using var writer = new Writer();
+        writer.WriteRand8(table);
+        writer.WriteRand16();
+        writer.WriteSetRand();
+        return writer.ToObject(table ? Table : null);
+    }
+
+    class Writer : NESObjectWriter
+    {
+        /// <summary>
+        /// Shifts a byte of the seed left, the bit shifted out is in the carry and sets the feedback
+        /// </summary>
+        void WriteShift(byte seed, byte tap)
+        {
+            Write(NESInstruction.LDA_zpg, seed);
+            Write(NESInstruction.BNE_rel, 2);
+            Write(NESInstruction.LDA, ZeroSeed);
+            Write(NESInstruction.ASL_A);
+            Write(NESInstruction.BCC, 2);
+            Write(NESInstruction.EOR, tap);
+            Write(NESInstruction.STA_zpg, seed);
+        }
+
+        public void WriteRand8(bool table)
+        {
+            ushort offset = Offset;
+            if (table)
+            {
+                Write(NESInstruction.INC_zpg, RAND_SEED);
+                Write(NESInstruction.LDX_zpg, RAND_SEED);
+                WriteLoadTable();
+            }
+            else
+            {
+                WriteShift(RAND_SEED, Tap1);
+                WriteShift(RAND_SEED + 1, Tap2);
+                Write(NESInstruction.ADC_X_zpg, RAND_SEED);
+            }
+            Write(NESInstruction.RTS_impl);
+            AddSymbol(nameof(NESLib.rand8), offset, Offset);
+            AddSymbol(nameof(NESLib.rand), offset, Offset);
+        }
+
+        /// <summary>
+        /// The seed after one step, in A/X
+        /// </summary>
+        public void WriteRand16()
+        {
+            ushort offset = Offset;
+            Write(NESInstruction.LDA_zpg, RAND_SEED);
+            Write(NESInstruction.ORA_zpg, RAND_SEED + 1);
+            Write(NESInstruction.BNE_rel, 2);
+            Write(NESInstruction.DEC_zpg, RAND_SEED);
+            Write(NESInstruction.ASL_zpg, RAND_SEED);
+            Write(NESInstruction.ROL_zpg, RAND_SEED + 1);
+            Write(NESInstruction.LDA_zpg, RAND_SEED);
+            Write(NESInstruction.BCC, 4);
+            Write(NESInstruction.EOR, Tap16);
+            Write(NESInstruction.STA_zpg, RAND_SEED);
+            Write(NESInstruction.LDX_zpg, RAND_SEED + 1);
+            Write(NESInstruction.RTS_impl);
+            AddSymbol(nameof(NESLib.rand16), offset, Offset);
+        }
+
+        public void WriteSetRand()
+        {
+            ushort offset = Offset;
+            Write(NESInstruction.STA_zpg, RAND_SEED);
+            Write(NESInstruction.STX_zpg, RAND_SEED + 1);
+            Write(NESInstruction.RTS_impl);
+            AddSymbol(nameof(NESLib.set_rand), offset, Offset);
+        }
+    }
+}
@@ -0,0 +1,340 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Abstract interpreter over the 6502 code of static void main. It tracks the known values of
+/// A, X, Y, the carry and RAM, along with which register the N and Z flags reflect, and:
+/// * removes loads of a value the register already holds
+/// * turns loads into TAX, TXA, etc. when another register holds the value
+/// * turns loads from RAM holding a known value into immediate loads
+/// * removes stores of a value RAM already holds, and CMP #0 when the flags are already set
+/// NOTE: main is straight-line code, so any jump, branch or return forgets everything.
+/// </summary>
+class RegisterOptimizer
+{
+    const ushort RAM_END = 0x0800;
+    /// <summary>
+    /// NESLib's own zero page is changed by the NMI handler, so values there are never tracked
+    /// </summary>
+    const ushort ZP_TRACKED = 0x22;
+    /// <summary>
+    /// The C stack grows down from $0800, built-ins like pusha write there
+    /// </summary>
+    const ushort C_STACK = 0x0700;
+
+    readonly ILogger _logger;
+
+    public RegisterOptimizer(ILogger? logger = null) => _logger = logger ?? new NullLogger();
+
+    public int BytesSaved { get; private set; }
+
+    public int CyclesSaved { get; private set; }
+
+    class State
+    {
+        public byte? A, X, Y;
+        public bool? Carry;
+        /// <summary>
+        /// The register whose value the N and Z flags reflect, if any
+        /// </summary>
+        public Registers Flags;
+        public readonly Dictionary<ushort, byte> Memory = new();
+
+        public byte? Get(Registers register) => register switch
+        {
+            Registers.A => A,
+            Registers.X => X,
+            _ => Y,
+        };
+
+        public void Set(Registers register, byte? value)
+        {
+            switch (register)
+            {
+                case Registers.A: A = value; break;
+                case Registers.X: X = value; break;
+                default: Y = value; break;
+            }
+            Flags = register;
+        }
+
+        public void Reset()
+        {
+            A = X = Y = null;
+            Carry = null;
+            Flags = Registers.None;
+            Memory.Clear();
+        }
+    }
+
+    /// <summary>
+    /// Returns the optimized code, and adds the ranges of the original code that were removed
+    /// </summary>
+    /// <param name="calls">What each subroutine called with JSR leaves in the registers</param>
+    public byte[] Optimize(byte[] code, IReadOnlyDictionary<ushort, BuiltInEffects> calls, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.Registers);
+        if (instructions is null)
+            return code;
+
+        var state = new State();
+        var output = new List<byte>(code.Length);
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var instruction = instructions[i];
+            var info = instruction.Info;
+            byte[]? replacement = null;
+            switch (info.Mnemonic)
+            {
+                case "LDA":
+                case "LDX":
+                case "LDY":
+                {
+                    var register = GetRegister(info.Mnemonic);
+                    byte? value = info.Mode == AddressMode.Immediate ? (byte)instruction.Operand : GetMemory(state, info, instruction.Operand);
+                    if (value is null)
+                    {
+                        state.Set(register, null);
+                        break;
+                    }
+                    if (state.Get(register) == value && (state.Flags == register || IsFlagDead(instructions, i + 1, carry: false)))
+                    {
+                        replacement = [];
+                        break;
+                    }
+                    if (register == Registers.A && state.X == value)
+                        replacement = [(byte)NESInstruction.TXA_impl];
+                    else if (register == Registers.A && state.Y == value)
+                        replacement = [(byte)NESInstruction.TYA_impl];
+                    else if (register == Registers.X && state.A == value)
+                        replacement = [(byte)NESInstruction.TAX_impl];
+                    else if (register == Registers.Y && state.A == value)
+                        replacement = [(byte)NESInstruction.TAY_impl];
+                    else if (info.Mode != AddressMode.Immediate)
+                        replacement = [(byte)(register switch { Registers.A => NESInstruction.LDA, Registers.X => NESInstruction.LDX, _ => NESInstruction.LDY }), value.Value];
+                    state.Set(register, value);
+                    break;
+                }
+                case "STA":
+                case "STX":
+                case "STY":
+                {
+                    if (info.Mode is not (AddressMode.ZeroPage or AddressMode.Absolute))
+                    {
+                        state.Memory.Clear();
+                        break;
+                    }
+                    if (!IsTracked(instruction.Operand))
+                        break;
+                    var value = state.Get(GetRegister(info.Mnemonic));
+                    if (value is null)
+                    {
+                        state.Memory.Remove(instruction.Operand);
+                    }
+                    else if (state.Memory.TryGetValue(instruction.Operand, out var current) && current == value)
+                    {
+                        replacement = [];
+                    }
+                    else
+                    {
+                        state.Memory[instruction.Operand] = value.Value;
+                    }
+                    break;
+                }
+                case "TAX":
+                    state.Set(Registers.X, state.A);
+                    break;
+                case "TAY":
+                    state.Set(Registers.Y, state.A);
+                    break;
+                case "TXA":
+                    state.Set(Registers.A, state.X);
+                    break;
+                case "TYA":
+                    state.Set(Registers.A, state.Y);
+                    break;
+                case "INX":
+                case "DEX":
+                    state.Set(Registers.X, (byte?)(state.X + (info.Mnemonic == "INX" ? 1 : -1)));
+                    break;
+                case "INY":
+                case "DEY":
+                    state.Set(Registers.Y, (byte?)(state.Y + (info.Mnemonic == "INY" ? 1 : -1)));
+                    break;
+                case "AND" when info.Mode == AddressMode.Immediate:
+                    state.Set(Registers.A, instruction.Operand == 0 ? 0 : (byte?)(state.A & instruction.Operand));
+                    break;
+                case "ORA" when info.Mode == AddressMode.Immediate:
+                    state.Set(Registers.A, instruction.Operand == 0xFF ? 0xFF : (byte?)(state.A | instruction.Operand));
+                    break;
+                case "EOR" when info.Mode == AddressMode.Immediate:
+                    state.Set(Registers.A, (byte?)(state.A ^ instruction.Operand));
+                    break;
+                case "ADC" when info.Mode == AddressMode.Immediate:
+                case "SBC" when info.Mode == AddressMode.Immediate:
+                {
+                    int? result = info.Mnemonic == "ADC" ?
+                        state.A + instruction.Operand + (state.Carry == true ? 1 : 0) :
+                        state.A - instruction.Operand - (state.Carry == true ? 0 : 1);
+                    if (state.Carry is null)
+                        result = null;
+                    state.Set(Registers.A, (byte?)result);
+                    state.Carry = result is null ? null : info.Mnemonic == "ADC" ? result > 0xFF : result >= 0;
+                    break;
+                }
+                case "ASL" when info.Mode == AddressMode.Accumulator:
+                case "LSR" when info.Mode == AddressMode.Accumulator:
+                case "ROL" when info.Mode == AddressMode.Accumulator:
+                case "ROR" when info.Mode == AddressMode.Accumulator:
+                {
+                    var a = state.A;
+                    bool rotate = info.Mnemonic is "ROL" or "ROR";
+                    bool left = info.Mnemonic is "ASL" or "ROL";
+                    if (a is null || rotate && state.Carry is null)
+                    {
+                        state.Set(Registers.A, null);
+                        state.Carry = null;
+                        break;
+                    }
+                    int carryIn = rotate && state.Carry == true ? 1 : 0;
+                    state.Carry = left ? (a & 0x80) != 0 : (a & 0x01) != 0;
+                    state.Set(Registers.A, (byte)(left ? a.Value << 1 | carryIn : a.Value >> 1 | carryIn << 7));
+                    break;
+                }
+                case "CLC":
+                    state.Carry = false;
+                    break;
+                case "SEC":
+                    state.Carry = true;
+                    break;
+                case "CMP" when info.Mode == AddressMode.Immediate:
+                case "CPX" when info.Mode == AddressMode.Immediate:
+                case "CPY" when info.Mode == AddressMode.Immediate:
+                {
+                    var register = info.Mnemonic switch { "CMP" => Registers.A, "CPX" => Registers.X, _ => Registers.Y };
+                    // Comparing with 0 sets N and Z from the register, and the carry
+                    if (instruction.Operand == 0)
+                    {
+                        if (state.Flags == register && (state.Carry == true || IsFlagDead(instructions, i + 1, carry: true)))
+                        {
+                            replacement = [];
+                            break;
+                        }
+                        state.Flags = register;
+                        state.Carry = true;
+                        break;
+                    }
+                    var value = state.Get(register);
+                    state.Carry = value is null ? null : value >= instruction.Operand;
+                    state.Flags = Registers.None;
+                    break;
+                }
+                case "NOP":
+                    break;
+                case "JSR":
+                {
+                    if (!calls.TryGetValue(instruction.Operand, out var effects))
+                        effects = BuiltInEffects.Unknown;
+                    state.A = (effects.Preserved & Registers.A) != 0 ? state.A : effects.A;
+                    state.X = (effects.Preserved & Registers.X) != 0 ? state.X : effects.X;
+                    state.Y = (effects.Preserved & Registers.Y) != 0 ? state.Y : effects.Y;
+                    state.Carry = null;
+                    state.Flags = Registers.None;
+                    // Built-ins write zero page and the C stack, but never main's locals
+                    foreach (var address in state.Memory.Keys.Where(a => !IsLocal(a)).ToArray())
+                    {
+                        state.Memory.Remove(address);
+                    }
+                    break;
+                }
+                default:
+                    state.Reset();
+                    break;
+            }
+
+            if (replacement is null)
+            {
+                output.AddRange(code.Skip(instruction.Offset).Take(info.Length));
+                continue;
+            }
+
+            int cycles = info.Cycles - (replacement.Length == 0 ? 0 : NESInstructionInfo.Get(replacement[0])!.Cycles);
+            BytesSaved += info.Length - replacement.Length;
+            CyclesSaved += cycles;
+            removed?.Add((instruction.Offset + replacement.Length, info.Length - replacement.Length));
+            output.AddRange(replacement);
+            _logger.WriteLine($"{nameof(CodeOptimizations.Registers)}: +{instruction.Offset:X4} {instruction} => {(replacement.Length == 0 ? "removed" : NESInstructionInfo.Get(replacement[0])!.Mnemonic)}, {cycles} cycles saved");
+        }
+
+        return output.ToArray();
+    }
+
+    static Registers GetRegister(string mnemonic) => mnemonic[2] switch
+    {
+        'A' => Registers.A,
+        'X' => Registers.X,
+        _ => Registers.Y,
+    };
+
+    static bool IsTracked(ushort address) =>
+        address is >= ZP_TRACKED and < 0x100 or >= IL2NESWriter.local and < RAM_END;
+
+    /// <summary>
+    /// Locals of static void main, which may have been moved to zero page
+    /// </summary>
+    static bool IsLocal(ushort address) =>
+        address is >= IL2NESWriter.zeroPageLocal and < 0x100 or >= IL2NESWriter.local and < C_STACK;
+
+    static byte? GetMemory(State state, NESInstructionInfo info, ushort address)
+    {
+        if (info.Mode is not (AddressMode.ZeroPage or AddressMode.Absolute) || !IsTracked(address))
+            return null;
+        return state.Memory.TryGetValue(address, out var value) ? value : null;
+    }
+
+    /// <summary>
+    /// True if N and Z (or the carry) are always set again before anything reads them.
+    /// Subroutines never expect flags as input, and the only JMP in main is `while (true) ;`
+    /// </summary>
+    static bool IsFlagDead(List<DecodedInstruction> instructions, int index, bool carry)
+    {
+        for (int i = index; i < instructions.Count; i++)
+        {
+            switch (instructions[i].Info.Mnemonic)
+            {
+                case "JSR":
+                case "JMP":
+                case "RTS":
+                    return true;
+                case "PHP":
+                case "BRK":
+                case "RTI":
+                    return false;
+            }
+            if (carry)
+            {
+                switch (instructions[i].Info.Mnemonic)
+                {
+                    case "ADC": case "SBC": case "ROL": case "ROR": case "BCC": case "BCS":
+                        return false;
+                    case "CLC": case "SEC": case "CMP": case "CPX": case "CPY": case "ASL": case "LSR": case "PLP":
+                        return true;
+                }
+            }
+            else
+            {
+                switch (instructions[i].Info.Mnemonic)
+                {
+                    case "BEQ": case "BNE": case "BMI": case "BPL":
+                        return false;
+                    case "LDA": case "LDX": case "LDY": case "TAX": case "TAY": case "TXA": case "TYA": case "TSX":
+                    case "INX": case "INY": case "DEX": case "DEY": case "INC": case "DEC":
+                    case "AND": case "ORA": case "EOR": case "ADC": case "SBC": case "BIT":
+                    case "CMP": case "CPX": case "CPY": case "ASL": case "LSR": case "ROL": case "ROR":
+                    case "PLA": case "PLP":
+                        return true;
+                }
+            }
+        }
+        return true;
+    }
+}
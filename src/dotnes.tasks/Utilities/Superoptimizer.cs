@@ -0,0 +1,305 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Searches for the fastest sequence of 6502 instructions equivalent to a short piece of code,
+/// running both on NESCpu. It is too slow to run during a build, instead Generate writes the
+/// peephole.txt rewrite database that PeepholeOptimizer reads.
+/// </summary>
+class Superoptimizer
+{
+    /// <summary>
+    /// Where the code runs, nothing else is there
+    /// </summary>
+    const ushort ADDRESS = 0x8000;
+    const int QuickInputs = 16;
+    const int RandomInputs = 3;
+
+    static readonly string[] implied = ["TAX", "TAY", "TXA", "TYA", "INX", "INY", "DEX", "DEY", "CLC", "SEC", "CLV"];
+    static readonly string[] accumulator = ["ASL", "LSR", "ROL", "ROR"];
+    static readonly string[] immediate = ["LDA", "LDX", "LDY", "AND", "ORA", "EOR", "ADC", "SBC", "CMP", "CPX", "CPY"];
+    static readonly string[] zeroPage = ["LDA", "LDX", "LDY", "STA", "STX", "STY", "AND", "ORA", "EOR", "ADC", "SBC", "CMP", "BIT", "INC", "DEC"];
+    static readonly byte[] constants = [0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF];
+
+    /// <summary>
+    /// Code to search for, and the outputs the replacement must keep
+    /// </summary>
+    public record Seed(string Name, byte[] Code, Outputs Required);
+
+    /// <summary>
+    /// Straight-line shapes of comparisons, shifts and flag computations
+    /// </summary>
+    public static readonly Seed[] Seeds =
+    [
+        // PHA, ASL A, PLA, ROR A
+        new("Arithmetic shift right", [0x48, 0x0A, 0x68, 0x6A], Outputs.A | Outputs.Carry | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // TAX, INX, TXA
+        new("Increment A", [0xAA, 0xE8, 0x8A], Outputs.A | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // TAX, DEX, TXA
+        new("Decrement A", [0xAA, 0xCA, 0x8A], Outputs.A | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // PHA, PLA
+        new("Push and pull A", [0x48, 0x68], Outputs.A | Outputs.X | Outputs.Y | Outputs.Carry | Outputs.Overflow | Outputs.Memory),
+        // TAX, TXA
+        new("Copy A to X and back", [0xAA, 0x8A], Outputs.All),
+        // LDA #$00, CLC, ADC $10
+        new("Add to zero", [0xA9, 0x00, 0x18, 0x65, 0x10], Outputs.A | Outputs.Carry | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // EOR #$FF, CLC, ADC #$01
+        new("Negate A", [0x49, 0xFF, 0x18, 0x69, 0x01], Outputs.A | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // LDA #$00, ROL A, EOR #$01
+        new("A = !carry", [0xA9, 0x00, 0x2A, 0x49, 0x01], Outputs.A | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // ASL A, LDA #$00, ADC #$FF, EOR #$FF
+        new("Sign of A", [0x0A, 0xA9, 0x00, 0x69, 0xFF, 0x49, 0xFF], Outputs.A | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // CMP #$80, LDA #$00, ROL A
+        new("A = A >= 128", [0xC9, 0x80, 0xA9, 0x00, 0x2A], Outputs.A | Outputs.Zero | Outputs.Negative | Outputs.Memory),
+        // STA $10, LDA $10
+        new("Store and reload A", [0x85, 0x10, 0xA5, 0x10], Outputs.A | Outputs.X | Outputs.Y | Outputs.Carry | Outputs.Overflow | Outputs.Memory),
+        // LDA $10, CLC, ADC #$01, STA $10
+        new("Increment in RAM", [0xA5, 0x10, 0x18, 0x69, 0x01, 0x85, 0x10], Outputs.Zero | Outputs.Negative | Outputs.Memory),
+    ];
+
+    record Input(byte A, byte X, byte Y, byte P, byte[] Values);
+
+    record Result(byte A, byte X, byte Y, byte P, byte S, byte[] Values);
+
+    readonly ILogger _logger;
+    readonly NESCpu _cpu = new();
+
+    public Superoptimizer(ILogger? logger = null) => _logger = logger ?? new NullLogger();
+
+    /// <summary>
+    /// Longest sequence to try, each instruction multiplies the search by ~100
+    /// </summary>
+    public int MaxInstructions { get; set; } = 3;
+
+    /// <summary>
+    /// Writes a rule for each seed that has a faster equivalent
+    /// </summary>
+    public void Generate(TextWriter writer, IEnumerable<Seed> seeds)
+    {
+        writer.WriteLine("# Generated by Superoptimizer.Generate, each rule is verified with NESCpu");
+        writer.WriteLine("# pattern => replacement : outputs the replacement keeps");
+        writer.WriteLine("# xx is the zero page operand the rule is verified on, it matches any address in RAM");
+        foreach (var seed in seeds)
+        {
+            var rule = Search(seed.Code, seed.Required);
+            if (rule is null)
+            {
+                _logger.WriteLine($"{seed.Name}: nothing faster than {Disassemble(seed.Code)}");
+                continue;
+            }
+            writer.WriteLine($"# {seed.Name}: {Disassemble(rule.Pattern)} => {Disassemble(rule.Replacement)}, {GetCycles(rule.Pattern) - GetCycles(rule.Replacement)} cycles saved");
+            writer.WriteLine(rule);
+        }
+    }
+
+    /// <summary>
+    /// Returns the fastest equivalent of the target, then the smallest, or null if there is nothing better
+    /// </summary>
+    /// <param name="required">Outputs that must be the same, any other output may differ</param>
+    public PeepholeRule? Search(byte[] target, Outputs required)
+    {
+        var addresses = GetAddresses(target);
+        var alphabet = GetAlphabet(target, addresses);
+        var inputs = GetInputs(addresses, exhaustive: false);
+        var expected = inputs.Select(i => Run(target, addresses, i)).ToArray();
+
+        int bestCycles = GetCycles(target), bestLength = target.Length;
+        byte[]? best = null;
+        var candidate = new List<byte[]>();
+        long tried = 0;
+
+        void Visit(int cycles, int length)
+        {
+            if (cycles < bestCycles || cycles == bestCycles && length < bestLength)
+            {
+                tried++;
+                var code = candidate.SelectMany(c => c).ToArray();
+                if (IsEquivalent(code, addresses, inputs, expected, required) &&
+                    (Verify(target, code) & required) == required)
+                {
+                    best = code;
+                    bestCycles = cycles;
+                    bestLength = length;
+                }
+            }
+            if (candidate.Count == MaxInstructions)
+                return;
+            foreach (var instruction in alphabet)
+            {
+                var info = NESInstructionInfo.Get(instruction[0])!;
+                if (cycles + info.Cycles > bestCycles)
+                    continue;
+                candidate.Add(instruction);
+                Visit(cycles + info.Cycles, length + instruction.Length);
+                candidate.RemoveAt(candidate.Count - 1);
+            }
+        }
+        Visit(0, 0);
+
+        _logger.WriteLine($"{Disassemble(target)}: tried {tried} candidates, best: {(best is null ? "none" : Disassemble(best))}");
+        return best is null ? null : new PeepholeRule(target, best, Verify(target, best));
+    }
+
+    /// <summary>
+    /// Runs both sequences on every value of A, the carry and overflow, with a few values of everything else.
+    /// Returns the outputs that are the same for all of them.
+    /// </summary>
+    public Outputs Verify(byte[] code, byte[] replacement)
+    {
+        var addresses = GetAddresses(code).Union(GetAddresses(replacement)).ToArray();
+        var outputs = Outputs.All;
+        foreach (var input in GetInputs(addresses, exhaustive: true))
+        {
+            outputs &= Compare(Run(code, addresses, input), Run(replacement, addresses, input));
+            if (outputs == Outputs.None)
+                break;
+        }
+        return outputs;
+    }
+
+    bool IsEquivalent(byte[] code, byte[] addresses, List<Input> inputs, Result[] expected, Outputs required)
+    {
+        for (int i = 0; i < inputs.Count; i++)
+        {
+            if ((Compare(expected[i], Run(code, addresses, inputs[i])) & required) != required)
+                return false;
+        }
+        return true;
+    }
+
+    Result Run(byte[] code, byte[] addresses, Input input)
+    {
+        _cpu.A = input.A;
+        _cpu.X = input.X;
+        _cpu.Y = input.Y;
+        _cpu.P = input.P;
+        _cpu.S = 0xFD;
+        for (int i = 0; i < addresses.Length; i++)
+        {
+            _cpu.Memory[addresses[i]] = input.Values[i];
+        }
+        _cpu.Run(code, ADDRESS);
+
+        var values = new byte[addresses.Length];
+        for (int i = 0; i < addresses.Length; i++)
+        {
+            values[i] = _cpu.Memory[addresses[i]];
+        }
+        return new Result(_cpu.A, _cpu.X, _cpu.Y, _cpu.P, _cpu.S, values);
+    }
+
+    static Outputs Compare(Result a, Result b)
+    {
+        var outputs = Outputs.None;
+        if (a.A == b.A)
+            outputs |= Outputs.A;
+        if (a.X == b.X)
+            outputs |= Outputs.X;
+        if (a.Y == b.Y)
+            outputs |= Outputs.Y;
+        if (((a.P ^ b.P) & 0x01) == 0)
+            outputs |= Outputs.Carry;
+        if (((a.P ^ b.P) & 0x02) == 0)
+            outputs |= Outputs.Zero;
+        if (((a.P ^ b.P) & 0x80) == 0)
+            outputs |= Outputs.Negative;
+        if (((a.P ^ b.P) & 0x40) == 0)
+            outputs |= Outputs.Overflow;
+        if (a.S == b.S && a.Values.AsSpan().SequenceEqual(b.Values))
+            outputs |= Outputs.Memory;
+        return outputs;
+    }
+
+    static List<Input> GetInputs(byte[] addresses, bool exhaustive)
+    {
+        // Always the same inputs, so the database is the same on every run
+        var random = new Random(6502);
+        Input Next(byte a, byte p)
+        {
+            var values = new byte[addresses.Length];
+            random.NextBytes(values);
+            return new((byte)a, (byte)random.Next(256), (byte)random.Next(256), p, values);
+        }
+
+        var inputs = new List<Input>();
+        if (!exhaustive)
+        {
+            foreach (byte a in constants)
+            {
+                inputs.Add(Next(a, (byte)random.Next(256)));
+            }
+            while (inputs.Count < QuickInputs)
+            {
+                inputs.Add(Next((byte)random.Next(256), (byte)random.Next(256)));
+            }
+            return inputs;
+        }
+
+        for (int a = 0; a < 256; a++)
+        {
+            for (int flags = 0; flags < 4; flags++)
+            {
+                // Carry and overflow, the other flags are random
+                byte p = (byte)((flags & 1) | (flags & 2) << 5);
+                for (int i = 0; i < RandomInputs; i++)
+                {
+                    inputs.Add(Next((byte)a, (byte)(p | random.Next(256) & 0x82)));
+                }
+            }
+        }
+        return inputs;
+    }
+
+    /// <summary>
+    /// Zero page and absolute addresses the code reads or writes
+    /// </summary>
+    static byte[] GetAddresses(byte[] code)
+    {
+        var addresses = new List<byte>();
+        foreach (var instruction in DecodedInstruction.Decode(code, new NullLogger(), CodeOptimizations.Peephole) ?? [])
+        {
+            if (instruction.Info.Mode == AddressMode.ZeroPage)
+            {
+                if (!addresses.Contains((byte)instruction.Operand))
+                    addresses.Add((byte)instruction.Operand);
+            }
+            else if (instruction.Info.Mode is not (AddressMode.Implied or AddressMode.Accumulator or AddressMode.Immediate))
+                throw new NotImplementedException($"{instruction} is not supported by {nameof(Superoptimizer)}!");
+        }
+        return addresses.ToArray();
+    }
+
+    static List<byte[]> GetAlphabet(byte[] target, byte[] addresses)
+    {
+        var values = new SortedSet<byte>(constants);
+        foreach (var instruction in DecodedInstruction.Decode(target, new NullLogger(), CodeOptimizations.Peephole) ?? [])
+        {
+            if (instruction.Info.Mode == AddressMode.Immediate)
+                values.Add((byte)instruction.Operand);
+        }
+
+        var alphabet = new List<byte[]>();
+        foreach (var info in Enumerable.Range(0, 256).Select(i => NESInstructionInfo.Get((byte)i)).OfType<NESInstructionInfo>())
+        {
+            if (info.Mode == AddressMode.Implied && implied.Contains(info.Mnemonic) ||
+                info.Mode == AddressMode.Accumulator && accumulator.Contains(info.Mnemonic))
+            {
+                alphabet.Add([info.Opcode]);
+            }
+            else if (info.Mode == AddressMode.Immediate && immediate.Contains(info.Mnemonic))
+            {
+                alphabet.AddRange(values.Select(v => new[] { info.Opcode, v }));
+            }
+            else if (info.Mode == AddressMode.ZeroPage && zeroPage.Contains(info.Mnemonic))
+            {
+                alphabet.AddRange(addresses.Select(a => new[] { info.Opcode, a }));
+            }
+        }
+        return alphabet;
+    }
+
+    static int GetCycles(byte[] code) =>
+        DecodedInstruction.Decode(code, new NullLogger(), CodeOptimizations.Peephole)?.Sum(i => i.Info.Cycles) ?? int.MaxValue;
+
+    public static string Disassemble(byte[] code) => code.Length == 0 ? "nothing" :
+        string.Join("; ", DecodedInstruction.Decode(code, new NullLogger(), CodeOptimizations.Peephole)?.Select(i => i.ToString()) ?? ["?"]);
+}
@@ -0,0 +1,163 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Optimizes the ends of 6502 routines, like the built-ins already do by hand:
+/// * `JSR f; RTS` becomes `JMP f`, saving a byte, 9 cycles and two bytes of stack
+/// * a tail ending in RTS or JMP that is identical to a later one becomes a JMP to it (cross-jumping)
+/// </summary>
+class TailCallOptimizer
+{
+    /// <summary>
+    /// A JMP is 3 bytes, so a shorter tail is not worth sharing
+    /// </summary>
+    internal const int DefaultMinTailLength = 4;
+
+    readonly ILogger _logger;
+
+    public TailCallOptimizer(ILogger? logger = null) => _logger = logger ?? new NullLogger();
+
+    /// <summary>
+    /// Shortest tail to share when cross-jumping, longer saves fewer bytes but only where it saves more
+    /// </summary>
+    public int MinTailLength { get; set; } = DefaultMinTailLength;
+
+    public int BytesSaved { get; private set; }
+
+    /// <summary>
+    /// Negative when cross-jumping trades cycles for bytes
+    /// </summary>
+    public int CyclesSaved { get; private set; }
+
+    /// <summary>
+    /// Replaces `JSR f; RTS` with `JMP f`, and adds the ranges of the original code that were removed
+    /// </summary>
+    public byte[] TailCalls(byte[] code, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.TailCalls);
+        if (instructions is null)
+            return code;
+
+        var jmp = NESInstructionInfo.Get(NESInstruction.JMP_abs);
+        var output = new List<byte>(code.Length);
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var instruction = instructions[i];
+            if (instruction.Info.Mnemonic == "JSR" && i + 1 < instructions.Count && instructions[i + 1].Info.Mnemonic == "RTS")
+            {
+                var rts = instructions[++i];
+                int cycles = instruction.Info.Cycles + rts.Info.Cycles - jmp.Cycles;
+                BytesSaved += rts.Info.Length;
+                CyclesSaved += cycles;
+                removed?.Add((rts.Offset, rts.Info.Length));
+                output.Add(jmp.Opcode);
+                output.Add((byte)instruction.Operand);
+                output.Add((byte)(instruction.Operand >> 8));
+                _logger.WriteLine($"{nameof(CodeOptimizations.TailCalls)}: +{instruction.Offset:X4} {instruction}; RTS => JMP, {cycles} cycles saved");
+                continue;
+            }
+            output.AddRange(code.Skip(instruction.Offset).Take(instruction.Info.Length));
+        }
+        return output.ToArray();
+    }
+
+    /// <summary>
+    /// Replaces each tail with a JMP to an identical later tail, and adds the ranges of the original code that were removed
+    /// </summary>
+    /// <param name="address">Where the code is in PRG_ROM, to encode the JMPs</param>
+    public byte[] CrossJump(byte[] code, ushort address, List<(int Offset, int Length)>? removed = null) =>
+        CrossJump(code, offset => (ushort)(address + offset), [], removed);
+
+    /// <summary>
+    /// Cross-jumps code that is not contiguous in PRG_ROM, such as the linked methods with their byte[] values in between
+    /// </summary>
+    /// <param name="getAddress">Address of an offset in the optimized code</param>
+    /// <param name="entries">Offsets called from elsewhere, which a tail cannot extend past</param>
+    public byte[] CrossJump(byte[] code, Func<int, ushort> getAddress, IReadOnlyCollection<int> entries, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.CrossJumping);
+        if (instructions is null)
+            return code;
+
+        var terminators = new List<int>();
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            if (instructions[i].Info.Mnemonic is "RTS" or "JMP")
+                terminators.Add(i);
+        }
+
+        // Each replaced tail is a range of instructions, and the index of the first instruction it jumps to
+        var tails = new List<(int Start, int End, int Target)>();
+        var replaced = new bool[instructions.Count];
+        var targets = new HashSet<int>();
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            if (entries.Contains(instructions[i].Offset))
+                targets.Add(i);
+        }
+        foreach (int end in terminators)
+        {
+            if (replaced[end])
+                continue;
+
+            int bestLength = 0, bestCount = 0, bestTarget = -1;
+            foreach (int other in terminators.Where(t => t > end))
+            {
+                int count = 0, length = 0;
+                while (end - count >= 0 && other - count > end && !replaced[end - count] &&
+                    (count == 0 || !targets.Contains(end - count + 1)) &&
+                    IsSame(code, instructions[end - count], instructions[other - count]))
+                {
+                    length += instructions[end - count].Info.Length;
+                    count++;
+                }
+                if (length >= bestLength && length > 0)
+                {
+                    bestLength = length;
+                    bestCount = count;
+                    bestTarget = other - count + 1;
+                }
+            }
+            if (bestLength < MinTailLength)
+                continue;
+
+            int start = end - bestCount + 1;
+            for (int i = start; i <= end; i++)
+            {
+                replaced[i] = true;
+            }
+            targets.Add(bestTarget);
+            tails.Add((start, end, bestTarget));
+        }
+        if (tails.Count == 0)
+            return code;
+
+        // Where an instruction ends up, once the tails before it are replaced
+        var jmp = NESInstructionInfo.Get(NESInstruction.JMP_abs);
+        int GetNewOffset(int index) =>
+            instructions[index].Offset - tails.Where(t => t.Start < index).Sum(t => instructions[t.End].Offset + instructions[t.End].Info.Length - instructions[t.Start].Offset - jmp.Length);
+
+        var output = new List<byte>(code.Length);
+        int offset = 0;
+        foreach (var (start, end, target) in tails.OrderBy(t => t.Start))
+        {
+            var first = instructions[start];
+            int length = instructions[end].Offset + instructions[end].Info.Length - first.Offset;
+            ushort jumpTo = getAddress(GetNewOffset(target));
+            output.AddRange(code.Skip(offset).Take(first.Offset - offset));
+            output.Add(jmp.Opcode);
+            output.Add((byte)jumpTo);
+            output.Add((byte)(jumpTo >> 8));
+            offset = first.Offset + length;
+
+            BytesSaved += length - jmp.Length;
+            CyclesSaved -= jmp.Cycles;
+            removed?.Add((first.Offset + jmp.Length, length - jmp.Length));
+            _logger.WriteLine($"{nameof(CodeOptimizations.CrossJumping)}: +{first.Offset:X4} {length} bytes => JMP ${jumpTo:X4}, {length - jmp.Length} bytes saved");
+        }
+        output.AddRange(code.Skip(offset));
+        return output.ToArray();
+    }
+
+    static bool IsSame(byte[] code, DecodedInstruction a, DecodedInstruction b) =>
+        a.Info == b.Info && code.AsSpan(a.Offset, a.Info.Length).SequenceEqual(code.AsSpan(b.Offset, b.Info.Length));
+}
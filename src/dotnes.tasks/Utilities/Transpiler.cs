@@ -1,9 +1,14 @@
 ﻿using System.Buffers;
 using System.Collections.Immutable;
+using System.Globalization;
 using System.Reflection;
 using System.Reflection.Metadata;
 using System.Reflection.Metadata.Ecma335;
 using System.Reflection.PortableExecutable;
+using System.Runtime.ExceptionServices;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading.Tasks;
 
 namespace dotnes;
 
@@ -13,6 +18,10 @@ class Transpiler : IDisposable
     readonly MetadataReader _reader;
     readonly IList<AssemblyReader> _assemblyFiles;
     readonly ILogger _logger;
+    readonly MappedImage? _image;
+    readonly string? _path;
+    MethodDefinitionHandle _main;
+    readonly Dictionary<EntityHandle, NESLibBinding?> _callees = new();
 
     public Transpiler(Stream stream, IList<AssemblyReader> assemblyFiles, ILogger? logger = null)
     {
@@ -22,83 +31,314 @@ class Transpiler : IDisposable
         _logger = logger ?? new NullLogger();
     }
 
+    /// <summary>
+    /// Opens the assembly as a memory-mapped file, so the PEReader reads the image in place
+    /// </summary>
+    public unsafe Transpiler(string path, IList<AssemblyReader> assemblyFiles, ILogger? logger = null)
+    {
+        _path = path;
+        _image = new MappedImage(path);
+        _pe = new PEReader(_image.Pointer, _image.Length);
+        _reader = _pe.GetMetadataReader();
+        _assemblyFiles = assemblyFiles;
+        _logger = logger ?? new NullLogger();
+    }
+
+    /// <summary>
+    /// Optional state kept between builds, such as pre-assembled built-ins
+    /// </summary>
+    public BuildCache? Cache { get; set; }
+
+    /// <summary>
+    /// Optional JSON output of the estimated bytes and cycles for each C# statement, uses the PDB if there is one
+    /// </summary>
+    public TextWriter? CostHints { get; set; }
+
+    /// <summary>
+    /// Optional text output of the RAM each part of the program uses, and the worst-case stack depths
+    /// </summary>
+    public TextWriter? RamMap { get; set; }
+
+    /// <summary>
+    /// IL optimization passes run on static void main, none by default
+    /// </summary>
+    public ILOptimizations Optimizations { get; set; }
+
+    /// <summary>
+    /// 6502 optimization passes run on the code of static void main, none by default
+    /// </summary>
+    public CodeOptimizations CodeOptimizations { get; set; }
+
+    /// <summary>
+    /// Optional profile from a previous build, for CodeOptimizations.ZeroPage
+    /// </summary>
+    public NESProfile? Profile { get; set; }
+
+    /// <summary>
+    /// Size versus speed policy, adds its passes to Optimizations and CodeOptimizations.
+    /// [NESOptimization] on static void main overrides it.
+    /// </summary>
+    public NESOptimization Optimization { get; set; }
+
+    /// <summary>
+    /// Built-ins to copy to RAM and call there, in addition to [RunFromRam] on static void main
+    /// </summary>
+    public ICollection<string>? RunFromRam { get; set; }
+
+    /// <summary>
+    /// Precompiled class libraries, linked after the destructor table so static void main can call their methods
+    /// </summary>
+    public IReadOnlyList<NESObject> Objects { get; set; } = [];
+
+    /// <summary>
+    /// Project assemblies static void main can call into, transpiled with it as one program.
+    /// They are disposed by the caller, which opened them.
+    /// </summary>
+    public IList<Transpiler> References { get; set; } = [];
+
+    /// <summary>
+    /// rand8 reads a 256-byte table generated when the ROM is built, instead of stepping the LFSRs of neslib
+    /// </summary>
+    public bool RandomTable { get; set; }
+
+    /// <summary>
+    /// Enums are stored in the fewest bytes that hold their declared members, instead of their underlying type.
+    /// A value outside of the members cast to the enum, such as `(Color)300`, is then truncated.
+    /// </summary>
+    public bool NarrowEnums { get; set; }
+
+    /// <summary>
+    /// Objects of the built-in routines outside of the cc65 runtime, linked after the Objects that are called
+    /// </summary>
+    IEnumerable<NESObject> BuiltInObjects => [Digits.Object, RandomTable ? Rand.Lookup : Rand.Lfsr, PaletteFade.Object];
+
+    /// <summary>
+    /// Last of the built-ins after static void main, where the string and byte[] tables start
+    /// </summary>
+    const ushort PRG_LAST = 0x85AE;
+    /// <summary>
+    /// Length of NESWriter.WriteDestructorTable, between the tables and the linked objects
+    /// </summary>
+    const int DestructorTableLength = 37;
+    /// <summary>
+    /// Size of main a library method is written at a second time, operands that move with it need relocations
+    /// </summary>
+    const ushort RelocationProbe = 0x0101;
+
+    /// <summary>
+    /// CodeOptimizations and the passes of the NESOptimization in effect, set by Write
+    /// </summary>
+    CodeOptimizations _codeOptimizations;
+    int _minTailLength = TailCallOptimizer.DefaultMinTailLength;
+    /// <summary>
+    /// Where each [RunFromRam] built-in runs, set by Write
+    /// </summary>
+    Dictionary<string, ushort> _ramAddresses = [];
+    /// <summary>
+    /// Lengths of the byte[] and string tables, which decide where methods and Objects are linked, set by Write
+    /// </summary>
+    int _byteArraysLength, _stringTableLength;
+    /// <summary>
+    /// Literal parts and formats of the interpolated strings LowerInterpolation lowered, which need no entry in the string table
+    /// </summary>
+    readonly HashSet<string> _interpolationStrings = [];
+    /// <summary>
+    /// Strings left out of the string table, only used by lowered interpolated strings, set by Write
+    /// </summary>
+    HashSet<string> _unusedStrings = [];
+    /// <summary>
+    /// Methods of the program static void main calls, and the lengths of their code and byte[] values, set by Write
+    /// </summary>
+    List<(string Name, ILInstruction[] Instructions)> _methods = [];
+    List<(int Code, int Data)> _methodLengths = [];
+    /// <summary>
+    /// Methods linked at the address of another method with the same code, by name, set by Write
+    /// </summary>
+    Dictionary<string, string> _shared = [];
+    /// <summary>
+    /// The Objects and BuiltInObjects static void main calls, set by Write
+    /// </summary>
+    List<NESObject> _objects = [];
+    /// <summary>
+    /// Static void methods without parameters in this assembly, by full name
+    /// </summary>
+    Dictionary<string, MethodDefinitionHandle>? _programMethods;
+    /// <summary>
+    /// Sizes of the enums in this assembly, by full name: of the underlying type, and of the fewest bytes that hold the members
+    /// </summary>
+    Dictionary<string, (int Size, int Narrowed)>? _enumSizes;
+    /// <summary>
+    /// Enums stored narrowed with NarrowEnums, each is logged once
+    /// </summary>
+    readonly HashSet<string> _narrowedEnums = new(StringComparer.Ordinal);
+    /// <summary>
+    /// Generic methods, and methods of generic types, called from this assembly with concrete type arguments,
+    /// by name such as `Engine.Pool<byte>.Clear`
+    /// </summary>
+    readonly Dictionary<string, Instantiation> _instantiations = new(StringComparer.Ordinal);
+    /// <summary>
+    /// Interface methods with a body, called when the type of a constrained call does not implement them, by the name of the call
+    /// </summary>
+    readonly Dictionary<string, string> _defaultImplementations = new(StringComparer.Ordinal);
+    TypeNameDecoder? _decoder;
+
+    /// <param name="Definition">Full name of the generic definition in metadata, such as `Engine.Pool`1.Clear`</param>
+    record Instantiation(string Definition, GenericContext Context);
+
     public void Write(Stream stream)
     {
         if (_assemblyFiles.Count == 0)
             throw new InvalidOperationException("At least one 'chr_generic.s' file must be present!");
 
         var assemblyReader = _assemblyFiles.FirstOrDefault(a => Path.GetFileName(a.Path) == "chr_generic.s") ?? _assemblyFiles[0];
-        var chr_rom = assemblyReader.GetSegments().FirstOrDefault(s => s.Name == "CHARS") ??
+        var segments = Cache?.GetSegments(assemblyReader) ?? assemblyReader.GetSegments();
+        var chr_rom = segments.FirstOrDefault(s => s.Name == "CHARS") ??
             throw new InvalidOperationException($"At least one 'CHARS' segment must be present in: {assemblyReader.Path}");
         int CHR_ROM_SIZE = (int)(chr_rom.Bytes.Length / NESWriter.CHR_ROM_BLOCK_SIZE);
 
-        _logger.WriteLine($"First pass...");
-
-        // Generate static void main in a first pass, so we know the size of the program
-        ushort sizeOfMain;
-        byte locals;
-        using (var mainWriter = new IL2NESWriter(new MemoryStream(), logger: _logger))
+        // Decode static void main once, both passes below reuse the same instructions.
+        // NOTE: this also reads all RVA field data, so the PEReader is not touched from other threads.
+        var main = ReadStaticVoidMain().ToArray();
+        var optimization = GetOptimization();
+        if (optimization != NESOptimization.None)
+            _logger.WriteLine($"Optimizing for: {optimization}");
+        var optimizations = Optimizations | optimization.GetILOptimizations();
+        _codeOptimizations = CodeOptimizations | optimization.GetCodeOptimizations();
+        _minTailLength = optimization.GetMinTailLength();
+        _ramAddresses = NESWriter.GetRamAddresses(GetRunFromRam());
+        foreach (var pair in _ramAddresses)
+        {
+            _logger.WriteLine($"Running {pair.Key} from RAM: ${pair.Value:X4}");
+        }
+        var graph = new CallGraph(main, ReadProgramMethod, _logger);
+        if ((optimizations & ILOptimizations.Inlining) != 0)
+        {
+            graph.Inline();
+            _logger.WriteLine($"{nameof(ILOptimizations.Inlining)}: {graph.Inlined} calls");
+        }
+        main = graph.Main;
+        _methods = graph.Methods;
+        if (optimizations != ILOptimizations.None)
         {
-            foreach (var instruction in ReadStaticVoidMain())
+            _logger.WriteLine($"Optimizing IL: {optimizations}");
+            main = new ILOptimizer(_logger).Optimize(main, optimizations);
+            for (int i = 0; i < _methods.Count; i++)
             {
-                _logger.WriteLine($"{instruction}");
-
-                if (instruction.Integer != null)
-                {
-                    mainWriter.Write(instruction.OpCode, instruction.Integer.Value, sizeOfMain: 0);
-                }
-                else if (instruction.String != null)
-                {
-                    mainWriter.Write(instruction.OpCode, instruction.String, sizeOfMain: 0);
-                }
-                else if (instruction.Bytes != null)
-                {
-                    mainWriter.Write(instruction.OpCode, instruction.Bytes.Value, sizeOfMain: 0);
-                }
-                else
-                {
-                    mainWriter.Write(instruction.OpCode, sizeOfMain: 0);
-                }
+                _methods[i] = (_methods[i].Name, new ILOptimizer(_logger).Optimize(_methods[i].Instructions, optimizations));
             }
-            mainWriter.Flush();
-            sizeOfMain = checked((ushort)mainWriter.BaseStream.Length);
-            locals = checked((byte)mainWriter.LocalCount);
         }
+        _shared = ShareCode(_methods);
+        _objects = Objects.Concat(BuiltInObjects).Where(o => graph.External.Any(o.Contains)).ToList();
+        foreach (var name in graph.External)
+        {
+            if (!_objects.Any(o => o.Symbols.Any(s => s.Name == name)))
+                throw new NotImplementedException($"{name} is not implemented!");
+        }
+        foreach (var (name, _) in _methods)
+        {
+            _logger.WriteLine($"Linking method: {name}");
+        }
+        foreach (var pair in _shared)
+        {
+            _logger.WriteLine($"Linking method: {pair.Key}, same code as {pair.Value}");
+        }
+        int notCalled = Objects.Count(o => !_objects.Contains(o));
+        if (notCalled > 0)
+            _logger.WriteLine($"Objects not called: {notCalled}");
+        var strings = main.Concat(_methods.SelectMany(m => m.Instructions)).Where(i => i.OpCode == ILOpCode.Ldstr && i.Bytes is null).Select(i => i.String!);
+        _unusedStrings = new HashSet<string>(_interpolationStrings.Except(strings));
+        // Every ldtoken adds its byte[] to the table, as do the literal tiles of interpolated strings, so its length is known before main is written
+        _byteArraysLength = main.Where(i => i.OpCode is ILOpCode.Ldtoken or ILOpCode.Ldstr && i.Bytes is not null).Sum(i => i.Bytes!.Value.Length);
+        _stringTableLength = 0;
 
-        _logger.WriteLine($"Size of main: {sizeOfMain}");
+        // The size of a method does not depend on where it is linked, write each once to lay them out
+        _methodLengths = _methods.Select(_ => (0, 0)).ToList();
+        for (int i = 0; i < _methods.Count; i++)
+        {
+            var code = WriteMethod(_methods[i].Instructions, sizeOfMain: 0, out var arrays);
+            _methodLengths[i] = (code.Length, arrays.Length);
+        }
+
+        _logger.WriteLine($"First pass...");
 
-        using var writer = new IL2NESWriter(stream, logger: _logger);
+        // Generate static void main in a first pass, so we know the size of the program
+        // The C# string table does not depend on sizeOfMain, so it is encoded at the same time
+        ushort sizeOfMain = 0;
+        byte locals = 0;
+        byte[] stringTable = [];
+        var firstPassLog = new BufferedLogger(_logger);
+        var stringTableLog = new BufferedLogger(_logger);
+        WriteSections(
+            (() =>
+            {
+                using var mainWriter = new IL2NESWriter(new MemoryStream(), logger: firstPassLog);
+                WriteMain(mainWriter, main, sizeOfMain: 0, firstPassLog);
+                mainWriter.Flush();
+                sizeOfMain = checked((ushort)mainWriter.BaseStream.Length);
+                locals = checked((byte)mainWriter.LocalCount);
+            }, firstPassLog),
+            (() => stringTable = WriteStringTable(stringTableLog), stringTableLog));
+        _stringTableLength = stringTable.Length;
 
-        _logger.WriteLine($"Writing header...");
-        writer.WriteHeader(PRG_ROM_SIZE: 2, CHR_ROM_SIZE: 1);
-        _logger.WriteLine($"Writing built-ins...");
-        writer.WriteBuiltIns(sizeOfMain);
+        if (_codeOptimizations != CodeOptimizations.None)
+        {
+            _logger.WriteLine($"Optimizing 6502 code: {_codeOptimizations}");
+            sizeOfMain = GetOptimizedSizeOfMain(main, sizeOfMain);
+        }
 
-        _logger.WriteLine($"Second pass...");
+        _logger.WriteLine($"Size of main: {sizeOfMain}");
+        var methods = WriteMethods(sizeOfMain);
 
-        // Write static void main *again*, second pass
-        // With a known value for sizeOfMain
-        foreach (var instruction in ReadStaticVoidMain())
+        // Each section logs to its own buffer while they are written in parallel
+        var builtInLog = new BufferedLogger(_logger);
+        var secondPassLog = new BufferedLogger(_logger);
+        using var writer = new IL2NESWriter(stream, logger: builtInLog);
+        using var mainSection = new IL2NESWriter(new MemoryStream(), logger: secondPassLog);
+        var costs = CostHints is null ? null : new CostEstimator(main);
+        if ((_codeOptimizations & CodeOptimizations.Boot) != 0)
         {
-            _logger.WriteLine($"{instruction}");
+            writer.Boot = GetBootProgram(graph.Instructions, _objects, locals);
+            _logger.WriteLine($"{nameof(CodeOptimizations.Boot)}: clearing RAM pages $00{(writer.Boot.Fade ? ", $01" : "")}, $03-${writer.Boot.LastPage:X2}, NTSC detection: {writer.Boot.DetectNTSC}");
+        }
 
-            if (instruction.Integer != null)
-            {
-                writer.Write(instruction.OpCode, instruction.Integer.Value, sizeOfMain);
-            }
-            else if (instruction.String != null)
-            {
-                writer.Write(instruction.OpCode, instruction.String, sizeOfMain);
-            }
-            else if (instruction.Bytes != null)
+        // Built-ins and static void main *again* (second pass) are independent sections,
+        // now that sizeOfMain is known they can be written at the same time
+        WriteSections(
+            (() =>
             {
-                writer.Write(instruction.OpCode, instruction.Bytes.Value, sizeOfMain);
-            }
-            else
+                builtInLog.WriteLine($"Writing header...");
+                writer.WriteHeader(PRG_ROM_SIZE: 2, CHR_ROM_SIZE: 1);
+                builtInLog.WriteLine($"Writing built-ins...");
+                // The cache only has the built-ins of the full startup
+                if (Cache is null || writer.Boot is not null)
+                {
+                    writer.WriteBuiltIns(sizeOfMain);
+                }
+                else
+                {
+                    writer.Write(Cache.GetBuiltIns(sizeOfMain, size => WriteBuiltIns(size, builtInLog)));
+                }
+            }, builtInLog),
+            (() =>
             {
-                writer.Write(instruction.OpCode, sizeOfMain);
-            }
-        }
+                secondPassLog.WriteLine($"Second pass...");
+                WriteMain(mainSection, main, sizeOfMain, secondPassLog, costs);
+                mainSection.Flush();
+                if (_codeOptimizations != CodeOptimizations.None)
+                {
+                    var code = OptimizeMain(((MemoryStream)mainSection.BaseStream).ToArray(), sizeOfMain, secondPassLog, costs);
+                    if (code.Length != sizeOfMain)
+                        throw new InvalidOperationException($"Optimized static void main is {code.Length} bytes, expected {sizeOfMain}!");
+                    mainSection.BaseStream.SetLength(0);
+                    mainSection.Write(code);
+                    mainSection.Flush();
+                }
+            }, secondPassLog));
+
+        // Link the sections in a fixed order, so the ROM is the same regardless of thread timing
+        _logger.WriteLine($"Linking static void main...");
+        mainSection.BaseStream.Position = 0;
+        mainSection.BaseStream.CopyTo(writer.BaseStream);
 
         // NOTE: not sure if string or byte[] is first
         _logger.WriteLine($"Writing string/byte[] table...");
@@ -107,27 +347,12 @@ class Transpiler : IDisposable
             using (var tableWriter = new IL2NESWriter(memoryStream, leaveOpen: true, logger: _logger))
             {
                 // Write byte[] table
-                tableWriter.WriteByteArrays(writer);
+                tableWriter.WriteByteArrays(mainSection);
 
                 // Write C# string table
-                int stringHeapSize = _reader.GetHeapSize(HeapIndex.UserString);
-                if (stringHeapSize > 0)
-                {
-                    var handle = MetadataTokens.UserStringHandle(0);
-                    do
-                    {
-                        string value = _reader.GetUserString(handle);
-                        if (!string.IsNullOrEmpty(value))
-                        {
-                            tableWriter.WriteString(value);
-                        }
-                        handle = _reader.GetNextHandle(handle);
-                    }
-                    while (!handle.IsNil);
-                }
+                tableWriter.Write(stringTable);
             }
 
-            const ushort PRG_LAST = 0x85AE;
             writer.WriteFinalBuiltIns((ushort)(PRG_LAST.GetAddressAfterMain(sizeOfMain) + memoryStream.Length), locals);
             memoryStream.Position = 0;
             memoryStream.CopyTo(writer.BaseStream);
@@ -136,13 +361,45 @@ class Transpiler : IDisposable
         _logger.WriteLine($"Destructor table...");
         writer.WriteDestructorTable();
 
+        if (_methods.Count > 0 || _objects.Count > 0)
+        {
+            _logger.WriteLine($"Linking methods and objects...");
+            ushort address = GetLinkAddress(sizeOfMain);
+            if (writer.Length - 16 + 0x8000 != address)
+                throw new InvalidOperationException($"Methods are linked at ${address:X4}, but the destructor table ends at ${writer.Length - 16 + 0x8000:X4}!");
+            foreach (var (code, arrays) in methods)
+            {
+                writer.Write(code);
+                writer.Write(arrays);
+                address = (ushort)(address + code.Length + arrays.Length);
+            }
+            foreach (var obj in _objects)
+            {
+                writer.Write(obj.Link(address, sizeOfMain));
+                address = (ushort)(address + obj.Length);
+            }
+        }
+
         // Pad 0s
         int PRG_ROM_SIZE = (int)writer.Length - 16;
         writer.WriteZeroes(NESWriter.PRG_ROM_BLOCK_SIZE - (PRG_ROM_SIZE % NESWriter.PRG_ROM_BLOCK_SIZE));
 
-        // Write interrupt vectors
+        // Write interrupt vectors, after the code copied to RAM
         const int VECTOR_ADDRESSES_SIZE = 6;
-        writer.WriteZeroes(NESWriter.PRG_ROM_BLOCK_SIZE - VECTOR_ADDRESSES_SIZE);
+        if (_ramAddresses.Count > 0)
+        {
+            using var memoryStream = new MemoryStream();
+            using (var ramWriter = new NESWriter(memoryStream, leaveOpen: true, logger: _logger))
+            {
+                ramWriter.WriteRamBuiltIns(_ramAddresses, sizeOfMain);
+            }
+            writer.WriteZeroes(NESWriter.PRG_ROM_BLOCK_SIZE - VECTOR_ADDRESSES_SIZE - memoryStream.Length);
+            writer.Write(memoryStream.ToArray());
+        }
+        else
+        {
+            writer.WriteZeroes(NESWriter.PRG_ROM_BLOCK_SIZE - VECTOR_ADDRESSES_SIZE);
+        }
         ushort nmi_data = 0x80BC;
         ushort reset_data = 0x8000;
         ushort irq_data = 0x8202;
@@ -167,120 +424,1334 @@ class Transpiler : IDisposable
             }
         }
         writer.Flush();
+
+        _logger.WriteLine($"Checking RAM budget...");
+        var prg = ReadPRG(stream);
+        var budget = new RamBudget(prg, ((MemoryStream)mainSection.BaseStream).ToArray(), locals,
+            NESWriter.GetRamCode(_ramAddresses, sizeOfMain), NESWriter.GetFinalBuiltInAddresses(sizeOfMain), _objects.Contains(PaletteFade.Object));
+        _logger.WriteLine($"{budget}");
+        RamMap?.Write(budget.ToString());
+        if (_methods.Count > 0 || _objects.Count > 0)
+        {
+            var romMap = GetRomMap(sizeOfMain);
+            _logger.WriteLine($"{romMap}");
+            RamMap?.Write(romMap);
+        }
+        if (budget.Overflows.Any())
+            throw new InvalidOperationException($"Program does not fit in RAM: {string.Join(", ", budget.Overflows.Select(r => $"{r.Name} needs {r.Used} of {r.Size} bytes"))}{Environment.NewLine}{budget}");
+
+        if (CostHints is not null && costs is not null)
+        {
+            _logger.WriteLine($"Writing cost hints...");
+            costs.Write(CostHints, ((MemoryStream)mainSection.BaseStream).ToArray(), prg, ReadStatements(), NESWriter.GetFinalBuiltInAddresses(sizeOfMain));
+        }
     }
 
     /// <summary>
-    /// Based on: https://github.com/icsharpcode/ILSpy/blob/8c508d9bbbc6a21cc244e930122ff5bca19cd11c/ILSpy/Analyzers/Builtin/MethodUsesAnalyzer.cs#L51
+    /// What the reset path needs for CodeOptimizations.Boot: the pages of RAM up to the last local,
+    /// NTSC detection only if ppu_system or ppu_wait_frame read it, from the program or a linked object, and page 1 if NES.Fade keeps its state there
     /// </summary>
-    public IEnumerable<ILInstruction> ReadStaticVoidMain()
+    static NESWriter.BootProgram GetBootProgram(IEnumerable<ILInstruction> program, IReadOnlyList<NESObject> objects, byte locals)
     {
-        var arrayValues = GetArrayValues(_reader);
+        byte lastPage = (byte)((IL2NESWriter.local + locals) >> 8);
+        string[] readers = [nameof(NESLib.ppu_system), nameof(NESLib.ppu_wait_frame)];
+        bool detectNTSC = program.Any(i => i.OpCode == ILOpCode.Call && readers.Contains(i.String)) ||
+            objects.Any(o => readers.Any(name => o.Calls(NESLibBinding.Get(name).Address)));
+        return new NESWriter.BootProgram(lastPage, detectNTSC, objects.Contains(PaletteFade.Object));
+    }
 
-        foreach (var h in _reader.MethodDefinitions)
+    /// <summary>
+    /// Reads PRG_ROM back from the output, so the cost of each built-in can be estimated
+    /// </summary>
+    static byte[]? ReadPRG(Stream stream)
+    {
+        if (!stream.CanSeek || !stream.CanRead)
+            return null;
+
+        const int HEADER_SIZE = 16;
+        long end = stream.Position;
+        var prg = new byte[2 * NESWriter.PRG_ROM_BLOCK_SIZE];
+        stream.Position = HEADER_SIZE;
+        int read = 0, count;
+        while (read < prg.Length && (count = stream.Read(prg, read, prg.Length - read)) > 0)
         {
-            var mainMethod = _reader.GetMethodDefinition(h);
-            if ((mainMethod.Attributes & MethodAttributes.Static) == 0)
+            read += count;
+        }
+        stream.Position = end;
+        return prg;
+    }
+
+    /// <summary>
+    /// [NESOptimization] on static void main, or Optimization. The attribute blob is the prolog then the enum as an Int32.
+    /// </summary>
+    NESOptimization GetOptimization()
+    {
+        foreach (var blob in GetMainAttributes(nameof(NESOptimizationAttribute)))
+        {
+            var optimization = (NESOptimization)blob.ReadInt32();
+            if (!Enum.IsDefined(typeof(NESOptimization), optimization))
+                throw new NotImplementedException($"[NESOptimization({(int)optimization})] is not implemented!");
+            return optimization;
+        }
+        return Optimization;
+    }
+
+    /// <summary>
+    /// Names of the built-ins in [RunFromRam] on static void main, and RunFromRam
+    /// </summary>
+    List<string> GetRunFromRam()
+    {
+        var names = new List<string>();
+        if (RunFromRam is not null)
+            names.AddRange(RunFromRam);
+        foreach (var blob in GetMainAttributes(nameof(RunFromRamAttribute)))
+        {
+            var name = blob.ReadSerializedString() ??
+                throw new InvalidOperationException($"[RunFromRam] needs the name of a built-in!");
+            if (!names.Contains(name))
+                names.Add(name);
+        }
+        return names;
+    }
+
+    /// <summary>
+    /// The custom attributes of a type on static void main, each blob is positioned after its prolog
+    /// </summary>
+    IEnumerable<BlobReader> GetMainAttributes(string attributeName)
+    {
+        if (_main.IsNil)
+            yield break;
+
+        foreach (var handle in _reader.GetMethodDefinition(_main).GetCustomAttributes())
+        {
+            var attribute = _reader.GetCustomAttribute(handle);
+            var type = attribute.Constructor.Kind switch
+            {
+                HandleKind.MemberReference => _reader.GetMemberReference((MemberReferenceHandle)attribute.Constructor).Parent,
+                HandleKind.MethodDefinition => _reader.GetMethodDefinition((MethodDefinitionHandle)attribute.Constructor).GetDeclaringType(),
+                _ => default,
+            };
+            var name = type.Kind switch
+            {
+                HandleKind.TypeReference => _reader.GetString(_reader.GetTypeReference((TypeReferenceHandle)type).Name),
+                HandleKind.TypeDefinition => _reader.GetString(_reader.GetTypeDefinition((TypeDefinitionHandle)type).Name),
+                _ => null,
+            };
+            if (name != attributeName)
                 continue;
 
-            var mainMethodName = _reader.GetString(mainMethod.Name);
-            if (mainMethodName == "Main" || mainMethodName == "<Main>$")
+            var blob = _reader.GetBlobReader(attribute.Value);
+            blob.ReadUInt16();
+            yield return blob;
+        }
+    }
+
+    /// <summary>
+    /// Reads the sequence points of static void main from a PDB next to the assembly, or embedded in it
+    /// </summary>
+    List<CostEstimator.Statement>? ReadStatements()
+    {
+        MetadataReaderProvider? provider = null;
+        if (_path is not null)
+        {
+            _pe.TryOpenAssociatedPortablePdb(_path, p => File.Exists(p) ? File.OpenRead(p) : null, out provider, out _);
+        }
+        else
+        {
+            var entry = _pe.ReadDebugDirectory().FirstOrDefault(e => e.Type == DebugDirectoryEntryType.EmbeddedPortablePdb);
+            if (entry.Type == DebugDirectoryEntryType.EmbeddedPortablePdb)
+                provider = _pe.ReadEmbeddedPortablePdbDebugDirectoryData(entry);
+        }
+        if (provider is null || _main.IsNil)
+        {
+            _logger.WriteLine($"No PDB found, cost hints are per IL instruction");
+            return null;
+        }
+
+        using (provider)
+        {
+            var pdb = provider.GetMetadataReader();
+            var statements = new List<CostEstimator.Statement>();
+            foreach (var point in pdb.GetMethodDebugInformation(_main).GetSequencePoints())
+            {
+                if (point.IsHidden)
+                    continue;
+                var document = pdb.GetString(pdb.GetDocument(point.Document).Name);
+                statements.Add(new CostEstimator.Statement(point.Offset, document, point.StartLine, point.StartColumn, point.EndLine, point.EndColumn));
+            }
+            return statements;
+        }
+    }
+
+    /// <summary>
+    /// Optimized code is smaller, which moves the built-ins and byte[] tables after it, and in turn
+    /// changes the addresses main refers to. Repeat the first pass until the size settles.
+    /// </summary>
+    ushort GetOptimizedSizeOfMain(ILInstruction[] main, ushort sizeOfMain)
+    {
+        const int MaxPasses = 8;
+        for (int pass = 0; pass < MaxPasses; pass++)
+        {
+            using var mainWriter = new IL2NESWriter(new MemoryStream(), logger: _logger);
+            WriteMain(mainWriter, main, sizeOfMain, _logger);
+            mainWriter.Flush();
+            var code = OptimizeMain(((MemoryStream)mainWriter.BaseStream).ToArray(), sizeOfMain, new NullLogger());
+            if (code.Length == sizeOfMain)
+                return sizeOfMain;
+            sizeOfMain = checked((ushort)code.Length);
+        }
+        throw new InvalidOperationException($"Size of optimized static void main did not settle after {MaxPasses} passes!");
+    }
+
+    /// <summary>
+    /// Writes the linked methods, with the TailCalls and CrossJumping passes over their code.
+    /// A shorter method moves the methods after it, so the layout is repeated until the lengths settle, like the size of main.
+    /// </summary>
+    List<(byte[] Code, byte[] Arrays)> WriteMethods(ushort sizeOfMain)
+    {
+        const int MaxPasses = 8;
+        for (int pass = 0; pass < MaxPasses; pass++)
+        {
+            var methods = new List<(byte[] Code, byte[] Arrays)>(_methods.Count);
+            ushort address = GetLinkAddress(sizeOfMain);
+            for (int i = 0; i < _methods.Count; i++)
+            {
+                var (code, data) = _methodLengths[i];
+                methods.Add((WriteMethod(_methods[i].Instructions, sizeOfMain, out var arrays, byteArrayOffset: (ushort)(address + code)), arrays));
+                address = (ushort)(address + code + data);
+            }
+            OptimizeMethods(methods, sizeOfMain);
+
+            var lengths = methods.Select(m => (m.Code.Length, m.Arrays.Length)).ToList();
+            if (lengths.SequenceEqual(_methodLengths))
+                return methods;
+            _methodLengths = lengths;
+        }
+        throw new InvalidOperationException($"Size of the linked methods did not settle after {MaxPasses} passes!");
+    }
+
+    /// <summary>
+    /// Methods end in RTS, so their tails are where `JSR f; RTS` and tails shared between routines occur.
+    /// The methods are cross-jumped as one block, assuming the layout in _methodLengths.
+    /// </summary>
+    void OptimizeMethods(List<(byte[] Code, byte[] Arrays)> methods, ushort sizeOfMain)
+    {
+        if ((_codeOptimizations & CodeOptimizations.TailCalls) != 0)
+        {
+            var optimizer = new TailCallOptimizer(_logger);
+            for (int i = 0; i < methods.Count; i++)
+            {
+                methods[i] = (optimizer.TailCalls(methods[i].Code), methods[i].Arrays);
+            }
+            _logger.WriteLine($"{nameof(CodeOptimizations.TailCalls)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved in linked methods");
+        }
+        if ((_codeOptimizations & CodeOptimizations.CrossJumping) != 0 && methods.Count > 1)
+        {
+            var entries = new List<int>();
+            var code = new List<byte>();
+            foreach (var method in methods)
             {
-                var body = _pe.GetMethodBody(mainMethod.RelativeVirtualAddress);
-                var blob = body.GetILReader();
+                entries.Add(code.Count);
+                code.AddRange(method.Code);
+            }
 
-                while (blob.RemainingBytes > 0)
+            // An offset in the block is in the method that starts before it, after the byte[] values of the methods before that
+            ushort linkAddress = GetLinkAddress(sizeOfMain);
+            ushort GetAddress(int offset)
+            {
+                int data = 0;
+                for (int i = 0; i < _methodLengths.Count - 1 && offset >= _methodLengths[i].Code; i++)
                 {
-                    ILOpCode opCode = DecodeOpCode(ref blob);
+                    offset -= _methodLengths[i].Code;
+                    data += _methodLengths[i].Code + _methodLengths[i].Data;
+                }
+                return (ushort)(linkAddress + data + offset);
+            }
 
-                    OperandType operandType = GetOperandType(opCode);
-                    string? stringValue = null;
-                    int? intValue = null;
-                    ImmutableArray<byte>? byteValue = null;
+            var optimizer = new TailCallOptimizer(_logger) { MinTailLength = _minTailLength };
+            var removed = new List<(int Offset, int Length)>();
+            var output = optimizer.CrossJump(code.ToArray(), GetAddress, entries, removed);
+            _logger.WriteLine($"{nameof(CodeOptimizations.CrossJumping)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved in linked methods");
 
-                    switch (operandType)
-                    {
-                        case OperandType.Field:
-                        case OperandType.Method:
-                        case OperandType.Sig:
-                        case OperandType.Tok:
-                            var entity = MetadataTokens.EntityHandle(blob.ReadInt32());
-                            if (entity.IsNil)
-                                continue;
+            // Each removed range is inside one method, as a tail does not extend past the start of a method
+            int start = 0;
+            for (int i = 0; i < methods.Count; i++)
+            {
+                int end = entries[i] + methods[i].Code.Length;
+                int length = methods[i].Code.Length - removed.Where(r => r.Offset >= entries[i] && r.Offset < end).Sum(r => r.Length);
+                methods[i] = (output[start..(start + length)], methods[i].Arrays);
+                start += length;
+            }
+        }
+    }
 
-                            switch (entity.Kind)
-                            {
-                                case HandleKind.TypeDefinition:
-                                    stringValue = _reader.GetString(_reader.GetTypeDefinition((TypeDefinitionHandle)entity).Name);
-                                    break;
-                                case HandleKind.TypeReference:
-                                    stringValue = _reader.GetString(_reader.GetTypeReference((TypeReferenceHandle)entity).Name);
-                                    break;
-                                case HandleKind.MethodDefinition:
-                                    var method = _reader.GetMethodDefinition((MethodDefinitionHandle)entity);
-                                    stringValue = _reader.GetString(method.Name);
-                                    break;
-                                case HandleKind.MemberReference:
-                                    var member = _reader.GetMemberReference((MemberReferenceHandle)entity);
-                                    stringValue = _reader.GetString(member.Name);
-                                    if (stringValue == "InitializeArray")
-                                    {
-                                        // HACK: skip for now
-                                        continue;
-                                    }
-                                    break;
-                                case HandleKind.FieldDefinition:
-                                    var field = _reader.GetFieldDefinition((FieldDefinitionHandle)entity);
-                                    var fieldName = _reader.GetString(field.Name);
-                                    if ((field.Attributes & FieldAttributes.HasFieldRVA) != 0)
-                                    {
-                                        if (arrayValues.TryGetValue (fieldName, out var value))
-                                        {
-                                            byteValue = value.Value;
-                                            break;
-                                        }
-                                    }
-                                    throw new NotImplementedException($"Reading fields like {fieldName} is not implemented!");
-                            }
+    /// <summary>
+    /// Runs the 6502 optimization passes over the code of static void main
+    /// </summary>
+    /// <param name="costs">Cost hints to update for each byte removed, if needed</param>
+    byte[] OptimizeMain(byte[] code, ushort sizeOfMain, ILogger logger, CostEstimator? costs = null)
+    {
+        var removed = new List<(int Offset, int Length)>();
+        if ((_codeOptimizations & CodeOptimizations.ZeroPage) != 0 && Profile is not null)
+        {
+            var optimizer = new ZeroPageOptimizer(logger);
+            code = optimizer.Optimize(code, Profile, removed);
+            logger.WriteLine($"{nameof(CodeOptimizations.ZeroPage)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved");
+            Remove(costs, removed);
+        }
+        if ((_codeOptimizations & CodeOptimizations.Registers) != 0)
+        {
+            var optimizer = new RegisterOptimizer(logger);
+            code = optimizer.Optimize(code, BuiltInEffects.GetAddresses(sizeOfMain), removed);
+            logger.WriteLine($"{nameof(CodeOptimizations.Registers)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved");
+            Remove(costs, removed);
+        }
+        if ((_codeOptimizations & CodeOptimizations.Peephole) != 0)
+        {
+            var optimizer = new PeepholeOptimizer(logger);
+            code = optimizer.Optimize(code, removed);
+            logger.WriteLine($"{nameof(CodeOptimizations.Peephole)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved");
+            Remove(costs, removed);
+        }
+        if ((_codeOptimizations & CodeOptimizations.TailCalls) != 0)
+        {
+            var optimizer = new TailCallOptimizer(logger);
+            code = optimizer.TailCalls(code, removed);
+            logger.WriteLine($"{nameof(CodeOptimizations.TailCalls)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved");
+            Remove(costs, removed);
+        }
+        if ((_codeOptimizations & CodeOptimizations.CrossJumping) != 0)
+        {
+            var optimizer = new TailCallOptimizer(logger) { MinTailLength = _minTailLength };
+            code = optimizer.CrossJump(code, NESWriter.main, removed);
+            logger.WriteLine($"{nameof(CodeOptimizations.CrossJumping)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved");
+            Remove(costs, removed);
+        }
+        // Last, so the addresses logged for each unofficial opcode are final
+        if ((_codeOptimizations & CodeOptimizations.Unofficial) != 0)
+        {
+            var optimizer = new UnofficialOptimizer(logger);
+            code = optimizer.Optimize(code, removed);
+            logger.WriteLine($"{nameof(CodeOptimizations.Unofficial)}: {optimizer.BytesSaved} bytes, {optimizer.CyclesSaved} cycles saved");
+            foreach (var (offset, instruction) in optimizer.Uses)
+            {
+                logger.WriteLine($"{nameof(CodeOptimizations.Unofficial)}: ${NESWriter.main + offset:X4} {instruction}");
+            }
+            Remove(costs, removed);
+        }
+        return code;
+    }
+
+    /// <summary>
+    /// Each pass reports offsets in its own input, so they are applied before the next pass
+    /// </summary>
+    static void Remove(CostEstimator? costs, List<(int Offset, int Length)> removed)
+    {
+        foreach (var (offset, length) in removed.OrderByDescending(r => r.Offset))
+        {
+            costs?.Remove(offset, length);
+        }
+        removed.Clear();
+    }
+
+    /// <summary>
+    /// Writes independent sections at the same time, then logs what each section logged, in order.
+    /// An exception of a section is thrown as is, as if the sections were written one after the other.
+    /// </summary>
+    static void WriteSections(params (Action Write, BufferedLogger Log)[] sections)
+    {
+        try
+        {
+            Parallel.Invoke(sections.Select(s => s.Write).ToArray());
+        }
+        catch (AggregateException ex)
+        {
+            ExceptionDispatchInfo.Capture(ex.InnerExceptions[0]).Throw();
+        }
+        finally
+        {
+            foreach (var section in sections)
+            {
+                section.Log.Flush();
+            }
+        }
+    }
+
+    /// <summary>
+    /// Writes the instructions of static void main, used for both passes
+    /// </summary>
+    void WriteMain(IL2NESWriter writer, ILInstruction[] instructions, ushort sizeOfMain, ILogger logger, CostEstimator? costs = null)
+    {
+        if (_ramAddresses.Count > 0)
+        {
+            writer.Write(NESInstruction.JSR, NESWriter.GetCopyRamAddress(_ramAddresses));
+        }
+        WriteInstructions(writer, instructions, sizeOfMain, logger, costs);
+    }
+
+    /// <summary>
+    /// Writes the instructions of static void main or of a method
+    /// </summary>
+    void WriteInstructions(IL2NESWriter writer, ILInstruction[] instructions, ushort sizeOfMain, ILogger logger, CostEstimator? costs = null)
+    {
+        if (_ramAddresses.Count > 0)
+        {
+            writer.RamAddresses = _ramAddresses;
+        }
+        if (_methods.Count > 0 || _objects.Count > 0)
+        {
+            writer.LinkedAddresses = GetLinkedAddresses(sizeOfMain);
+        }
+        for (int i = 0; i < instructions.Length; i++)
+        {
+            var instruction = instructions[i];
+            logger.WriteLine($"{instruction}");
+            writer.LowestLength = writer.BaseStream.Length;
+
+            if (instruction.Integer != null)
+            {
+                writer.Write(instruction.OpCode, instruction.Integer.Value, sizeOfMain);
+            }
+            else if (instruction.Callee != null)
+            {
+                writer.Write(instruction.OpCode, instruction.Callee, sizeOfMain);
+            }
+            else if (instruction.String != null)
+            {
+                writer.Write(instruction.OpCode, instruction.String, sizeOfMain);
+            }
+            else if (instruction.Bytes != null)
+            {
+                writer.Write(instruction.OpCode, instruction.Bytes.Value, sizeOfMain);
+            }
+            else
+            {
+                writer.Write(instruction.OpCode, sizeOfMain);
+            }
+
+            costs?.Record(i, writer.LowestLength, writer.BaseStream.Length);
+        }
+    }
+
+    /// <summary>
+    /// Methods and Objects follow the string and byte[] tables, then the destructor table
+    /// </summary>
+    ushort GetLinkAddress(ushort sizeOfMain) =>
+        checked((ushort)(PRG_LAST.GetAddressAfterMain(sizeOfMain) + _byteArraysLength + _stringTableLength + DestructorTableLength));
+
+    Dictionary<string, ushort> GetLinkedAddresses(ushort sizeOfMain)
+    {
+        var addresses = new Dictionary<string, ushort>(StringComparer.Ordinal);
+        ushort address = GetLinkAddress(sizeOfMain);
+        for (int i = 0; i < _methods.Count; i++)
+        {
+            addresses[_methods[i].Name] = address;
+            address = (ushort)(address + _methodLengths[i].Code + _methodLengths[i].Data);
+        }
+        foreach (var pair in _shared)
+        {
+            addresses[pair.Key] = addresses[pair.Value];
+        }
+        foreach (var obj in _objects)
+        {
+            foreach (var pair in obj.GetAddresses(address))
+            {
+                addresses[pair.Key] = pair.Value;
+            }
+            address = (ushort)(address + obj.Length);
+        }
+        return addresses;
+    }
+
+    /// <summary>
+    /// Methods that lower to the same IL, such as the instantiations of a generic method for two byte-sized enums, share one copy.
+    /// Calls compare by the method they are linked to, so callers of shared methods can be shared in turn.
+    /// Removes the copies from methods, and returns the method each one is linked to.
+    /// </summary>
+    static Dictionary<string, string> ShareCode(List<(string Name, ILInstruction[] Instructions)> methods)
+    {
+        var shared = new Dictionary<string, string>(StringComparer.Ordinal);
+        for (int count = -1; count != shared.Count;)
+        {
+            count = shared.Count;
+            var lowerings = new Dictionary<string, string>(StringComparer.Ordinal);
+            foreach (var (name, instructions) in methods)
+            {
+                if (shared.ContainsKey(name))
+                    continue;
+                var lowering = GetLowering(instructions, shared);
+                if (lowerings.TryGetValue(lowering, out var first))
+                    shared.Add(name, first);
+                else
+                    lowerings.Add(lowering, name);
+            }
+        }
+        methods.RemoveAll(m => shared.ContainsKey(m.Name));
+
+        // A method shared in an earlier pass can point to one shared in a later pass
+        foreach (var name in shared.Keys.ToList())
+        {
+            var target = shared[name];
+            while (shared.TryGetValue(target, out var next))
+                target = next;
+            shared[name] = target;
+        }
+        return shared;
+    }
+
+    static string GetLowering(ILInstruction[] instructions, Dictionary<string, string> shared) =>
+        string.Join(Environment.NewLine, instructions.Select(i =>
+        {
+            var operand = i.Callee is { IsLinked: true } callee && shared.TryGetValue(callee.Name, out var target) ? target : i.Callee?.Name ?? i.String;
+            return $"{i.OpCode} {i.Integer} {operand} {(i.Bytes is { } bytes ? Convert.ToBase64String(bytes.ToArray()) : null)}";
+        }));
+
+    /// <summary>
+    /// Address and ROM cost of each linked method, instantiation and object method, so the cost of generics is visible
+    /// </summary>
+    string GetRomMap(ushort sizeOfMain)
+    {
+        using var writer = new StringWriter();
+        writer.WriteLine("ROM map of linked methods:");
+        ushort address = GetLinkAddress(sizeOfMain);
+        int used = 0;
+        for (int i = 0; i < _methods.Count; i++)
+        {
+            var (name, _) = _methods[i];
+            int length = _methodLengths[i].Code + _methodLengths[i].Data;
+            writer.WriteLine($"  ${address:X4}-${address + length - 1:X4} {name,-40}{length,5} bytes");
+            foreach (var pair in _shared.Where(p => p.Value == name))
+            {
+                writer.WriteLine($"  ${address:X4}-${address + length - 1:X4} {pair.Key,-40}{0,5} bytes, same code as {name}");
+            }
+            address = (ushort)(address + length);
+            used += length;
+        }
+        foreach (var obj in _objects)
+        {
+            foreach (var symbol in obj.Symbols)
+            {
+                writer.WriteLine($"  ${address + symbol.Offset:X4}-${address + symbol.Offset + symbol.Length - 1:X4} {symbol.Name,-40}{symbol.Length,5} bytes");
+            }
+            address = (ushort)(address + obj.Length);
+            used += obj.Length;
+        }
+        writer.WriteLine($"  {used} bytes linked, {_shared.Count} methods share code");
+        return writer.ToString();
+    }
+
+    /// <summary>
+    /// Transpiles the public static methods of a class library, so ROMs referencing it link the code instead of transpiling it again.
+    /// Each method is written at two sizes of main, the operands that differ are relocated when it is linked.
+    /// </summary>
+    public NESObject TranspileObject()
+    {
+        var obj = new NESObject();
+        var code = new List<byte>();
+        var data = new List<byte>();
+        foreach (var (name, method) in GetLibraryMethods())
+        {
+            _logger.WriteLine($"Transpiling {name}...");
+            var instructions = ReadMethod(method).ToArray();
+            if (Optimizations != ILOptimizations.None)
+                instructions = new ILOptimizer(_logger).Optimize(instructions, Optimizations);
+            if (instructions.Any(i => i.OpCode == ILOpCode.Ldstr || i.Callee is { } callee && Digits.Object.Contains(callee.Name)))
+                throw new NotImplementedException($"{name}: strings in a class library are not implemented!");
+
+            var bytes = WriteMethod(instructions, sizeOfMain: 0, out var arrays);
+            var probe = WriteMethod(instructions, RelocationProbe, out _);
+            if (bytes.Length != probe.Length)
+                throw new InvalidOperationException($"{name}: size depends on the size of main, it cannot be relocated!");
+
+            ushort offset = checked((ushort)code.Count);
+            int cycles = AddRelocations(obj, name, bytes, probe, offset, data.Count);
+            obj.Symbols.Add(new NESObject.Symbol(name, offset, checked((ushort)bytes.Length), cycles));
+            code.AddRange(bytes);
+            data.AddRange(arrays);
+        }
+        obj.Code = code.ToArray();
+        obj.Data = data.ToArray();
+        _logger.WriteLine($"Object: {obj.Symbols.Count} methods, {obj.Code.Length} bytes of code, {obj.Data.Length} bytes of data, {obj.Relocations.Count} relocations");
+        return obj;
+    }
+
+    /// <summary>
+    /// Public static void methods without parameters or locals, named like `Namespace.Type.Method`
+    /// </summary>
+    IEnumerable<(string Name, MethodDefinition Method)> GetLibraryMethods()
+    {
+        foreach (var t in _reader.TypeDefinitions)
+        {
+            var type = _reader.GetTypeDefinition(t);
+            // Generic types are instantiated by the program that calls them, they cannot be transpiled ahead of time
+            if (!type.GetDeclaringType().IsNil || _reader.GetString(type.Name).StartsWith("<", StringComparison.Ordinal) || type.GetGenericParameters().Count > 0)
+                continue;
+            foreach (var h in type.GetMethods())
+            {
+                var method = _reader.GetMethodDefinition(h);
+                if ((method.Attributes & (MethodAttributes.Static | MethodAttributes.MemberAccessMask)) != (MethodAttributes.Static | MethodAttributes.Public) ||
+                    (method.Attributes & MethodAttributes.SpecialName) != 0 || method.RelativeVirtualAddress == 0 || method.GetGenericParameters().Count > 0)
+                    continue;
+
+                var name = GetMethodName(t, method.Name);
+                if (!IsStaticVoid(method))
+                    throw new NotImplementedException($"{name}: only static void methods without parameters can be in a class library!");
+                if (!_pe.GetMethodBody(method.RelativeVirtualAddress).LocalSignature.IsNil)
+                    throw new NotImplementedException($"{name}: locals in a class library are not implemented!");
+                yield return (name, method);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Writes a method, and separately the byte[] values it loads
+    /// </summary>
+    /// <param name="byteArrayOffset">Address of the byte[] values, or 0 for rodata after static void main</param>
+    byte[] WriteMethod(ILInstruction[] instructions, ushort sizeOfMain, out byte[] arrays, ushort byteArrayOffset = 0)
+    {
+        using var methodWriter = new IL2NESWriter(new MemoryStream(), logger: _logger) { ByteArrayOffset = byteArrayOffset };
+        WriteInstructions(methodWriter, instructions, sizeOfMain, _logger);
+        methodWriter.Flush();
+
+        using var memoryStream = new MemoryStream();
+        using (var tableWriter = new IL2NESWriter(memoryStream, leaveOpen: true, logger: _logger))
+        {
+            tableWriter.WriteByteArrays(methodWriter);
+        }
+        arrays = memoryStream.ToArray();
+        return ((MemoryStream)methodWriter.BaseStream).ToArray();
+    }
+
+    /// <summary>
+    /// Compares a method written at sizes of main 0 and RelocationProbe: an absolute operand that moved by RelocationProbe
+    /// refers to the cc65 runtime after main, an LDA #, LDX # pair that moved is the address of a byte[].
+    /// Returns the cycles of one pass through the method.
+    /// </summary>
+    static int AddRelocations(NESObject obj, string name, byte[] bytes, byte[] probe, ushort codeOffset, int dataOffset)
+    {
+        int cycles = 0;
+        int offset = 0;
+        while (offset < bytes.Length)
+        {
+            var info = NESInstructionInfo.Get(bytes[offset]) ??
+                throw new InvalidOperationException($"{name}: ${bytes[offset]:X2} at +{offset:X4} is not an instruction!");
+            cycles += info.Cycles;
+            if (bytes.AsSpan(offset, info.Length).SequenceEqual(probe.AsSpan(offset, info.Length)))
+            {
+                offset += info.Length;
+                continue;
+            }
+
+            var lda = NESInstructionInfo.Get(NESInstruction.LDA);
+            var ldx = NESInstructionInfo.Get(NESInstruction.LDX);
+            if (info.Length == 3 && (ushort)((probe[offset + 1] | probe[offset + 2] << 8) - (bytes[offset + 1] | bytes[offset + 2] << 8)) == RelocationProbe)
+            {
+                obj.Relocations.Add(new NESObject.Relocation((ushort)(codeOffset + offset + 1), NESObject.RelocationKind.AfterMain));
+                offset += 3;
+            }
+            else if (info == lda && offset + 3 < bytes.Length && bytes[offset + 2] == ldx.Opcode)
+            {
+                cycles += ldx.Cycles;
+                ushort address = (ushort)(bytes[offset + 1] | bytes[offset + 3] << 8);
+                ushort addend = checked((ushort)(address - PRG_LAST + dataOffset));
+                obj.Relocations.Add(new NESObject.Relocation((ushort)(codeOffset + offset + 1), NESObject.RelocationKind.DataLow, addend));
+                obj.Relocations.Add(new NESObject.Relocation((ushort)(codeOffset + offset + 3), NESObject.RelocationKind.DataHigh, addend));
+                offset += 4;
+            }
+            else
+            {
+                throw new InvalidOperationException($"{name}: ${bytes[offset]:X2} at +{offset:X4} depends on the size of main, it cannot be relocated!");
+            }
+        }
+        return cycles;
+    }
+
+    /// <summary>
+    /// Pre-assembles the built-ins, which only depend on the size of static void main
+    /// </summary>
+    byte[] WriteBuiltIns(ushort sizeOfMain, ILogger logger)
+    {
+        using var memoryStream = new MemoryStream();
+        using (var builtInWriter = new NESWriter(memoryStream, leaveOpen: true, logger: logger))
+        {
+            builtInWriter.WriteBuiltIns(sizeOfMain);
+        }
+        return memoryStream.ToArray();
+    }
+
+    /// <summary>
+    /// Encodes the C# string table, the non-empty strings in the user string heap but those in _unusedStrings
+    /// </summary>
+    unsafe byte[] WriteStringTable(ILogger logger)
+    {
+        using var memoryStream = new MemoryStream();
+        using (var tableWriter = new IL2NESWriter(memoryStream, leaveOpen: true, logger: logger))
+        {
+            // Read the user string heap in place, rather than allocating a string for each entry
+            int stringHeapSize = _reader.GetHeapSize(HeapIndex.UserString);
+            var heap = new BlobReader(_reader.MetadataPointer + _reader.GetHeapMetadataOffset(HeapIndex.UserString), stringHeapSize);
+            while (heap.RemainingBytes > 0)
+            {
+                // Each entry is UTF-16 characters, followed by a single byte of flags
+                int length = heap.ReadCompressedInteger();
+                if (length > 1)
+                {
+                    var chars = MemoryMarshal.Cast<byte, char>(new ReadOnlySpan<byte>(heap.CurrentPointer, length - 1));
+                    if (_unusedStrings.Count == 0 || !_unusedStrings.Contains(chars.ToString()))
+                        tableWriter.WriteString(chars);
+                }
+                heap.Offset += length;
+            }
+        }
+        return memoryStream.ToArray();
+    }
+
+    public IEnumerable<ILInstruction> ReadStaticVoidMain()
+    {
+        foreach (var h in _reader.MethodDefinitions)
+        {
+            var mainMethod = _reader.GetMethodDefinition(h);
+            if ((mainMethod.Attributes & MethodAttributes.Static) == 0)
+                continue;
+
+            var mainMethodName = _reader.GetString(mainMethod.Name);
+            if (mainMethodName == "Main" || mainMethodName == "<Main>$")
+            {
+                _main = h;
+                foreach (var instruction in ReadMethod(mainMethod))
+                {
+                    yield return instruction;
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Decodes the IL of a method body, with delegates of static methods lowered to function pointers
+    /// and interpolated strings lowered to literal tiles and digits
+    /// </summary>
+    /// <param name="context">Type arguments of a generic method or of a method of a generic type</param>
+    IEnumerable<ILInstruction> ReadMethod(MethodDefinition definition, GenericContext? context = null) =>
+        LowerDelegates(LowerInterpolation(DecodeMethod(definition, context).ToList()).ToList());
+
+    const string InterpolatedStringHandler = "System.Runtime.CompilerServices.DefaultInterpolatedStringHandler";
+
+    /// <summary>
+    /// `vram_write($"SCORE {score}")` builds no string: C# appends to a DefaultInterpolatedStringHandler in a local, which is
+    /// lowered to a vram_write of the literal tiles, from the byte[] table, and a call to one of the Digits routines for each hole.
+    /// Holes that are constants are formatted when the ROM is built, and become part of the literal tiles.
+    /// </summary>
+    IEnumerable<ILInstruction> LowerInterpolation(List<ILInstruction> instructions)
+    {
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var instruction = instructions[i];
+            // ldloca handler, ldc length of the literals, ldc number of holes, call .ctor
+            if (instruction.OpCode is not (ILOpCode.Ldloca_s or ILOpCode.Ldloca) || i + 3 >= instructions.Count ||
+                !IsInterpolationCall(instructions[i + 3], ".ctor"))
+            {
+                yield return instruction;
+                continue;
+            }
+
+            int end = instructions.FindIndex(i, c => IsInterpolationCall(c, "ToStringAndClear"));
+            if (end < 0 || end + 1 >= instructions.Count || instructions[end + 1] is not { OpCode: ILOpCode.Call, String: nameof(NESLib.vram_write) } write)
+                throw new NotImplementedException("Interpolated strings are only implemented as the argument of vram_write!");
+
+            var literal = new StringBuilder();
+            var lowered = new List<ILInstruction>();
+            void WriteLiteral()
+            {
+                if (literal.Length == 0)
+                    return;
+                var tiles = ImmutableArray.Create(NESWriter.Encoding.GetBytes(literal.ToString()));
+                lowered.Add(new ILInstruction(ILOpCode.Ldstr, Bytes: tiles) { Offset = instruction.Offset });
+                lowered.Add(write with { Offset = instruction.Offset });
+                literal.Clear();
+            }
+
+            // Each part is ldloca handler, its arguments, call Append*
+            for (int start = i + 5; start < end; start++)
+            {
+                int call = instructions.FindIndex(start, c => IsInterpolationCall(c, null));
+                var arguments = instructions.GetRange(start, call - start);
+                var callee = instructions[call].Callee!.Name;
+                if (instructions[call].String == "AppendLiteral" && arguments is [{ OpCode: ILOpCode.Ldstr, String: { } text }])
+                {
+                    literal.Append(text);
+                    _interpolationStrings.Add(text);
+                }
+                else if (instructions[call].String == "AppendFormatted")
+                {
+                    string type = callee.Substring(callee.IndexOf('<') + 1).TrimEnd('>');
+                    string? format = null;
+                    if (arguments is [.., { OpCode: ILOpCode.Ldstr, String: { } f }])
+                    {
+                        format = f;
+                        arguments.RemoveAt(arguments.Count - 1);
+                        _interpolationStrings.Add(f);
+                    }
+                    if (arguments.Count > 1 && ILOptimizer.GetConstant(arguments[^1]) is not null)
+                        throw new NotImplementedException($"Alignment of {{{type}}} in an interpolated string is not implemented!");
+                    var routine = (type, format) switch
+                    {
+                        ("byte", null) => Digits.Byte,
+                        ("ushort", null) => Digits.UShort,
+                        ("byte", "X2") => Digits.HexByte,
+                        ("ushort", "X4") => Digits.HexUShort,
+                        _ => throw new NotImplementedException($"{{{type}{(format is null ? "" : ":" + format)}}} in an interpolated string is not implemented, only byte and ushort, with X2 or X4 for BCD!"),
+                    };
+                    if (arguments is [var argument] && ILOptimizer.GetConstant(argument) is int value)
+                    {
+                        literal.Append(type == "byte" ? ((byte)value).ToString(format, CultureInfo.InvariantCulture) : ((ushort)value).ToString(format, CultureInfo.InvariantCulture));
+                    }
+                    else
+                    {
+                        WriteLiteral();
+                        lowered.AddRange(arguments);
+                        lowered.Add(new ILInstruction(ILOpCode.Call, String: routine) { Offset = instructions[call].Offset, Callee = Digits.Get(routine) });
+                    }
+                }
+                else
+                {
+                    throw new NotImplementedException($"{callee} in an interpolated string is not implemented!");
+                }
+                // Skip the ldloca of the next part
+                start = call + 1;
+            }
+            WriteLiteral();
+            foreach (var part in lowered)
+                yield return part;
+            i = end + 1;
+        }
+    }
+
+    static bool IsLocal(ILOpCode code) => code is >= ILOpCode.Ldloc_0 and <= ILOpCode.Stloc_3 or
+        ILOpCode.Ldloc_s or ILOpCode.Ldloca_s or ILOpCode.Stloc_s or ILOpCode.Ldloc or ILOpCode.Ldloca or ILOpCode.Stloc;
+
+    /// <summary>
+    /// A call to a method of DefaultInterpolatedStringHandler, or to the one named name
+    /// </summary>
+    static bool IsInterpolationCall(ILInstruction instruction, string? name) =>
+        instruction.OpCode == ILOpCode.Call &&
+        instruction.Callee?.Name.StartsWith(InterpolatedStringHandler + ".", StringComparison.Ordinal) == true &&
+        (name is null || instruction.String == name);
+
+    /// <summary>
+    /// A delegate of a static method is its function pointer: `new Action(M)`, cached by C# or not, is `ldftn M`, and `Invoke` is `calli`.
+    /// Calls through a function pointer known at build time are written as a JSR to it.
+    /// </summary>
+    static IEnumerable<ILInstruction> LowerDelegates(List<ILInstruction> instructions)
+    {
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var instruction = instructions[i];
+            // A method group is cached in a static field of <>O: ldsfld, dup, brtrue.s, pop, ldnull, ldftn, newobj, dup, stsfld
+            if (instruction.OpCode == ILOpCode.Ldsfld && i + 8 < instructions.Count &&
+                instructions[i + 1].OpCode == ILOpCode.Dup &&
+                instructions[i + 2].OpCode is ILOpCode.Brtrue_s or ILOpCode.Brtrue &&
+                instructions[i + 3].OpCode == ILOpCode.Pop &&
+                IsDelegate(instructions, i + 4) &&
+                instructions[i + 7].OpCode == ILOpCode.Dup &&
+                instructions[i + 8].OpCode == ILOpCode.Stsfld && instructions[i + 8].String == instruction.String)
+            {
+                yield return instructions[i + 5] with { Offset = instruction.Offset };
+                i += 8;
+            }
+            else if (IsDelegate(instructions, i))
+            {
+                yield return instructions[i + 1] with { Offset = instruction.Offset };
+                i += 2;
+            }
+            else if (instruction.OpCode == ILOpCode.Callvirt && instruction.String == "Invoke")
+            {
+                yield return new ILInstruction(ILOpCode.Calli) { Offset = instruction.Offset };
+            }
+            else
+            {
+                yield return instruction;
+            }
+        }
+    }
+
+    /// <summary>
+    /// ldnull, ldftn, newobj: a delegate of a static method
+    /// </summary>
+    static bool IsDelegate(List<ILInstruction> instructions, int index) =>
+        index + 2 < instructions.Count &&
+        instructions[index].OpCode == ILOpCode.Ldnull &&
+        instructions[index + 1].OpCode == ILOpCode.Ldftn &&
+        instructions[index + 2].OpCode == ILOpCode.Newobj;
+
+    /// <summary>
+    /// Decodes the IL of a method body
+    /// Based on: https://github.com/icsharpcode/ILSpy/blob/8c508d9bbbc6a21cc244e930122ff5bca19cd11c/ILSpy/Analyzers/Builtin/MethodUsesAnalyzer.cs#L51
+    /// </summary>
+    IEnumerable<ILInstruction> DecodeMethod(MethodDefinition definition, GenericContext? context)
+    {
+        var arrayValues = GetArrayValues(_reader);
+        var body = _pe.GetMethodBody(definition.RelativeVirtualAddress);
+        var blob = body.GetILReader();
+        // The type argument of a constrained. prefix, for the call after it
+        NESType? constrained = null;
+
+        while (blob.RemainingBytes > 0)
+        {
+            int offset = blob.Offset;
+            ILOpCode opCode = DecodeOpCode(ref blob);
+
+            OperandType operandType = GetOperandType(opCode);
+            string? stringValue = null;
+            int? intValue = null;
+            ImmutableArray<byte>? byteValue = null;
+            NESLibBinding? callee = null;
+
+            switch (operandType)
+            {
+                case OperandType.Field:
+                case OperandType.Method:
+                case OperandType.Sig:
+                case OperandType.Tok:
+                    var entity = MetadataTokens.EntityHandle(blob.ReadInt32());
+                    if (entity.IsNil)
+                        continue;
+
+                    switch (entity.Kind)
+                    {
+                        case HandleKind.TypeDefinition:
+                            stringValue = _reader.GetString(_reader.GetTypeDefinition((TypeDefinitionHandle)entity).Name);
                             break;
-                        // 64-bit
-                        case OperandType.I8:
-                        case OperandType.R:
-                            goto default;
-                        // 32-bit
-                        case OperandType.BrTarget:
-                        case OperandType.I:
-                        case OperandType.Type:
-                        case OperandType.ShortR:
-                            intValue = blob.ReadInt32();
+                        case HandleKind.TypeReference:
+                            stringValue = _reader.GetString(_reader.GetTypeReference((TypeReferenceHandle)entity).Name);
                             break;
-                        case OperandType.String:
-                            stringValue = _reader.GetUserString(MetadataTokens.UserStringHandle(blob.ReadInt32()));
+                        case HandleKind.MethodDefinition:
+                            var method = _reader.GetMethodDefinition((MethodDefinitionHandle)entity);
+                            stringValue = _reader.GetString(method.Name);
+                            if (constrained is not null)
+                                callee = ResolveConstrained(opCode, constrained, entity, context);
+                            else if (operandType == OperandType.Method)
+                                callee = ResolveCallee(entity);
                             break;
-                        // (n + 1) * 32-bit
-                        case OperandType.Switch:
-                            //uint n = blob.ReadUInt32();
-                            //blob.Offset += (int)(n * 4);
-                            goto default;
-                        // 16-bit
-                        case OperandType.Variable:
-                            intValue = blob.ReadInt16();
+                        case HandleKind.MemberReference:
+                            var member = _reader.GetMemberReference((MemberReferenceHandle)entity);
+                            stringValue = _reader.GetString(member.Name);
+                            if (stringValue == "InitializeArray")
+                            {
+                                // HACK: skip for now
+                                continue;
+                            }
+                            if (constrained is not null)
+                                callee = ResolveConstrained(opCode, constrained, entity, context);
+                            else if (operandType == OperandType.Method)
+                                callee = member.Parent.Kind == HandleKind.TypeSpecification ? ResolveInstantiation(entity, context) : ResolveCallee(entity);
                             break;
-                        // 8-bit
-                        case OperandType.ShortVariable:
-                        case OperandType.ShortBrTarget:
-                        case OperandType.ShortI:
-                            intValue = blob.ReadByte();
+                        case HandleKind.MethodSpecification:
+                            var specification = _reader.GetMethodSpecification((MethodSpecificationHandle)entity);
+                            stringValue = _reader.GetString(specification.Method.Kind == HandleKind.MethodDefinition ?
+                                _reader.GetMethodDefinition((MethodDefinitionHandle)specification.Method).Name :
+                                _reader.GetMemberReference((MemberReferenceHandle)specification.Method).Name);
+                            if (constrained is not null)
+                                throw new NotImplementedException($"Generic interface method {stringValue} on {constrained} is not implemented!");
+                            if (operandType == OperandType.Method)
+                                callee = ResolveInstantiation(entity, context);
                             break;
-                        case OperandType.None:
+                        case HandleKind.FieldDefinition:
+                            var field = _reader.GetFieldDefinition((FieldDefinitionHandle)entity);
+                            var fieldName = _reader.GetString(field.Name);
+                            if ((field.Attributes & FieldAttributes.HasFieldRVA) != 0)
+                            {
+                                if (arrayValues.TryGetValue (fieldName, out var value))
+                                {
+                                    byteValue = value.Value;
+                                    break;
+                                }
+                            }
+                            // Where C# caches the delegate of a method group, removed by LowerDelegates
+                            if (_reader.StringComparer.Equals(_reader.GetTypeDefinition(field.GetDeclaringType()).Name, "<>O"))
+                            {
+                                stringValue = fieldName;
+                                break;
+                            }
+                            throw new NotImplementedException($"Reading fields like {fieldName} is not implemented!");
+                        case HandleKind.StandaloneSignature when opCode == ILOpCode.Calli:
+                            var signature = _reader.GetBlobReader(_reader.GetStandaloneSignature((StandaloneSignatureHandle)entity).Signature);
+                            signature.ReadSignatureHeader();
+                            if (signature.ReadCompressedInteger() != 0 || signature.ReadSignatureTypeCode() != SignatureTypeCode.Void)
+                                throw new NotImplementedException("calli is only implemented for delegate*<void>!");
                             break;
-                        default:
-                            throw new NotSupportedException($"{opCode}, OperandType={operandType} is not supported.");
                     }
+                    break;
+                // 64-bit
+                case OperandType.I8:
+                case OperandType.R:
+                    goto default;
+                // The type arguments are known, so sizeof(T) is a constant of each instantiation
+                case OperandType.Type when opCode == ILOpCode.Sizeof:
+                    var type = DecodeType(MetadataTokens.EntityHandle(blob.ReadInt32()), context);
+                    if (type.Size == 0)
+                        throw new NotImplementedException($"sizeof({type}) is not implemented!");
+                    opCode = ILOpCode.Ldc_i4;
+                    intValue = type.Size;
+                    break;
+                // T.Method() on a type parameter, resolved with the call that follows
+                case OperandType.Type when opCode == ILOpCode.Constrained:
+                    constrained = DecodeType(MetadataTokens.EntityHandle(blob.ReadInt32()), context);
+                    continue;
+                // 32-bit
+                case OperandType.BrTarget:
+                case OperandType.I:
+                case OperandType.Type:
+                case OperandType.ShortR:
+                    intValue = blob.ReadInt32();
+                    break;
+                case OperandType.String:
+                    stringValue = _reader.GetUserString(MetadataTokens.UserStringHandle(blob.ReadInt32()));
+                    break;
+                // (n + 1) * 32-bit
+                case OperandType.Switch:
+                    //uint n = blob.ReadUInt32();
+                    //blob.Offset += (int)(n * 4);
+                    goto default;
+                // 16-bit
+                case OperandType.Variable:
+                    intValue = blob.ReadInt16();
+                    break;
+                // 8-bit
+                case OperandType.ShortVariable:
+                case OperandType.ShortBrTarget:
+                case OperandType.ShortI:
+                    intValue = blob.ReadByte();
+                    break;
+                case OperandType.None:
+                    break;
+                default:
+                    throw new NotSupportedException($"{opCode}, OperandType={operandType} is not supported.");
+            }
+
+            constrained = null;
+            yield return new ILInstruction(opCode, intValue, stringValue, byteValue) { Offset = offset, Callee = callee };
+        }
+    }
 
-                    yield return new ILInstruction(opCode, intValue, stringValue, byteValue);
+    /// <summary>
+    /// Each method handle is looked up in the NESLib bindings once, not at every call
+    /// </summary>
+    NESLibBinding? ResolveCallee(EntityHandle handle)
+    {
+        if (!_callees.TryGetValue(handle, out var callee))
+        {
+            callee = NESLibBinding.Resolve(_reader, handle) ?? ResolveLinked(handle);
+            _callees.Add(handle, callee);
+        }
+        return callee;
+    }
+
+    /// <summary>
+    /// A method that is not in NESLib, linked from the program or one of the Objects
+    /// </summary>
+    NESLibBinding? ResolveLinked(EntityHandle handle)
+    {
+        string? name = null;
+        if (handle.Kind == HandleKind.MemberReference)
+        {
+            var member = _reader.GetMemberReference((MemberReferenceHandle)handle);
+            name = GetMethodName(member.Parent, member.Name);
+        }
+        else if (handle.Kind == HandleKind.MethodDefinition)
+        {
+            var method = _reader.GetMethodDefinition((MethodDefinitionHandle)handle);
+            name = GetMethodName(method.GetDeclaringType(), method.Name);
+        }
+        if (name is null)
+            return null;
+        var symbol = Objects.SelectMany(o => o.Symbols).FirstOrDefault(s => s.Name == name);
+        return NESLibBinding.Linked(name, symbol?.Cycles ?? 0);
+    }
+
+    /// <summary>
+    /// A call to a generic method or to a method of a generic type, named after its type arguments like `Engine.Util.Fill<byte>`
+    /// or `Engine.Pool<byte>.Clear`. A generic method passes its own type arguments on, so every call is to a concrete instantiation.
+    /// </summary>
+    NESLibBinding? ResolveInstantiation(EntityHandle handle, GenericContext? context)
+    {
+        var methodArguments = ImmutableArray<NESType>.Empty;
+        if (handle.Kind == HandleKind.MethodSpecification)
+        {
+            var specification = _reader.GetMethodSpecification((MethodSpecificationHandle)handle);
+            methodArguments = specification.DecodeSignature(Decoder, context);
+            handle = specification.Method;
+        }
+
+        EntityHandle parent;
+        string method;
+        if (handle.Kind == HandleKind.MemberReference)
+        {
+            var member = _reader.GetMemberReference((MemberReferenceHandle)handle);
+            parent = member.Parent;
+            method = _reader.GetString(member.Name);
+        }
+        else if (handle.Kind == HandleKind.MethodDefinition)
+        {
+            var definition = _reader.GetMethodDefinition((MethodDefinitionHandle)handle);
+            parent = definition.GetDeclaringType();
+            method = _reader.GetString(definition.Name);
+        }
+        else
+        {
+            return null;
+        }
+
+        var type = DecodeType(parent, context);
+        var name = methodArguments.IsEmpty ? $"{type}.{method}" : $"{type}.{method}<{string.Join(",", methodArguments)}>";
+        var instantiation = new Instantiation($"{type.Definition}.{method}", new GenericContext(type.TypeArguments, methodArguments));
+        if (!_instantiations.ContainsKey(name))
+        {
+            _logger.WriteLine($"Instantiating {instantiation.Definition} as {name}");
+            _instantiations.Add(name, instantiation);
+        }
+        return NESLibBinding.Linked(name);
+    }
+
+    /// <summary>
+    /// A static abstract or static virtual interface method called on a type parameter, such as `T.Update()`.
+    /// The type argument is known in each instantiation and the program is closed, so this is a direct call
+    /// to the implementation in that type, such as `Game.Player.Update`, or else to the body in the interface.
+    /// </summary>
+    NESLibBinding ResolveConstrained(ILOpCode opCode, NESType type, EntityHandle handle, GenericContext? context)
+    {
+        if (opCode != ILOpCode.Call)
+            throw new NotImplementedException($"{opCode} on {type} is not implemented, only static interface methods are!");
+        if (type.Name.StartsWith("!", StringComparison.Ordinal))
+            throw new NotImplementedException($"{type} is not a known type argument!");
+
+        EntityHandle parent;
+        string method;
+        if (handle.Kind == HandleKind.MemberReference)
+        {
+            var member = _reader.GetMemberReference((MemberReferenceHandle)handle);
+            parent = member.Parent;
+            method = _reader.GetString(member.Name);
+        }
+        else
+        {
+            var definition = _reader.GetMethodDefinition((MethodDefinitionHandle)handle);
+            parent = definition.GetDeclaringType();
+            method = _reader.GetString(definition.Name);
+        }
+
+        var name = $"{type}.{method}";
+        if (!type.TypeArguments.IsEmpty && !_instantiations.ContainsKey(name))
+            _instantiations.Add(name, new Instantiation($"{type.Definition}.{method}", new GenericContext(type.TypeArguments, ImmutableArray<NESType>.Empty)));
+        if (!_defaultImplementations.ContainsKey(name))
+        {
+            var fallback = parent.Kind == HandleKind.TypeSpecification ? ResolveInstantiation(handle, context) : ResolveLinked(handle);
+            if (fallback is not null)
+                _defaultImplementations.Add(name, fallback.Name);
+        }
+        _logger.WriteLine($"Devirtualized {method} on {type}: {name}");
+        return NESLibBinding.Linked(name);
+    }
+
+    TypeNameDecoder Decoder => _decoder ??= new TypeNameDecoder(GetTypeName, GetEnumSize);
+
+    NESType DecodeType(EntityHandle handle, GenericContext? context) => handle.Kind switch
+    {
+        HandleKind.TypeDefinition => Decoder.GetTypeFromDefinition(_reader, (TypeDefinitionHandle)handle, 0),
+        HandleKind.TypeReference => Decoder.GetTypeFromReference(_reader, (TypeReferenceHandle)handle, 0),
+        HandleKind.TypeSpecification => Decoder.GetTypeFromSpecification(_reader, context, (TypeSpecificationHandle)handle, 0),
+        _ => throw new NotImplementedException($"Type {handle.Kind} is not implemented!"),
+    };
+
+    /// <summary>
+    /// Size of an enum of this assembly or of References, narrowed with NarrowEnums, or 0 if there is no such enum
+    /// </summary>
+    int GetEnumSize(string name)
+    {
+        foreach (var assembly in References.Prepend(this))
+        {
+            if (!assembly.GetEnumSizes().TryGetValue(name, out var sizes))
+                continue;
+            if (!NarrowEnums || sizes.Narrowed == sizes.Size)
+                return sizes.Size;
+            if (_narrowedEnums.Add(name))
+                _logger.WriteLine($"Narrowing enum {name} to {sizes.Narrowed} byte(s), declared {sizes.Size}: values cast to it that are not members are truncated");
+            return sizes.Narrowed;
+        }
+        return 0;
+    }
+
+    Dictionary<string, (int Size, int Narrowed)> GetEnumSizes()
+    {
+        if (_enumSizes is not null)
+            return _enumSizes;
+
+        _enumSizes = new Dictionary<string, (int, int)>(StringComparer.Ordinal);
+        foreach (var t in _reader.TypeDefinitions)
+        {
+            var type = _reader.GetTypeDefinition(t);
+            if (type.BaseType.IsNil || GetTypeName(type.BaseType) != "System.Enum" || GetTypeName(t) is not { } name)
+                continue;
+            int size = 0;
+            long min = 0, max = 0;
+            foreach (var f in type.GetFields())
+            {
+                // value__ is the only instance field of an enum, the others are its values
+                var field = _reader.GetFieldDefinition(f);
+                if ((field.Attributes & FieldAttributes.Static) == 0)
+                {
+                    size = field.DecodeSignature(Decoder, null).Size;
+                }
+                else if (GetEnumValue(field.GetDefaultValue()) is long value)
+                {
+                    min = Math.Min(min, value);
+                    max = Math.Max(max, value);
                 }
             }
+            // The fewest bytes that hold every member. C# casts any value of the underlying type to the enum,
+            // so this is only the size with NarrowEnums, which truncates the values that are not members.
+            int narrowed = min >= 0 ? (max <= byte.MaxValue ? 1 : max <= ushort.MaxValue ? 2 : size) :
+                min >= sbyte.MinValue && max <= sbyte.MaxValue ? 1 : min >= short.MinValue && max <= short.MaxValue ? 2 : size;
+            narrowed = Math.Min(narrowed, size);
+            if (narrowed < size)
+                _logger.WriteLine($"Enum {name} members fit in {narrowed} byte(s), declared {size}, NESNarrowEnums=true stores it in {narrowed}");
+            _enumSizes[name] = (size, narrowed);
+        }
+        return _enumSizes;
+    }
+
+    /// <summary>
+    /// The value of an enum member
+    /// </summary>
+    long? GetEnumValue(ConstantHandle handle)
+    {
+        if (handle.IsNil)
+            return null;
+        var constant = _reader.GetConstant(handle);
+        var blob = _reader.GetBlobReader(constant.Value);
+        return constant.TypeCode switch
+        {
+            ConstantTypeCode.Byte => blob.ReadByte(),
+            ConstantTypeCode.SByte => blob.ReadSByte(),
+            ConstantTypeCode.UInt16 => blob.ReadUInt16(),
+            ConstantTypeCode.Int16 => blob.ReadInt16(),
+            ConstantTypeCode.UInt32 => blob.ReadUInt32(),
+            ConstantTypeCode.Int32 => blob.ReadInt32(),
+            ConstantTypeCode.UInt64 => (long)blob.ReadUInt64(),
+            ConstantTypeCode.Int64 => blob.ReadInt64(),
+            _ => null,
+        };
+    }
+
+    /// <summary>
+    /// Full name of a method, like `Namespace.Type.Method` or `Namespace.Outer+Inner.Method`, or null if its type is not named
+    /// </summary>
+    string? GetMethodName(EntityHandle type, StringHandle method)
+    {
+        var typeName = GetTypeName(type);
+        return typeName is null ? null : $"{typeName}.{_reader.GetString(method)}";
+    }
+
+    string? GetTypeName(EntityHandle handle)
+    {
+        string? outer, ns, name;
+        switch (handle.Kind)
+        {
+            case HandleKind.TypeDefinition:
+                var definition = _reader.GetTypeDefinition((TypeDefinitionHandle)handle);
+                var declaringType = definition.GetDeclaringType();
+                outer = declaringType.IsNil ? null : GetTypeName(declaringType);
+                ns = _reader.GetString(definition.Namespace);
+                name = _reader.GetString(definition.Name);
+                break;
+            case HandleKind.TypeReference:
+                var reference = _reader.GetTypeReference((TypeReferenceHandle)handle);
+                outer = reference.ResolutionScope.Kind == HandleKind.TypeReference ? GetTypeName(reference.ResolutionScope) : null;
+                ns = _reader.GetString(reference.Namespace);
+                name = _reader.GetString(reference.Name);
+                break;
+            default:
+                return null;
+        }
+        if (outer is not null)
+            return $"{outer}+{name}";
+        return string.IsNullOrEmpty(ns) ? name : $"{ns}.{name}";
+    }
+
+    /// <summary>
+    /// A static method returning void, without parameters
+    /// </summary>
+    bool IsStaticVoid(MethodDefinition method)
+    {
+        if ((method.Attributes & MethodAttributes.Static) == 0)
+            return false;
+        var signature = _reader.GetBlobReader(method.Signature);
+        if (signature.ReadSignatureHeader().IsGeneric)
+            signature.ReadCompressedInteger();
+        return signature.ReadCompressedInteger() == 0 && signature.ReadSignatureTypeCode() == SignatureTypeCode.Void;
+    }
+
+    /// <summary>
+    /// Decodes a method of this assembly or of References by its full name, for the CallGraph.
+    /// An instantiation of a generic method is decoded with its type arguments.
+    /// Returns null if it is not in the program, such as a method of one of the Objects.
+    /// </summary>
+    ILInstruction[]? ReadProgramMethod(string name)
+    {
+        var definition = name;
+        GenericContext? context = null;
+        foreach (var assembly in References.Prepend(this))
+        {
+            if (assembly._instantiations.TryGetValue(name, out var instantiation))
+            {
+                (definition, context) = instantiation;
+                break;
+            }
+        }
+        foreach (var assembly in References.Prepend(this))
+        {
+            if (!assembly.GetProgramMethods().TryGetValue(definition, out var handle))
+                continue;
+            var method = assembly._reader.GetMethodDefinition(handle);
+            var instructions = assembly.ReadMethod(method, context).ToArray();
+            // The handler of an interpolated string is a local, but it is lowered away
+            if (instructions.Any(i => IsLocal(i.OpCode)))
+                throw new NotImplementedException($"{name}: locals are only implemented in static void main!");
+            if (instructions.Any(i => i.OpCode == ILOpCode.Ldstr && i.Bytes is null))
+                throw new NotImplementedException($"{name}: strings are only implemented in static void main!");
+            return instructions;
+        }
+        // A static virtual interface method the type does not implement
+        foreach (var assembly in References.Prepend(this))
+        {
+            if (assembly._defaultImplementations.TryGetValue(name, out var fallback))
+                return ReadProgramMethod(fallback);
+        }
+        return null;
+    }
+
+    Dictionary<string, MethodDefinitionHandle> GetProgramMethods()
+    {
+        if (_programMethods is not null)
+            return _programMethods;
+
+        _programMethods = new Dictionary<string, MethodDefinitionHandle>(StringComparer.Ordinal);
+        foreach (var t in _reader.TypeDefinitions)
+        {
+            foreach (var h in _reader.GetTypeDefinition(t).GetMethods())
+            {
+                var method = _reader.GetMethodDefinition(h);
+                if (method.RelativeVirtualAddress == 0 || (method.Attributes & MethodAttributes.SpecialName) != 0 || !IsStaticVoid(method))
+                    continue;
+                if (GetMethodName(t, method.Name) is { } name && !_programMethods.ContainsKey(name))
+                    _programMethods.Add(name, h);
+                // An explicit interface implementation such as `Engine.IState.Update` is also found as `Game.Player.Update`
+                var methodName = _reader.GetString(method.Name);
+                int dot = methodName.LastIndexOf('.');
+                if (dot > 0 && GetTypeName(t) is { } typeName && !_programMethods.ContainsKey($"{typeName}.{methodName.Substring(dot + 1)}"))
+                    _programMethods.Add($"{typeName}.{methodName.Substring(dot + 1)}", h);
+            }
         }
+        return _programMethods;
     }
 
     Dictionary<string, ArrayValue> GetArrayValues(MetadataReader reader)
@@ -360,5 +1831,6 @@ class Transpiler : IDisposable
             assembly.Dispose();
         }
         _pe.Dispose();
+        _image?.Dispose();
     }
 }
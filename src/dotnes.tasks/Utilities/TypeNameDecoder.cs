@@ -0,0 +1,107 @@
+﻿using System.Collections.Immutable;
+using System.Reflection.Metadata;
+
+namespace dotnes;
+
+/// <summary>
+/// A type in a signature, with the generic parameters of the method being read replaced by its type arguments
+/// </summary>
+/// <param name="Name">Name of the type, such as `byte` or `Engine.Pool&lt;Engine.Tile&gt;`</param>
+/// <param name="Size">Size in bytes of a primitive or an enum, or 0 if it is not known</param>
+record NESType(string Name, int Size = 0)
+{
+    /// <summary>
+    /// Name of the generic type definition in metadata, such as `Engine.Pool`1`, or Name if it is not generic
+    /// </summary>
+    public string Definition { get; init; } = Name;
+
+    public ImmutableArray<NESType> TypeArguments { get; init; } = ImmutableArray<NESType>.Empty;
+
+    public override string ToString() => Name;
+}
+
+/// <summary>
+/// Type arguments of the generic type and method whose body is read
+/// </summary>
+record GenericContext(ImmutableArray<NESType> TypeArguments, ImmutableArray<NESType> MethodArguments);
+
+/// <summary>
+/// Decodes type signatures to NESType, for generic instantiations and sizeof
+/// </summary>
+class TypeNameDecoder : ISignatureTypeProvider<NESType, GenericContext?>
+{
+    readonly Func<EntityHandle, string?> _getTypeName;
+    readonly Func<string, int> _getSize;
+
+    /// <param name="getTypeName">Full name of a TypeDefinition or TypeReference</param>
+    /// <param name="getSize">Size of an enum by full name, or 0</param>
+    public TypeNameDecoder(Func<EntityHandle, string?> getTypeName, Func<string, int> getSize)
+    {
+        _getTypeName = getTypeName;
+        _getSize = getSize;
+    }
+
+    public NESType GetPrimitiveType(PrimitiveTypeCode typeCode) => typeCode switch
+    {
+        PrimitiveTypeCode.Boolean => new("bool", 1),
+        PrimitiveTypeCode.Byte => new("byte", 1),
+        PrimitiveTypeCode.SByte => new("sbyte", 1),
+        PrimitiveTypeCode.Char => new("char", 2),
+        PrimitiveTypeCode.Int16 => new("short", 2),
+        PrimitiveTypeCode.UInt16 => new("ushort", 2),
+        PrimitiveTypeCode.Int32 => new("int", 4),
+        PrimitiveTypeCode.UInt32 => new("uint", 4),
+        PrimitiveTypeCode.Int64 => new("long", 8),
+        PrimitiveTypeCode.UInt64 => new("ulong", 8),
+        _ => new(typeCode.ToString()),
+    };
+
+    public NESType GetTypeFromDefinition(MetadataReader reader, TypeDefinitionHandle handle, byte rawTypeKind) => GetType(handle);
+
+    public NESType GetTypeFromReference(MetadataReader reader, TypeReferenceHandle handle, byte rawTypeKind) => GetType(handle);
+
+    NESType GetType(EntityHandle handle)
+    {
+        var name = _getTypeName(handle) ?? throw new NotImplementedException($"Type {handle.Kind} is not implemented!");
+        return new NESType(name, _getSize(name));
+    }
+
+    public NESType GetTypeFromSpecification(MetadataReader reader, GenericContext? genericContext, TypeSpecificationHandle handle, byte rawTypeKind) =>
+        reader.GetTypeSpecification(handle).DecodeSignature(this, genericContext);
+
+    /// <summary>
+    /// `Engine.Pool`1` with `byte` is `Engine.Pool&lt;byte&gt;`
+    /// </summary>
+    public NESType GetGenericInstantiation(NESType genericType, ImmutableArray<NESType> typeArguments)
+    {
+        var name = genericType.Name;
+        int tick = name.LastIndexOf('`');
+        if (tick >= 0)
+            name = name.Substring(0, tick);
+        return new NESType($"{name}<{string.Join(",", typeArguments)}>")
+        {
+            Definition = genericType.Definition,
+            TypeArguments = typeArguments,
+        };
+    }
+
+    public NESType GetGenericTypeParameter(GenericContext? genericContext, int index) =>
+        genericContext is not null && index < genericContext.TypeArguments.Length ? genericContext.TypeArguments[index] : new($"!{index}");
+
+    public NESType GetGenericMethodParameter(GenericContext? genericContext, int index) =>
+        genericContext is not null && index < genericContext.MethodArguments.Length ? genericContext.MethodArguments[index] : new($"!!{index}");
+
+    public NESType GetModifiedType(NESType modifier, NESType unmodifiedType, bool isRequired) => unmodifiedType;
+
+    public NESType GetPinnedType(NESType elementType) => elementType;
+
+    public NESType GetSZArrayType(NESType elementType) => new($"{elementType}[]", 2);
+
+    public NESType GetArrayType(NESType elementType, ArrayShape shape) => throw new NotImplementedException($"Multi-dimensional arrays of {elementType} are not implemented!");
+
+    public NESType GetByReferenceType(NESType elementType) => new($"{elementType}&", 2);
+
+    public NESType GetPointerType(NESType elementType) => new($"{elementType}*", 2);
+
+    public NESType GetFunctionPointerType(MethodSignature<NESType> signature) => new("delegate*", 2);
+}
@@ -0,0 +1,137 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Combines pairs of official instructions into one of the unofficial opcodes the 2A03 runs reliably:
+/// * `LDA m; TAX`, `LDX m; TXA` or `LDA m; LDX m` become `LAX m`
+/// * `AND #i; LSR A` becomes `ALR #i`, and `AND #i; CLC` becomes `ANC #i` when i clears bit 7
+/// * `TXA; CLC; ADC #i; TAX` or `TXA; SEC; SBC #i; TAX` become `LDA #$FF; AXS #-i` or `LDA #$FF; AXS #i`
+/// Some emulators and clone consoles do not run them, so this is never part of CodeOptimizations.All.
+/// </summary>
+class UnofficialOptimizer
+{
+    const ushort REGISTERS_START = 0x2000;
+    const ushort REGISTERS_END = 0x4020;
+
+    readonly ILogger _logger;
+
+    public UnofficialOptimizer(ILogger? logger = null) => _logger = logger ?? new NullLogger();
+
+    public int BytesSaved { get; private set; }
+
+    public int CyclesSaved { get; private set; }
+
+    /// <summary>
+    /// Offsets in the optimized code of each unofficial instruction, for the build log
+    /// </summary>
+    public List<(int Offset, string Instruction)> Uses { get; } = new();
+
+    /// <summary>
+    /// Returns the optimized code, and adds the ranges of the original code that were removed
+    /// </summary>
+    public byte[] Optimize(byte[] code, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.Unofficial);
+        if (instructions is null)
+            return code;
+
+        var output = new List<byte>(code.Length);
+        for (int i = 0; i < instructions.Count; i++)
+        {
+            var instruction = instructions[i];
+            var replacement = Rewrite(instructions, i, out int count);
+            if (replacement is null)
+            {
+                output.AddRange(code.Skip(instruction.Offset).Take(instruction.Info.Length));
+                continue;
+            }
+
+            var pattern = instructions.Skip(i).Take(count).ToList();
+            int length = pattern.Sum(n => n.Info.Length);
+            var decoded = DecodedInstruction.Decode(replacement, _logger, CodeOptimizations.Unofficial)!;
+            int cycles = pattern.Sum(n => n.Info.Cycles) - decoded.Sum(n => n.Info.Cycles);
+            BytesSaved += length - replacement.Length;
+            CyclesSaved += cycles;
+            if (length > replacement.Length)
+                removed?.Add((instruction.Offset + replacement.Length, length - replacement.Length));
+            foreach (var used in decoded.Where(n => n.Info.Unofficial))
+            {
+                Uses.Add((output.Count + used.Offset, used.ToString()));
+            }
+            output.AddRange(replacement);
+            _logger.WriteLine($"{nameof(CodeOptimizations.Unofficial)}: +{instruction.Offset:X4} {string.Join("; ", pattern)} => {string.Join("; ", decoded)}, {cycles} cycles saved");
+            i += count - 1;
+        }
+        return output.ToArray();
+    }
+
+    /// <summary>
+    /// Returns the replacement for the instructions at index, or null. Outputs the replacement
+    /// does not keep must not be read afterwards.
+    /// </summary>
+    static byte[]? Rewrite(List<DecodedInstruction> instructions, int index, out int count)
+    {
+        count = 2;
+        if (index + 1 >= instructions.Count)
+            return null;
+        var first = instructions[index];
+        var second = instructions[index + 1];
+
+        switch (first.Info.Mnemonic, second.Info.Mnemonic)
+        {
+            case ("LDA", "TAX"):
+            case ("LDX", "TXA"):
+                return Encode("LAX", first);
+            // The same address read twice, which is not the same as once for PPU_STATUS and the controllers
+            case ("LDA", "LDX"):
+            case ("LDX", "LDA"):
+                if (first.Info.Mode != second.Info.Mode || first.Operand != second.Operand ||
+                    first.Info.Mode is not (AddressMode.ZeroPage or AddressMode.Absolute) ||
+                    first.Operand is >= REGISTERS_START and < REGISTERS_END)
+                    return null;
+                return Encode("LAX", first);
+            case ("AND", "LSR") when first.Info.Mode == AddressMode.Immediate && second.Info.Mode == AddressMode.Accumulator:
+                return [(byte)NESInstruction.ALR, (byte)first.Operand];
+            // AND clears the sign, so the carry ANC copies from it is clear too
+            case ("AND", "CLC") when first.Info.Mode == AddressMode.Immediate && first.Operand < 0x80:
+                return [(byte)NESInstruction.ANC, (byte)first.Operand];
+        }
+
+        // TXA; CLC; ADC #i; TAX or TXA; SEC; SBC #i; TAX
+        count = 4;
+        if (index + 3 >= instructions.Count || first.Info.Mnemonic != "TXA" || instructions[index + 3].Info.Mnemonic != "TAX")
+            return null;
+        var math = instructions[index + 2];
+        if (math.Info.Mode != AddressMode.Immediate)
+            return null;
+        byte operand;
+        if (second.Info.Mnemonic == "CLC" && math.Info.Mnemonic == "ADC" && math.Operand != 0)
+            operand = (byte)(0x100 - math.Operand);
+        else if (second.Info.Mnemonic == "SEC" && math.Info.Mnemonic == "SBC")
+            operand = (byte)math.Operand;
+        else
+            return null;
+
+        // AXS leaves A at $FF and does not set the overflow, TXA puts A back if it is still used
+        var live = PeepholeOptimizer.GetLive(instructions, index + count);
+        if ((live & Outputs.Overflow) != 0)
+            return null;
+        byte[] axs = [(byte)NESInstruction.LDA, 0xFF, (byte)NESInstruction.AXS, operand];
+        return (live & Outputs.A) == 0 ? axs : [.. axs, (byte)NESInstruction.TXA_impl];
+    }
+
+    /// <summary>
+    /// The unofficial instruction with the same addressing mode and operand, or null if there is none
+    /// </summary>
+    static byte[]? Encode(string mnemonic, DecodedInstruction instruction)
+    {
+        var info = Enumerable.Range(0, 256)
+            .Select(i => NESInstructionInfo.Get((byte)i))
+            .FirstOrDefault(i => i is not null && i.Mnemonic == mnemonic && i.Mode == instruction.Info.Mode);
+        return info?.Length switch
+        {
+            2 => [info.Opcode, (byte)instruction.Operand],
+            3 => [info.Opcode, (byte)instruction.Operand, (byte)(instruction.Operand >> 8)],
+            _ => null,
+        };
+    }
+}
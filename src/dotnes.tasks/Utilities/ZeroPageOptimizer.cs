@@ -0,0 +1,113 @@
+﻿namespace dotnes;
+
+/// <summary>
+/// Moves the locals of static void main that a profile shows are hot into free zero page,
+/// zero page instructions are a byte smaller and a cycle faster
+/// </summary>
+class ZeroPageOptimizer
+{
+    /// <summary>
+    /// Locals are never above the C stack
+    /// </summary>
+    const ushort LOCALS_END = 0x0700;
+
+    readonly ILogger _logger;
+
+    public ZeroPageOptimizer(ILogger? logger = null) => _logger = logger ?? new NullLogger();
+
+    public int BytesSaved { get; private set; }
+
+    public int CyclesSaved { get; private set; }
+
+    /// <summary>
+    /// Gives the most accessed locals a zero page address each, while there is room.
+    /// Startup code clears all of RAM, so only the addresses main uses are candidates.
+    /// </summary>
+    public static Dictionary<ushort, byte> GetPlacement(NESProfile profile, ICollection<ushort> used)
+    {
+        var placement = new Dictionary<ushort, byte>();
+        int next = IL2NESWriter.zeroPageLocal;
+        foreach (var pair in profile.RAM
+            .Where(p => p.Key >= IL2NESWriter.local && p.Key < LOCALS_END && used.Contains(p.Key))
+            .OrderByDescending(p => p.Value)
+            .ThenBy(p => p.Key))
+        {
+            if (next > byte.MaxValue)
+                break;
+            placement[pair.Key] = (byte)next++;
+        }
+        return placement;
+    }
+
+    /// <summary>
+    /// Places the locals of the code by the profile, see Optimize(byte[], IReadOnlyDictionary, List)
+    /// </summary>
+    public byte[] Optimize(byte[] code, NESProfile profile, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.ZeroPage);
+        if (instructions is null)
+            return code;
+
+        var used = new HashSet<ushort>(instructions
+            .Where(i => i.Info.Mode == AddressMode.Absolute)
+            .Select(i => i.Operand));
+        return Optimize(code, GetPlacement(profile, used), removed);
+    }
+
+    /// <summary>
+    /// Returns the optimized code, and adds the ranges of the original code that were removed
+    /// </summary>
+    public byte[] Optimize(byte[] code, IReadOnlyDictionary<ushort, byte> placement, List<(int Offset, int Length)>? removed = null)
+    {
+        var instructions = DecodedInstruction.Decode(code, _logger, CodeOptimizations.ZeroPage);
+        if (instructions is null || placement.Count == 0)
+            return code;
+
+        // An indexed access could reach any local, and not every absolute instruction has a zero page form
+        var moved = new Dictionary<ushort, byte>();
+        foreach (var pair in placement)
+        {
+            moved[pair.Key] = pair.Value;
+        }
+        foreach (var instruction in instructions)
+        {
+            var mode = instruction.Info.Mode;
+            if (mode is AddressMode.AbsoluteX or AddressMode.AbsoluteY && instruction.Operand >= IL2NESWriter.local && instruction.Operand < LOCALS_END)
+            {
+                _logger.WriteLine($"{nameof(CodeOptimizations.ZeroPage)}: skipped, {instruction} at +{instruction.Offset:X4} is indexed");
+                return code;
+            }
+            if (mode == AddressMode.Absolute && moved.ContainsKey(instruction.Operand) && GetZeroPage(instruction.Info) is null)
+            {
+                _logger.WriteLine($"{nameof(CodeOptimizations.ZeroPage)}: ${instruction.Operand:X4} stays, {instruction} has no zero page form");
+                moved.Remove(instruction.Operand);
+            }
+        }
+
+        var output = new List<byte>(code.Length);
+        foreach (var instruction in instructions)
+        {
+            if (instruction.Info.Mode != AddressMode.Absolute || !moved.TryGetValue(instruction.Operand, out var address))
+            {
+                output.AddRange(code.Skip(instruction.Offset).Take(instruction.Info.Length));
+                continue;
+            }
+            var zeroPage = GetZeroPage(instruction.Info)!;
+            output.Add(zeroPage.Opcode);
+            output.Add(address);
+            BytesSaved += instruction.Info.Length - zeroPage.Length;
+            CyclesSaved += instruction.Info.Cycles - zeroPage.Cycles;
+            removed?.Add((instruction.Offset + zeroPage.Length, instruction.Info.Length - zeroPage.Length));
+        }
+        foreach (var pair in moved.OrderBy(p => p.Value))
+        {
+            _logger.WriteLine($"{nameof(CodeOptimizations.ZeroPage)}: ${pair.Key:X4} => ${pair.Value:X2}");
+        }
+        return output.ToArray();
+    }
+
+    static NESInstructionInfo? GetZeroPage(NESInstructionInfo info) =>
+        Enumerable.Range(0, 256)
+            .Select(i => NESInstructionInfo.Get((byte)i))
+            .FirstOrDefault(i => i is not null && i.Mnemonic == info.Mnemonic && i.Mode == AddressMode.ZeroPage);
+}
@@ -0,0 +1,362 @@
+﻿using System.Reflection.Metadata;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CSharp;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class CallGraphTests
+{
+    readonly ILogger _logger;
+
+    public CallGraphTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    static ILInstruction Call(string name) => new(ILOpCode.Call, String: name) { Callee = NESLibBinding.Linked(name) };
+
+    static ILInstruction NESLibCall(string name) => new(ILOpCode.Call, String: name) { Callee = NESLibBinding.Get(name) };
+
+    static readonly ILInstruction Ret = new(ILOpCode.Ret);
+
+    static readonly ILInstruction Loop = new(ILOpCode.Br_s, 0xFE);
+
+    [Fact]
+    public void Methods()
+    {
+        var methods = new Dictionary<string, ILInstruction[]>
+        {
+            ["Engine.Title.Draw"] = [NESLibCall(nameof(NESLib.pal_clear)), Call("Engine.Title.Clear"), Ret],
+            ["Engine.Title.Clear"] = [NESLibCall(nameof(NESLib.ppu_off)), Ret],
+            ["Engine.Title.Unused"] = [NESLibCall(nameof(NESLib.ppu_off)), Ret],
+        };
+        var graph = new CallGraph([Call("Engine.Title.Draw"), Call("Engine.Sound.Play"), Loop], n => methods.TryGetValue(n, out var m) ? m : null, _logger);
+
+        Assert.Equal(["Engine.Title.Draw", "Engine.Title.Clear"], graph.Methods.Select(m => m.Name));
+        Assert.Equal(["Engine.Sound.Play"], graph.External);
+    }
+
+    [Fact]
+    public void Inline()
+    {
+        var methods = new Dictionary<string, ILInstruction[]>
+        {
+            // Called once
+            ["Once"] = [NESLibCall(nameof(NESLib.pal_clear)), NESLibCall(nameof(NESLib.ppu_off)), Ret],
+            // Called twice, but only calls another method
+            ["Wrapper"] = [NESLibCall(nameof(NESLib.ppu_on_all)), Ret],
+            // Called twice
+            ["Twice"] = [NESLibCall(nameof(NESLib.ppu_off)), NESLibCall(nameof(NESLib.ppu_on_all)), Ret],
+            // Calls itself
+            ["Recursive"] = [NESLibCall(nameof(NESLib.ppu_off)), Call("Recursive"), Ret],
+        };
+        var graph = new CallGraph([Call("Once"), Call("Wrapper"), Call("Wrapper"), Call("Twice"), Call("Twice"), Call("Recursive"), Loop],
+            n => methods.TryGetValue(n, out var m) ? m : null, _logger);
+        graph.Inline();
+
+        Assert.Equal(3, graph.Inlined);
+        Assert.Equal(["Twice", "Recursive"], graph.Methods.Select(m => m.Name));
+        Assert.Equal([
+            nameof(NESLib.pal_clear),
+            nameof(NESLib.ppu_off),
+            nameof(NESLib.ppu_on_all),
+            nameof(NESLib.ppu_on_all),
+            "Twice",
+            "Twice",
+            "Recursive",
+        ], graph.Main.Where(i => i.OpCode == ILOpCode.Call).Select(i => i.Callee!.Name));
+    }
+
+    const string Draw = """
+        pal_col(0, 0x02);
+        pal_col(1, 0x14);
+        pal_bg(new byte[] { 0x0F, 0x01, 0x02, 0x03, 0x0F, 0x11, 0x12, 0x13, 0x0F, 0x21, 0x22, 0x23, 0x0F, 0x31, 0x32, 0x33 });
+        vram_adr(NAMETABLE_A);
+        vram_put(0x41);
+        """;
+
+    const string Library = $$"""
+        using static NES.NESLib;
+
+        namespace Engine;
+
+        public static class Title
+        {
+            public static void Draw()
+            {
+                {{Draw}}
+                Sprites.Clear();
+            }
+
+            public static void Unused() => ppu_off();
+        }
+
+        static class Sprites
+        {
+            public static void Clear() => oam_clear();
+        }
+        """;
+
+    [Theory]
+    [InlineData((int)ILOptimizations.None)]
+    [InlineData((int)ILOptimizations.Inlining)]
+    public void Write(int optimizations)
+    {
+        var library = CompileLibrary(Library);
+        var program = Transpile(CompileProgram("Engine.Title.Draw();", library), (ILOptimizations)optimizations, library);
+        var inline = Transpile(CompileProgram(Draw + "\noam_clear();"), ILOptimizations.None);
+
+        // Inlined, static void main is the same as the code written in it
+        const int main = 16 + 0x500;
+        if (optimizations != 0)
+            Assert.Equal(Convert.ToHexString(inline, main, 0x40), Convert.ToHexString(program, main, 0x40));
+        else
+            Assert.Equal((byte)NESInstruction.JSR, program[main]);
+
+        var (expectedWrites, expectedPalette) = Utilities.RunToLoop(inline);
+        var (actualWrites, actualPalette) = Utilities.RunToLoop(program);
+        Assert.Equal(expectedWrites, actualWrites);
+        Assert.Equal(expectedPalette, actualPalette);
+    }
+
+    [Fact]
+    public void Write_LocalFunction()
+    {
+        var expected = Transpile(CompileProgram(Draw), ILOptimizations.None);
+        var actual = Transpile(CompileProgram($$"""
+            Draw();
+
+            static void Draw()
+            {
+                {{Draw}}
+            }
+            """), ILOptimizations.None);
+
+        Assert.Equal(Utilities.RunToLoop(expected).Writes, Utilities.RunToLoop(actual).Writes);
+    }
+
+    [Theory]
+    [InlineData("unsafe { delegate*<void> f = &Draw; f(); }", ILOptimizations.None)]
+    [InlineData("unsafe { delegate*<void> f = &Draw; f(); }", ILOptimizations.All)]
+    [InlineData("System.Action a = Draw; a();", ILOptimizations.None)]
+    [InlineData("new System.Action(Draw)();", ILOptimizations.None)]
+    public void Write_FunctionPointer(string call, ILOptimizations optimizations)
+    {
+        var expected = Transpile(CompileProgram(Draw), ILOptimizations.None);
+        var actual = Transpile(CompileProgram($$"""
+            {{call}}
+
+            static void Draw()
+            {
+                {{Draw}}
+            }
+            """), optimizations);
+
+        // Called through a JSR to the method, like a direct call
+        const int main = 16 + 0x500;
+        Assert.Equal((byte)NESInstruction.JSR, actual[main]);
+        Assert.Equal((byte)NESInstruction.JMP_abs, actual[main + 3]);
+        Assert.Equal(Utilities.RunToLoop(expected).Writes, Utilities.RunToLoop(actual).Writes);
+    }
+
+    [Fact]
+    public void Write_NotImplemented()
+    {
+        // Methods are looked up by full name, there is no Engine.Title.Draw without the reference
+        var library = CompileLibrary(Library);
+        var ex = Assert.Throws<NotImplementedException>(() => Transpile(CompileProgram("Engine.Title.Draw();", library), ILOptimizations.None));
+        Assert.Contains("Engine.Title.Draw", ex.Message);
+    }
+
+    const string Generics = """
+        using static NES.NESLib;
+
+        namespace Engine;
+
+        public enum Tile : byte { Blank, Wall }
+
+        public enum Color : byte { Black, White }
+
+        [System.Flags]
+        public enum Layers { Background = 1, Sprites = 2, Hud = 128 }
+
+        public struct Point { public byte X, Y; }
+
+        public static class Util
+        {
+            public static unsafe void Put<T>() where T : unmanaged => vram_put((byte)sizeof(T));
+        }
+
+        public static class Pool<T> where T : unmanaged
+        {
+            public static void Clear() => Util.Put<T>();
+        }
+        """;
+
+    /// <summary>
+    /// Layers is declared as an int, but its members fit in a byte, which is its size only with NarrowEnums
+    /// </summary>
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public void Write_Generic(bool narrowEnums)
+    {
+        var library = CompileLibrary(Generics);
+        using var romMap = new StringWriter();
+        var program = Transpile(CompileProgram("""
+            vram_adr(NAMETABLE_A);
+            Engine.Util.Put<Engine.Tile>();
+            Engine.Util.Put<Engine.Color>();
+            Engine.Util.Put<ushort>();
+            Engine.Pool<byte>.Clear();
+            Engine.Util.Put<Engine.Layers>();
+            """, library), ILOptimizations.None, romMap, narrowEnums, library);
+        var inline = Transpile(CompileProgram($"""
+            vram_adr(NAMETABLE_A);
+            vram_put(1);
+            vram_put(1);
+            vram_put(2);
+            vram_put(1);
+            vram_put({(narrowEnums ? 1 : 4)});
+            """), ILOptimizations.None);
+
+        Assert.Equal(Utilities.RunToLoop(inline).Writes, Utilities.RunToLoop(program).Writes);
+
+        // Byte-sized instantiations share one copy of the code, each one is in the map
+        var map = romMap.ToString();
+        _logger.WriteLine($"{map}");
+        Assert.Contains("Engine.Util.Put<Engine.Tile>", map);
+        Assert.Contains("Engine.Util.Put<ushort>", map);
+        Assert.Contains("Engine.Pool<byte>.Clear", map);
+        Assert.Contains("Engine.Util.Put<Engine.Color>", map);
+        Assert.Contains("same code as Engine.Util.Put<Engine.Tile>", map);
+        Assert.Contains("Engine.Util.Put<Engine.Layers>", map);
+        Assert.Contains(narrowEnums ? "3 methods share code" : "2 methods share code", map);
+    }
+
+    [Fact]
+    public void Write_Generic_NotImplemented()
+    {
+        var library = CompileLibrary(Generics);
+        var ex = Assert.Throws<NotImplementedException>(() => Transpile(CompileProgram("Engine.Util.Put<Engine.Point>();", library), ILOptimizations.None, library));
+        Assert.Contains("sizeof(Engine.Point)", ex.Message);
+    }
+
+    const string Interfaces = """
+        using static NES.NESLib;
+
+        namespace Engine;
+
+        public interface IState
+        {
+            static abstract void Update();
+
+            static virtual void Draw() => vram_put(0x30);
+        }
+
+        public struct Title : IState
+        {
+            public static void Update() => vram_put(0x41);
+        }
+
+        public struct Game : IState
+        {
+            static void IState.Update() => vram_put(0x42);
+
+            public static void Draw() => vram_put(0x43);
+        }
+
+        public static class Machine
+        {
+            public static void Run<T>() where T : IState
+            {
+                T.Update();
+                T.Draw();
+            }
+        }
+        """;
+
+    [Theory]
+    [InlineData((int)ILOptimizations.None)]
+    [InlineData((int)ILOptimizations.Inlining)]
+    public void Write_Interface(int optimizations)
+    {
+        var library = CompileLibrary(Interfaces);
+        var program = Transpile(CompileProgram("""
+            vram_adr(NAMETABLE_A);
+            Engine.Machine.Run<Engine.Title>();
+            Engine.Machine.Run<Engine.Game>();
+            """, library), (ILOptimizations)optimizations, library);
+        var inline = Transpile(CompileProgram("""
+            vram_adr(NAMETABLE_A);
+            vram_put(0x41);
+            vram_put(0x30);
+            vram_put(0x42);
+            vram_put(0x43);
+            """), ILOptimizations.None);
+
+        // Each T.Update() and T.Draw() is a JSR to the one method it can reach, or is inlined
+        Assert.Equal(Utilities.RunToLoop(inline).Writes, Utilities.RunToLoop(program).Writes);
+        if (optimizations != 0)
+            Assert.Equal(Convert.ToHexString(inline, 16 + 0x500, 0x20), Convert.ToHexString(program, 16 + 0x500, 0x20));
+    }
+
+    byte[] Transpile(Stream dll, ILOptimizations optimizations, params byte[][] references) =>
+        Transpile(dll, optimizations, null, false, references);
+
+    byte[] Transpile(Stream dll, ILOptimizations optimizations, TextWriter? ramMap, bool narrowEnums, params byte[][] references)
+    {
+        // The references are disposed by the caller of Write, which opened them
+        var transpilers = references.Select(r => new Transpiler(new MemoryStream(r), Array.Empty<AssemblyReader>(), _logger)).ToList();
+        try
+        {
+            return Utilities.Transpile(dll, _logger, il =>
+            {
+                il.Optimizations = optimizations;
+                il.RamMap = ramMap;
+                il.NarrowEnums = narrowEnums;
+                il.References = transpilers;
+            });
+        }
+        finally
+        {
+            foreach (var transpiler in transpilers)
+            {
+                transpiler.Dispose();
+            }
+        }
+    }
+
+    static IEnumerable<MetadataReference> References => ((string)AppContext.GetData("TRUSTED_PLATFORM_ASSEMBLIES")!)
+        .Split(Path.PathSeparator)
+        .Select(p => MetadataReference.CreateFromFile(p))
+        .Append(MetadataReference.CreateFromFile(typeof(NESLib).Assembly.Location));
+
+    static byte[] CompileLibrary(string source)
+    {
+        var compilation = CSharpCompilation.Create("Engine",
+            new[] { CSharpSyntaxTree.ParseText(source) },
+            References,
+            new CSharpCompilationOptions(OutputKind.DynamicallyLinkedLibrary, optimizationLevel: OptimizationLevel.Release, allowUnsafe: true));
+        return Emit(compilation).ToArray();
+    }
+
+    internal static MemoryStream CompileProgram(string source, byte[]? library = null)
+    {
+        var references = References;
+        if (library is not null)
+            references = references.Append(MetadataReference.CreateFromImage(library));
+        var compilation = CSharpCompilation.Create("program",
+            new[] { CSharpSyntaxTree.ParseText($"using static NES.NESLib;\n\n{source}\nwhile (true) ;\n") },
+            references,
+            new CSharpCompilationOptions(OutputKind.ConsoleApplication, optimizationLevel: OptimizationLevel.Release, allowUnsafe: true));
+        return Emit(compilation);
+    }
+
+    static MemoryStream Emit(CSharpCompilation compilation)
+    {
+        var dll = new MemoryStream();
+        var result = compilation.Emit(dll);
+        Assert.True(result.Success, string.Join(Environment.NewLine, result.Diagnostics));
+        dll.Position = 0;
+        return dll;
+    }
+}
@@ -0,0 +1,103 @@
+﻿using System.Reflection.Metadata;
+using System.Text.RegularExpressions;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CSharp;
+using Microsoft.CodeAnalysis.Emit;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class CostEstimatorTests
+{
+    readonly ILogger _logger;
+
+    public CostEstimatorTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const string HelloSource =
+@"pal_col(0, 0x02);
+pal_col(1, 0x14);
+pal_col(2, 0x20);
+pal_col(3, 0x30);
+vram_adr(NTADR_A(2, 2));
+vram_write(""HELLO, .NET!"");
+ppu_on_all();
+while (true) ;
+";
+
+    string Transpile(Stream dll)
+    {
+        using var costHints = new StringWriter();
+        var actual = Utilities.Transpile(dll, _logger, il => il.CostHints = costHints);
+
+        using var rom = Utilities.GetResource("hello.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+        AssertEx.Equal(expected, actual);
+
+        var json = costHints.ToString();
+        _logger.WriteLine($"{json}");
+        return json;
+    }
+
+    [Fact]
+    public void NESInstructionInfo_Get()
+    {
+        var lda = NESInstructionInfo.Get(NESInstruction.LDA);
+        Assert.Equal("LDA", lda.Mnemonic);
+        Assert.Equal(2, lda.Length);
+        Assert.Equal(2, lda.Cycles);
+
+        var jsr = NESInstructionInfo.Get(NESInstruction.JSR);
+        Assert.Equal(3, jsr.Length);
+        Assert.Equal(6, jsr.Cycles);
+
+        Assert.True(NESInstructionInfo.Get(NESInstruction.LDA_abs_y).PageCross);
+        Assert.Null(NESInstructionInfo.Get(0x02));
+    }
+
+    [Fact]
+    public void Write_ILOffsets()
+    {
+        using var dll = Utilities.GetResource("hello.release.dll");
+        var json = Transpile(dll);
+
+        // Without a PDB, there is a line per IL instruction that wrote code
+        Assert.Contains("{\"ilOffset\": 0, \"bytes\": 2, \"cycles\": 2, \"calls\": [], \"totalCycles\": 2, \"exact\": true},", json);
+        Assert.Contains("{\"name\": \"pal_col\", \"address\": 33342, \"cycles\": ", json);
+        Assert.Contains("{\"name\": \"pusha\", \"address\": ", json);
+    }
+
+    [Fact]
+    public void Write_PDB()
+    {
+        var references = ((string)AppContext.GetData("TRUSTED_PLATFORM_ASSEMBLIES")!)
+            .Split(Path.PathSeparator)
+            .Select(p => MetadataReference.CreateFromFile(p))
+            .Append(MetadataReference.CreateFromFile(typeof(NESLib).Assembly.Location));
+        var compilation = CSharpCompilation.Create("hello",
+            new[] { CSharpSyntaxTree.ParseText("using static NES.NESLib;\n" + HelloSource, path: "Program.cs", encoding: System.Text.Encoding.UTF8) },
+            references,
+            new CSharpCompilationOptions(OutputKind.ConsoleApplication, optimizationLevel: OptimizationLevel.Release));
+
+        using var dll = new MemoryStream();
+        var result = compilation.Emit(dll, options: new EmitOptions(debugInformationFormat: DebugInformationFormat.Embedded));
+        Assert.True(result.Success, string.Join(Environment.NewLine, result.Diagnostics));
+        dll.Position = 0;
+
+        var json = Transpile(dll);
+        var lines = json.Split('\n').Where(l => l.Contains("\"document\": \"Program.cs\"")).ToArray();
+
+        // One per statement, the infinite loop is a single JMP
+        Assert.Equal(8, lines.Length);
+        Assert.Contains("\"line\": 2, \"column\": 1, \"endLine\": 2, \"endColumn\": 18", lines[0]);
+        Assert.Contains("{\"name\": \"pal_col\"", lines[0]);
+        Assert.Contains("{\"name\": \"vram_write\"", lines[5]);
+        Assert.Contains("\"bytes\": 3, \"cycles\": 3, \"calls\": []", lines[7]);
+        foreach (var line in lines)
+        {
+            var match = Regex.Match(line, @"""totalCycles"": (\d+)");
+            Assert.True(match.Success, line);
+            Assert.True(int.Parse(match.Groups[1].Value) > 0, line);
+        }
+    }
+}
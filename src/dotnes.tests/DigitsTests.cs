@@ -0,0 +1,135 @@
+﻿using System.Text;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class DigitsTests
+{
+    readonly ILogger _logger;
+
+    public DigitsTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const ushort Address = 0x9000;
+
+    /// <summary>
+    /// Runs a routine of Digits with a value in A/X, and returns the tiles written to PPU_DATA
+    /// </summary>
+    static string Run(string name, ushort value)
+    {
+        var tiles = new StringBuilder();
+        var cpu = new NESCpu { WriteRegister = (address, tile) => { if (address == 0x2007) tiles.Append((char)tile); } };
+        var obj = Digits.Object;
+        Array.Copy(obj.Link(Address, sizeOfMain: 0), 0, cpu.Memory, Address, obj.Length);
+        ushort routine = obj.GetAddresses(Address)[name];
+        cpu.A = (byte)(value & 0xFF);
+        cpu.X = (byte)(value >> 8);
+        cpu.Run([(byte)NESInstruction.JSR, (byte)(routine & 0xFF), (byte)(routine >> 8)], 0x8000);
+        return tiles.ToString();
+    }
+
+    [Fact]
+    public void Byte()
+    {
+        for (int value = 0; value <= byte.MaxValue; value++)
+        {
+            Assert.Equal(value.ToString(), Run(Digits.Byte, (ushort)value));
+        }
+    }
+
+    [Theory]
+    [InlineData(0)]
+    [InlineData(9)]
+    [InlineData(10)]
+    [InlineData(255)]
+    [InlineData(256)]
+    [InlineData(1000)]
+    [InlineData(9999)]
+    [InlineData(10000)]
+    [InlineData(12345)]
+    [InlineData(60009)]
+    [InlineData(65535)]
+    public void UShort(int value) => Assert.Equal(value.ToString(), Run(Digits.UShort, (ushort)value));
+
+    [Theory]
+    [InlineData(Digits.HexByte, 0x42, "42")]
+    [InlineData(Digits.HexByte, 0x0F, "0F")]
+    [InlineData(Digits.HexUShort, 0x1234, "1234")]
+    [InlineData(Digits.HexUShort, 0x0099, "0099")]
+    public void Hex(string name, int value, string expected) => Assert.Equal(expected, Run(name, (ushort)value));
+
+    [Theory]
+    [InlineData("const byte score = 42;", "SCORE 42 ", "")]
+    [InlineData("const ushort score = 1234;", "SCORE 1234 ", "")]
+    [InlineData("const byte score = 0x42;", "SCORE 42 ", ":X2")]
+    public void Write_Constant(string declaration, string expected, string format)
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram($$"""
+            {{declaration}}
+            vram_adr(NTADR_A(2, 2));
+            vram_write($"SCORE {score{{format}}} ");
+            """), _logger);
+
+        // Formatted when the ROM is built, the tiles are one literal and the routines are not linked
+        Assert.Equal(expected, GetTiles(rom));
+        Assert.True(rom.AsSpan().IndexOf(Digits.Object.Data) < 0);
+    }
+
+    [Theory]
+    [InlineData("byte score = 42;", "SCORE 42 ", "")]
+    [InlineData("ushort score = 1234;", "SCORE 1234 ", "")]
+    [InlineData("byte score = 0x42;", "SCORE 42 ", ":X2")]
+    public void Write_Local(string declaration, string expected, string format)
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram($$"""
+            {{declaration}}
+            vram_adr(NTADR_A(2, 2));
+            vram_write($"SCORE {score{{format}}} ");
+            """), _logger);
+        Assert.Equal(expected, GetTiles(rom));
+        Assert.True(rom.AsSpan().IndexOf(Digits.Object.Data) > 0);
+    }
+
+    [Fact]
+    public void Write_StringTable()
+    {
+        // The literals and the format of a lowered interpolated string are only tiles, not strings in the table
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            byte score = 0x42;
+            vram_write($"SCORE {score:X2}!");
+            """), _logger);
+        Assert.True(rom.AsSpan().IndexOf("SCORE \0"u8) < 0);
+        Assert.True(rom.AsSpan().IndexOf("X2\0"u8) < 0);
+        Assert.True(rom.AsSpan().IndexOf("!\0"u8) < 0);
+
+        // Unless an ldstr still uses them
+        rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            byte score = 0x42;
+            vram_write($"SCORE {score:X2}!");
+            vram_write("SCORE ");
+            """), _logger);
+        Assert.True(rom.AsSpan().IndexOf("SCORE \0"u8) > 0);
+        Assert.True(rom.AsSpan().IndexOf("X2\0"u8) < 0);
+    }
+
+    [Theory]
+    [InlineData("int score = 42;", "{int}", "")]
+    [InlineData("const byte score = 42;", "{byte:D3}", ":D3")]
+    public void Write_NotImplemented(string declaration, string message, string format)
+    {
+        var ex = Assert.Throws<NotImplementedException>(() => Utilities.Transpile(CallGraphTests.CompileProgram($$"""
+            {{declaration}}
+            vram_write($"SCORE {score{{format}}}");
+            """), _logger));
+        Assert.Contains(message, ex.Message);
+    }
+
+    /// <summary>
+    /// The tiles written after the last vram_adr
+    /// </summary>
+    static string GetTiles(byte[] rom)
+    {
+        var writes = Utilities.RunToLoop(rom).Writes;
+        int last = writes.FindLastIndex(w => w.Item1 == 0x2006);
+        return string.Concat(writes.Skip(last + 1).Select(w => (char)w.Item2));
+    }
+}
@@ -0,0 +1,186 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class FadeTests
+{
+    readonly ILogger _logger;
+
+    public FadeTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const ushort PAL_BG_PTR = 0x08;
+    const ushort PAL_SPR_PTR = 0x0A;
+    const ushort PAL_UPDATE = 0x07;
+
+    static void Start(NESCpu cpu, Dictionary<string, ushort> routines, byte level, byte frames)
+    {
+        var pusha = NESWriter.GetFinalBuiltInAddresses(sizeOfMain: 0).First(p => p.Value == "pusha").Key;
+        Utilities.Call(cpu, pusha, a: level);
+        Utilities.Call(cpu, routines[PaletteFade.Start], a: frames);
+    }
+
+    static ushort ReadWord(NESCpu cpu, ushort address) => (ushort)(cpu.Memory[address] | cpu.Memory[address + 1] << 8);
+
+    /// <summary>
+    /// The pointer pal_bright sets for a level, into the tables after palBrightTableL and palBrightTableH
+    /// </summary>
+    static ushort GetBrightTable(NESCpu cpu, int level) => (ushort)(cpu.Memory[0x8422 + level] | cpu.Memory[0x842B + level] << 8);
+
+    [Fact]
+    public void Update()
+    {
+        var (cpu, routines) = Utilities.Load(PaletteFade.Object);
+        Start(cpu, routines, level: 0, frames: 3);
+
+        // From the normal brightness after reset, one level down every 3 frames, and the palette flagged only then
+        var levels = new List<int>();
+        for (int frame = 1; frame <= 15; frame++)
+        {
+            cpu.Memory[PAL_UPDATE] = 0;
+            Utilities.Call(cpu, routines[PaletteFade.Update]);
+            if (cpu.Memory[PAL_UPDATE] == 0)
+                continue;
+            var table = ReadWord(cpu, PAL_BG_PTR);
+            Assert.Equal(table, ReadWord(cpu, PAL_SPR_PTR));
+            int level = Enumerable.Range(0, 9).First(l => GetBrightTable(cpu, l) == table);
+            levels.Add(frame * 10 + level);
+        }
+        Assert.Equal([33, 62, 91, 120], levels);
+    }
+
+    [Fact]
+    public void Update_NotStarted()
+    {
+        // Called every frame without a fade, the normal brightness after reset is kept
+        var (cpu, routines) = Utilities.Load(PaletteFade.Object);
+        for (int frame = 0; frame < 300; frame++)
+        {
+            Utilities.Call(cpu, routines[PaletteFade.Update]);
+            Assert.Equal(0, cpu.Memory[PAL_UPDATE]);
+        }
+    }
+
+    [Fact]
+    public void Cycles()
+    {
+        foreach (var symbol in PaletteFade.Object.Symbols)
+        {
+            Assert.Equal(symbol.Cycles, NESLibBinding.Get(symbol.Name).Attribute.Cycles);
+        }
+    }
+
+    [Fact]
+    public void Start_Zero()
+    {
+        var (cpu, routines) = Utilities.Load(PaletteFade.Object);
+        Start(cpu, routines, level: 8, frames: 0);
+        Assert.NotEqual(0, cpu.Memory[PAL_UPDATE]);
+        Assert.Equal(GetBrightTable(cpu, 8), ReadWord(cpu, PAL_BG_PTR));
+
+        // Nothing more to do, so nothing to upload
+        cpu.Memory[PAL_UPDATE] = 0;
+        Utilities.Call(cpu, routines[PaletteFade.Update]);
+        Assert.Equal(0, cpu.Memory[PAL_UPDATE]);
+    }
+
+    [Fact]
+    public void SetTables()
+    {
+        var (cpu, routines) = Utilities.Load(PaletteFade.Object);
+        const ushort tables = 0xA000;
+        Utilities.Call(cpu, routines[PaletteFade.SetTables], a: tables & 0xFF, x: tables >> 8);
+        Assert.Equal(tables + 4 * 64, ReadWord(cpu, PAL_BG_PTR));
+
+        Start(cpu, routines, level: 8, frames: 1);
+        for (int level = 5; level <= 8; level++)
+        {
+            Utilities.Call(cpu, routines[PaletteFade.Update]);
+            Assert.Equal(tables + level * 64, ReadWord(cpu, PAL_BG_PTR));
+            Assert.Equal(tables + level * 64, ReadWord(cpu, PAL_SPR_PTR));
+        }
+    }
+
+    [Fact]
+    public void SetSpriteTables()
+    {
+        // The sprites fade through their own tables, the background through those of pal_bright
+        var (cpu, routines) = Utilities.Load(PaletteFade.Object);
+        const ushort tables = 0xA000;
+        Utilities.Call(cpu, routines[PaletteFade.SetSpriteTables], a: tables & 0xFF, x: tables >> 8);
+        Assert.Equal(GetBrightTable(cpu, 4), ReadWord(cpu, PAL_BG_PTR));
+        Assert.Equal(tables + 4 * 64, ReadWord(cpu, PAL_SPR_PTR));
+
+        // Then custom tables for both
+        const ushort background = 0xB000;
+        Utilities.Call(cpu, routines[PaletteFade.SetTables], a: background & 0xFF, x: background >> 8);
+        Utilities.Call(cpu, routines[PaletteFade.SetSpriteTables], a: tables & 0xFF, x: tables >> 8);
+        Start(cpu, routines, level: 0, frames: 1);
+        for (int level = 3; level >= 0; level--)
+        {
+            Utilities.Call(cpu, routines[PaletteFade.Update]);
+            Assert.Equal(background + level * 64, ReadWord(cpu, PAL_BG_PTR));
+            Assert.Equal(tables + level * 64, ReadWord(cpu, PAL_SPR_PTR));
+        }
+    }
+
+    [Fact]
+    public void To()
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            pal_col(0, 0x30);
+            ppu_on_all();
+            NES.Fade.To(0, 4);
+            ppu_wait_nmi();
+            """), _logger);
+
+        // After the one of reset, the palette is uploaded in the NMI after pal_col, and then only when the level changes, every 4 frames
+        var uploads = RunToLoop(rom).Skip(1).ToList();
+        Assert.Equal([0x30, 0x10, 0x10, 0x00, 0x0F], uploads.Select(u => u.Color));
+        for (int i = 2; i < uploads.Count; i++)
+        {
+            Assert.Equal(4, uploads[i].Frame - uploads[i - 1].Frame);
+        }
+    }
+
+    [Fact]
+    public void Update_Boot()
+    {
+        // RAM is not cleared on power up, the reset path of Boot clears the state of Fade with the rest
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            pal_col(0, 0x30);
+            ppu_on_all();
+            NES.Fade.Update();
+            ppu_wait_nmi();
+            """), _logger, il => il.CodeOptimizations = CodeOptimizations.Boot);
+
+        var cpu = Utilities.RunToLoop(rom, (_, _, _) => { }, fill: 0xFF);
+        Assert.Equal(new byte[8], cpu.Memory.Skip(0x01B8).Take(8));
+    }
+
+    [Fact]
+    public void To_NotCalled()
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            pal_col(0, 0x30);
+            ppu_on_all();
+            """), _logger);
+        Assert.True(rom.AsSpan().IndexOf(PaletteFade.Object.Code) < 0);
+    }
+
+    /// <summary>
+    /// Runs a ROM from reset to `while (true) ;`, and returns the frame and background color of each palette upload
+    /// </summary>
+    static List<(int Frame, byte Color)> RunToLoop(byte[] rom)
+    {
+        var uploads = new List<(int Frame, byte Color)>();
+        var writes = new List<(ushort Address, byte Value)>();
+        Utilities.RunToLoop(rom, (cpu, address, value) =>
+        {
+            // The background color is the first write to PPU_DATA after PPU_ADDR is set to $3F00
+            if (address == 0x2007 && writes is [.., (0x2006, 0x3F), (0x2006, 0x00)])
+                uploads.Add(((int)(cpu.Cycles / 29781), value));
+            writes.Add((address, value));
+        });
+        return uploads;
+    }
+}
@@ -188,4 +188,33 @@ public class IL2NESWriterTests
         var expected = Utilities.ToByteArray("A91C A286 202B82 A220 A900 20D483 A916 208D85 A203 A9C0 20DF83 A9DC A285 20A385 A200 A940 204F83 208982 4C2B85");
         AssertEx.Equal(expected, writer);
     }
+
+    [Fact]
+    public void Write_Stloc_ushort()
+    {
+        // ushort score = 1234; stores its value, the path used to store $03C0 whatever the value
+        const ushort sizeOfMain = 0x20;
+        using var writer = GetWriter();
+        writer.Write(ILOpCode.Ldc_i4, 1234, sizeOfMain);
+        writer.Write(ILOpCode.Stloc_0, sizeOfMain);
+        writer.Flush();
+
+        Assert.Equal("A204A9D28D24038E2503A928A286", Convert.ToHexString(stream.ToArray()));
+    }
+
+    [Fact]
+    public void Write_Stloc_Returned()
+    {
+        // byte r = rand8(); vram_put(r); stores the value rand8 returns in A
+        const ushort sizeOfMain = 0x20;
+        using var writer = GetWriter();
+        writer.LinkedAddresses = new Dictionary<string, ushort> { [nameof(rand8)] = 0x9000 };
+        writer.Write(ILOpCode.Call, NESLibBinding.Get(nameof(rand8)), sizeOfMain);
+        writer.Write(ILOpCode.Stloc_0, sizeOfMain);
+        writer.Write(ILOpCode.Ldloc_0, sizeOfMain);
+        writer.Write(ILOpCode.Call, NESLibBinding.Get(nameof(vram_put)), sizeOfMain);
+        writer.Flush();
+
+        Assert.Equal("2000908D2403AD240320DB83", Convert.ToHexString(stream.ToArray()));
+    }
 }
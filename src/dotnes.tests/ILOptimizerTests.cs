@@ -0,0 +1,276 @@
+﻿using System.Reflection.Metadata;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class ILOptimizerTests
+{
+    readonly ILogger _logger;
+
+    public ILOptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    static ILInstruction[] ReadStaticVoidMain(string name)
+    {
+        using var transpiler = new Transpiler(Utilities.GetResource($"{name}.dll"), Array.Empty<AssemblyReader>());
+        return transpiler.ReadStaticVoidMain().ToArray();
+    }
+
+    [Theory]
+    [InlineData("onelocal", true)]
+    [InlineData("onelocal", false)]
+    [InlineData("onelocalbyte", true)]
+    [InlineData("onelocalbyte", false)]
+    public void Optimize_SameILAsAttributeTable(string name, bool debug)
+    {
+        var configuration = debug ? "debug" : "release";
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(ReadStaticVoidMain($"{name}.{configuration}"), ILOptimizations.All);
+        var expected = ReadStaticVoidMain($"attributetable.{configuration}");
+
+        // Offsets still point at the original IL
+        Assert.Equal(expected.Select(i => i.ToString()), actual.Select(i => i.ToString()));
+        Assert.Equal(1, optimizer.Changes[ILOptimizations.ConstantPropagation]);
+        Assert.Equal(1, optimizer.Changes[ILOptimizations.DeadStores]);
+    }
+
+    [Theory]
+    [InlineData("onelocal")]
+    [InlineData("onelocalbyte")]
+    public void Write(string name)
+    {
+        // Without the local, the ROM is the same as attributetable
+        using var rom = Utilities.GetResource("attributetable.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        using var dll = Utilities.GetResource($"{name}.release.dll");
+        AssertEx.Equal(expected, Utilities.Transpile(dll, _logger, il => il.Optimizations = ILOptimizations.All));
+    }
+
+    [Fact]
+    public void DeadStores_LocalIsRead()
+    {
+        var main = ReadStaticVoidMain("onelocal.release");
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.DeadStores);
+
+        Assert.Equal(main, actual);
+        Assert.Empty(optimizer.Changes);
+    }
+
+    [Fact]
+    public void DeadCode()
+    {
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Nop) { Offset = 0 },
+            new ILInstruction(ILOpCode.Call, String: "ppu_on_all") { Offset = 1 },
+            new ILInstruction(ILOpCode.Br_s, 254) { Offset = 6 },
+            new ILInstruction(ILOpCode.Ldc_i4_0) { Offset = 8 },
+            new ILInstruction(ILOpCode.Call, String: "ppu_on_bg") { Offset = 9 },
+        };
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.DeadCode);
+
+        Assert.Equal(new[] { main[1], main[2] }, actual);
+        Assert.Equal(3, optimizer.Changes[ILOptimizations.DeadCode]);
+    }
+
+    [Fact]
+    public void DeadCode_BranchTarget()
+    {
+        // br.s +1 skips over the ldc, but the call is reachable
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Br_s, 1) { Offset = 0 },
+            new ILInstruction(ILOpCode.Ldc_i4_0) { Offset = 2 },
+            new ILInstruction(ILOpCode.Call, String: "ppu_on_all") { Offset = 3 },
+        };
+        var actual = new ILOptimizer(_logger).Optimize(main, ILOptimizations.DeadCode);
+
+        Assert.Equal(new[] { main[0], main[2] }, actual);
+    }
+
+    [Fact]
+    public void DeadCode_NopIsTarget()
+    {
+        // while (true) ppu_on_all(); in a debug build, the br.s jumps back to the nop
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Nop) { Offset = 0 },
+            new ILInstruction(ILOpCode.Call, String: "ppu_on_all") { Offset = 1 },
+            new ILInstruction(ILOpCode.Br_s, 0xF8) { Offset = 6 },
+        };
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.DeadCode);
+
+        Assert.Equal(main, actual);
+        Assert.Empty(optimizer.Changes);
+    }
+
+    [Fact]
+    public void CopyPropagation()
+    {
+        // byte a = 5; byte b = a; vram_put(b);
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldc_i4_5) { Offset = 0 },
+            new ILInstruction(ILOpCode.Stloc_0) { Offset = 1 },
+            new ILInstruction(ILOpCode.Ldloc_0) { Offset = 2 },
+            new ILInstruction(ILOpCode.Stloc_1) { Offset = 3 },
+            new ILInstruction(ILOpCode.Ldloc_1) { Offset = 4 },
+            new ILInstruction(ILOpCode.Call, String: "vram_put") { Offset = 5 },
+        };
+
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.CopyPropagation | ILOptimizations.DeadStores);
+        Assert.Equal(new[] { main[0], main[1], main[2] with { Offset = 4 }, main[5] }, actual);
+        Assert.Equal(1, optimizer.Changes[ILOptimizations.CopyPropagation]);
+
+        optimizer = new ILOptimizer(_logger);
+        actual = optimizer.Optimize(main, ILOptimizations.All);
+        Assert.Equal(new[] { main[0] with { Offset = 4 }, main[5] }, actual);
+    }
+
+    [Fact]
+    public void CopyPropagation_SourceChanges()
+    {
+        // byte a = 5; byte b = a; a = 6; vram_put(b);
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldc_i4_5) { Offset = 0 },
+            new ILInstruction(ILOpCode.Stloc_0) { Offset = 1 },
+            new ILInstruction(ILOpCode.Ldloc_0) { Offset = 2 },
+            new ILInstruction(ILOpCode.Stloc_1) { Offset = 3 },
+            new ILInstruction(ILOpCode.Ldc_i4_6) { Offset = 4 },
+            new ILInstruction(ILOpCode.Stloc_0) { Offset = 5 },
+            new ILInstruction(ILOpCode.Ldloc_1) { Offset = 6 },
+            new ILInstruction(ILOpCode.Call, String: "vram_put") { Offset = 7 },
+        };
+
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.CopyPropagation);
+        Assert.Equal(main, actual);
+        Assert.Empty(optimizer.Changes);
+    }
+
+    [Fact]
+    public void ConstantPropagation_FunctionPointer()
+    {
+        // delegate*<void> f = &Draw; f();
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldftn, String: "Draw") { Offset = 0 },
+            new ILInstruction(ILOpCode.Stloc_0) { Offset = 6 },
+            new ILInstruction(ILOpCode.Ldloc_0) { Offset = 7 },
+            new ILInstruction(ILOpCode.Calli) { Offset = 8 },
+        };
+
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.ConstantPropagation | ILOptimizations.DeadStores);
+        Assert.Equal(new[] { main[0] with { Offset = 7 }, main[3] }, actual);
+        Assert.Equal(1, optimizer.Changes[ILOptimizations.ConstantPropagation]);
+    }
+
+    [Fact]
+    public void ConstantFolding_Flags()
+    {
+        // var a = Layers.Background; var f = a | Layers.Sprites; if ((f & Layers.Sprites) != 0) vram_put(0x41); while (true) ;
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldc_i4_1) { Offset = 0 },
+            new ILInstruction(ILOpCode.Stloc_0) { Offset = 1 },
+            new ILInstruction(ILOpCode.Ldloc_0) { Offset = 2 },
+            new ILInstruction(ILOpCode.Ldc_i4_2) { Offset = 3 },
+            new ILInstruction(ILOpCode.Or) { Offset = 4 },
+            new ILInstruction(ILOpCode.Stloc_1) { Offset = 5 },
+            new ILInstruction(ILOpCode.Ldloc_1) { Offset = 6 },
+            new ILInstruction(ILOpCode.Ldc_i4_2) { Offset = 7 },
+            new ILInstruction(ILOpCode.And) { Offset = 8 },
+            new ILInstruction(ILOpCode.Brfalse_s, 7) { Offset = 9 },
+            new ILInstruction(ILOpCode.Ldc_i4_s, 0x41) { Offset = 11 },
+            new ILInstruction(ILOpCode.Call, String: "vram_put") { Offset = 13 },
+            new ILInstruction(ILOpCode.Br_s, 254) { Offset = 18 },
+        };
+
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.All);
+        Assert.Equal(new[] { main[10], main[11], main[12] }, actual);
+        Assert.Equal(3, optimizer.Changes[ILOptimizations.ConstantFolding]);
+    }
+
+    [Fact]
+    public void ConstantFolding_Branch()
+    {
+        // if (0 == 0) skips the vram_put, the br.s left behind jumps to the next instruction
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldc_i4_0) { Offset = 0 },
+            new ILInstruction(ILOpCode.Brfalse_s, 7) { Offset = 1 },
+            new ILInstruction(ILOpCode.Ldc_i4_s, 0x41) { Offset = 3 },
+            new ILInstruction(ILOpCode.Call, String: "vram_put") { Offset = 5 },
+            new ILInstruction(ILOpCode.Call, String: "ppu_on_all") { Offset = 10 },
+        };
+
+        var actual = new ILOptimizer(_logger).Optimize(main, ILOptimizations.ConstantFolding | ILOptimizations.DeadCode);
+        Assert.Equal(new[] { main[4] }, actual);
+    }
+
+    [Fact]
+    public void ConstantFolding_BranchIsTarget()
+    {
+        // The br.s to the next instruction is where the brtrue.s lands, so it stays
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldloc_0) { Offset = 0 },
+            new ILInstruction(ILOpCode.Brtrue_s, 0) { Offset = 1 },
+            new ILInstruction(ILOpCode.Br_s, 0) { Offset = 3 },
+            new ILInstruction(ILOpCode.Call, String: "ppu_on_all") { Offset = 5 },
+        };
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.ConstantFolding | ILOptimizations.DeadCode);
+
+        Assert.Equal(main, actual);
+        Assert.Empty(optimizer.Changes);
+    }
+
+    [Theory]
+    [InlineData(0xFD, (int)ILOpCode.Ldc_i4_0, (int)ILOpCode.Clt, 1)]
+    [InlineData(0xFA, (int)ILOpCode.Ldc_i4_2, (int)ILOpCode.Div, -3)]
+    [InlineData(0xF8, (int)ILOpCode.Ldc_i4_1, (int)ILOpCode.Shr, -4)]
+    [InlineData(0xFF, (int)ILOpCode.Ldc_i4_m1, (int)ILOpCode.Add, -2)]
+    public void ConstantFolding_Negative(int left, int right, int code, int expected)
+    {
+        // The operand of ldc.i4.s is decoded as an unsigned byte, 0xFD is -3
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldc_i4_s, left) { Offset = 0 },
+            new ILInstruction((ILOpCode)right) { Offset = 2 },
+            new ILInstruction((ILOpCode)code) { Offset = 3 },
+            new ILInstruction(ILOpCode.Pop) { Offset = 4 },
+        };
+
+        var actual = new ILOptimizer(_logger).Optimize(main, ILOptimizations.ConstantFolding);
+        Assert.Equal(new[] { new ILInstruction(ILOpCode.Ldc_i4, expected) { Offset = 0 }, main[3] }, actual);
+    }
+
+    [Theory]
+    [InlineData((int)ILOpCode.Div)]
+    [InlineData((int)ILOpCode.Rem)]
+    public void ConstantFolding_Overflow(int code)
+    {
+        // int.MinValue / -1 overflows, it is not folded
+        var main = new[]
+        {
+            new ILInstruction(ILOpCode.Ldc_i4, int.MinValue) { Offset = 0 },
+            new ILInstruction(ILOpCode.Ldc_i4_m1) { Offset = 5 },
+            new ILInstruction((ILOpCode)code) { Offset = 6 },
+            new ILInstruction(ILOpCode.Pop) { Offset = 7 },
+        };
+
+        var optimizer = new ILOptimizer(_logger);
+        var actual = optimizer.Optimize(main, ILOptimizations.ConstantFolding);
+        Assert.Equal(main, actual);
+        Assert.False(optimizer.Changes.ContainsKey(ILOptimizations.ConstantFolding));
+    }
+}
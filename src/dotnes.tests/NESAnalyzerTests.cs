@@ -0,0 +1,193 @@
+﻿using System.Collections.Immutable;
+using dotnes.analyzers;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CodeActions;
+using Microsoft.CodeAnalysis.CodeFixes;
+using Microsoft.CodeAnalysis.CSharp;
+using Microsoft.CodeAnalysis.Diagnostics;
+using Microsoft.CodeAnalysis.Text;
+
+namespace dotnes.tests;
+
+public class NESAnalyzerTests
+{
+    static readonly MetadataReference[] References = ((string)AppContext.GetData("TRUSTED_PLATFORM_ASSEMBLIES")!)
+        .Split(Path.PathSeparator)
+        .Select(p => MetadataReference.CreateFromFile(p))
+        .Append(MetadataReference.CreateFromFile(typeof(NESLib).Assembly.Location))
+        .ToArray();
+
+    class CostHintsText(string text) : AdditionalText
+    {
+        public override string Path => "/obj/hello.nescost.json";
+
+        public override SourceText GetText(CancellationToken cancellationToken = default) => SourceText.From(text);
+    }
+
+    static async Task<ImmutableArray<Diagnostic>> GetDiagnostics(string source, string? costHints = null, MetadataReference? library = null)
+    {
+        var compilation = CSharpCompilation.Create("hello",
+            new[] { CSharpSyntaxTree.ParseText("using static NES.NESLib;\n" + source, path: "/src/Program.cs") },
+            library is null ? References : References.Append(library),
+            new CSharpCompilationOptions(OutputKind.ConsoleApplication, allowUnsafe: true));
+        Assert.Empty(compilation.GetDiagnostics().Where(d => d.Severity == DiagnosticSeverity.Error));
+        return await compilation
+            .WithAnalyzers(ImmutableArray.Create<DiagnosticAnalyzer>(new NESAnalyzer()),
+                new AnalyzerOptions(costHints is null ? ImmutableArray<AdditionalText>.Empty : ImmutableArray.Create<AdditionalText>(new CostHintsText(costHints))))
+            .GetAnalyzerDiagnosticsAsync();
+    }
+
+    static async Task AssertDiagnostics(string source, params string[] expected)
+    {
+        var diagnostics = await GetDiagnostics(source);
+        Assert.Equal(expected, diagnostics.Select(d => d.Id).OrderBy(id => id).ToArray());
+    }
+
+    static async Task<string> ApplyFix(string source)
+    {
+        var diagnostic = (await GetDiagnostics(source)).First(d => d.Severity == DiagnosticSeverity.Info);
+
+        using var workspace = new AdhocWorkspace();
+        var document = workspace.AddProject("hello", LanguageNames.CSharp)
+            .WithMetadataReferences(References)
+            .AddDocument("Program.cs", SourceText.From("using static NES.NESLib;\n" + source));
+        var actions = new List<CodeAction>();
+        var context = new CodeFixContext(document, diagnostic, (a, _) => actions.Add(a), CancellationToken.None);
+        await new NESCodeFixProvider().RegisterCodeFixesAsync(context);
+
+        var action = Assert.Single(actions);
+        var operation = (await action.GetOperationsAsync(CancellationToken.None)).OfType<ApplyChangesOperation>().Single();
+        var text = await operation.ChangedSolution.GetDocument(document.Id)!.GetTextAsync();
+        return text.ToString().Substring("using static NES.NESLib;\n".Length);
+    }
+
+    [Fact]
+    public Task SupportedNESLibMethods() => AssertDiagnostics("""
+        pal_col(0, 0x02);
+        vram_adr(NTADR_A(2, 2));
+        ppu_on_all();
+        while (true) ;
+        """);
+
+    [Fact]
+    public Task SupportedFadeMethods() => AssertDiagnostics("""
+        ppu_on_all();
+        NES.Fade.To(0, 4);
+        while (true) ;
+        """);
+
+    [Fact]
+    public Task UnsupportedNESLibMethod() => AssertDiagnostics("""
+        byte next = oam_spr(40, 40, 0x10, 0, 0);
+        while (true) ;
+        """, "NES001");
+
+    [Fact]
+    public Task UnsupportedMethod() => AssertDiagnostics("""
+        System.Console.WriteLine("hello");
+        while (true) ;
+        """, "NES002");
+
+    [Theory]
+    // A local function, a generic instantiation, and calls through a delegate and a function pointer
+    [InlineData("Draw(); static void Draw() => ppu_on_all();")]
+    [InlineData("Put<byte>(1); static void Put<T>(T value) { }")]
+    [InlineData("System.Action a = Draw; a(); static void Draw() => ppu_on_all();")]
+    [InlineData("unsafe { delegate*<void> f = &Draw; f(); } static void Draw() => ppu_on_all();")]
+    // A static interface member called on a type parameter
+    [InlineData("Spawn<Bat>(); static void Spawn<T>() where T : IActor => T.Draw(); interface IActor { static abstract void Draw(); } struct Bat : IActor { public static void Draw() => ppu_on_all(); }")]
+    public Task SupportedMethods(string source) => AssertDiagnostics(source);
+
+    [Fact]
+    public async Task SupportedLibraryMethods()
+    {
+        // A class library, or a project reference, built against neslib
+        using var engine = Utilities.Compile("namespace Engine; public static class Title { public static void Draw() => NES.NESLib.ppu_on_all(); }",
+            "Engine", OutputKind.DynamicallyLinkedLibrary);
+        var diagnostics = await GetDiagnostics("Engine.Title.Draw();", library: MetadataReference.CreateFromImage(engine.ToArray()));
+        Assert.Empty(diagnostics);
+    }
+
+    [Theory]
+    [InlineData("int x = 10; vram_put((byte)x);", "NES100")]
+    [InlineData("ushort x = 255; vram_put((byte)x);", "NES100")]
+    [InlineData("int x = 256; vram_put((byte)x);", null)]
+    [InlineData("int x = 10; x += 1000; vram_put((byte)x);", null)]
+    [InlineData("const int x = 10; vram_put((byte)x);", null)]
+    [InlineData("byte x = 10; vram_put(x);", null)]
+    [InlineData("ulong x = 0xFFFF_FFFF_FFFF_FFFFUL; vram_put((byte)x);", null)]
+    public Task WideLocal(string source, string? expected) => AssertDiagnostics(source, expected is null ? Array.Empty<string>() : new[] { expected });
+
+    [Theory]
+    [InlineData("for (int i = 0; i < 32; i++) vram_put((byte)i);", "NES101")]
+    [InlineData("for (int i = 0; i <= 255; i++) vram_put((byte)i);", null)]
+    [InlineData("for (int i = 0; i < 300; i++) vram_put((byte)i);", null)]
+    [InlineData("for (int i = 0; i < 32; i++) { i += 2; vram_put((byte)i); }", null)]
+    [InlineData("for (byte i = 0; i < 32; i++) vram_put(i);", null)]
+    [InlineData("for (ulong i = 0; i < 32UL; i++) vram_put((byte)i);", "NES101")]
+    [InlineData("for (ulong i = 0; i < 0xFFFF_FFFF_FFFF_FFFFUL; i++) vram_put((byte)i);", null)]
+    [InlineData("for (int i = 0; i < 2.5; i++) vram_put((byte)i);", null)]
+    public Task WideLoopCounter(string source, string? expected) => AssertDiagnostics(source, expected is null ? Array.Empty<string>() : new[] { expected });
+
+    [Theory]
+    [InlineData("for (byte i = 0; i < 32; i++) vram_put((byte)(i * 8));", "NES102")]
+    [InlineData("for (byte i = 0; i < 32; i++) vram_put((byte)(i % 3));", "NES102")]
+    [InlineData("for (byte i = 0; i < 32; i++) vram_put((byte)(4 * 8));", null)]
+    [InlineData("byte i = 3; vram_put((byte)(i * 8));", null)]
+    public Task MultiplyInLoop(string source, string? expected) => AssertDiagnostics(source, expected is null ? Array.Empty<string>() : new[] { expected });
+
+    [Fact]
+    public Task ArrayOfStructs() => AssertDiagnostics("""
+        var actors = new Actor[4];
+        actors[0].X = 1;
+        for (byte i = 0; i < 4; i++)
+            vram_put(actors[i].X);
+        struct Actor { public byte X, Y; }
+        """, "NES103");
+
+    [Fact]
+    public async Task Fix_WideLocal()
+    {
+        var actual = await ApplyFix("int x = 10; vram_put((byte)x);");
+        Assert.Equal("byte x = 10; vram_put((byte)x);", actual);
+    }
+
+    [Fact]
+    public async Task Fix_WideLoopCounter()
+    {
+        var actual = await ApplyFix("for (int i = 0; i < 32; i++) vram_put((byte)i);");
+        Assert.Equal("for (byte i = 0; i < 32; i++) vram_put((byte)i);", actual);
+    }
+
+    [Fact]
+    public async Task Fix_MultiplyInLoop()
+    {
+        var actual = await ApplyFix("for (byte i = 0; i < 32; i++) vram_put((byte)(i * 8 + 1));");
+        Assert.Equal("for (byte i = 0; i < 32; i++) vram_put((byte)((i << 3) + 1));", actual);
+    }
+
+    [Fact]
+    public async Task StatementCost()
+    {
+        var diagnostics = await GetDiagnostics("""
+            pal_col(0, 0x02);
+            ppu_on_all();
+            while (true) ;
+            """, """
+            {
+              "statements": [
+                {"ilOffset": 0, "document": "/home/user/hello/Program.cs", "line": 2, "column": 1, "endLine": 2, "endColumn": 18, "bytes": 10, "cycles": 16, "calls": [{"name": "pusha", "address": 34210, "cycles": 24, "exact": false}, {"name": "pal_col", "address": 33342, "cycles": 52, "exact": false}], "totalCycles": 92, "exact": false},
+                {"ilOffset": 7, "document": "/home/user/hello/Program.cs", "line": 3, "column": 1, "endLine": 3, "endColumn": 14, "bytes": 3, "cycles": 6, "calls": [{"name": "ppu_on_all", "address": 33417, "cycles": 30, "exact": true}], "totalCycles": 36, "exact": true},
+                {"ilOffset": 12, "document": "/home/user/hello/Other.cs", "line": 1, "column": 1, "endLine": 1, "endColumn": 2, "bytes": 3, "cycles": 3, "calls": [], "totalCycles": 3, "exact": true}
+              ]
+            }
+            """);
+
+        var costs = diagnostics.Where(d => d.Id == "NES104").OrderBy(d => d.Location.SourceSpan.Start).ToArray();
+        Assert.Equal(2, costs.Length);
+        Assert.Equal("10 bytes, at least 92 cycles including pusha, pal_col", costs[0].GetMessage());
+        Assert.Equal("pal_col(0, 0x02);", costs[0].Location.SourceTree!.GetText().ToString(costs[0].Location.SourceSpan));
+        Assert.Equal("3 bytes, 36 cycles including ppu_on_all", costs[1].GetMessage());
+        Assert.Equal("ppu_on_all();", costs[1].Location.SourceTree!.GetText().ToString(costs[1].Location.SourceSpan));
+    }
+}
@@ -0,0 +1,64 @@
+﻿namespace dotnes.tests;
+
+public class NESCpuTests
+{
+    [Theory]
+    // CLC, LDA #$7F, ADC #$01: overflow into the sign bit
+    [InlineData("18A97F6901", 0x80, false, true)]
+    // SEC, LDA #$00, SBC #$01: borrow
+    [InlineData("38A900E901", 0xFF, false, false)]
+    // LDA #$80, CMP #$80, ROR A: arithmetic shift right
+    [InlineData("A980C9806A", 0xC0, false, false)]
+    // LDA #$05, PHA, LDA #$00, PLA
+    [InlineData("A90548A90068", 0x05, false, false)]
+    // LDA #$F3, ALR #$0F: A = $03 >> 1, carry from bit 0
+    [InlineData("A9F34B0F", 0x01, true, false)]
+    // LDA #$F3, ANC #$F0: carry from the sign
+    [InlineData("A9F30BF0", 0xF0, true, false)]
+    // LDX #$10, LDA #$FF, AXS #$04, TXA: X = $0C without borrow
+    [InlineData("A210A9FFCB048A", 0x0C, true, false)]
+    // LDA #$05, STA $10, LAX $10, INX, TXA
+    [InlineData("A9058510A710E88A", 0x06, false, false)]
+    public void Run(string code, int a, bool carry, bool overflow)
+    {
+        var cpu = new NESCpu();
+        cpu.Run(Convert.FromHexString(code), 0x8000);
+
+        Assert.Equal((byte)a, cpu.A);
+        Assert.Equal(carry, cpu.C);
+        Assert.Equal(overflow, cpu.V);
+        Assert.Equal(0xFD, cpu.S);
+    }
+
+    [Fact]
+    public void Run_Subroutine()
+    {
+        var cpu = new NESCpu();
+        // LDX #$03, STX $0200, RTS
+        cpu.Memory[0x9000] = 0xA2;
+        cpu.Memory[0x9001] = 0x03;
+        cpu.Memory[0x9002] = 0x8E;
+        cpu.Memory[0x9003] = 0x00;
+        cpu.Memory[0x9004] = 0x02;
+        cpu.Memory[0x9005] = 0x60;
+
+        // JSR $9000, INX
+        cpu.Run([0x20, 0x00, 0x90, 0xE8], 0x8000);
+
+        Assert.Equal(4, cpu.X);
+        Assert.Equal(3, cpu.Memory[0x0200]);
+        Assert.Equal(6 + 2 + 4 + 6 + 2, cpu.Cycles);
+    }
+
+    [Fact]
+    public void Run_Branch()
+    {
+        // LDX #$03, DEX, BNE -3: 2 + 3 * 2 + 2 * 3 + 2
+        var cpu = new NESCpu();
+        cpu.Run([0xA2, 0x03, 0xCA, 0xD0, 0xFD], 0x8000);
+
+        Assert.Equal(0, cpu.X);
+        Assert.True(cpu.Z);
+        Assert.Equal(16, cpu.Cycles);
+    }
+}
@@ -0,0 +1,99 @@
+﻿using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CSharp;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class NESLibBindingTests
+{
+    readonly ILogger _logger;
+
+    public NESLibBindingTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Fact]
+    public void Addresses()
+    {
+        using var memoryStream = new MemoryStream();
+        using (var writer = new NESWriter(memoryStream, leaveOpen: true))
+        {
+            writer.WriteBuiltIns(sizeOfMain: 0);
+        }
+        var builtIns = memoryStream.ToArray();
+
+        foreach (var binding in NESLibBinding.All.Where(b => !b.IsIntrinsic && !b.IsLinked))
+        {
+            using var stream = new MemoryStream();
+            using (var writer = new NESWriter(stream, leaveOpen: true))
+            {
+                writer.WriteBuiltIn(binding.Name, sizeOfMain: 0);
+            }
+            var expected = stream.ToArray();
+            var actual = builtIns.AsSpan(binding.Address - 0x8000, expected.Length).ToArray();
+            Assert.True(expected.AsSpan().SequenceEqual(actual), $"{binding.Name} is not at ${binding.Address:X4}");
+        }
+    }
+
+    [Fact]
+    public void Get()
+    {
+        var binding = NESLibBinding.Get(nameof(NESLib.pal_col));
+        Assert.Equal(0x823E, binding.Address);
+        Assert.Equal(2, binding.ParameterCount);
+        Assert.Equal(new BuiltInEffects(Registers.A, Y: 0), binding.Effects);
+
+        // Overloads share a binding
+        Assert.Equal(1, NESLibBinding.Get(nameof(NESLib.vram_write)).ParameterCount);
+        Assert.True(NESLibBinding.Get(nameof(NESLib.NTADR_A)).IsIntrinsic);
+
+        // Other classes of neslib are bound by full name, from the attribute alone
+        Assert.Equal(2, NESLibBinding.Get($"{typeof(Fade).FullName}.{nameof(Fade.To)}").ParameterCount);
+        Assert.Equal(1, NESLibBinding.Get(nameof(NESLib.rand8)).ReturnSize);
+        Assert.Equal(2, NESLibBinding.Get(nameof(NESLib.rand16)).ReturnSize);
+    }
+
+    [Fact]
+    public void Get_NotImplemented()
+    {
+        // There is no routine for oam_spr in PRG_ROM
+        Assert.Throws<NotImplementedException>(() => NESLibBinding.Get(nameof(NESLib.oam_spr)));
+        Assert.Null(NESLibBinding.TryGet(nameof(NESLib.oam_spr)));
+        Assert.Equal(BuiltInEffects.Unknown, BuiltInEffects.Get(nameof(NESLib.oam_spr)));
+    }
+
+    [Fact]
+    public void Write()
+    {
+        // Methods are bound from their [NESBuiltIn] attribute, not a list in the transpiler
+        using var dll = Compile("""
+            using static NES.NESLib;
+
+            pal_bright(2);
+            delay(1);
+            ppu_on_all();
+            while (true) ;
+            """);
+        var rom = Utilities.Transpile(dll, _logger);
+
+        const int main = 16 + 0x500;
+        var code = Convert.ToHexString(rom, main, 16);
+        Assert.StartsWith("A902207982A901201A84208982", code);
+    }
+
+    static Stream Compile(string source)
+    {
+        var references = ((string)AppContext.GetData("TRUSTED_PLATFORM_ASSEMBLIES")!)
+            .Split(Path.PathSeparator)
+            .Select(p => MetadataReference.CreateFromFile(p))
+            .Append(MetadataReference.CreateFromFile(typeof(NESLib).Assembly.Location));
+        var compilation = CSharpCompilation.Create("bindings",
+            new[] { CSharpSyntaxTree.ParseText(source) },
+            references,
+            new CSharpCompilationOptions(OutputKind.ConsoleApplication, optimizationLevel: OptimizationLevel.Release));
+
+        var dll = new MemoryStream();
+        var result = compilation.Emit(dll);
+        Assert.True(result.Success, string.Join(Environment.NewLine, result.Diagnostics));
+        dll.Position = 0;
+        return dll;
+    }
+}
@@ -0,0 +1,208 @@
+﻿using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CSharp;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class NESObjectTests
+{
+    readonly ILogger _logger;
+
+    public NESObjectTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const string Draw = """
+        pal_col(0, 0x02);
+        pal_col(1, 0x14);
+        pal_bg(new byte[] { 0x0F, 0x01, 0x02, 0x03, 0x0F, 0x11, 0x12, 0x13, 0x0F, 0x21, 0x22, 0x23, 0x0F, 0x31, 0x32, 0x33 });
+        vram_adr(NAMETABLE_A);
+        vram_put(0x41);
+        """;
+
+    const string Library = $$"""
+        using static NES.NESLib;
+
+        namespace Engine;
+
+        public static class Title
+        {
+            public static void Draw()
+            {
+                {{Draw}}
+            }
+
+            public static void Clear() => pal_clear();
+
+            static void Hidden() => pal_clear();
+        }
+        """;
+
+    [Fact]
+    public void TranspileObject()
+    {
+        var obj = TranspileLibrary(CompileLibrary(Library));
+
+        Assert.Equal(["Engine.Title.Draw", "Engine.Title.Clear"], obj.Symbols.Select(s => s.Name));
+        var draw = obj.Symbols[0];
+        var clear = obj.Symbols[1];
+        Assert.Equal(0, draw.Offset);
+        Assert.Equal(draw.Length, clear.Offset);
+        Assert.Equal(obj.Code.Length, clear.Offset + clear.Length);
+        Assert.Equal((byte)NESInstruction.RTS_impl, obj.Code[draw.Length - 1]);
+        Assert.Equal("204E8260", Convert.ToHexString(obj.Code, clear.Offset, clear.Length));
+        Assert.True(draw.Cycles > clear.Cycles);
+        Assert.Equal(16, obj.Data.Length);
+
+        // pal_col pushes its first argument with pusha, after main
+        Assert.True(obj.Relocations.Any(r => r.Kind == NESObject.RelocationKind.AfterMain));
+        Assert.Equal(1, obj.Relocations.Count(r => r.Kind == NESObject.RelocationKind.DataLow && r.Addend == 0));
+        Assert.Equal(1, obj.Relocations.Count(r => r.Kind == NESObject.RelocationKind.DataHigh && r.Addend == 0));
+    }
+
+    [Fact]
+    public void ReadWrite()
+    {
+        var expected = TranspileLibrary(CompileLibrary(Library));
+        using var writer = new StringWriter();
+        expected.Write(writer);
+        _logger.WriteLine($"{writer}");
+
+        var actual = NESObject.Read(new StringReader(writer.ToString()));
+        Assert.Equal(expected.Code, actual.Code);
+        Assert.Equal(expected.Data, actual.Data);
+        Assert.Equal(expected.Symbols, actual.Symbols);
+        Assert.Equal(expected.Relocations, actual.Relocations);
+    }
+
+    [Fact]
+    public void ReadWrite_Code()
+    {
+        // The routines of Fade call each other, the addresses are fixed up where the object is linked
+        var expected = PaletteFade.Object;
+        Assert.True(expected.Relocations.Any(r => r.Kind == NESObject.RelocationKind.Code));
+        using var writer = new StringWriter();
+        expected.Write(writer);
+
+        var actual = NESObject.Read(new StringReader(writer.ToString()));
+        Assert.Equal(expected.Relocations, actual.Relocations);
+        Assert.Equal(expected.Link(0x9000, sizeOfMain: 6), actual.Link(0x9000, sizeOfMain: 6));
+    }
+
+    [Theory]
+    [InlineData("version 2")]
+    [InlineData("code 123")]
+    [InlineData("symbol Engine.Title.Draw $0000")]
+    public void Read_Invalid(string line)
+    {
+        Assert.Throws<FormatException>(() => NESObject.Read(new StringReader(line)));
+    }
+
+    [Fact]
+    public void Link()
+    {
+        var library = CompileLibrary(Library);
+        var obj = TranspileLibrary(new MemoryStream(library));
+        var linked = Utilities.Transpile(CompileProgram("Engine.Title.Draw();", library), _logger, il => il.Objects = [obj]);
+        var inline = Utilities.Transpile(CompileProgram(Draw), _logger);
+
+        // main is JSR Engine.Title.Draw and JMP to itself, the method is after the destructor table
+        const int main = 16 + 0x500;
+        const ushort sizeOfMain = 6;
+        Assert.Equal((byte)NESInstruction.JSR, linked[main]);
+        Assert.Equal((byte)NESInstruction.JMP_abs, linked[main + 3]);
+        ushort address = (ushort)(linked[main + 1] | linked[main + 2] << 8);
+        Assert.Equal(Convert.ToHexString(obj.Link(address, sizeOfMain)), Convert.ToHexString(linked, address - 0x8000 + 16, obj.Length));
+
+        // Relocated code does the same as the code transpiled inline
+        var (expectedWrites, expectedPalette) = Utilities.RunToLoop(inline);
+        var (actualWrites, actualPalette) = Utilities.RunToLoop(linked);
+        Assert.NotEmpty(expectedWrites);
+        Assert.Contains((byte)0x33, expectedPalette);
+        Assert.Equal(expectedWrites, actualWrites);
+        Assert.Equal(expectedPalette, actualPalette);
+    }
+
+    [Theory]
+    [InlineData("ppu_wait_frame", true)]
+    [InlineData("ppu_system", true)]
+    [InlineData("ppu_wait_nmi", false)]
+    public void Link_Boot(string name, bool detectNTSC)
+    {
+        // The program only calls the object, which is the one reading NTSC_MODE
+        var library = CompileLibrary($$"""
+            using static NES.NESLib;
+
+            namespace Engine;
+
+            public static class Frame
+            {
+                public static void Wait() => {{name}}();
+            }
+            """);
+        var obj = TranspileLibrary(library);
+        Assert.True(obj.Calls(NESLibBinding.Get(name).Address));
+
+        var rom = Utilities.Transpile(CompileProgram("Engine.Frame.Wait();", library), _logger, il =>
+        {
+            il.Objects = [obj];
+            il.CodeOptimizations = CodeOptimizations.Boot;
+        });
+        Assert.Equal(detectNTSC, Convert.ToHexString(rom).Contains("A234A018CAD0FD88D0FA"));
+    }
+
+    [Fact]
+    public void TranspileObject_NotImplemented()
+    {
+        var dll = CompileLibrary("""
+            namespace Engine;
+
+            public static class Text
+            {
+                public static void Draw(byte x) { }
+            }
+            """);
+        Assert.Throws<NotImplementedException>(() => TranspileLibrary(dll));
+    }
+
+    NESObject TranspileLibrary(Stream dll)
+    {
+        using var il = new Transpiler(dll, Array.Empty<AssemblyReader>(), _logger);
+        return il.TranspileObject();
+    }
+
+    NESObject TranspileLibrary(byte[] dll) => TranspileLibrary(new MemoryStream(dll));
+
+    static IEnumerable<MetadataReference> References => ((string)AppContext.GetData("TRUSTED_PLATFORM_ASSEMBLIES")!)
+        .Split(Path.PathSeparator)
+        .Select(p => MetadataReference.CreateFromFile(p))
+        .Append(MetadataReference.CreateFromFile(typeof(NESLib).Assembly.Location));
+
+    static byte[] CompileLibrary(string source)
+    {
+        var compilation = CSharpCompilation.Create("Engine",
+            new[] { CSharpSyntaxTree.ParseText(source) },
+            References,
+            new CSharpCompilationOptions(OutputKind.DynamicallyLinkedLibrary, optimizationLevel: OptimizationLevel.Release));
+        return Emit(compilation).ToArray();
+    }
+
+    static MemoryStream CompileProgram(string source, byte[]? library = null)
+    {
+        var references = References;
+        if (library is not null)
+            references = references.Append(MetadataReference.CreateFromImage(library));
+        var compilation = CSharpCompilation.Create("program",
+            new[] { CSharpSyntaxTree.ParseText($"using static NES.NESLib;\n\n{source}\nwhile (true) ;\n") },
+            references,
+            new CSharpCompilationOptions(OutputKind.ConsoleApplication, optimizationLevel: OptimizationLevel.Release));
+        return Emit(compilation);
+    }
+
+    static MemoryStream Emit(CSharpCompilation compilation)
+    {
+        var dll = new MemoryStream();
+        var result = compilation.Emit(dll);
+        Assert.True(result.Success, string.Join(Environment.NewLine, result.Diagnostics));
+        dll.Position = 0;
+        return dll;
+    }
+}
@@ -0,0 +1,88 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class NESOptimizationTests
+{
+    readonly ILogger _logger;
+
+    public NESOptimizationTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const string Source =
+@"using NES;
+using static NES.NESLib;
+
+class Program
+{
+    {0}
+    static void Main()
+    {
+        uint fill = 32 * 30;
+        vram_adr(NAMETABLE_A);
+        vram_fill(0x16, fill);
+        ppu_on_all();
+        while (true) ;
+    }
+}
+";
+
+    [Theory]
+    [InlineData((int)NESOptimization.None, (int)ILOptimizations.None, (int)CodeOptimizations.None, 4)]
+    [InlineData((int)NESOptimization.Size, (int)ILOptimizations.All, (int)CodeOptimizations.All, 4)]
+    [InlineData((int)NESOptimization.Speed, (int)ILOptimizations.All, (int)(CodeOptimizations.All & ~CodeOptimizations.CrossJumping), 4)]
+    [InlineData((int)NESOptimization.Balanced, (int)ILOptimizations.All, (int)CodeOptimizations.All, 8)]
+    public void Passes(int optimization, int il, int code, int minTailLength)
+    {
+        var level = (NESOptimization)optimization;
+        Assert.Equal((ILOptimizations)il, level.GetILOptimizations());
+        Assert.Equal((CodeOptimizations)code, level.GetCodeOptimizations());
+        Assert.Equal(minTailLength, level.GetMinTailLength());
+    }
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("onelocal")]
+    public void Write_None(string name)
+    {
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        using var dll = Utilities.GetResource($"{name}.release.dll");
+        AssertEx.Equal(expected, Utilities.Transpile(dll, _logger, il => il.Optimization = NESOptimization.None));
+    }
+
+    [Theory]
+    [InlineData((int)NESOptimization.Size)]
+    [InlineData((int)NESOptimization.Speed)]
+    [InlineData((int)NESOptimization.Balanced)]
+    public void Write_Level(int optimization)
+    {
+        var level = (NESOptimization)optimization;
+        using var dll = Utilities.GetResource("onelocal.release.dll");
+        var actual = Utilities.Transpile(dll, _logger, il => il.Optimization = level);
+
+        using var dll2 = Utilities.GetResource("onelocal.release.dll");
+        var expected = Utilities.Transpile(dll2, _logger, il =>
+        {
+            il.Optimizations = level.GetILOptimizations();
+            il.CodeOptimizations = level.GetCodeOptimizations();
+        });
+
+        AssertEx.Equal(expected, actual);
+    }
+
+    [Fact]
+    public void Write_Attribute()
+    {
+        using var attribute = Compile("[NESOptimization(NESOptimization.Speed)]");
+        using var speed = Compile("");
+        using var none = Compile("");
+
+        var actual = Utilities.Transpile(attribute, _logger);
+        AssertEx.Equal(Utilities.Transpile(speed, _logger, il => il.Optimization = NESOptimization.Speed), actual);
+        Assert.NotEqual(Convert.ToHexString(Utilities.Transpile(none, _logger)), Convert.ToHexString(actual));
+    }
+
+    static Stream Compile(string attribute) => Utilities.Compile(Source.Replace("{0}", attribute));
+}
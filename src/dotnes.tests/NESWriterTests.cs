@@ -318,4 +318,33 @@ public class NESWriterTests
 
         AssertEx.Equal(data, writer);
     }
-}
\ No newline at end of file
+
+    [Theory]
+    [InlineData(3, false, false)]
+    [InlineData(3, true, false)]
+    [InlineData(5, false, false)]
+    [InlineData(7, false, true)]
+    public void WriteBuiltIns_Boot(int lastPage, bool detectNTSC, bool fade)
+    {
+        using (var writer = GetWriter())
+        {
+            writer.WriteBuiltIns(sizeOfMain);
+        }
+        var expected = stream.ToArray();
+        using (var writer = GetWriter())
+        {
+            writer.Boot = new NESWriter.BootProgram((byte)lastPage, detectNTSC, fade);
+            writer.WriteBuiltIns(sizeOfMain);
+        }
+        var actual = stream.ToArray();
+
+        // Only the reset path changes, every built-in after it keeps its address
+        Assert.Equal(expected.Length, actual.Length);
+        const int nmi = 0x80BC - 0x8000;
+        Assert.Equal(expected.Skip(nmi).ToArray(), actual.Skip(nmi).ToArray());
+        Assert.Equal(detectNTSC, Convert.ToHexString(actual).Contains("A234A018CAD0FD88D0FA"));
+        Assert.Equal(lastPage - 2 + (fade ? 1 : 0), Enumerable.Range(0, nmi - 2)
+            .Count(i => actual[i] == (byte)NESInstruction.STA_abs_X && actual[i + 1] == 0x00));
+        Assert.Equal(fade, Convert.ToHexString(actual).Contains("9D0001"));
+    }
+}
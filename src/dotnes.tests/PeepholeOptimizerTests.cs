@@ -0,0 +1,76 @@
+﻿using System.Reflection.Metadata;
+using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class PeepholeOptimizerTests
+{
+    readonly ILogger _logger;
+
+    public PeepholeOptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Theory]
+    // PHA, ASL A, PLA, ROR A => CMP #$80, ROR A
+    [InlineData("480A686A8D0002", "C9806A8D0002")]
+    // STA $10, LDA $10, then JSR only reads A and X
+    [InlineData("8510A510200090", "8510200090")]
+    // STA $10, LDA $10, then PHP reads the flags of the LDA
+    [InlineData("8510A51008", "8510A51008")]
+    // TAX, INX, TXA => CLC, ADC #$01 when X, the carry and overflow are written again
+    [InlineData("AAE88AA200B838", "186901A200B838")]
+    // TAX, INX, TXA, then STX reads X
+    [InlineData("AAE88A8E0002", "AAE88A8E0002")]
+    // LDA #$00, CLC, ADC $10 => CLC, LDA $10 before the while (true) loop
+    [InlineData("A9001865104C0085", "18A5104C0085")]
+    // STA $0324, LDA $0324 => STA $0324, a wildcard matches an absolute address too
+    [InlineData("8D2403AD2403200090", "8D2403200090")]
+    // LDA $40, CLC, ADC #$01, STA $40 => INC $40, then LDA #$00 writes the flags again
+    [InlineData("A5401869018540A9004C0085", "E640A9004C0085")]
+    // STA $10, LDA $11 are two addresses
+    [InlineData("8510A511200090", "8510A511200090")]
+    // STA $2007, LDA $2007 is not RAM
+    [InlineData("8D0720AD0720200090", "8D0720AD0720200090")]
+    public void Optimize(string code, string expected)
+    {
+        var optimizer = new PeepholeOptimizer(_logger);
+        var removed = new List<(int Offset, int Length)>();
+        var actual = optimizer.Optimize(Convert.FromHexString(code), removed);
+
+        Assert.Equal(expected, Convert.ToHexString(actual));
+        Assert.Equal(code.Length / 2 - expected.Length / 2, optimizer.BytesSaved);
+        Assert.Equal(optimizer.BytesSaved, removed.Sum(r => r.Length));
+    }
+
+    [Fact]
+    public void Optimize_Transpiled()
+    {
+        // byte r = rand8(); vram_put(r); as a debug build writes it, with the local stored and loaded again
+        const ushort sizeOfMain = 0x20;
+        using var writer = new IL2NESWriter(new MemoryStream(), logger: _logger);
+        writer.LinkedAddresses = new Dictionary<string, ushort> { [nameof(NESLib.rand8)] = 0x9000 };
+        writer.Write(ILOpCode.Call, NESLibBinding.Get(nameof(NESLib.rand8)), sizeOfMain);
+        writer.Write(ILOpCode.Stloc_0, sizeOfMain);
+        writer.Write(ILOpCode.Ldloc_0, sizeOfMain);
+        writer.Write(ILOpCode.Call, NESLibBinding.Get(nameof(NESLib.vram_put)), sizeOfMain);
+        writer.Flush();
+
+        // STA $0324; LDA $0324 => STA $0324
+        var optimizer = new PeepholeOptimizer(_logger);
+        var actual = optimizer.Optimize(((MemoryStream)writer.BaseStream).ToArray());
+        Assert.Equal("2000908D240320DB83", Convert.ToHexString(actual));
+        Assert.Equal(3, optimizer.BytesSaved);
+    }
+
+    [Theory]
+    // LDA $10, then JSR
+    [InlineData("A510200090", (int)(Outputs.X | Outputs.Memory))]
+    // CLC, ADC #$01 reads A, but not the carry it just set
+    [InlineData("186901", (int)(Outputs.A | Outputs.X | Outputs.Y | Outputs.Memory))]
+    // Y and the flags are unknown at the end
+    [InlineData("A900A200", (int)(Outputs.Y | Outputs.Carry | Outputs.Overflow | Outputs.Memory))]
+    public void GetLive(string code, int expected)
+    {
+        var instructions = DecodedInstruction.Decode(Convert.FromHexString(code), _logger, CodeOptimizations.Peephole)!;
+        Assert.Equal((Outputs)expected, PeepholeOptimizer.GetLive(instructions, 0));
+    }
+}
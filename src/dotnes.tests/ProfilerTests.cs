@@ -0,0 +1,68 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class ProfilerTests
+{
+    readonly ILogger _logger;
+
+    public ProfilerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    static byte[] GetRom(string name)
+    {
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var bytes = new byte[rom.Length];
+        rom.Read(bytes, 0, bytes.Length);
+        return bytes;
+    }
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("onelocal")]
+    public void Run_MainLoop(string name)
+    {
+        var profile = new Profiler(GetRom(name), _logger) { Frames = 10 }.Run();
+
+        Assert.Equal(10, profile.Frames);
+        // static void main ends with `while (true) ;`, which runs for most of each frame
+        var hottest = profile.Code.OrderByDescending(p => p.Value).First();
+        Assert.True(hottest.Key >= NESWriter.main, $"${hottest.Key:X4} is not in main");
+        Assert.Equal(0x4C, GetRom(name)[16 + hottest.Key - 0x8000]);
+    }
+
+    [Fact]
+    public void Run_Locals()
+    {
+        var profile = new Profiler(GetRom("onelocal"), _logger) { Frames = 10 }.Run();
+
+        Assert.True(profile.RAM.ContainsKey(IL2NESWriter.local + 1), "local 0 was not accessed");
+    }
+
+    [Fact]
+    public void ReadInput()
+    {
+        var profiler = new Profiler(GetRom("hello"), _logger) { Frames = 2 };
+        profiler.ReadInput(new StringReader("# press start\n1 Start\n0 left a\n"));
+
+        Assert.Equal(2, profiler.Run().Frames);
+        Assert.Throws<ArgumentException>(() => profiler.ReadInput(new StringReader("5 Turbo")));
+    }
+
+    [Fact]
+    public void Profile_RoundTrip()
+    {
+        var profile = new NESProfile { Frames = 60 };
+        profile.Code[0x8500] = 1;
+        profile.Code[0x8503] = 100000;
+        profile.RAM[0x0325] = 42;
+
+        var writer = new StringWriter();
+        profile.Write(writer);
+        var actual = NESProfile.Read(new StringReader(writer.ToString()));
+
+        Assert.Equal(60, actual.Frames);
+        Assert.Equal(profile.Code.OrderBy(p => p.Key), actual.Code.OrderBy(p => p.Key));
+        Assert.Equal(profile.RAM.OrderBy(p => p.Key), actual.RAM.OrderBy(p => p.Key));
+        Assert.Throws<FormatException>(() => NESProfile.Read(new StringReader("code 8500")));
+    }
+}
@@ -0,0 +1,151 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class RamBudgetTests
+{
+    readonly ILogger _logger;
+
+    public RamBudgetTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const ushort PRG_START = 0x8000;
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("attributetable")]
+    [InlineData("onelocal")]
+    public void Write(string name)
+    {
+        using var dll = Utilities.GetResource($"{name}.release.dll");
+        var map = new StringWriter();
+        Utilities.Transpile(dll, _logger, il => il.RamMap = map);
+
+        var text = map.ToString();
+        _logger.WriteLine($"{text}");
+        Assert.Contains("$01E0-$01FF hardware stack", text);
+        Assert.Contains("$0700-$07FF C stack", text);
+        Assert.DoesNotContain("over", text);
+        Assert.DoesNotContain("lower bound", text);
+    }
+
+    /// <summary>
+    /// The depths from the call graph are never less than running the ROM shows
+    /// </summary>
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("attributetable")]
+    [InlineData("onelocal")]
+    public void Depths_AtLeastRun(string name)
+    {
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var bytes = new byte[rom.Length];
+        rom.Read(bytes, 0, bytes.Length);
+        var prg = bytes.Skip(16).Take(2 * NESWriter.PRG_ROM_BLOCK_SIZE).ToArray();
+        var sizeOfMain = GetSizeOfMain(prg);
+        var budget = new RamBudget(prg, [], locals: 0, [], NESWriter.GetFinalBuiltInAddresses(sizeOfMain));
+
+        var cpu = new NESCpu();
+        cpu.ReadRegister = address => address == 0x2002 ? (byte)0x80 : cpu.Memory[address];
+        Array.Copy(prg, 0, cpu.Memory, PRG_START, prg.Length);
+        cpu.Reset();
+        int hardware = 0, cStack = 0;
+        for (int frame = 0; frame < 10; frame++)
+        {
+            while (cpu.Cycles < (frame + 1L) * 29781)
+            {
+                cpu.Step();
+                hardware = Math.Max(hardware, 0xFF - cpu.S);
+                // pusha and popa change sp a byte at a time, it is only consistent back in main
+                int sp = cpu.Memory[0x22] | cpu.Memory[0x23] << 8;
+                if (cpu.PC >= NESWriter.main && cpu.PC < NESWriter.main + sizeOfMain)
+                    cStack = Math.Max(cStack, 0x0800 - sp);
+            }
+            if ((cpu.Memory[0x2000] & 0x80) != 0)
+                cpu.NMI();
+        }
+
+        _logger.WriteLine($"Hardware stack: {budget.HardwareStack} >= {hardware}, C stack: {budget.CStack} >= {cStack}");
+        Assert.True(budget.Exact);
+        Assert.True(budget.HardwareStack >= hardware, $"Hardware stack {budget.HardwareStack} < {hardware}");
+        Assert.True(budget.CStack >= cStack, $"C stack {budget.CStack} < {cStack}");
+        Assert.True(cStack > 0, "Nothing was pushed on the C stack");
+    }
+
+    [Fact]
+    public void Depths()
+    {
+        var prg = new byte[2 * NESWriter.PRG_ROM_BLOCK_SIZE];
+        var names = new Dictionary<ushort, string> { [0x9100] = "pusha", [0x9110] = "popa" };
+        Assemble(prg, 0x8000,
+            0x20, 0x00, 0x90,       // JSR $9000
+            0x4C, 0x03, 0x80);      // JMP $8003
+        Assemble(prg, 0x9000,
+            0x48,                   // PHA
+            0x20, 0x00, 0x91,       // JSR pusha
+            0x20, 0x00, 0x91,       // JSR pusha
+            0x20, 0x20, 0x90,       // JSR $9020
+            0x68,                   // PLA
+            0x60);                  // RTS
+        Assemble(prg, 0x9020,
+            0xF0, 0x03,             // BEQ +3
+            0x20, 0x10, 0x91,       // JSR popa
+            0x20, 0x10, 0x91,       // JSR popa
+            0x60);                  // RTS
+        Assemble(prg, 0x9100, 0x60);
+        Assemble(prg, 0x9110, 0x60);
+        Assemble(prg, 0x9200,
+            0x48,                   // PHA
+            0x40);                  // RTI
+        Assemble(prg, 0xFFFA, 0x00, 0x92, 0x00, 0x80, 0x00, 0x00);
+
+        var budget = new RamBudget(prg, [], locals: 0, [], names);
+
+        // JSR $9000, PHA, JSR $9020, JSR popa, then an NMI that pushes PC, P and A
+        Assert.Equal(2 + 1 + 2 + 2 + 3 + 1, budget.HardwareStack);
+        Assert.Equal(2, budget.CStack);
+        Assert.True(budget.Exact);
+    }
+
+    [Fact]
+    public void Overflows()
+    {
+        var budget = new RamBudget(null, [0x85, 0x40, 0x85, 0x41, 0xA5, 0x40], locals: 0x400, [], new Dictionary<ushort, string>());
+
+        var region = Assert.Single(budget.Overflows);
+        Assert.Equal("BSS, locals", region.Name);
+        Assert.Equal(2, budget.Regions.Single(r => r.Name == "zero page locals").Used);
+        Assert.False(budget.Exact);
+        Assert.Contains("bytes over", budget.ToString());
+        Assert.Contains("lower bound", budget.ToString());
+    }
+
+    [Fact]
+    public void Fade()
+    {
+        var budget = new RamBudget(null, [], locals: 0, [], new Dictionary<ushort, string>(), fade: true);
+
+        var region = budget.Regions.Single(r => r.Name == "NES.Fade");
+        Assert.Equal(0x01B8, region.Start);
+        Assert.Equal(8, region.Used);
+        Assert.False(region.Overflows);
+        Assert.False(new RamBudget(null, [], locals: 0, [], new Dictionary<ushort, string>()).Regions.Any(r => r.Name == "NES.Fade"));
+    }
+
+    static void Assemble(byte[] prg, ushort address, params byte[] code) => Array.Copy(code, 0, prg, address - PRG_START, code.Length);
+
+    /// <summary>
+    /// main ends with `JMP` to itself, for `while (true) ;`
+    /// </summary>
+    static ushort GetSizeOfMain(byte[] prg)
+    {
+        int offset = NESWriter.main - PRG_START;
+        while (true)
+        {
+            var info = NESInstructionInfo.Get(prg[offset])!;
+            ushort address = (ushort)(PRG_START + offset);
+            if (info.Mnemonic == "JMP" && (prg[offset + 1] | prg[offset + 2] << 8) == address)
+                return (ushort)(address + 3 - NESWriter.main);
+            offset += info.Length;
+        }
+    }
+}
@@ -0,0 +1,227 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class RandTests
+{
+    readonly ILogger _logger;
+
+    public RandTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const ushort Seed = 0x3C;
+
+    [Fact]
+    public void Rand8()
+    {
+        var (cpu, routines) = Utilities.Load(Rand.Lfsr);
+        ushort seed = 0;
+        var values = new HashSet<byte>();
+        for (int i = 0; i < 1000; i++)
+        {
+            Utilities.Call(cpu, routines[nameof(NESLib.rand8)]);
+            var expected = Rand.Next(ref seed);
+            Assert.Equal(expected, cpu.A);
+            Assert.Equal(seed, cpu.Memory[Seed] | cpu.Memory[Seed + 1] << 8);
+            values.Add(expected);
+        }
+        Assert.True(values.Count > 128, $"rand8 returned {values.Count} values");
+    }
+
+    [Fact]
+    public void Rand16()
+    {
+        var (cpu, routines) = Utilities.Load(Rand.Lfsr);
+        ushort seed = 0;
+        var values = new HashSet<ushort>();
+        for (int i = 0; i < 1000; i++)
+        {
+            Utilities.Call(cpu, routines[nameof(NESLib.rand16)]);
+            var expected = Rand.Next16(ref seed);
+            Assert.Equal(expected, cpu.A | cpu.X << 8);
+            values.Add(expected);
+        }
+        // The 16-bit LFSR does not repeat for 65535 values
+        Assert.Equal(1000, values.Count);
+    }
+
+    [Fact]
+    public void Next16_Period()
+    {
+        ushort seed = 1;
+        int period = 0;
+        do
+        {
+            Rand.Next16(ref seed);
+            period++;
+        }
+        while (seed != 1);
+        Assert.Equal(ushort.MaxValue, period);
+    }
+
+    [Fact]
+    public void SetRand()
+    {
+        var (cpu, routines) = Utilities.Load(Rand.Lfsr);
+        cpu.A = 0x34;
+        cpu.X = 0x12;
+        Utilities.Call(cpu, routines[nameof(NESLib.set_rand)]);
+        Utilities.Call(cpu, routines[nameof(NESLib.rand)]);
+
+        ushort seed = 0x1234;
+        Assert.Equal(Rand.Next(ref seed), cpu.A);
+    }
+
+    [Fact]
+    public void Lookup()
+    {
+        var (cpu, routines) = Utilities.Load(Rand.Lookup);
+        var (lfsr, lfsrRoutines) = Utilities.Load(Rand.Lfsr);
+        long cycles = 0, lfsrCycles = 0;
+        for (int i = 0; i < 255; i++)
+        {
+            long start = cpu.Cycles, lfsrStart = lfsr.Cycles;
+            Utilities.Call(cpu, routines[nameof(NESLib.rand8)]);
+            Utilities.Call(lfsr, lfsrRoutines[nameof(NESLib.rand8)]);
+            cycles += cpu.Cycles - start;
+            lfsrCycles += lfsr.Cycles - lfsrStart;
+
+            // The table is the values of the LFSRs from the seed after reset
+            Assert.Equal(lfsr.A, cpu.A);
+        }
+        Assert.True(cycles < lfsrCycles * 2 / 3, $"{cycles} cycles with the table, {lfsrCycles} without");
+        Assert.Equal(Rand.Table, Rand.Lookup.Data);
+    }
+
+    [Fact]
+    public void Cycles()
+    {
+        // The cycles in [NESBuiltIn] hold for the routines linked with and without the table
+        foreach (var obj in new[] { Rand.Lfsr, Rand.Lookup })
+        {
+            foreach (var symbol in obj.Symbols)
+            {
+                int cycles = NESLibBinding.Get(symbol.Name).Attribute.Cycles;
+                Assert.True(cycles == 0 || cycles == symbol.Cycles, $"{symbol.Name} takes {symbol.Cycles} cycles, not {cycles}");
+            }
+        }
+        Assert.NotEqual(Rand.Lfsr.Symbols[0].Cycles, Rand.Lookup.Symbols[0].Cycles);
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public void Write(bool randomTable)
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            pal_col(1, rand8());
+            vram_adr(NTADR_A(2, 2));
+            vram_put(rand8());
+            vram_put(rand());
+            """), _logger, il => il.RandomTable = randomTable);
+
+        ushort seed = 0;
+        var expected = Enumerable.Range(0, 3).Select(_ => Rand.Next(ref seed)).ToArray();
+        var (writes, palette) = Utilities.RunToLoop(rom);
+        Assert.Equal(expected[0], palette[1]);
+        Assert.Equal(expected[1..], writes.Skip(writes.FindLastIndex(w => w.Item1 == 0x2006) + 1).Select(w => w.Item2));
+        Assert.Equal(randomTable, rom.AsSpan().IndexOf(Rand.Table) > 0);
+    }
+
+    [Fact]
+    public void Write_FirstArgument()
+    {
+        // The value rand8 returns in A is pushed before the next argument is loaded
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            pal_col(rand8(), 0x30);
+            """), _logger);
+
+        ushort seed = 0;
+        var palette = Utilities.RunToLoop(rom).Palette;
+        Assert.Equal(0x30, palette[Rand.Next(ref seed) & 0x1F]);
+    }
+
+    [Fact]
+    public void Write_LocalArgument()
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            byte i = 3;
+            pal_col(i, rand8());
+            """), _logger);
+
+        ushort seed = 0;
+        var palette = Utilities.RunToLoop(rom).Palette;
+        Assert.Equal(Rand.Next(ref seed), palette[3]);
+    }
+
+    [Fact]
+    public void Write_Stloc()
+    {
+        // The local is stored from A, its value is not known at build time
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            byte r = rand8();
+            vram_adr(NTADR_A(2, 2));
+            vram_put(r);
+            vram_put(rand8());
+            vram_put(r);
+            """), _logger);
+
+        ushort seed = 0;
+        var first = Rand.Next(ref seed);
+        var expected = new[] { first, Rand.Next(ref seed), first };
+        var writes = Utilities.RunToLoop(rom).Writes;
+        Assert.Equal(expected, writes.Skip(writes.FindLastIndex(w => w.Item1 == 0x2006) + 1).Select(w => w.Item2));
+    }
+
+    [Fact]
+    public void Write_StlocArgument()
+    {
+        // The constant before the local is pushed, as before a constant
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            byte r = rand8();
+            pal_col(1, r);
+            pal_col(2, r);
+            """), _logger);
+
+        ushort seed = 0;
+        var expected = Rand.Next(ref seed);
+        var palette = Utilities.RunToLoop(rom).Palette;
+        Assert.Equal(expected, palette[1]);
+        Assert.Equal(expected, palette[2]);
+    }
+
+    [Fact]
+    public void Write_Pop()
+    {
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            rand8();
+            vram_adr(NTADR_A(2, 2));
+            vram_put(rand8());
+            """), _logger);
+
+        ushort seed = 0;
+        Rand.Next(ref seed);
+        var writes = Utilities.RunToLoop(rom).Writes;
+        Assert.Equal([Rand.Next(ref seed)], writes.Skip(writes.FindLastIndex(w => w.Item1 == 0x2006) + 1).Select(w => w.Item2));
+    }
+
+    [Theory]
+    [InlineData("vram_adr(NTADR_A(rand8(), 2));")]
+    [InlineData("vram_put((byte)(rand8() + 1));")]
+    public void Write_NotImplemented(string source)
+    {
+        // Other uses of a value only known at run time
+        Assert.Throws<NotImplementedException>(() => Utilities.Transpile(CallGraphTests.CompileProgram(source), _logger));
+    }
+
+    [Fact]
+    public void Write_NotCalled()
+    {
+        // The routines are linked only into ROMs that call them
+        var rom = Utilities.Transpile(CallGraphTests.CompileProgram("""
+            vram_adr(NTADR_A(2, 2));
+            vram_put(0x41);
+            """), _logger, il => il.RandomTable = true);
+        Assert.True(rom.AsSpan().IndexOf(Rand.Lfsr.Code) < 0);
+        Assert.True(rom.AsSpan().IndexOf(Rand.Table) < 0);
+    }
+}
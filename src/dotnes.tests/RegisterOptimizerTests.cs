@@ -0,0 +1,90 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class RegisterOptimizerTests
+{
+    const ushort Unknown = 0x9000;
+    const ushort PalCol = 0x9100;
+
+    readonly ILogger _logger;
+    readonly Dictionary<ushort, BuiltInEffects> _calls = new()
+    {
+        [PalCol] = BuiltInEffects.Get(nameof(NESLib.pal_col)),
+    };
+
+    public RegisterOptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Theory]
+    // LDA #$05, LDA #$05
+    [InlineData("A905A90560", "A90560")]
+    // LDX #$05, LDA #$05 => TXA
+    [InlineData("A205A90560", "A2058A60")]
+    // LDA #$16, STA $0325, LDA #$00, LDX $0325 => LDX #$16
+    [InlineData("A9168D2503A900AE250360", "A9168D2503A900A21660")]
+    // LDA #$01, STA $0325, STA $0325
+    [InlineData("A9018D25038D250360", "A9018D250360")]
+    // CPX #$00 after LDX, the carry is dead before JSR
+    [InlineData("A605E000200090", "A605200090")]
+    // LDA #$05, JSR pal_col, LDA #$05
+    [InlineData("A905200091A90560", "A90520009160")]
+    // LDA #$05, JSR unknown, LDA #$05
+    [InlineData("A905200090A90560", "A905200090A90560")]
+    // LDX #$05, LDA #$00, LDX #$05, PHP reads the flags of A
+    [InlineData("A205A900A2050860", "A205A900A2050860")]
+    // STA $0325,Y forgets RAM
+    [InlineData("A9018D2503992503AE250360", "A9018D2503992503AE250360")]
+    // The NMI handler writes zero page below $22
+    [InlineData("A90185108510A60160", "A90185108510A60160")]
+    // Branches are not supported yet
+    [InlineData("A905D000A90560", "A905D000A90560")]
+    public void Optimize(string code, string expected)
+    {
+        var optimizer = new RegisterOptimizer(_logger);
+        var removed = new List<(int Offset, int Length)>();
+        var actual = optimizer.Optimize(Convert.FromHexString(code), _calls, removed);
+
+        Assert.Equal(expected, Convert.ToHexString(actual));
+        Assert.Equal(code.Length / 2 - expected.Length / 2, optimizer.BytesSaved);
+        Assert.Equal(optimizer.BytesSaved, removed.Sum(r => r.Length));
+    }
+
+    [Fact]
+    public void Optimize_Cycles()
+    {
+        // LDA #$16, STA $0325, LDX $0325 => TAX
+        var optimizer = new RegisterOptimizer(_logger);
+        var actual = optimizer.Optimize(Convert.FromHexString("A9168D2503AE250360"), _calls);
+
+        Assert.Equal("A9168D2503AA60", Convert.ToHexString(actual));
+        Assert.Equal(2, optimizer.BytesSaved);
+        Assert.Equal(2, optimizer.CyclesSaved);
+    }
+
+    [Theory]
+    [InlineData("onelocal")]
+    [InlineData("onelocalbyte")]
+    public void Write(string name)
+    {
+        using var expectedDll = Utilities.GetResource($"{name}.release.dll");
+        using var actualDll = Utilities.GetResource($"{name}.release.dll");
+        var expected = Utilities.Transpile(expectedDll, _logger, il => il.CodeOptimizations = CodeOptimizations.None);
+        var actual = Utilities.Transpile(actualDll, _logger, il => il.CodeOptimizations = CodeOptimizations.Registers);
+
+        // The local is read back from RAM, unless its value is already known
+        byte[] load = [(byte)NESInstruction.LDA_abs, 0x25, 0x03];
+        Assert.True(IndexOf(expected, load) >= 0);
+        Assert.Equal(-1, IndexOf(actual, load));
+        Assert.Equal(expected.Length, actual.Length);
+    }
+
+    static int IndexOf(byte[] bytes, byte[] value)
+    {
+        for (int i = 0; i + value.Length <= bytes.Length; i++)
+        {
+            if (bytes.AsSpan(i, value.Length).SequenceEqual(value))
+                return i;
+        }
+        return -1;
+    }
+}
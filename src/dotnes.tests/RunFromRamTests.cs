@@ -0,0 +1,119 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class RunFromRamTests
+{
+    readonly ILogger _logger;
+
+    public RunFromRamTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    const string Source =
+@"using NES;
+using static NES.NESLib;
+
+class Program
+{
+    {0}
+    static void Main()
+    {
+        pal_col(0, 0x02);
+        pal_col(1, 0x14);
+        vram_adr(NAMETABLE_A);
+        vram_write(new byte[] { 0x01, 0x02, 0x03, 0x04, 0x05 });
+        ppu_on_all();
+        while (true) ;
+    }
+}
+";
+
+    [Theory]
+    [InlineData(0)]
+    [InlineData(1)]
+    [InlineData(64)]
+    [InlineData(256)]
+    [InlineData(300)]
+    public void vram_write(int length)
+    {
+        const ushort source = 0x9000;
+        var addresses = NESWriter.GetRamAddresses([nameof(NESLib.vram_write)]);
+        var copyram = NESWriter.GetCopyRamAddress(addresses);
+        var code = WriteRamBuiltIns(addresses, sizeOfMain: 0);
+        var data = Enumerable.Range(0, length).Select(i => (byte)(i * 7)).ToArray();
+
+        var writes = new List<byte>();
+        var cpu = new NESCpu
+        {
+            WriteRegister = (address, value) =>
+            {
+                if (address == 0x2007)
+                    writes.Add(value);
+            },
+        };
+        Array.Copy(data, 0, cpu.Memory, source, data.Length);
+        // popax returns the source address pushed by main
+        ushort popax = NESWriter.GetFinalBuiltInAddresses(0).Single(p => p.Value == "popax").Key;
+        cpu.Memory[popax] = (byte)NESInstruction.LDA;
+        cpu.Memory[popax + 1] = unchecked((byte)source);
+        cpu.Memory[popax + 2] = (byte)NESInstruction.LDX;
+        cpu.Memory[popax + 3] = (byte)(source >> 8);
+        cpu.Memory[popax + 4] = (byte)NESInstruction.RTS_impl;
+
+        cpu.Run(code, copyram);
+        var ram = cpu.Memory.Skip(NESWriter.RAM_CODE).Take(code.Length - 12).ToArray();
+        Assert.Equal(code.Skip(12).ToArray(), ram);
+
+        cpu.A = (byte)length;
+        cpu.X = (byte)(length >> 8);
+        cpu.Run(ram, addresses[nameof(NESLib.vram_write)], maxSteps: 100_000);
+        Assert.Equal(data, writes.ToArray());
+    }
+
+    [Fact]
+    public void Write()
+    {
+        using var none = Compile("");
+        using var ram = Compile("[RunFromRam(nameof(vram_write))]");
+        var expected = Utilities.Transpile(none, _logger);
+        var actual = Utilities.Transpile(ram, _logger);
+
+        // main calls copyram first, then vram_write in RAM
+        const int main = 16 + 0x500;
+        var copyram = NESWriter.GetCopyRamAddress(NESWriter.GetRamAddresses([nameof(NESLib.vram_write)]));
+        Assert.Equal($"20{copyram & 0xFF:X2}{copyram >> 8:X2}", Convert.ToHexString(actual, main, 3));
+        Assert.Contains("200006", Convert.ToHexString(actual, main, 0x100));
+        Assert.DoesNotContain("200006", Convert.ToHexString(expected, main, 0x100));
+
+        // copyram and the code it copies end at the interrupt vectors
+        const int vectors = 16 + 2 * NESWriter.PRG_ROM_BLOCK_SIZE - 6;
+        Assert.Equal(Convert.ToHexString(expected, vectors, 6), Convert.ToHexString(actual, vectors, 6));
+        Assert.Equal((byte)NESInstruction.RTS_impl, actual[vectors - 1]);
+        Assert.Equal((byte)NESInstruction.LDX, actual[copyram - 0x8000 + 16]);
+    }
+
+    [Fact]
+    public void GetRamAddresses()
+    {
+        var addresses = NESWriter.GetRamAddresses([nameof(NESLib.vram_write), nameof(NESLib.vram_write)]);
+        Assert.Equal(NESWriter.RAM_CODE, addresses[nameof(NESLib.vram_write)]);
+        Assert.Equal(1, addresses.Count);
+    }
+
+    [Fact]
+    public void GetRamAddresses_NotImplemented()
+    {
+        Assert.Throws<NotImplementedException>(() => NESWriter.GetRamAddresses([nameof(NESLib.pal_col)]));
+    }
+
+    static byte[] WriteRamBuiltIns(IReadOnlyDictionary<string, ushort> addresses, ushort sizeOfMain)
+    {
+        using var memoryStream = new MemoryStream();
+        using (var writer = new NESWriter(memoryStream, leaveOpen: true))
+        {
+            writer.WriteRamBuiltIns(addresses, sizeOfMain);
+        }
+        return memoryStream.ToArray();
+    }
+
+    static Stream Compile(string attribute) => Utilities.Compile(Source.Replace("{0}", attribute));
+}
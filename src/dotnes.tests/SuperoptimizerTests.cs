@@ -0,0 +1,48 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class SuperoptimizerTests
+{
+    readonly ILogger _logger;
+
+    public SuperoptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Fact(Skip = "Run by hand to regenerate peephole.txt")]
+    public void Generate()
+    {
+        var path = Path.Combine(Utilities.GetSourceDirectory(), "..", "dotnes.tasks", "Utilities", "peephole.txt");
+        using var writer = new StreamWriter(path) { NewLine = "\n" };
+        new Superoptimizer(_logger).Generate(writer, Superoptimizer.Seeds);
+    }
+
+    [Fact]
+    public void Database()
+    {
+        var superoptimizer = new Superoptimizer(_logger);
+        Assert.NotEmpty(PeepholeRule.Default);
+        foreach (var rule in PeepholeRule.Default)
+        {
+            _logger.WriteLine($"{rule}");
+            Assert.Equal(rule.Preserves, superoptimizer.Verify(rule.Pattern, rule.Replacement));
+        }
+    }
+
+    [Fact]
+    public void Search_ArithmeticShiftRight()
+    {
+        // PHA, ASL A, PLA, ROR A => CMP #$80, ROR A
+        var rule = new Superoptimizer(_logger).Search([0x48, 0x0A, 0x68, 0x6A], Outputs.A | Outputs.Carry | Outputs.Memory);
+
+        Assert.NotNull(rule);
+        Assert.Equal("C9806A", PeepholeRule.ToHex(rule!.Replacement));
+        Assert.Equal(Outputs.All, rule.Preserves);
+    }
+
+    [Fact]
+    public void Search_NothingFaster()
+    {
+        // LDA #$01
+        Assert.Null(new Superoptimizer(_logger).Search([0xA9, 0x01], Outputs.A));
+    }
+}
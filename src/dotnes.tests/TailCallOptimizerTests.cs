@@ -0,0 +1,111 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class TailCallOptimizerTests
+{
+    readonly ILogger _logger;
+
+    public TailCallOptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Theory]
+    // JSR $9000, RTS => JMP $9000
+    [InlineData("A901200090" + "60", "A9014C0090", 1, 9)]
+    // JSR $9000, JMP $8500 is not a tail call
+    [InlineData("2000904C0085", "2000904C0085", 0, 0)]
+    // Branches are not supported yet
+    [InlineData("D000200090" + "60", "D000200090" + "60", 0, 0)]
+    public void TailCalls(string code, string expected, int bytes, int cycles)
+    {
+        var optimizer = new TailCallOptimizer(_logger);
+        var removed = new List<(int Offset, int Length)>();
+        var actual = optimizer.TailCalls(Convert.FromHexString(code), removed);
+
+        Assert.Equal(expected, Convert.ToHexString(actual));
+        Assert.Equal(bytes, optimizer.BytesSaved);
+        Assert.Equal(cycles, optimizer.CyclesSaved);
+        Assert.Equal(bytes, removed.Sum(r => r.Length));
+    }
+
+    [Theory]
+    // LDA #$01, JSR $9000, STA $0200, RTS and LDA #$02 with the same tail at $8507
+    [InlineData("A901" + "2000908D020060" + "A902" + "2000908D020060", "A9014C0785" + "A902" + "2000908D020060", 4)]
+    // JMP $9000 is too short to share
+    [InlineData("A901" + "4C0090" + "A902" + "4C0090", "A901" + "4C0090" + "A902" + "4C0090", 0)]
+    // Three copies jump to the last, the third only shares STA $0200, RTS
+    [InlineData("A9018D0002" + "60" + "A9018D0002" + "60" + "A2018D0002" + "60" + "A9018D0002" + "60", "4C0B85" + "4C0B85" + "A201" + "4C0D85" + "A9018D0002" + "60", 7)]
+    public void CrossJump(string code, string expected, int bytes)
+    {
+        var optimizer = new TailCallOptimizer(_logger);
+        var removed = new List<(int Offset, int Length)>();
+        var actual = optimizer.CrossJump(Convert.FromHexString(code), 0x8500, removed);
+
+        Assert.Equal(expected, Convert.ToHexString(actual));
+        Assert.Equal(bytes, optimizer.BytesSaved);
+        Assert.Equal(bytes, removed.Sum(r => r.Length));
+    }
+
+    [Fact]
+    public void Write_Methods()
+    {
+        // Both methods end in JSR pal_col; RTS, and in the same 8 bytes before it
+        var source = """
+            Title();
+            Score();
+            Title();
+            Score();
+
+            static void Title()
+            {
+                vram_adr(NAMETABLE_A);
+                pal_col(1, 0x14);
+            }
+
+            static void Score()
+            {
+                vram_adr(NTADR_A(2, 2));
+                pal_col(1, 0x14);
+            }
+            """;
+        var expected = Utilities.Transpile(CallGraphTests.CompileProgram(source), _logger);
+        var actual = Utilities.Transpile(CallGraphTests.CompileProgram(source), _logger,
+            il => il.CodeOptimizations = CodeOptimizations.TailCalls | CodeOptimizations.CrossJumping);
+
+        // Score ends in JMP pal_col, Title in a JMP to the same tail in Score
+        var jsr = Convert.FromHexString("203E8260");
+        var jmp = Convert.FromHexString("4C3E82");
+        Assert.Equal(2, Count(expected, jsr));
+        Assert.Equal(0, Count(actual, jsr));
+        Assert.Equal(1, Count(actual, jmp));
+        var (expectedWrites, expectedPalette) = Utilities.RunToLoop(expected);
+        var (actualWrites, actualPalette) = Utilities.RunToLoop(actual);
+        Assert.Equal(expectedWrites, actualWrites);
+        Assert.Equal(expectedPalette, actualPalette);
+    }
+
+    static int Count(byte[] rom, byte[] value)
+    {
+        int count = 0, index;
+        var span = rom.AsSpan();
+        while ((index = span.IndexOf(value)) >= 0)
+        {
+            count++;
+            span = span[(index + value.Length)..];
+        }
+        return count;
+    }
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("onelocal")]
+    public void Write_MainHasNoTails(string name)
+    {
+        // static void main ends with `while (true) ;`, so it never returns and has a single tail
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        using var dll = Utilities.GetResource($"{name}.release.dll");
+        AssertEx.Equal(expected, Utilities.Transpile(dll, _logger, il => il.CodeOptimizations = CodeOptimizations.TailCalls | CodeOptimizations.CrossJumping));
+    }
+}
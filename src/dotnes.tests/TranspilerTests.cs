@@ -100,13 +100,168 @@ ILInstruction { OpCode = Br_s, Integer = 254, String = , Bytes =  }";
         var expected = new byte[rom.Length];
         rom.Read(expected, 0, expected.Length);
 
-        var chr_generic = new StreamReader(Utilities.GetResource("chr_generic.s"));
-
         using var dll = Utilities.GetResource($"{name}.{configuration}.dll");
-        using var il = new Transpiler(dll, new[] { new AssemblyReader(chr_generic) }, _logger);
-        using var ms = new MemoryStream();
-        il.Write(ms);
+        AssertEx.Equal(expected, Utilities.Transpile(dll, _logger));
+    }
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("onelocal")]
+    public void Write_Parallel(string name)
+    {
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        // Sections are written on the thread pool, the ROM should never depend on thread timing
+        var actual = new byte[8][];
+        Parallel.For(0, actual.Length, i =>
+        {
+            using var dll = Utilities.GetResource($"{name}.release.dll");
+            actual[i] = Utilities.Transpile(dll, new NullLogger());
+        });
+
+        foreach (var bytes in actual)
+        {
+            AssertEx.Equal(expected, bytes);
+        }
+    }
+
+    [Fact]
+    public void Write_ParallelLog()
+    {
+        // MSBuild's logger is not thread-safe, the sections log on the calling thread in a fixed order
+        var logs = new List<(int Thread, string Message)>[2];
+        for (int i = 0; i < logs.Length; i++)
+        {
+            var logger = new ThreadLogger();
+            using var dll = Utilities.GetResource("hello.release.dll");
+            Utilities.Transpile(dll, logger);
+            logs[i] = logger.Messages;
+        }
+
+        int thread = Environment.CurrentManagedThreadId;
+        Assert.True(logs[0].All(m => m.Thread == thread));
+        Assert.Equal(logs[0], logs[1]);
+        Assert.True(logs[0].FindIndex(m => m.Message == "Second pass...") > logs[0].FindIndex(m => m.Message == "Writing built-ins..."));
+    }
+
+    [Fact]
+    public void Write_ParallelException()
+    {
+        // Thrown while static void main is written in parallel with the string table, as if they were written in turn
+        var dll = CallGraphTests.CompileProgram("byte x = 3;\nvram_put((byte)(x * x));");
+        Assert.Throws<NotImplementedException>(() => Utilities.Transpile(dll, _logger));
+    }
+
+    class ThreadLogger : ILogger
+    {
+        public List<(int Thread, string Message)> Messages { get; } = [];
+
+        public void WriteLine(IFormattable message) => Messages.Add((Environment.CurrentManagedThreadId, message.ToString()!));
+    }
 
-        AssertEx.Equal(expected, ms.ToArray());
+    [Theory]
+    [InlineData("attributetable")]
+    [InlineData("hello")]
+    public void Write_MemoryMapped(string name)
+    {
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        var path = Path.Combine(Path.GetTempPath(), $"{Guid.NewGuid()}.{name}.dll");
+        try
+        {
+            using (var dll = Utilities.GetResource($"{name}.release.dll"))
+            using (var file = File.Create(path))
+            {
+                dll.CopyTo(file);
+            }
+
+            var chr_generic = new StreamReader(Utilities.GetResource("chr_generic.s"));
+            using var il = new Transpiler(path, new[] { new AssemblyReader(chr_generic) }, _logger);
+            using var ms = new MemoryStream();
+            il.Write(ms);
+
+            AssertEx.Equal(expected, ms.ToArray());
+        }
+        finally
+        {
+            File.Delete(path);
+        }
+    }
+
+    [Fact]
+    public void Write_BuildCache()
+    {
+        using var rom = Utilities.GetResource("hello.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        var cache = new BuildCache();
+        for (int i = 0; i < 2; i++)
+        {
+            using var dll = Utilities.GetResource("hello.release.dll");
+            AssertEx.Equal(expected, Utilities.Transpile(dll, _logger, il => il.Cache = cache));
+        }
+
+        // Built-ins are reused the second time, chr_generic.s is not a file on disk
+        Assert.Equal(1, cache.Hits);
+    }
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("attributetable")]
+    [InlineData("onelocal")]
+    public void Write_Boot(string name)
+    {
+        using var rom = Utilities.GetResource($"{name}.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+
+        using var dll = Utilities.GetResource($"{name}.release.dll");
+        var actual = Utilities.Transpile(dll, _logger, il => il.CodeOptimizations = CodeOptimizations.Boot);
+
+        // static void main starts sooner, after the same writes to the PPU and with the same RAM
+        var (expectedCycles, expectedWrites, expectedRAM) = RunToMain(expected);
+        var (actualCycles, actualWrites, actualRAM) = RunToMain(actual);
+        _logger.WriteLine($"Cycles to main: {expectedCycles} -> {actualCycles}");
+        Assert.True(actualCycles / 29781 < expectedCycles / 29781, $"{actualCycles} cycles is not a frame sooner than {expectedCycles}");
+        Assert.Equal(expectedWrites, actualWrites);
+        Assert.Equal(expectedRAM, actualRAM);
+    }
+
+    /// <summary>
+    /// Runs a ROM from reset to static void main, and returns the cycles, the writes to PPU_ADDR and PPU_DATA, and RAM after condes
+    /// </summary>
+    static (long Cycles, List<(ushort, byte)> Writes, byte[] RAM) RunToMain(byte[] rom)
+    {
+        var writes = new List<(ushort, byte)>();
+        var cpu = new NESCpu
+        {
+            WriteRegister = (address, value) =>
+            {
+                if (address is 0x2006 or 0x2007)
+                    writes.Add((address, value));
+            },
+        };
+        cpu.ReadRegister = address => address == 0x2002 ? (byte)0x80 : cpu.Memory[address];
+        Array.Copy(rom, 16, cpu.Memory, 0x8000, 2 * NESWriter.PRG_ROM_BLOCK_SIZE);
+        cpu.Reset();
+        long frame = 29781;
+        while (cpu.PC != NESWriter.main)
+        {
+            cpu.Step();
+            if (cpu.Cycles > 10 * 29781)
+                throw new InvalidOperationException($"static void main was not reached, PC=${cpu.PC:X4}");
+            if (cpu.Cycles >= frame)
+            {
+                frame += 29781;
+                if ((cpu.Memory[0x2000] & 0x80) != 0)
+                    cpu.NMI();
+            }
+        }
+        return (cpu.Cycles, writes, cpu.Memory.Skip(IL2NESWriter.local + 1).Take(0x0800 - IL2NESWriter.local - 1).ToArray());
     }
 }
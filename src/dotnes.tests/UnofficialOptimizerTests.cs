@@ -0,0 +1,86 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class UnofficialOptimizerTests
+{
+    readonly ILogger _logger;
+
+    public UnofficialOptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Theory]
+    // LDA $10, TAX => LAX $10
+    [InlineData("A510AA" + "4C0085", "A710" + "4C0085", 1, 2)]
+    // LDX $10, TXA => LAX $10
+    [InlineData("A6108A" + "4C0085", "A710" + "4C0085", 1, 2)]
+    // LDA $0325, LDX $0325 => LAX $0325
+    [InlineData("AD2503AE2503" + "4C0085", "AF2503" + "4C0085", 3, 4)]
+    // LDA $2002, LDX $2002 reads PPU_STATUS twice
+    [InlineData("AD0220AE0220" + "4C0085", "AD0220AE0220" + "4C0085", 0, 0)]
+    // LDA #$01, TAX: there is no stable immediate LAX
+    [InlineData("A901AA" + "4C0085", "A901AA" + "4C0085", 0, 0)]
+    // AND #$FE, LSR A => ALR #$FE
+    [InlineData("29FE4A" + "4C0085", "4BFE" + "4C0085", 1, 2)]
+    // AND #$0F, CLC => ANC #$0F
+    [InlineData("290F18" + "4C0085", "0B0F" + "4C0085", 1, 2)]
+    // AND #$8F, CLC: ANC would set the carry from bit 7
+    [InlineData("298F18" + "4C0085", "298F18" + "4C0085", 0, 0)]
+    // TXA, CLC, ADC #$04, TAX, then A is loaded => LDA #$FF, AXS #$FC
+    [InlineData("8A186904AA" + "A900" + "4C0085", "A9FFCBFC" + "A900" + "4C0085", 1, 4)]
+    // TXA, CLC, ADC #$04, TAX, then a tail call reads A => LDA #$FF, AXS #$FC, TXA
+    [InlineData("8A186904AA" + "4C0085", "A9FFCBFC8A" + "4C0085", 0, 2)]
+    // TXA, SEC, SBC #$04, TAX, then A is stored => LDA #$FF, AXS #$04, TXA
+    [InlineData("8A38E904AA" + "8D0002" + "4C0085", "A9FFCB048A" + "8D0002" + "4C0085", 0, 2)]
+    public void Optimize(string code, string expected, int bytes, int cycles)
+    {
+        var optimizer = new UnofficialOptimizer(_logger);
+        var removed = new List<(int Offset, int Length)>();
+        var actual = optimizer.Optimize(Convert.FromHexString(code), removed);
+
+        Assert.Equal(expected, Convert.ToHexString(actual));
+        Assert.Equal(bytes, optimizer.BytesSaved);
+        Assert.Equal(cycles, optimizer.CyclesSaved);
+        Assert.Equal(bytes, removed.Sum(r => r.Length));
+        Assert.Equal(expected == code ? 0 : 1, optimizer.Uses.Count);
+    }
+
+    [Theory]
+    // LDA $10, TAX => LAX $10
+    [InlineData("A510AA", "A710", (int)Outputs.All)]
+    // LDA $10, LDX $10 => LAX $10
+    [InlineData("A510A610", "A710", (int)Outputs.All)]
+    // AND #$FE, LSR A => ALR #$FE
+    [InlineData("29FE4A", "4BFE", (int)Outputs.All)]
+    // AND #$0F, CLC => ANC #$0F
+    [InlineData("290F18", "0B0F", (int)Outputs.All)]
+    // TXA, CLC, ADC #$04, TAX => LDA #$FF, AXS #$FC
+    [InlineData("8A186904AA", "A9FFCBFC", (int)(Outputs.All & ~Outputs.A & ~Outputs.Overflow))]
+    // TXA, SEC, SBC #$04, TAX => LDA #$FF, AXS #$04, TXA
+    [InlineData("8A38E904AA", "A9FFCB048A", (int)(Outputs.All & ~Outputs.Overflow))]
+    // DEC $10, CMP $10 => DCP $10
+    [InlineData("C610C510", "C710", (int)Outputs.All)]
+    // INC $10, SBC $10 => ISC $10
+    [InlineData("E610E510", "E710", (int)Outputs.All)]
+    // LDA #$FF, SAX $10 => LDA #$FF, STX $10
+    [InlineData("A9FF8710", "A9FF8610", (int)Outputs.All)]
+    public void Verify(string code, string replacement, int preserves)
+    {
+        var superoptimizer = new Superoptimizer(_logger);
+        Assert.Equal((Outputs)preserves, superoptimizer.Verify(Convert.FromHexString(code), Convert.FromHexString(replacement)));
+    }
+
+    [Theory]
+    [InlineData("hello")]
+    [InlineData("onelocal")]
+    [InlineData("attributetable")]
+    public void Write(string name)
+    {
+        using var officialDll = Utilities.GetResource($"{name}.release.dll");
+        using var unofficialDll = Utilities.GetResource($"{name}.release.dll");
+        var official = Utilities.Transpile(officialDll, _logger, il => il.CodeOptimizations = CodeOptimizations.All);
+        var actual = Utilities.Transpile(unofficialDll, _logger, il => il.CodeOptimizations = CodeOptimizations.All | CodeOptimizations.Unofficial);
+
+        // The samples load constants and 16-bit locals, which none of the rewrites apply to yet
+        AssertEx.Equal(official, actual);
+    }
+}
@@ -1,4 +1,8 @@
-﻿namespace dotnes.tests;
+﻿using System.Runtime.CompilerServices;
+using Microsoft.CodeAnalysis;
+using Microsoft.CodeAnalysis.CSharp;
+
+namespace dotnes.tests;
 
 class Utilities
 {
@@ -10,6 +14,125 @@ class Utilities
         return stream;
     }
 
+    /// <summary>
+    /// The framework and neslib, what a dotnes project compiles against
+    /// </summary>
+    public static IEnumerable<MetadataReference> References => ((string)AppContext.GetData("TRUSTED_PLATFORM_ASSEMBLIES")!)
+        .Split(Path.PathSeparator)
+        .Select(p => MetadataReference.CreateFromFile(p))
+        .Append(MetadataReference.CreateFromFile(typeof(NESLib).Assembly.Location));
+
+    /// <summary>
+    /// Compiles C# source in Release, like the samples
+    /// </summary>
+    public static MemoryStream Compile(string source, string assemblyName = "program", OutputKind kind = OutputKind.ConsoleApplication, IEnumerable<MetadataReference>? references = null)
+    {
+        var compilation = CSharpCompilation.Create(assemblyName,
+            new[] { CSharpSyntaxTree.ParseText(source) },
+            references ?? References,
+            new CSharpCompilationOptions(kind, optimizationLevel: OptimizationLevel.Release, allowUnsafe: true));
+
+        var dll = new MemoryStream();
+        var result = compilation.Emit(dll);
+        Assert.True(result.Success, string.Join(Environment.NewLine, result.Diagnostics));
+        dll.Position = 0;
+        return dll;
+    }
+
+    /// <summary>
+    /// Transpiles a program with chr_generic.s as its CHR ROM, and returns the ROM
+    /// </summary>
+    /// <param name="configure">Sets options of the Transpiler before it writes, such as its optimizations</param>
+    public static byte[] Transpile(Stream dll, ILogger logger, Action<Transpiler>? configure = null)
+    {
+        var chr_generic = new StreamReader(GetResource("chr_generic.s"));
+        using var il = new Transpiler(dll, new[] { new AssemblyReader(chr_generic) }, logger);
+        configure?.Invoke(il);
+        using var ms = new MemoryStream();
+        il.Write(ms);
+        return ms.ToArray();
+    }
+
+    /// <summary>
+    /// Runs a ROM from reset to `while (true) ;` and returns the writes to PPU_ADDR and PPU_DATA, and the palette buffer
+    /// </summary>
+    public static (List<(ushort, byte)> Writes, byte[] Palette) RunToLoop(byte[] rom)
+    {
+        var writes = new List<(ushort, byte)>();
+        var cpu = RunToLoop(rom, (_, address, value) => writes.Add((address, value)));
+        return (writes, cpu.Memory.Skip(0x01C0).Take(32).ToArray());
+    }
+
+    /// <summary>
+    /// Runs a ROM from reset to `while (true) ;`, with an NMI every frame once it is enabled
+    /// </summary>
+    /// <param name="onWrite">Called for each write to PPU_ADDR and PPU_DATA</param>
+    /// <param name="fill">Value of RAM before reset, which is not cleared on power up</param>
+    public static NESCpu RunToLoop(byte[] rom, Action<NESCpu, ushort, byte> onWrite, byte fill = 0)
+    {
+        const int CyclesPerFrame = 29781;
+        var cpu = new NESCpu();
+        Array.Fill(cpu.Memory, fill, 0, 0x0800);
+        cpu.WriteRegister = (address, value) =>
+        {
+            if (address is 0x2006 or 0x2007)
+                onWrite(cpu, address, value);
+        };
+        cpu.ReadRegister = address => address == 0x2002 ? (byte)0x80 : cpu.Memory[address];
+        Array.Copy(rom, 16, cpu.Memory, 0x8000, 2 * NESWriter.PRG_ROM_BLOCK_SIZE);
+        cpu.Reset();
+        long frame = CyclesPerFrame;
+        while (cpu.Memory[cpu.PC] != (byte)NESInstruction.JMP_abs || (cpu.Memory[cpu.PC + 1] | cpu.Memory[cpu.PC + 2] << 8) != cpu.PC)
+        {
+            cpu.Step();
+            if (cpu.Cycles >= frame)
+            {
+                frame += CyclesPerFrame;
+                if ((cpu.Memory[0x2000] & 0x80) != 0)
+                    cpu.NMI();
+            }
+            if (cpu.Cycles > 60 * CyclesPerFrame)
+                throw new InvalidOperationException($"while (true) was not reached, PC=${cpu.PC:X4}");
+        }
+        return cpu;
+    }
+
+    /// <summary>
+    /// A CPU with the built-ins and an empty main at $8000, a NESObject linked at address, and RAM cleared as after reset
+    /// </summary>
+    public static (NESCpu Cpu, Dictionary<string, ushort> Routines) Load(NESObject obj, ushort address = 0x9000)
+    {
+        var cpu = new NESCpu();
+        using (var stream = new MemoryStream())
+        {
+            using (var writer = new NESWriter(stream, leaveOpen: true))
+            {
+                writer.WriteBuiltIns(sizeOfMain: 0);
+                writer.WriteFinalBuiltIns(0x85AE, locals: 0);
+            }
+            stream.ToArray().CopyTo(cpu.Memory, 0x8000);
+        }
+        Array.Copy(obj.Link(address, sizeOfMain: 0), 0, cpu.Memory, address, obj.Length);
+        // The C stack starts at $0700, as startup sets sp
+        cpu.Memory[0x22 + 1] = 0x07;
+        return (cpu, obj.GetAddresses(address));
+    }
+
+    /// <summary>
+    /// Calls a routine with a JSR from just below $8000, with A and X set if given
+    /// </summary>
+    public static void Call(NESCpu cpu, ushort routine, byte? a = null, byte? x = null)
+    {
+        cpu.A = a ?? cpu.A;
+        cpu.X = x ?? cpu.X;
+        cpu.Run([(byte)NESInstruction.JSR, (byte)(routine & 0xFF), (byte)(routine >> 8)], 0x8000 - 3);
+    }
+
+    /// <summary>
+    /// The dotnes.tests directory, for tests that regenerate files in the repo
+    /// </summary>
+    public static string GetSourceDirectory([CallerFilePath] string path = "") => Path.GetDirectoryName(path)!;
+
     public static byte[] ToByteArray(string text)
     {
         ArgumentNullException.ThrowIfNull(text);
@@ -0,0 +1,75 @@
+﻿using Xunit.Abstractions;
+
+namespace dotnes.tests;
+
+public class ZeroPageOptimizerTests
+{
+    readonly ILogger _logger;
+
+    public ZeroPageOptimizerTests(ITestOutputHelper output) => _logger = new XUnitLogger(output);
+
+    [Theory]
+    // LDA $0325, STA $0325 => LDA $40, STA $40
+    [InlineData("AD25038D2503", "A54085" + "40", 2, 2)]
+    // LDA $0326 was not placed
+    [InlineData("AD2603", "AD2603", 0, 0)]
+    // LDA $0325,X could be any local
+    [InlineData("AD2503BD2403", "AD2503BD2403", 0, 0)]
+    // JMP $0325 has no zero page form, so $0325 stays
+    [InlineData("AD25034C2503", "AD25034C2503", 0, 0)]
+    public void Optimize(string code, string expected, int bytes, int cycles)
+    {
+        var optimizer = new ZeroPageOptimizer(_logger);
+        var removed = new List<(int Offset, int Length)>();
+        var placement = new Dictionary<ushort, byte> { [0x0325] = 0x40 };
+        var actual = optimizer.Optimize(Convert.FromHexString(code), placement, removed);
+
+        Assert.Equal(expected, Convert.ToHexString(actual));
+        Assert.Equal(bytes, optimizer.BytesSaved);
+        Assert.Equal(cycles, optimizer.CyclesSaved);
+        Assert.Equal(bytes, removed.Sum(r => r.Length));
+    }
+
+    [Fact]
+    public void GetPlacement()
+    {
+        var profile = new NESProfile();
+        profile.RAM[0x0024] = 1000;
+        profile.RAM[0x0324] = 5;
+        profile.RAM[0x0325] = 50;
+        profile.RAM[0x0700] = 500;
+
+        profile.RAM[0x0326] = 100;
+
+        var placement = ZeroPageOptimizer.GetPlacement(profile, new ushort[] { 0x0024, 0x0324, 0x0325, 0x0700 });
+
+        Assert.Equal(2, placement.Count);
+        Assert.Equal(IL2NESWriter.zeroPageLocal, placement[0x0325]);
+        Assert.Equal(IL2NESWriter.zeroPageLocal + 1, placement[0x0324]);
+    }
+
+    [Fact]
+    public void Write_Profile()
+    {
+        using var rom = Utilities.GetResource("onelocal.nes");
+        var expected = new byte[rom.Length];
+        rom.Read(expected, 0, expected.Length);
+        var profile = new Profiler(expected, _logger) { Frames = 10 }.Run();
+
+        using var dll = Utilities.GetResource("onelocal.release.dll");
+        var actual = Utilities.Transpile(dll, _logger, il =>
+        {
+            il.CodeOptimizations = CodeOptimizations.ZeroPage;
+            il.Profile = profile;
+        });
+
+        Assert.Equal(expected.Length, actual.Length);
+        Assert.NotEqual(Convert.ToHexString(expected), Convert.ToHexString(actual));
+
+        // Startup still clears the first local at $0325, main uses zero page instead
+        const ushort first = IL2NESWriter.local + 1;
+        var after = new Profiler(actual, _logger) { Frames = 10 }.Run();
+        Assert.True(after.RAM[first] < profile.RAM[first]);
+        Assert.True(after.RAM.ContainsKey(IL2NESWriter.zeroPageLocal));
+    }
+}
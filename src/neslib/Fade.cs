@@ -0,0 +1,41 @@
+﻿namespace NES;
+
+/// <summary>
+/// Fades the palette through the brightness levels of pal_bright, 0 is black, 4 is normal, 8 is white.
+/// The palette is uploaded in the NMI only on the frames the level changes, such as `Fade.To(0, 4);` to fade out.
+/// </summary>
+public static class Fade
+{
+    /// <summary>
+    /// Steps the brightness one level every number of frames until it is level, 0 sets it at once.
+    /// Returns when it is there, the screen has to be on.
+    /// </summary>
+    [NESBuiltIn("_fade_to", 0, Arguments = NESRegisters.A, Cycles = 39)]
+    public static void To(byte level, byte frames) { }
+
+    /// <summary>
+    /// Starts a fade like To that Update steps, for a game loop that keeps running while it fades
+    /// </summary>
+    [NESBuiltIn("_fade_start", 0, Arguments = NESRegisters.A, Cycles = 30)]
+    public static void Start(byte level, byte frames) { }
+
+    /// <summary>
+    /// Steps a fade started by Start, call it once per frame. It does nothing until Start is called.
+    /// </summary>
+    [NESBuiltIn("_fade_update", 0, Cycles = 50)]
+    public static void Update() { }
+
+    /// <summary>
+    /// Fades through custom color tables instead of the ones of pal_bright: 9 tables of 64 bytes, for levels 0 to 8.
+    /// Each maps a color of the palette to the color shown at its level, such as a fade to red.
+    /// The background and the sprites both use them, until SetSpriteTables.
+    /// </summary>
+    [NESBuiltIn("_fade_set_tables", 0, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 115)]
+    public static void SetTables(byte[] tables) { }
+
+    /// <summary>
+    /// Fades the sprites through their own custom color tables, laid out as for SetTables, after SetTables set those of the background
+    /// </summary>
+    [NESBuiltIn("_fade_set_sprite_tables", 0, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 107)]
+    public static void SetSpriteTables(byte[] tables) { }
+}
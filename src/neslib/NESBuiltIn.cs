@@ -0,0 +1,89 @@
+﻿namespace NES;
+
+/// <summary>
+/// How arguments reach a NESLib routine
+/// </summary>
+public enum NESCallingConvention
+{
+    /// <summary>
+    /// cc65's __fastcall__: the last argument is in A, or A and X, the others are pushed on the C stack
+    /// </summary>
+    FastCall = 0,
+    /// <summary>
+    /// Computed by the transpiler at build time, there is no routine to call
+    /// </summary>
+    Intrinsic = 1,
+}
+
+/// <summary>
+/// 6502 registers, used to describe the arguments and side effects of a NESLib routine
+/// </summary>
+[Flags]
+public enum NESRegisters
+{
+    None = 0,
+    A = 1,
+    X = 2,
+    Y = 4,
+    All = A | X | Y,
+}
+
+/// <summary>
+/// Binds a NESLib method to the routine the transpiler calls, such as `[NESBuiltIn("_pal_col", 0x823E)]`
+/// </summary>
+[AttributeUsage(AttributeTargets.Method, Inherited = false)]
+public sealed class NESBuiltInAttribute : Attribute
+{
+    /// <summary>
+    /// An intrinsic, with no routine to call
+    /// </summary>
+    public NESBuiltInAttribute() => CallingConvention = NESCallingConvention.Intrinsic;
+
+    public NESBuiltInAttribute(string symbol, ushort address)
+    {
+        Symbol = symbol;
+        Address = address;
+    }
+
+    /// <summary>
+    /// Label of the routine in neslib.sinc or crt0.s
+    /// </summary>
+    public string? Symbol { get; }
+
+    /// <summary>
+    /// Address of the routine in PRG_ROM, or 0 for a routine linked after the destructor table only if it is called
+    /// </summary>
+    public ushort Address { get; }
+
+    public NESCallingConvention CallingConvention { get; set; }
+
+    /// <summary>
+    /// Registers holding the last argument
+    /// </summary>
+    public NESRegisters Arguments { get; set; }
+
+    /// <summary>
+    /// Registers that do not have the same value on return
+    /// </summary>
+    public NESRegisters Clobbers { get; set; } = NESRegisters.All;
+
+    /// <summary>
+    /// Value of A on return, or -1 if it is not known
+    /// </summary>
+    public int A { get; set; } = -1;
+
+    /// <summary>
+    /// Value of X on return, or -1 if it is not known
+    /// </summary>
+    public int X { get; set; } = -1;
+
+    /// <summary>
+    /// Value of Y on return, or -1 if it is not known
+    /// </summary>
+    public int Y { get; set; } = -1;
+
+    /// <summary>
+    /// Cycles of one pass through the routine including the RTS, not counting loops, or 0 if it is not known
+    /// </summary>
+    public int Cycles { get; set; }
+}
@@ -16,41 +16,49 @@ public static class NESLib
     /// <summary>
     /// set bg and spr palettes, data is 32 bytes array
     /// </summary>
+    [NESBuiltIn("_pal_all", 0x8211, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 47)]
     public static void pal_all(byte[] data) { }
 
     /// <summary>
     /// set bg palette only, data is 16 bytes array
     /// </summary>
+    [NESBuiltIn("_pal_bg", 0x822B, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 76)]
     public static void pal_bg(byte[] data) { }
 
     /// <summary>
     /// set spr palette only, data is 16 bytes array
     /// </summary>
+    [NESBuiltIn("_pal_spr", 0x8235, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 64)]
     public static void pal_spr(byte[] data) { }
 
     /// <summary>
     /// set a palette entry, index is 0..31
     /// </summary>
+    [NESBuiltIn("_pal_col", 0x823E, Arguments = NESRegisters.A, Clobbers = NESRegisters.X | NESRegisters.Y, Y = 0, Cycles = 52)]
     public static void pal_col(byte index, byte color) { }
 
     /// <summary>
     /// reset palette to $0f
     /// </summary>
+    [NESBuiltIn("_pal_clear", 0x824E, Clobbers = NESRegisters.A | NESRegisters.X, A = 0x0F, X = 0x20, Cycles = 24)]
     public static void pal_clear() { }
 
     /// <summary>
     /// set virtual bright both for sprites and background, 0 is black, 4 is normal, 8 is white
     /// </summary>
+    [NESBuiltIn("_pal_bright", 0x8279, Arguments = NESRegisters.A, Cycles = 61)]
     public static void pal_bright(byte bright) { }
 
     /// <summary>
     /// set virtual bright for sprites only
     /// </summary>
+    [NESBuiltIn("_pal_spr_bright", 0x825D, Arguments = NESRegisters.A, Clobbers = NESRegisters.A | NESRegisters.X, Cycles = 25)]
     public static void pal_spr_bright(byte bright) { }
 
     /// <summary>
     /// set virtual bright for sprites background only
     /// </summary>
+    [NESBuiltIn("_pal_bg_bright", 0x826B, Arguments = NESRegisters.A, Cycles = 25)]
     public static void pal_bg_bright(byte bright) { }
 
 
@@ -60,67 +68,80 @@ public static class NESLib
     /// <summary>
     /// wait actual TV frame, 50hz for PAL, 60hz for NTSC
     /// </summary>
+    [NESBuiltIn("_ppu_wait_nmi", 0x82F0, Cycles = 19)]
     public static void ppu_wait_nmi() { }
 
     /// <summary>
     /// wait virtual frame, it is always 50hz, frame-to-frame in PAL, frameskip in NTSC
     /// </summary>
+    [NESBuiltIn("_ppu_wait_frame", 0x82DB, Clobbers = NESRegisters.A, Cycles = 31)]
     public static void ppu_wait_frame() { }
 
     /// <summary>
     /// turn off rendering, nmi still enabled when rendering is disabled
     /// </summary>
+    [NESBuiltIn("_ppu_off", 0x8280, Cycles = 30)]
     public static void ppu_off() { }
 
     /// <summary>
     /// turn on bg, spr
     /// </summary>
+    [NESBuiltIn("_ppu_on_all", 0x8289, Cycles = 30)]
     public static void ppu_on_all() { }
 
     /// <summary>
     /// turn on bg only
     /// </summary>
+    [NESBuiltIn("_ppu_on_bg", 0x8292, Cycles = 23)]
     public static void ppu_on_bg() { }
 
     /// <summary>
     /// turn on spr only
     /// </summary>
+    [NESBuiltIn("_ppu_on_spr", 0x8298, Cycles = 16)]
     public static void ppu_on_spr() { }
 
     /// <summary>
     /// set PPU_MASK directly
     /// </summary>
+    [NESBuiltIn("_ppu_mask", 0x829E, Arguments = NESRegisters.A, Cycles = 9)]
     public static void ppu_mask(byte mask) { }
 
     /// <summary>
     /// get current video system, 0 for PAL, not 0 for NTSC
     /// </summary>
+    [NESBuiltIn("_ppu_system", 0x82A1, Cycles = 11)]
     public static byte ppu_system() => default;
 
     /// <summary>
     /// Return an 8-bit counter incremented at each vblank
     /// </summary>
+    [NESBuiltIn("_nesclock", 0x8415, Clobbers = NESRegisters.A | NESRegisters.X, X = 0, Cycles = 11)]
     public static byte nesclock() => default;
 
     /// <summary>
     /// get the internal ppu ctrl cache var for manual writing
     /// </summary>
+    [NESBuiltIn("_get_ppu_ctrl_var", 0x82A6, Cycles = 11)]
     public static byte get_ppu_ctrl_var() => default;
 
     /// <summary>
     /// set the internal ppu ctrl cache var for manual writing
     /// </summary>
+    [NESBuiltIn("_set_ppu_ctrl_var", 0x82AB, Arguments = NESRegisters.A, Clobbers = NESRegisters.None, Cycles = 9)]
     public static void set_ppu_ctrl_var(byte var) { }
 
 
     /// <summary>
     /// clear OAM buffer, all the sprites are hidden
     /// </summary>
+    [NESBuiltIn("_oam_clear", 0x82AE, Clobbers = NESRegisters.A | NESRegisters.X, A = 0xFF, X = 0, Cycles = 25)]
     public static void oam_clear() { }
 
     /// <summary>
     /// set sprite display mode, 0 for 8x8 sprites, 1 for 8x16 sprites
     /// </summary>
+    [NESBuiltIn("_oam_size", 0x82BC, Arguments = NESRegisters.A, Clobbers = NESRegisters.A, Cycles = 32)]
     public static void oam_size(byte size) { }
 
     /// <summary>
@@ -141,37 +162,45 @@ public static class NESLib
     /// <summary>
     /// hide all remaining sprites from given offset
     /// </summary>
+    [NESBuiltIn("_oam_hide_rest", 0x82CE, Arguments = NESRegisters.A, Clobbers = NESRegisters.A | NESRegisters.X, A = 0xF0, X = 0, Cycles = 25)]
     public static void oam_hide_rest(byte sprid) { }
 
 
     /// <summary>
     /// set vram pointer to write operations if you need to write some data to vram
     /// </summary>
+    [NESBuiltIn("_vram_adr", 0x83D4, Arguments = NESRegisters.A | NESRegisters.X, Clobbers = NESRegisters.None, Cycles = 14)]
     public static void vram_adr(ushort adr) { }
 
     /// <summary>
     /// put a byte at current vram address, works only when rendering is turned off
     /// </summary>
+    [NESBuiltIn("_vram_put", 0x83DB, Arguments = NESRegisters.A, Clobbers = NESRegisters.None, Cycles = 10)]
     public static void vram_put(byte n) { }
 
     /// <summary>
     /// fill a block with a byte at current vram address, works only when rendering is turned off
     /// </summary>
+    [NESBuiltIn("_vram_fill", 0x83DF, Arguments = NESRegisters.A | NESRegisters.X, X = 0, Y = 0, Cycles = 73)]
     public static void vram_fill(byte n, uint len) { }
 
     /// <summary>
     /// set vram autoincrement, 0 for +1 and not 0 for +32
     /// </summary>
+    [NESBuiltIn("_vram_inc", 0x8401, Arguments = NESRegisters.A, Cycles = 30)]
     public static void vram_inc(byte n) { }
 
     /// <summary>
-    /// write a block to current address of vram, works only when rendering is turned off
+    /// write a block to current address of vram, works only when rendering is turned off.
+    /// The holes of an interpolated string are written as digits at the same address, also only with rendering off.
     /// </summary>
+    [NESBuiltIn("_vram_write", 0x834F, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 106)]
     public static void vram_write(string src) { }
 
     /// <summary>
     /// write a block to current address of vram, works only when rendering is turned off
     /// </summary>
+    [NESBuiltIn("_vram_write", 0x834F, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 106)]
     public static void vram_write(byte[] src) { }
 
     /// <summary>
@@ -182,12 +211,14 @@ public static class NESLib
     /// <summary>
     /// delay for N frames
     /// </summary>
+    [NESBuiltIn("_delay", 0x841A, Arguments = NESRegisters.A, Cycles = 37)]
     public static void delay(byte frames) { }
 
     /// <summary>
     /// set scroll, including rhe top bits
     /// it is always applied at beginning of a TV frame, not at the function call
     /// </summary>
+    [NESBuiltIn("_scroll", 0x82FB, Arguments = NESRegisters.A | NESRegisters.X, Cycles = 111)]
     public static void scroll(int x, int y) { }
 
     /// <summary>
@@ -203,29 +234,37 @@ public static class NESLib
     /// <summary>
     /// select current chr bank for sprites, 0..1
     /// </summary>
+    [NESBuiltIn("_bank_spr", 0x832E, Arguments = NESRegisters.A, Cycles = 28)]
     public static void bank_spr(byte n) { }
 
     /// <summary>
     /// select current chr bank for background, 0..1
     /// </summary>
+    [NESBuiltIn("_bank_bg", 0x833E, Arguments = NESRegisters.A, Cycles = 30)]
     public static void bank_bg(byte n) { }
 
     /// <summary>
     /// get random number 0..255, same as rand8()
     /// </summary>
+    // No Cycles, NESRandomTable picks the routine: 41 cycles for the LFSRs, 18 for the table
+    [NESBuiltIn("_rand8", 0, Clobbers = NESRegisters.A | NESRegisters.X)]
     public static byte rand() => default;
     /// <summary>
     /// get random number 0..255
     /// </summary>
+    // No Cycles, NESRandomTable picks the routine: 41 cycles for the LFSRs, 18 for the table
+    [NESBuiltIn("_rand8", 0, Clobbers = NESRegisters.A | NESRegisters.X)]
     public static byte rand8() => default;
     /// <summary>
     /// get random number 0..65535
     /// </summary>
+    [NESBuiltIn("_rand16", 0, Clobbers = NESRegisters.A | NESRegisters.X, Cycles = 42)]
     public static ushort rand16() => default;
 
     /// <summary>
     /// set random seed
     /// </summary>
+    [NESBuiltIn("_set_rand", 0, Arguments = NESRegisters.A | NESRegisters.X, Clobbers = NESRegisters.None, Cycles = 12)]
     public static void set_rand(ushort seed) { }
 
     /// <summary>
@@ -245,6 +284,7 @@ public static class NESLib
     ///
     /// length of this data should be under 256 bytes
     /// </summary>
+    [NESBuiltIn("_set_vram_update", 0x8376, Arguments = NESRegisters.A | NESRegisters.X, Clobbers = NESRegisters.A, Cycles = 18)]
     public static void set_vram_update(byte[] buf) { }
 
     // all following vram functions only work when display is disabled
@@ -252,6 +292,7 @@ public static class NESLib
     /// <summary>
     /// do a series of VRAM writes, the same format as for set_vram_update, but writes done right away
     /// </summary>
+    [NESBuiltIn("_flush_vram_update", 0x837F, Arguments = NESRegisters.A | NESRegisters.X)]
     public static void flush_vram_update(byte[] buf) { }
 
     // These are from: https://github.com/mhughson/attributes/blob/master/neslib.h
@@ -267,24 +308,28 @@ public static class NESLib
     /// macro to calculate nametable address from X,Y in compile time
     /// #define NTADR_A(x,y)	 	(NAMETABLE_A|(((y)<<5)|(x)))
     /// </summary>
+    [NESBuiltIn]
     public static ushort NTADR_A(byte x, byte y) => (ushort)(NAMETABLE_A | ((y << 5) | x));
 
     /// <summary>
     /// macro to calculate nametable address from X,Y in compile time
     /// #define NTADR_B(x,y) 		(NAMETABLE_B|(((y)<<5)|(x)))
     /// </summary>
+    [NESBuiltIn]
     public static ushort NTADR_B(byte x, byte y) => (ushort)(NAMETABLE_B | ((y << 5) | x));
 
     /// <summary>
     /// macro to calculate nametable address from X,Y in compile time
     /// #define NTADR_C(x,y) 		(NAMETABLE_C|(((y)<<5)|(x)))
     /// </summary>
+    [NESBuiltIn]
     public static ushort NTADR_C(byte x, byte y) => (ushort)(NAMETABLE_C | ((y << 5) | x));
 
     /// <summary>
     /// macro to calculate nametable address from X,Y in compile time
     /// #define NTADR_D(x,y) 		(NAMETABLE_D|(((y)<<5)|(x)))
     /// </summary>
+    [NESBuiltIn]
     public static ushort NTADR_D(byte x, byte y) => (ushort)(NAMETABLE_D | ((y << 5) | x));
 
     /// <summary>
@@ -0,0 +1,35 @@
+﻿namespace NES;
+
+/// <summary>
+/// How the transpiler trades code size for speed, set per project with the NESOptimization MSBuild property
+/// </summary>
+public enum NESOptimization
+{
+    /// <summary>
+    /// Code is transpiled as written
+    /// </summary>
+    None = 0,
+    /// <summary>
+    /// Smallest code, even when it is slower
+    /// </summary>
+    Size = 1,
+    /// <summary>
+    /// Fastest code, never traded for size
+    /// </summary>
+    Speed = 2,
+    /// <summary>
+    /// Trades a few cycles only where it saves enough bytes
+    /// </summary>
+    Balanced = 3,
+}
+
+/// <summary>
+/// Overrides the project's NESOptimization for a method, such as `[NESOptimization(NESOptimization.Speed)]` on Main
+/// </summary>
+[AttributeUsage(AttributeTargets.Method, Inherited = false)]
+public sealed class NESOptimizationAttribute : Attribute
+{
+    public NESOptimizationAttribute(NESOptimization optimization) => Optimization = optimization;
+
+    public NESOptimization Optimization { get; }
+}
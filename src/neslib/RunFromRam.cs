@@ -0,0 +1,13 @@
+﻿namespace NES;
+
+/// <summary>
+/// Copies a built-in to RAM at startup and calls it there, where it patches its own operands instead of
+/// using indirect addressing, such as `[RunFromRam(nameof(vram_write))]` on Main
+/// </summary>
+[AttributeUsage(AttributeTargets.Method, AllowMultiple = true, Inherited = false)]
+public sealed class RunFromRamAttribute : Attribute
+{
+    public RunFromRamAttribute(string name) => Name = name;
+
+    public string Name { get; }
+}